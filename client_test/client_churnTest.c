@@ -0,0 +1,298 @@
+/*
+ * client_churnTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Connection churn against the echo server (SERVERapp, raw mode): every worker connects, sends one request, waits for
+ *  its answer and closes, again and again. Reports connections per second and the latency of the first request on a
+ *  fresh connection (connect included).
+ *  It runs once for every level of the server capacity (-m, as SERVERapp -m), with that share of the capacity held
+ *  by idle connections. Near the top the server evicts (KillOldestClient) and refuses (over capacity), which is where
+ *  the accept path is stressed. Holders still alive at the end of a level tell how many were evicted.
+ *  With -r the workers close with a reset, so the client side does not run out of ports in TIME_WAIT.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "tcp_client.h"
+
+#define DEFAULT_CAPACITY 1000 /* SERVERapp default */
+#define DEFAULT_WORKERS 4
+#define MAX_WORKERS 256
+#define DEFAULT_LEVEL_SEC 3
+#define START_SAMPLES 4096
+#define ANSWER_TIMEOUT_SEC 2
+
+static const char REQUEST[] = "churn";
+/* share of the capacity held idle, in percent */
+static const uint LEVELS[] = {0, 50, 90, 98, 100, 110};
+
+typedef struct Worker
+{
+	pthread_t m_thread;
+	unsigned long m_connections;
+	unsigned long m_failed;
+	uint64_t* m_latencyUS;
+	unsigned long m_samplesCapacity;
+} Worker_t;
+
+/* global for sigaction */
+bool g_isClientRun = TRUE;
+char g_serverIP[16] = "127.0.0.1";
+uint g_serverPort = 4848;
+bool g_isReset = FALSE;
+uint64_t g_endUS;
+
+void sigAbortHandler(int dummy)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit\n\n";
+	write(STDOUT_FILENO, notify, strlen(notify));
+
+	g_isClientRun = FALSE;
+
+	return;
+}
+
+static uint64_t NowUS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* connect, one request and its answer. the open client, or NULL */
+static TCP_C_t* Connect(void)
+{
+	struct timeval timeout = {ANSWER_TIMEOUT_SEC, 0};
+	char answer[sizeof(REQUEST)];
+	uint got = 0;
+	int length;
+	TCP_C_t* client;
+
+	client = TCP_CreateClient(g_serverIP, g_serverPort);
+	if (! client)
+	{
+		return NULL;
+	}
+	setsockopt(TCP_ClientGetSocket(client), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) );
+
+	if (TCP_ClientSend(client, (void*) REQUEST, sizeof(REQUEST) ) != sizeof(REQUEST) )
+	{
+		TCP_DestroyClient(client);
+		return NULL;
+	}
+	/* the echo server answers with as many bytes. a refused or evicted connection reads 0 */
+	while (got < sizeof(REQUEST) )
+	{
+		length = recv(TCP_ClientGetSocket(client), answer + got, sizeof(REQUEST) - got, 0);
+		if (length <= 0)
+		{
+			TCP_DestroyClient(client);
+			return NULL;
+		}
+		got += length;
+	}
+	return client;
+}
+
+static void Close(TCP_C_t* _client)
+{
+	struct linger reset = {1, 0};
+
+	if (g_isReset)
+	{
+		setsockopt(TCP_ClientGetSocket(_client), SOL_SOCKET, SO_LINGER, &reset, sizeof(reset) );
+	}
+	TCP_DestroyClient(_client);
+}
+
+static void* Churn(void* _worker)
+{
+	Worker_t* worker = _worker;
+	uint64_t* bigger;
+	uint64_t startUS;
+	TCP_C_t* client;
+
+	while (g_isClientRun && (startUS = NowUS()) < g_endUS)
+	{
+		client = Connect();
+		if (! client)
+		{
+			worker->m_failed++;
+			continue;
+		}
+
+		if (worker->m_connections == worker->m_samplesCapacity)
+		{
+			worker->m_samplesCapacity = worker->m_samplesCapacity ? worker->m_samplesCapacity * 2 : START_SAMPLES;
+			bigger = realloc(worker->m_latencyUS, worker->m_samplesCapacity * sizeof(uint64_t) );
+			if (! bigger)
+			{
+				Close(client);
+				break;
+			}
+			worker->m_latencyUS = bigger;
+		}
+		worker->m_latencyUS[worker->m_connections++] = NowUS() - startUS;
+		Close(client);
+	}
+	return NULL;
+}
+
+static int CompareUS(const void* _a, const void* _b)
+{
+	uint64_t a = *(const uint64_t*) _a;
+	uint64_t b = *(const uint64_t*) _b;
+
+	return (a > b) - (a < b);
+}
+
+static void RunLevel(uint _level, uint _capacity, uint _workersNum, uint _levelSec)
+{
+	uint holdersNum = _capacity * _level / 100;
+	TCP_C_t** holders;
+	uint holdersOpen = 0;
+	uint holdersAlive = 0;
+	Worker_t workers[MAX_WORKERS];
+	unsigned long connections = 0;
+	unsigned long failed = 0;
+	uint64_t* all;
+	uint64_t startUS;
+	uint64_t elapsedUS;
+	uint i;
+
+	holders = calloc(holdersNum + 1, sizeof(TCP_C_t*) );
+	if (! holders)
+	{
+		return;
+	}
+	/* the server refuses holders over its capacity, they count as not open */
+	for (i = 0; g_isClientRun && i < holdersNum; ++i)
+	{
+		holders[i] = Connect();
+		holdersOpen += (holders[i] != NULL);
+	}
+
+	memset(workers, 0, sizeof(workers) );
+	startUS = NowUS();
+	g_endUS = startUS + (uint64_t) _levelSec * 1000000;
+	for (i = 0; i < _workersNum; ++i)
+	{
+		pthread_create(&workers[i].m_thread, NULL, Churn, &workers[i]);
+	}
+	for (i = 0; i < _workersNum; ++i)
+	{
+		pthread_join(workers[i].m_thread, NULL);
+		connections += workers[i].m_connections;
+		failed += workers[i].m_failed;
+	}
+	elapsedUS = NowUS() - startUS;
+
+	for (i = 0; i < holdersNum; ++i)
+	{
+		if (holders[i])
+		{
+			holdersAlive += TCP_ClientIsAlive(holders[i]);
+			Close(holders[i]);
+		}
+	}
+	free(holders);
+
+	all = malloc((connections + 1) * sizeof(uint64_t) );
+	for (i = 0, connections = 0; all && i < _workersNum; ++i)
+	{
+		if (workers[i].m_connections > 0)
+		{
+			memcpy(all + connections, workers[i].m_latencyUS, workers[i].m_connections * sizeof(uint64_t) );
+			connections += workers[i].m_connections;
+		}
+	}
+	for (i = 0; i < _workersNum; ++i)
+	{
+		free(workers[i].m_latencyUS);
+	}
+
+	printf("%4u%% %6u %6u %6u %10.0f %8lu", _level, holdersNum, holdersOpen, holdersAlive, connections * 1e6 / elapsedUS, failed);
+	if (all && connections > 0)
+	{
+		qsort(all, connections, sizeof(uint64_t), CompareUS);
+		printf(" %8lu %8lu %8lu\n", (unsigned long) all[connections / 2], (unsigned long) all[connections * 99 / 100],
+				(unsigned long) all[connections - 1]);
+	}
+	else
+	{
+		printf(" %8s %8s %8s\n", "-", "-", "-");
+	}
+	fflush(stdout);
+	free(all);
+
+	/* the server closes the holders it still had before the next level */
+	sleep(1);
+}
+
+int main(int argc, char* argv[])
+{
+	uint capacity = DEFAULT_CAPACITY;
+	uint workersNum = DEFAULT_WORKERS;
+	uint levelSec = DEFAULT_LEVEL_SEC;
+	int opt;
+	uint i;
+
+	struct sigaction psa;
+	memset(&psa, 0, sizeof(psa));
+	psa.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &psa, NULL);
+	/* a connection the server reset is not a reason to die */
+	signal(SIGPIPE, SIG_IGN);
+
+	while ((opt = getopt(argc, argv, "i:p:m:w:d:r")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i':
+			strncpy(g_serverIP, optarg, sizeof(g_serverIP) - 1);
+			break;
+		case 'p':
+			g_serverPort = atoi(optarg);
+			break;
+		case 'm':
+			capacity = atoi(optarg);
+			break;
+		case 'w':
+			workersNum = atoi(optarg);
+			break;
+		case 'd':
+			levelSec = atoi(optarg);
+			break;
+		case 'r':
+			g_isReset = TRUE;
+			break;
+		default:
+			printf("usage: %s [-i ip] [-p port] [-m server capacity] [-w workers] [-d seconds per level] [-r (close with reset)]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (workersNum < 1 || workersNum > MAX_WORKERS)
+	{
+		workersNum = DEFAULT_WORKERS;
+	}
+
+	printf("--START--\n");
+	printf("%5s %6s %6s %6s %10s %8s %8s %8s %8s\n", "level", "held", "open", "alive", "conn/sec", "failed", "p50 usec", "p99 usec", "max usec");
+	for (i = 0; g_isClientRun && i < sizeof(LEVELS) / sizeof(LEVELS[0]); ++i)
+	{
+		RunLevel(LEVELS[i], capacity, workersNum, levelSec);
+	}
+	printf("--END--\n");
+	return 0;
+}
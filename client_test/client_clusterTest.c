@@ -0,0 +1,223 @@
+/*
+ * client_clusterTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Keys spread over several echo servers (SERVERapp, raw mode, one per port) with a consistent hash cluster. the echo
+ *  server answers with the request, its first byte a '!'.
+ *  First the ring alone: the share of the keys each server owns, and how many keys move when the last server is
+ *  removed and added back. Then requests for random keys, checked against their answers, with a line every second of
+ *  the answers of every server. Stop (kill -INT) a server while it runs to see its keys go to the replicas, and
+ *  start it again to see them come back after the retry time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tcp_cluster.h"
+
+#define MAX_MSG_SIZE 256
+#define RING_KEYS 100000
+#define TRAFFIC_KEYS 10000
+#define DEFAULT_SECONDS 10
+#define RETRY_MS 1000
+#define CONNECT_TIMEOUT_MS 500
+
+/* global for sigaction */
+bool g_isClientRun = TRUE;
+
+void sigAbortHandler(int dummy)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit\n\n";
+	write(STDOUT_FILENO, notify, strlen(notify));
+
+	g_isClientRun = FALSE;
+
+	return;
+}
+
+static uint MakeKey(char* _key, uint _number)
+{
+	return sprintf(_key, "key:%u", _number);
+}
+
+/* the share of every server, and the keys that move when the last one leaves and comes back */
+static void CheckRing(TCP_Cluster_t* _cluster, int* _nodeIDs, uint _nodesNum, const char* _serverIP, uint* _ports)
+{
+	static int owners[RING_KEYS];
+	uint counts[TCP_CLUSTER_MAX_NODES] = {0};
+	char key[32];
+	uint moved = 0;
+	uint movedWrong = 0;
+	uint lastKeys;
+	int owner;
+	uint i;
+
+	for (i = 0; i < RING_KEYS; ++i)
+	{
+		owners[i] = TCP_ClusterOwner(_cluster, key, MakeKey(key, i) );
+		counts[owners[i]]++;
+	}
+	for (i = 0; i < _nodesNum; ++i)
+	{
+		printf("server %s:%u owns %5.2f%% of the keys (even share %5.2f%%)\n", _serverIP, _ports[i],
+				counts[_nodeIDs[i]] * 100.0 / RING_KEYS, 100.0 / _nodesNum);
+	}
+	if (_nodesNum < 2)
+	{
+		return;
+	}
+
+	lastKeys = counts[_nodeIDs[_nodesNum - 1]];
+	TCP_ClusterRemoveNode(_cluster, _nodeIDs[_nodesNum - 1]);
+	for (i = 0; i < RING_KEYS; ++i)
+	{
+		owner = TCP_ClusterOwner(_cluster, key, MakeKey(key, i) );
+		if (owner != owners[i])
+		{
+			++moved;
+			/* only the keys of the server that left may move */
+			movedWrong += (owners[i] != _nodeIDs[_nodesNum - 1]);
+		}
+	}
+	printf("removed %s:%u: %u keys moved (%.2f%%), it owned %u, moved from other servers %u\n", _serverIP, _ports[_nodesNum - 1],
+			moved, moved * 100.0 / RING_KEYS, lastKeys, movedWrong);
+
+	_nodeIDs[_nodesNum - 1] = TCP_ClusterAddNode(_cluster, _serverIP, _ports[_nodesNum - 1]);
+	moved = 0;
+	for (i = 0; i < RING_KEYS; ++i)
+	{
+		/* it takes back its free ID, and its points are of its address, so every key is where it was */
+		moved += (TCP_ClusterOwner(_cluster, key, MakeKey(key, i) ) != owners[i]);
+	}
+	printf("added %s:%u back: %u keys differ from before it left\n", _serverIP, _ports[_nodesNum - 1], moved);
+}
+
+static void Traffic(TCP_Cluster_t* _cluster, int* _nodeIDs, uint _nodesNum, uint* _ports, uint _seconds)
+{
+	unsigned long lastRequests[TCP_CLUSTER_MAX_NODES] = {0};
+	unsigned long requests;
+	unsigned long failures;
+	unsigned long answered = 0;
+	unsigned long failed = 0;
+	unsigned long mismatched = 0;
+	char key[32];
+	char msg[MAX_MSG_SIZE];
+	char answer[MAX_MSG_SIZE];
+	uint keyLength;
+	uint msgLength;
+	int length;
+	bool isUp;
+	time_t end = time(NULL) + _seconds;
+	time_t nextPrint = time(NULL) + 1;
+	uint i;
+
+	while (g_isClientRun && time(NULL) < end)
+	{
+		keyLength = MakeKey(key, rand() % TRAFFIC_KEYS);
+		msgLength = snprintf(msg, sizeof(msg), "GET %s", key);
+		length = TCP_ClusterRequest(_cluster, key, keyLength, msg, msgLength, answer, sizeof(answer), NULL);
+		if (length < 0)
+		{
+			++failed;
+		}
+		else if ((uint) length != msgLength || answer[0] != '!' || memcmp(answer + 1, msg + 1, msgLength - 1) != 0)
+		{
+			++mismatched;
+		}
+		else
+		{
+			++answered;
+		}
+
+		if (time(NULL) >= nextPrint)
+		{
+			nextPrint = time(NULL) + 1;
+			printf("answered %lu, failed %lu, mismatched %lu |", answered, failed, mismatched);
+			for (i = 0; i < _nodesNum; ++i)
+			{
+				TCP_ClusterNodeStatus(_cluster, _nodeIDs[i], &isUp, &requests, &failures);
+				printf(" %u:%s %lu/s", _ports[i], isUp ? "up" : "DOWN", requests - lastRequests[_nodeIDs[i]]);
+				lastRequests[_nodeIDs[i]] = requests;
+			}
+			printf("\n");
+			fflush(stdout);
+			answered = 0;
+			failed = 0;
+			mismatched = 0;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	char serverIP[64] = "127.0.0.1";
+	uint ports[TCP_CLUSTER_MAX_NODES];
+	int nodeIDs[TCP_CLUSTER_MAX_NODES];
+	uint nodesNum = 0;
+	uint seconds = DEFAULT_SECONDS;
+	uint virtualNodes = 0;
+	TCP_Cluster_t* cluster;
+	int opt;
+
+	struct sigaction psa;
+	memset(&psa, 0, sizeof(psa));
+	psa.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &psa, NULL);
+
+	while ((opt = getopt(argc, argv, "i:d:v:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i':
+			strncpy(serverIP, optarg, sizeof(serverIP) - 1);
+			break;
+		case 'd':
+			seconds = atoi(optarg);
+			break;
+		case 'v':
+			virtualNodes = atoi(optarg);
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+	if (optind >= argc || argc - optind > TCP_CLUSTER_MAX_NODES)
+	{
+		printf("usage: %s [-i ip] [-d seconds] [-v virtual nodes] port port ...\n", argv[0]);
+		return 1;
+	}
+
+	printf("--START--\n");
+	cluster = TCP_CreateCluster(virtualNodes, CONNECT_TIMEOUT_MS, RETRY_MS);
+	if (! cluster)
+	{
+		printf("\nERROR. could not create the cluster.\n\n");
+		return 1;
+	}
+	for (; optind < argc; ++optind)
+	{
+		ports[nodesNum] = atoi(argv[optind]);
+		nodeIDs[nodesNum] = TCP_ClusterAddNode(cluster, serverIP, ports[nodesNum]);
+		if (nodeIDs[nodesNum] < 0)
+		{
+			printf("\nERROR. could not add %s:%u.\n\n", serverIP, ports[nodesNum]);
+			TCP_DestroyCluster(cluster);
+			return 1;
+		}
+		++nodesNum;
+	}
+
+	CheckRing(cluster, nodeIDs, nodesNum, serverIP, ports);
+	Traffic(cluster, nodeIDs, nodesNum, ports, seconds);
+
+	TCP_DestroyCluster(cluster);
+	printf("--END--\n");
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * client_coroTest.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Round trip rate with the coroutine layer. Many coroutines on one client loop,
+ *  each connects and keeps a request / response ping-pong with a raw echo server.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+#include "tcp_coro.hpp"
+
+#define DEFAULT_CLIENTS 100
+#define DEFAULT_ROUND_TRIPS 1000
+#define PING_MSG "Start MSG:^bla^bla^bla^END"
+#define IDLE_MS 2000
+
+struct LoadStats
+{
+	uint m_running = 0;
+	uint m_failed = 0;
+	unsigned long m_responses = 0;
+};
+
+static long NowNS(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static tcp::Task PingPong(tcp::ClientLoop& _loop, const char* _serverIP, uint _serverPort, uint _roundTrips, LoadStats& _stats)
+{
+	std::unique_ptr<tcp::Connection> conn = co_await _loop.connect(_serverIP, _serverPort);
+	std::size_t got;
+	uint i;
+
+	if (! conn)
+	{
+		_stats.m_failed++;
+		_stats.m_running--;
+		co_return;
+	}
+
+	for (i = 0; i < _roundTrips; ++i)
+	{
+		co_await conn->write(PING_MSG, sizeof(PING_MSG) );
+
+		/* a stream, the response may come in pieces. the server may change its bytes */
+		got = 0;
+		while (got < sizeof(PING_MSG) )
+		{
+			tcp::Message msg = co_await conn->read();
+			if (! msg)
+			{
+				_stats.m_failed++;
+				_stats.m_running--;
+				co_return;
+			}
+			got += msg.m_size;
+		}
+		_stats.m_responses++;
+	}
+	_stats.m_running--;
+}
+
+int main(int argc, char* argv[])
+{
+	uint serverPort = 4848;  		/* Default value */
+	char serverIP[128] = "127.0.0.1"; /* Default value */
+	uint clientsNum = DEFAULT_CLIENTS;
+	uint roundTrips = DEFAULT_ROUND_TRIPS;
+	LoadStats stats;
+	long start;
+	long last;
+	unsigned long lastResponses = 0;
+	uint i;
+
+	if (argc >= 3)
+	{
+		std::strncpy(serverIP , argv[1], sizeof(serverIP) - 1);
+		serverPort = std::atoi(argv[2]) ;
+	}
+	if (argc >= 4 && std::atoi(argv[3]) > 0)
+	{
+		clientsNum = std::atoi(argv[3]);
+	}
+	if (argc >= 5 && std::atoi(argv[4]) > 0)
+	{
+		roundTrips = std::atoi(argv[4]);
+	}
+
+	std::printf("--START--\n");
+	std::unique_ptr<tcp::ClientLoop> loop = tcp::ClientLoop::Create(clientsNum);
+	if (! loop)
+	{
+		std::printf("\nERROR. could not create the client loop.\n\n");
+		return 1;
+	}
+
+	start = NowNS();
+	for (i = 0; i < clientsNum; ++i)
+	{
+		stats.m_running++;
+		loop->Spawn(PingPong(*loop, serverIP, serverPort, roundTrips, stats) );
+	}
+
+	last = start;
+	while (stats.m_running > 0 && (NowNS() - last) / 1000000 < IDLE_MS)
+	{
+		loop->RunOnce(IDLE_MS);
+		if (stats.m_responses != lastResponses)
+		{
+			lastResponses = stats.m_responses;
+			last = NowNS();
+		}
+	}
+
+	std::printf("%u clients, %u failed: %lu round trips in %.3f sec, %.0f round trips/sec\n",
+			clientsNum, stats.m_failed, stats.m_responses, (last - start) / 1e9, stats.m_responses / ((last - start) / 1e9) );
+
+	loop.reset();
+	std::printf("--END--\n");
+	return 0;
+}
@@ -0,0 +1,396 @@
+/*
+ * client_kvTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Benchmark of the key-value server (SERVERkv). Every connection has its own thread and keeps -d requests in flight.
+ *  First the keys are set, each by one connection. Then for -s seconds the connections get and set random keys, -g
+ *  percent of them gets. Every value starts with the number of its key, so each answer to a get is checked.
+ *  Reports the requests per second and the latency of the requests, from the call to its answer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h> /* htons */
+
+#include "tcp_client.h"
+#include "tcp_rpc_client.h"
+
+/* as server_kv.c registers them */
+#define KV_GET 1
+#define KV_SET 2
+#define KV_DEL 3
+
+#define DEFAULT_CONNECTIONS 4
+#define MAX_CONNECTIONS 256
+#define DEFAULT_DEPTH 64
+#define MAX_DEPTH 4096 /* power of 2, at least the depth */
+#define DEFAULT_KEYS 100000
+#define DEFAULT_VALUE_SIZE 100
+#define MAX_VALUE_SIZE 65536
+#define DEFAULT_GET_PERCENT 90
+#define DEFAULT_SECONDS 10
+#define KEY_SIZE 16
+#define START_SAMPLES 65536
+
+typedef struct Worker
+{
+	pthread_t m_thread;
+	uint m_index;
+	TCP_RpcClient_t* m_rpc;
+	unsigned int m_seed;
+
+	/* of the calls in flight, by request ID */
+	uint64_t m_startNS[MAX_DEPTH];
+	uint32_t m_keyOf[MAX_DEPTH];
+	bool m_isGet[MAX_DEPTH];
+
+	unsigned long m_gets;
+	unsigned long m_sets;
+	unsigned long m_misses;
+	unsigned long m_failed;
+	unsigned long m_mismatched;
+	bool m_isMeasuring;
+	uint32_t* m_latencyNS;
+	unsigned long m_samplesNum;
+	unsigned long m_samplesCapacity;
+} Worker_t;
+
+/* global for sigaction */
+bool g_isClientRun = TRUE;
+char g_serverIP[16] = "127.0.0.1";
+uint g_serverPort = 4848;
+uint g_connections = DEFAULT_CONNECTIONS;
+uint g_depth = DEFAULT_DEPTH;
+uint g_keys = DEFAULT_KEYS;
+uint g_valueSize = DEFAULT_VALUE_SIZE;
+uint g_getPercent = DEFAULT_GET_PERCENT;
+uint64_t g_endNS;
+pthread_barrier_t g_startLine;
+
+void sigAbortHandler(int dummy)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit\n\n";
+	write(STDOUT_FILENO, notify, strlen(notify));
+
+	g_isClientRun = FALSE;
+
+	return;
+}
+
+static uint64_t NowNS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static uint MakeKey(char* _key, uint32_t _number)
+{
+	return snprintf(_key, KEY_SIZE, "key:%010u", _number);
+}
+
+static void OnAnswer(uint _requestID, TCP_RPC_STATUS _status, void* _result, size_t _resultSize, void* _userData)
+{
+	Worker_t* worker = _userData;
+	uint slot = _requestID % MAX_DEPTH;
+	uint64_t latencyNS = NowNS() - worker->m_startNS[slot];
+	uint32_t* bigger;
+	uint32_t number;
+
+	if (worker->m_isGet[slot])
+	{
+		worker->m_gets++;
+		if (TCP_RPC_FAILED == _status)
+		{
+			worker->m_misses++;
+		}
+		else if (_status != TCP_RPC_OK)
+		{
+			worker->m_failed++;
+		}
+		else
+		{
+			memcpy(&number, _result, _resultSize >= sizeof(number) ? sizeof(number) : 0);
+			if (_resultSize != g_valueSize || number != worker->m_keyOf[slot])
+			{
+				worker->m_mismatched++;
+			}
+		}
+	}
+	else
+	{
+		worker->m_sets++;
+		worker->m_failed += (_status != TCP_RPC_OK);
+	}
+
+	if (! worker->m_isMeasuring)
+	{
+		return;
+	}
+	if (worker->m_samplesNum == worker->m_samplesCapacity)
+	{
+		worker->m_samplesCapacity = worker->m_samplesCapacity ? worker->m_samplesCapacity * 2 : START_SAMPLES;
+		bigger = realloc(worker->m_latencyNS, worker->m_samplesCapacity * sizeof(uint32_t) );
+		if (! bigger)
+		{
+			return;
+		}
+		worker->m_latencyNS = bigger;
+	}
+	worker->m_latencyNS[worker->m_samplesNum++] = latencyNS > UINT32_MAX ? UINT32_MAX : latencyNS;
+}
+
+static int Call(Worker_t* _worker, uint32_t _number, bool _isGet)
+{
+	unsigned char args[2 + KEY_SIZE + MAX_VALUE_SIZE];
+	uint16_t keyLength;
+	uint length;
+	uint64_t startNS = NowNS();
+	int requestID;
+
+	if (_isGet)
+	{
+		length = MakeKey((char*) args, _number);
+		requestID = TCP_RpcCall(_worker->m_rpc, KV_GET, args, length, OnAnswer, _worker);
+	}
+	else
+	{
+		length = MakeKey((char*) args + 2, _number);
+		keyLength = htons(length);
+		memcpy(args, &keyLength, sizeof(keyLength) );
+		/* the value starts with the number of its key, the rest is filler */
+		memcpy(args + 2 + length, &_number, sizeof(_number) );
+		memset(args + 2 + length + sizeof(_number), 'v', g_valueSize - sizeof(_number) );
+		requestID = TCP_RpcCall(_worker->m_rpc, KV_SET, args, 2 + length + g_valueSize, OnAnswer, _worker);
+	}
+
+	if (requestID >= 0)
+	{
+		_worker->m_startNS[requestID % MAX_DEPTH] = startNS;
+		_worker->m_keyOf[requestID % MAX_DEPTH] = _number;
+		_worker->m_isGet[requestID % MAX_DEPTH] = _isGet;
+	}
+	return requestID;
+}
+
+/* poll what arrived, FALSE when the connection broke */
+static bool Poll(Worker_t* _worker)
+{
+	return TCP_RpcPoll(_worker->m_rpc, 1000) >= 0;
+}
+
+static void* Run(void* _worker)
+{
+	Worker_t* worker = _worker;
+	bool isFine = TRUE;
+	uint32_t number;
+
+	/* the keys of this connection */
+	for (number = worker->m_index; isFine && g_isClientRun && number < g_keys; )
+	{
+		while (number < g_keys && TCP_RpcInFlight(worker->m_rpc) < (int) g_depth && Call(worker, number, FALSE) >= 0)
+		{
+			number += g_connections;
+		}
+		isFine = Poll(worker);
+	}
+	while (isFine && TCP_RpcInFlight(worker->m_rpc) > 0)
+	{
+		isFine = Poll(worker);
+	}
+	worker->m_gets = 0;
+	worker->m_sets = 0;
+	worker->m_misses = 0;
+	worker->m_failed = 0;
+
+	pthread_barrier_wait(&g_startLine);
+	worker->m_isMeasuring = TRUE;
+
+	while (isFine && g_isClientRun && NowNS() < g_endNS)
+	{
+		while (TCP_RpcInFlight(worker->m_rpc) < (int) g_depth
+				&& Call(worker, rand_r(&worker->m_seed) % g_keys, (uint) (rand_r(&worker->m_seed) % 100) < g_getPercent) >= 0)
+		{
+		}
+		isFine = Poll(worker);
+	}
+	/* the answers of the last calls count in the latency, not in the time */
+	while (isFine && TCP_RpcInFlight(worker->m_rpc) > 0)
+	{
+		isFine = Poll(worker);
+	}
+	if (! isFine)
+	{
+		printf("connection %u: server closed the connection.\n", worker->m_index);
+	}
+	return NULL;
+}
+
+static int CompareNS(const void* _a, const void* _b)
+{
+	uint32_t a = *(const uint32_t*) _a;
+	uint32_t b = *(const uint32_t*) _b;
+
+	return (a > b) - (a < b);
+}
+
+static void Report(Worker_t* _workers, uint64_t _elapsedNS)
+{
+	unsigned long gets = 0;
+	unsigned long sets = 0;
+	unsigned long misses = 0;
+	unsigned long failed = 0;
+	unsigned long mismatched = 0;
+	unsigned long samplesNum = 0;
+	uint32_t* all;
+	uint i;
+
+	for (i = 0; i < g_connections; ++i)
+	{
+		gets += _workers[i].m_gets;
+		sets += _workers[i].m_sets;
+		misses += _workers[i].m_misses;
+		failed += _workers[i].m_failed;
+		mismatched += _workers[i].m_mismatched;
+		samplesNum += _workers[i].m_samplesNum;
+	}
+	printf("requests/sec %.0f (gets %lu, sets %lu) in %.2f sec. misses %lu, failed %lu, mismatched %lu\n",
+			(gets + sets) * 1e9 / _elapsedNS, gets, sets, _elapsedNS / 1e9, misses, failed, mismatched);
+	if (0 == samplesNum)
+	{
+		return;
+	}
+
+	all = malloc(samplesNum * sizeof(uint32_t) );
+	if (! all)
+	{
+		return;
+	}
+	for (i = 0, samplesNum = 0; i < g_connections; ++i)
+	{
+		memcpy(all + samplesNum, _workers[i].m_latencyNS, _workers[i].m_samplesNum * sizeof(uint32_t) );
+		samplesNum += _workers[i].m_samplesNum;
+	}
+	qsort(all, samplesNum, sizeof(uint32_t), CompareNS);
+	printf("latency usec: p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n", all[samplesNum / 2] / 1e3,
+			all[samplesNum * 9 / 10] / 1e3, all[samplesNum * 99 / 100] / 1e3, all[samplesNum * 999 / 1000] / 1e3,
+			all[samplesNum - 1] / 1e3);
+	free(all);
+}
+
+int main(int argc, char* argv[])
+{
+	uint seconds = DEFAULT_SECONDS;
+	Worker_t* workers;
+	TCP_C_t* clients[MAX_CONNECTIONS];
+	uint64_t startNS;
+	uint64_t elapsedNS;
+	int opt;
+	bool isUsage = FALSE;
+	uint i;
+
+	struct sigaction psa;
+	memset(&psa, 0, sizeof(psa));
+	psa.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &psa, NULL);
+
+	while (! isUsage && (opt = getopt(argc, argv, "i:p:c:d:k:v:g:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i':
+			strncpy(g_serverIP, optarg, sizeof(g_serverIP) - 1);
+			break;
+		case 'p':
+			g_serverPort = atoi(optarg);
+			break;
+		case 'c':
+			g_connections = atoi(optarg);
+			break;
+		case 'd':
+			g_depth = atoi(optarg);
+			break;
+		case 'k':
+			g_keys = atoi(optarg);
+			break;
+		case 'v':
+			g_valueSize = atoi(optarg);
+			break;
+		case 'g':
+			g_getPercent = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		default:
+			isUsage = TRUE;
+			break;
+		}
+	}
+	if (isUsage || g_connections < 1 || g_connections > MAX_CONNECTIONS || g_depth < 1 || g_depth > MAX_DEPTH
+		|| g_keys < 1 || g_valueSize < sizeof(uint32_t) || g_valueSize > MAX_VALUE_SIZE || g_getPercent > 100)
+	{
+		printf("usage: %s [-i ip] [-p port] [-c connections] [-d depth] [-k keys] [-v value size] [-g get percent] [-s seconds]\n", argv[0]);
+		return 1;
+	}
+
+	printf("--START--\n");
+	workers = calloc(g_connections, sizeof(Worker_t) );
+	if (! workers)
+	{
+		return 1;
+	}
+	for (i = 0; i < g_connections; ++i)
+	{
+		clients[i] = TCP_CreateClient(g_serverIP, g_serverPort);
+		workers[i].m_rpc = clients[i] ? TCP_CreateRpcClient(clients[i], g_depth) : NULL;
+		if (! workers[i].m_rpc)
+		{
+			printf("\nERROR. coud not connect to server ip %s port %u.\n\n", g_serverIP, g_serverPort);
+			return 1;
+		}
+		workers[i].m_index = i;
+		workers[i].m_seed = i + 1;
+	}
+
+	printf("%u connections, %u in flight each. %u keys of %u byte values, %u%% gets\n", g_connections, g_depth, g_keys,
+			g_valueSize, g_getPercent);
+	pthread_barrier_init(&g_startLine, NULL, g_connections + 1);
+	startNS = NowNS();
+	for (i = 0; i < g_connections; ++i)
+	{
+		pthread_create(&workers[i].m_thread, NULL, Run, &workers[i]);
+	}
+	/* all the keys are set */
+	pthread_barrier_wait(&g_startLine);
+	printf("keys set in %.2f sec\n", (NowNS() - startNS) / 1e9);
+	startNS = NowNS();
+	g_endNS = startNS + (uint64_t) seconds * 1000000000;
+	for (i = 0; i < g_connections; ++i)
+	{
+		pthread_join(workers[i].m_thread, NULL);
+	}
+	elapsedNS = NowNS() - startNS;
+
+	Report(workers, elapsedNS);
+
+	for (i = 0; i < g_connections; ++i)
+	{
+		TCP_DestroyRpcClient(workers[i].m_rpc);
+		TCP_DestroyClient(clients[i]);
+		free(workers[i].m_latencyNS);
+	}
+	free(workers);
+	pthread_barrier_destroy(&g_startLine);
+	printf("--END--\n");
+	return 0;
+}
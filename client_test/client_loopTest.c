@@ -0,0 +1,141 @@
+/*
+ * client_loopTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Load client. opens many connections from one thread using the client loop,
+ *  and keeps each of them in a send / receive ping-pong with the server.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "tcp_client_loop.h"
+
+#define DEFAULT_CONNECTIONS 1000
+#define PING_MSG "Start MSG:^bla^bla^bla^END"
+
+/* global for sigaction */
+TCP_CL_t* g_loop = NULL;
+bool g_isClientRun = TRUE;
+
+typedef struct LoadStats
+{
+	uint m_connected;
+	uint m_failed;
+	uint m_closed;
+	unsigned long m_responses;
+} LoadStats_t;
+
+void sigAbortHandler(int dummy)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit\n\n";
+	write(STDOUT_FILENO, notify, strlen(notify));
+
+	g_isClientRun = FALSE;
+	TCP_StopClientLoop(g_loop);
+
+	return;
+}
+
+int OnConnect(uint _socketNum, bool _isConnected, void* _contex)
+{
+	LoadStats_t* stats = _contex;
+
+	if (! _isConnected)
+	{
+		stats->m_failed++;
+		return FALSE;
+	}
+
+	stats->m_connected++;
+	return TCP_ClientLoopSend(g_loop, _socketNum, PING_MSG, sizeof(PING_MSG) ) > 0;
+}
+
+int OnData(void* _data, size_t _sizeData, uint _socketNum, void* _contex)
+{
+	LoadStats_t* stats = _contex;
+
+	stats->m_responses++;
+	return TCP_ClientLoopSend(g_loop, _socketNum, PING_MSG, sizeof(PING_MSG) ) > 0;
+}
+
+int OnDisconnect(uint _socketNum, void* _contex)
+{
+	LoadStats_t* stats = _contex;
+
+	stats->m_closed++;
+	return TRUE;
+}
+
+int main(int argc, char* argv[])
+{
+	uint serverPort = 4848;  		/* Default value */
+	char serverIP[16] = "127.0.0.1"; /* Default value */
+	uint connectionsNum = DEFAULT_CONNECTIONS;
+	LoadStats_t stats;
+	unsigned long lastResponses = 0;
+	time_t lastPrint = time(NULL);
+	uint i;
+
+	struct sigaction psa;
+	memset(&psa, 0, sizeof(psa));
+	psa.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &psa, NULL);
+
+	if (argc >= 3)
+	{
+		strncpy(serverIP , argv[1], sizeof(serverIP) - 1);
+		serverPort = atoi(argv[2]) ;
+	}
+	if (argc >= 4)
+	{
+		connectionsNum = atoi(argv[3]);
+	}
+
+	printf("--START--\n");
+
+	memset(&stats, 0, sizeof(stats));
+	g_loop = TCP_CreateClientLoop(connectionsNum, OnConnect, OnData, OnDisconnect, &stats);
+	if (! g_loop)
+	{
+		printf("ERROR. could not create client loop.\n");
+		return 1;
+	}
+
+	for (i = 0; i < connectionsNum; ++i)
+	{
+		if (TCP_ClientLoopConnect(g_loop, serverIP, serverPort) < 0)
+		{
+			printf("connect #%d failed to start.\n", i);
+			break;
+		}
+	}
+
+	/* wake at least once a second, so progress can be printed */
+	while (g_isClientRun && TCP_ClientLoopConnectionsNum(g_loop) > 0)
+	{
+		if (TCP_ClientLoopRunOnce(g_loop, 1000) < 0)
+		{
+			break;
+		}
+
+		if (time(NULL) != lastPrint)
+		{
+			printf("connected %u, failed %u, closed %u, responses/sec %lu\n",
+					stats.m_connected, stats.m_failed, stats.m_closed, stats.m_responses - lastResponses);
+			lastResponses = stats.m_responses;
+			lastPrint = time(NULL);
+		}
+	}
+
+	TCP_DestroyClientLoop(g_loop);
+	g_loop = NULL;
+	printf("--END--\n");
+	return 0;
+}
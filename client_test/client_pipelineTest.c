@@ -0,0 +1,181 @@
+/*
+ * client_pipelineTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Keeps many requests in flight on one connection. The server should run in framed mode (SERVERapp -f).
+ *  With "z" after the depth, the messages are longer and repetitive, and compression is offered (SERVERapp -f -z).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tcp_client.h"
+#include "tcp_pipeline.h"
+
+#define MAX_MSG_SIZE 1024
+#define DEFAULT_DEPTH 64
+#define MAX_DEPTH 4096 /* power of 2, at least the pipeline depth */
+#define FILLER_REPEAT 40
+
+/* global for sigaction */
+bool g_isClientRun = TRUE;
+bool g_isLongMsg = FALSE;
+
+typedef struct PipeStats
+{
+	TCP_Pipe_t* m_pipe;
+	unsigned long m_sent;
+	unsigned long m_responses;
+	unsigned long m_mismatch;
+	unsigned long m_sentSeq[MAX_DEPTH]; /* what was sent, by request ID */
+} PipeStats_t;
+
+void sigAbortHandler(int dummy)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit\n\n";
+	write(STDOUT_FILENO, notify, strlen(notify));
+
+	g_isClientRun = FALSE;
+
+	return;
+}
+
+static void BuildMsg(char* _msg, unsigned long _seq)
+{
+	int i;
+	int length = sprintf(_msg, "Start MSG:%lu:", _seq);
+
+	/* the kind of text that compresses well */
+	for (i = 0; g_isLongMsg && i < FILLER_REPEAT; ++i)
+	{
+		length += sprintf(_msg + length, "^bla%d", i % 4);
+	}
+	strcpy(_msg + length, "END");
+}
+
+void OnResponse(uint _requestID, void* _data, size_t _sizeData, void* _userData)
+{
+	PipeStats_t* stats = _userData;
+	char expected[MAX_MSG_SIZE];
+
+	/* the server replace the first byte with '!' */
+	BuildMsg(expected, stats->m_sentSeq[_requestID % MAX_DEPTH]);
+	if (_sizeData != strlen(expected) || memcmp((char*) _data + 1, expected + 1, _sizeData - 1) != 0)
+	{
+		stats->m_mismatch++;
+	}
+	stats->m_responses++;
+}
+
+int main(int argc, char* argv[])
+{
+	uint serverPort = 4848;  		/* Default value */
+	char serverIP[16] = "127.0.0.1"; /* Default value */
+	uint depth = DEFAULT_DEPTH;
+	char msg[MAX_MSG_SIZE];
+	char response[MAX_MSG_SIZE];
+	TCP_C_t* client;
+	PipeStats_t stats;
+	unsigned long lastResponses = 0;
+	time_t lastPrint = time(NULL);
+	int requestID;
+	int length;
+
+	struct sigaction psa;
+	memset(&psa, 0, sizeof(psa));
+	psa.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &psa, NULL);
+
+	if (argc >= 3)
+	{
+		strncpy(serverIP , argv[1], sizeof(serverIP) - 1);
+		serverPort = atoi(argv[2]) ;
+	}
+	if (argc >= 4)
+	{
+		depth = atoi(argv[3]);
+		if (depth < 1 || depth > MAX_DEPTH)
+		{
+			depth = MAX_DEPTH;
+		}
+	}
+	if (argc >= 5 && argv[4][0] == 'z')
+	{
+		g_isLongMsg = TRUE;
+	}
+
+	printf("--START--\n");
+	client = TCP_CreateClient(serverIP, serverPort);
+	if (!client)
+	{
+		printf("\nERROR. coud not connect to server ip %s port %d.\n\n", serverIP, serverPort);
+		return 1;
+	}
+
+	memset(&stats, 0, sizeof(stats) );
+	stats.m_pipe = TCP_CreatePipeline(client, depth);
+	if (! stats.m_pipe)
+	{
+		TCP_DestroyClient(client);
+		return 1;
+	}
+	if (g_isLongMsg && ! TCP_PipelineSetCompression(stats.m_pipe, NULL, TCP_COMPRESS_DEFAULT_THRESHOLD) )
+	{
+		printf("could not offer compression.\n");
+	}
+
+	/* future style first, one request and wait for it */
+	requestID = TCP_PipelineSend(stats.m_pipe, "Start MSG:hello:END", sizeof("Start MSG:hello:END") - 1, NULL, NULL);
+	length = TCP_PipelineWait(stats.m_pipe, requestID, response, MAX_MSG_SIZE - 1, 1000);
+	if (length < 0)
+	{
+		printf("no response to the first request. is the server in framed mode?\n");
+		g_isClientRun = FALSE;
+	}
+	else
+	{
+		response[length] = '\0';
+		printf("recived #%d (%d): %s.\n", requestID, length, response);
+	}
+
+	while (g_isClientRun)
+	{
+		/* fill the pipe, then read whatever arrived */
+		while (TCP_PipelineInFlight(stats.m_pipe) < (int) depth)
+		{
+			BuildMsg(msg, ++stats.m_sent);
+			requestID = TCP_PipelineSend(stats.m_pipe, msg, strlen(msg), OnResponse, &stats);
+			if (requestID < 0)
+			{
+				g_isClientRun = FALSE;
+				break;
+			}
+			stats.m_sentSeq[requestID % MAX_DEPTH] = stats.m_sent;
+		}
+
+		if (TCP_PipelinePoll(stats.m_pipe, 1000) < 0)
+		{
+			printf("server closed connection. quitting client.\n");
+			break;
+		}
+
+		if (time(NULL) != lastPrint)
+		{
+			printf("responses/sec %lu, mismatched %lu, in flight %d\n",
+					stats.m_responses - lastResponses, stats.m_mismatch, TCP_PipelineInFlight(stats.m_pipe) );
+			lastResponses = stats.m_responses;
+			lastPrint = time(NULL);
+		}
+	}
+
+	TCP_DestroyPipeline(stats.m_pipe);
+	TCP_DestroyClient(client);
+	printf("--END--\n");
+	return 0;
+}
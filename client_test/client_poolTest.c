@@ -0,0 +1,154 @@
+/*
+ * client_poolTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Worker threads that take a connection from the pool for each request,
+ *  like a service that does not keep its own connections.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tcp_pool.h"
+
+#define MAX_MSG_SIZE 1024
+#define MAX_THREADS 64
+#define POOL_MIN_WARM 8
+#define POOL_IDLE_TIMEOUT_MS 10000
+#define POOL_HEALTH_CHECK_MS 500
+#define CHECKOUT_WAIT_MS 1000
+#define REQUEST_MSG "Start MSG:^bla^bla^END"
+
+/* global for sigaction */
+bool g_isClientRun = TRUE;
+
+typedef struct Worker
+{
+	TCP_Pool_t* m_pool;
+	unsigned long m_requests;
+	unsigned long m_failures;
+} Worker_t;
+
+void sigAbortHandler(int dummy)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit\n\n";
+	write(STDOUT_FILENO, notify, strlen(notify));
+
+	g_isClientRun = FALSE;
+
+	return;
+}
+
+void* WorkerThread(void* _worker)
+{
+	Worker_t* worker = _worker;
+	char buffer[MAX_MSG_SIZE];
+	TCP_C_t* client;
+	bool isBroken;
+
+	while (g_isClientRun)
+	{
+		client = TCP_PoolCheckout(worker->m_pool, CHECKOUT_WAIT_MS);
+		if (! client)
+		{
+			worker->m_failures++;
+			sleep(1);
+			continue;
+		}
+
+		isBroken = TCP_ClientSend(client, REQUEST_MSG, sizeof(REQUEST_MSG) ) <= 0
+				|| TCP_ClientRecive(client, buffer, MAX_MSG_SIZE) <= 0;
+
+		TCP_PoolCheckin(worker->m_pool, client, isBroken);
+
+		if (isBroken)
+		{
+			worker->m_failures++;
+		}
+		else
+		{
+			worker->m_requests++;
+		}
+	}
+
+	return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+	uint serverPort = 4848;  		/* Default value */
+	char serverIP[16] = "127.0.0.1"; /* Default value */
+	uint threadsNum = 4;
+	pthread_t threads[MAX_THREADS];
+	Worker_t workers[MAX_THREADS];
+	TCP_Pool_t* pool;
+	unsigned long requests, failures;
+	uint idleNum, busyNum;
+	uint i;
+
+	struct sigaction psa;
+	memset(&psa, 0, sizeof(psa));
+	psa.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &psa, NULL);
+
+	if (argc >= 3)
+	{
+		strncpy(serverIP , argv[1], sizeof(serverIP) - 1);
+		serverPort = atoi(argv[2]) ;
+	}
+	if (argc >= 4)
+	{
+		threadsNum = atoi(argv[3]);
+		if (threadsNum < 1 || threadsNum > MAX_THREADS)
+		{
+			threadsNum = MAX_THREADS;
+		}
+	}
+
+	printf("--START--\n");
+
+	pool = TCP_CreatePool(serverIP, serverPort, POOL_MIN_WARM, threadsNum + POOL_MIN_WARM,
+						POOL_IDLE_TIMEOUT_MS, POOL_HEALTH_CHECK_MS);
+	if (! pool)
+	{
+		printf("ERROR. could not create pool.\n");
+		return 1;
+	}
+
+	for (i = 0; i < threadsNum; ++i)
+	{
+		workers[i].m_pool = pool;
+		workers[i].m_requests = 0;
+		workers[i].m_failures = 0;
+		pthread_create(&threads[i], NULL, WorkerThread, &workers[i]);
+	}
+
+	while (g_isClientRun)
+	{
+		sleep(1);
+
+		requests = failures = 0;
+		for (i = 0; i < threadsNum; ++i)
+		{
+			requests += workers[i].m_requests;
+			failures += workers[i].m_failures;
+		}
+		TCP_PoolStatus(pool, &idleNum, &busyNum);
+		printf("requests %lu, failures %lu, idle %u, busy %u\n", requests, failures, idleNum, busyNum);
+	}
+
+	for (i = 0; i < threadsNum; ++i)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	TCP_DestroyPool(pool);
+	printf("--END--\n");
+	return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * client_pubsubTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Fan-out rate of the broker. The server should run with -b.
+ *  Subscribers all follow one topic, a second process publishes to it as fast as it can.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "tcp_client.h"
+#include "tcp_frame.h"
+
+#define MAX_SUBSCRIBERS 256
+#define DEFAULT_SUBSCRIBERS 8
+#define DEFAULT_MESSAGES 100000
+#define READ_SIZE 65536
+#define IDLE_MS 2000
+#define TOPIC "bench"
+
+typedef struct Subscriber
+{
+	TCP_C_t* m_client;
+	unsigned char m_partial[TCP_FRAME_HEADER_SIZE]; /* a header split between reads */
+	uint m_partialLength;
+	uint m_payloadLeft; /* of the frame being read */
+	uint m_received;
+} Subscriber_t;
+
+static long NowNS(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static bool SendCommand(TCP_C_t* _client, const char* _command)
+{
+	unsigned char frame[TCP_FRAME_HEADER_SIZE + 256];
+	TCP_FrameHeader_t header = {0};
+	uint length = strlen(_command);
+
+	header.m_length = length;
+	TCP_FrameEncode(&header, frame);
+	memcpy(frame + TCP_FRAME_HEADER_SIZE, _command, length);
+	return TCP_ClientSend(_client, frame, TCP_FRAME_HEADER_SIZE + length) == (int) (TCP_FRAME_HEADER_SIZE + length);
+}
+
+/* count the frames in what was read. returns FALSE on a broken frame */
+static bool CountFrames(Subscriber_t* _sub, unsigned char* _data, uint _length)
+{
+	TCP_FrameHeader_t header;
+	uint take;
+
+	while (_length > 0)
+	{
+		if (_sub->m_payloadLeft > 0)
+		{
+			take = (_length < _sub->m_payloadLeft) ? _length : _sub->m_payloadLeft;
+			_sub->m_payloadLeft -= take;
+			_data += take;
+			_length -= take;
+			continue;
+		}
+
+		take = TCP_FRAME_HEADER_SIZE - _sub->m_partialLength;
+		take = (_length < take) ? _length : take;
+		memcpy(_sub->m_partial + _sub->m_partialLength, _data, take);
+		_sub->m_partialLength += take;
+		_data += take;
+		_length -= take;
+
+		if (_sub->m_partialLength == TCP_FRAME_HEADER_SIZE)
+		{
+			if (! TCP_FrameDecode(_sub->m_partial, &header) )
+			{
+				return FALSE;
+			}
+			_sub->m_partialLength = 0;
+			_sub->m_payloadLeft = header.m_length;
+			++_sub->m_received;
+		}
+	}
+	return TRUE;
+}
+
+static void Publish(TCP_C_t* _publisher, uint _messages)
+{
+	char command[128];
+	uint i;
+
+	for (i = 0; i < _messages; ++i)
+	{
+		snprintf(command, sizeof(command), "PUB " TOPIC " message %08u of the fan-out benchmark", i);
+		if (! SendCommand(_publisher, command) )
+		{
+			printf("publisher: send failed.\n");
+			return;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	uint serverPort = 4848;  		/* Default value */
+	char serverIP[128] = "127.0.0.1"; /* Default value */
+	uint subscribersNum = DEFAULT_SUBSCRIBERS;
+	uint messages = DEFAULT_MESSAGES;
+	static Subscriber_t subs[MAX_SUBSCRIBERS];
+	struct pollfd fds[MAX_SUBSCRIBERS];
+	static unsigned char buffer[READ_SIZE];
+	TCP_C_t* publisher;
+	uint done = 0;
+	unsigned long total = 0;
+	long start;
+	long last;
+	uint i;
+	int n;
+	pid_t child;
+
+	if (argc >= 3)
+	{
+		strncpy(serverIP , argv[1], sizeof(serverIP) - 1);
+		serverPort = atoi(argv[2]) ;
+	}
+	if (argc >= 4 && atoi(argv[3]) > 0 && atoi(argv[3]) <= MAX_SUBSCRIBERS)
+	{
+		subscribersNum = atoi(argv[3]);
+	}
+	if (argc >= 5 && atoi(argv[4]) > 0)
+	{
+		messages = atoi(argv[4]);
+	}
+
+	printf("--START--\n");
+	for (i = 0; i < subscribersNum; ++i)
+	{
+		subs[i].m_client = TCP_CreateClient(serverIP, serverPort);
+		if (! subs[i].m_client || ! SendCommand(subs[i].m_client, "SUB " TOPIC) )
+		{
+			printf("\nERROR. coud not connect to server ip %s port %d.\n\n", serverIP, serverPort);
+			return 1;
+		}
+		fds[i].fd = TCP_ClientGetSocket(subs[i].m_client);
+		fds[i].events = POLLIN;
+	}
+
+	publisher = TCP_CreateClient(serverIP, serverPort);
+	if (! publisher)
+	{
+		printf("\nERROR. coud not connect to server ip %s port %d.\n\n", serverIP, serverPort);
+		return 1;
+	}
+
+	/* the first message makes sure every subscription was handled before the clock starts */
+	SendCommand(publisher, "PUB " TOPIC " ready");
+	for (i = 0; i < subscribersNum; ++i)
+	{
+		while (subs[i].m_received == 0)
+		{
+			n = recv(fds[i].fd, buffer, READ_SIZE, 0);
+			if (n <= 0 || ! CountFrames(&subs[i], buffer, n) )
+			{
+				printf("subscriber %u: no response from server. is it running with -b?\n", i);
+				return 1;
+			}
+		}
+		subs[i].m_received = 0;
+	}
+
+	start = NowNS();
+	child = fork();
+	if (child == 0)
+	{
+		Publish(publisher, messages);
+		TCP_DestroyClient(publisher);
+		_exit(0);
+	}
+
+	last = start;
+	while (done < subscribersNum && (NowNS() - last) / 1000000 < IDLE_MS)
+	{
+		if (poll(fds, subscribersNum, IDLE_MS) <= 0)
+		{
+			continue;
+		}
+		for (i = 0; i < subscribersNum; ++i)
+		{
+			if (! (fds[i].revents & POLLIN) )
+			{
+				continue;
+			}
+			n = recv(fds[i].fd, buffer, READ_SIZE, 0);
+			if (n <= 0 || ! CountFrames(&subs[i], buffer, n) )
+			{
+				printf("subscriber %u: disconnected.\n", i);
+				fds[i].fd = -1;
+				++done;
+				continue;
+			}
+			last = NowNS();
+			if (subs[i].m_received == messages)
+			{
+				fds[i].fd = -1;
+				++done;
+			}
+		}
+	}
+
+	for (i = 0; i < subscribersNum; ++i)
+	{
+		total += subs[i].m_received;
+		TCP_DestroyClient(subs[i].m_client);
+	}
+	printf("%u subscribers, %u published: %lu delivered (%lu dropped) in %.3f sec, %.0f deliveries/sec\n",
+			subscribersNum, messages, total, (unsigned long) messages * subscribersNum - total,
+			(last - start) / 1e9, total / ((last - start) / 1e9) );
+
+	waitpid(child, NULL, 0);
+	TCP_DestroyClient(publisher);
+	printf("--END--\n");
+	return 0;
+}
@@ -0,0 +1,382 @@
+/*
+ * client_replayTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Replays a capture (SERVERapp -r file) against a server, and reports the throughput and the latency.
+ *  The messages of each captured socket go on one connection, over as many connections as asked. Each connection
+ *  sends its messages in order, and waits for the answer to one before sending the next, as the echo server answers
+ *  every message with one of the same length (raw) or one frame (framed, -f).
+ *  Speed 1 keeps the original gaps between messages, 2 halves them, 0 sends as fast as the answers come.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "tcp_client.h"
+#include "tcp_frame.h"
+#include "tcp_capture.h"
+
+#define DEFAULT_CONNECTIONS 8
+#define MAX_CONNECTIONS 1024
+#define START_RECORDS 4096
+
+typedef struct Replayer
+{
+	pthread_t m_thread;
+	TCP_CaptureRecord_t** m_records; /* of this connection, in order */
+	uint m_recordsNum;
+	uint m_recordsCapacity;
+	unsigned long m_answered;
+	unsigned long m_late; /* sent after their time, the answers to earlier ones came too slow */
+	uint64_t* m_latencyUS; /* of every answered message */
+	bool m_isFailed;
+} Replayer_t;
+
+/* global for sigaction */
+bool g_isClientRun = TRUE;
+bool g_isFramed = FALSE;
+double g_speed = 1;
+char g_serverIP[16] = "127.0.0.1";
+uint g_serverPort = 4848;
+uint64_t g_startUS;
+uint64_t g_firstRecordUS;
+pthread_barrier_t g_startLine;
+
+void sigAbortHandler(int dummy)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit\n\n";
+	write(STDOUT_FILENO, notify, strlen(notify));
+
+	g_isClientRun = FALSE;
+
+	return;
+}
+
+static uint64_t NowUS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static bool AddRecord(Replayer_t* _replayer, TCP_CaptureRecord_t* _record)
+{
+	TCP_CaptureRecord_t** bigger;
+
+	if (_replayer->m_recordsNum == _replayer->m_recordsCapacity)
+	{
+		_replayer->m_recordsCapacity = _replayer->m_recordsCapacity ? _replayer->m_recordsCapacity * 2 : START_RECORDS;
+		bigger = realloc(_replayer->m_records, _replayer->m_recordsCapacity * sizeof(TCP_CaptureRecord_t*) );
+		if (! bigger)
+		{
+			return FALSE;
+		}
+		_replayer->m_records = bigger;
+	}
+	_replayer->m_records[_replayer->m_recordsNum++] = _record;
+	return TRUE;
+}
+
+/* all of _length, or FALSE */
+static bool ReadAll(int _socketFD, unsigned char* _buffer, uint _length)
+{
+	int got;
+
+	while (_length > 0)
+	{
+		got = recv(_socketFD, _buffer, _length, 0);
+		if (got <= 0)
+		{
+			return FALSE;
+		}
+		_buffer += got;
+		_length -= got;
+	}
+	return TRUE;
+}
+
+static bool SendRecord(TCP_C_t* _client, TCP_CaptureRecord_t* _record, unsigned char* _buffer)
+{
+	TCP_FrameHeader_t header;
+	uint length = _record->m_length;
+
+	if (! g_isFramed)
+	{
+		memcpy(_buffer, _record->m_data, length);
+		return TCP_ClientSend(_client, _buffer, length) == (int) length;
+	}
+
+	if (length > TCP_FRAME_MAX_PAYLOAD)
+	{
+		length = TCP_FRAME_MAX_PAYLOAD;
+	}
+	header.m_length = length;
+	header.m_requestID = _record->m_requestID;
+	header.m_flags = 0;
+	header.m_method = 0;
+	TCP_FrameEncode(&header, _buffer);
+	memcpy(_buffer + TCP_FRAME_HEADER_SIZE, _record->m_data, length);
+	return TCP_ClientSend(_client, _buffer, TCP_FRAME_HEADER_SIZE + length) == (int) (TCP_FRAME_HEADER_SIZE + length);
+}
+
+static bool ReadAnswer(int _socketFD, TCP_CaptureRecord_t* _record, unsigned char* _buffer)
+{
+	TCP_FrameHeader_t header;
+
+	if (! g_isFramed)
+	{
+		return ReadAll(_socketFD, _buffer, _record->m_length);
+	}
+
+	return ReadAll(_socketFD, _buffer, TCP_FRAME_HEADER_SIZE)
+		&& TCP_FrameDecode(_buffer, &header)
+		&& ReadAll(_socketFD, _buffer, header.m_length);
+}
+
+static void* Replay(void* _replayer)
+{
+	Replayer_t* replayer = _replayer;
+	TCP_CaptureRecord_t* record;
+	unsigned char* buffer;
+	TCP_C_t* client;
+	uint64_t dueUS;
+	uint64_t sentUS;
+	uint64_t nowUS;
+	uint i;
+
+	client = TCP_CreateClient(g_serverIP, g_serverPort);
+	buffer = malloc(TCP_FRAME_HEADER_SIZE + TCP_CAPTURE_MAX_RECORD);
+	replayer->m_latencyUS = malloc((replayer->m_recordsNum + 1) * sizeof(uint64_t) );
+	replayer->m_isFailed = ! client || ! buffer || ! replayer->m_latencyUS;
+
+	/* all connections start the clock together */
+	pthread_barrier_wait(&g_startLine);
+
+	for (i = 0; ! replayer->m_isFailed && g_isClientRun && i < replayer->m_recordsNum; ++i)
+	{
+		record = replayer->m_records[i];
+		if (g_speed > 0)
+		{
+			dueUS = g_startUS + (uint64_t) ((record->m_timeUS - g_firstRecordUS) / g_speed);
+			nowUS = NowUS();
+			if (dueUS > nowUS)
+			{
+				usleep(dueUS - nowUS);
+			}
+			else if (nowUS - dueUS > 1000)
+			{
+				replayer->m_late++;
+			}
+		}
+
+		sentUS = NowUS();
+		if (! SendRecord(client, record, buffer) || ! ReadAnswer(TCP_ClientGetSocket(client), record, buffer) )
+		{
+			replayer->m_isFailed = TRUE;
+			break;
+		}
+		replayer->m_latencyUS[replayer->m_answered++] = NowUS() - sentUS;
+	}
+
+	TCP_DestroyClient(client);
+	free(buffer);
+	return NULL;
+}
+
+static int CompareUS(const void* _a, const void* _b)
+{
+	uint64_t a = *(const uint64_t*) _a;
+	uint64_t b = *(const uint64_t*) _b;
+
+	return (a > b) - (a < b);
+}
+
+static void Report(Replayer_t* _replayers, uint _connections, uint64_t _elapsedUS)
+{
+	unsigned long answered = 0;
+	unsigned long late = 0;
+	uint failed = 0;
+	uint64_t* all;
+	uint i;
+
+	for (i = 0; i < _connections; ++i)
+	{
+		answered += _replayers[i].m_answered;
+		late += _replayers[i].m_late;
+		failed += _replayers[i].m_isFailed;
+	}
+	printf("messages %lu in %.3f sec, %.0f messages/sec. late %lu, connections failed %u\n",
+			answered, _elapsedUS / 1e6, _elapsedUS ? answered * 1e6 / _elapsedUS : 0, late, failed);
+	if (0 == answered)
+	{
+		return;
+	}
+
+	all = malloc(answered * sizeof(uint64_t) );
+	if (! all)
+	{
+		return;
+	}
+	answered = 0;
+	for (i = 0; i < _connections; ++i)
+	{
+		if (_replayers[i].m_answered > 0)
+		{
+			memcpy(all + answered, _replayers[i].m_latencyUS, _replayers[i].m_answered * sizeof(uint64_t) );
+			answered += _replayers[i].m_answered;
+		}
+	}
+	qsort(all, answered, sizeof(uint64_t), CompareUS);
+	printf("latency usec: p50 %lu, p90 %lu, p99 %lu, max %lu\n", (unsigned long) all[answered / 2],
+			(unsigned long) all[answered * 9 / 10], (unsigned long) all[answered * 99 / 100], (unsigned long) all[answered - 1]);
+	free(all);
+}
+
+int main(int argc, char* argv[])
+{
+	uint connections = DEFAULT_CONNECTIONS;
+	TCP_CaptureReader_t* reader;
+	TCP_CaptureRecord_t* records = NULL;
+	TCP_CaptureRecord_t* bigger;
+	uint recordsNum = 0;
+	uint recordsCapacity = 0;
+	Replayer_t* replayers;
+	uint* connectionOf; /* by captured socket number, + 1. 0 when not seen yet */
+	uint maxSocket = 0;
+	uint socketsSeen = 0;
+	uint64_t elapsedUS;
+	int opt;
+	uint i;
+
+	struct sigaction psa;
+	memset(&psa, 0, sizeof(psa));
+	psa.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &psa, NULL);
+
+	while ((opt = getopt(argc, argv, "i:p:c:s:f")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i':
+			strncpy(g_serverIP, optarg, sizeof(g_serverIP) - 1);
+			break;
+		case 'p':
+			g_serverPort = atoi(optarg);
+			break;
+		case 'c':
+			connections = atoi(optarg);
+			break;
+		case 's':
+			g_speed = atof(optarg);
+			break;
+		case 'f':
+			g_isFramed = TRUE;
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+	if (optind != argc - 1 || connections < 1 || connections > MAX_CONNECTIONS || g_speed < 0)
+	{
+		printf("usage: %s [-i ip] [-p port] [-c connections] [-s speed (1 original, 0 max)] [-f (framed)] capture/file\n", argv[0]);
+		return 1;
+	}
+
+	printf("--START--\n");
+	reader = TCP_CaptureOpen(argv[optind]);
+	if (! reader)
+	{
+		printf("\nERROR. could not read capture %s.\n\n", argv[optind]);
+		return 1;
+	}
+
+	/* the records point into the reader's mapping */
+	for (;;)
+	{
+		if (recordsNum == recordsCapacity)
+		{
+			recordsCapacity = recordsCapacity ? recordsCapacity * 2 : START_RECORDS;
+			bigger = realloc(records, recordsCapacity * sizeof(TCP_CaptureRecord_t) );
+			if (! bigger)
+			{
+				break;
+			}
+			records = bigger;
+		}
+		if (! TCP_CaptureNext(reader, &records[recordsNum]) )
+		{
+			break;
+		}
+		if (records[recordsNum].m_socketNum > maxSocket)
+		{
+			maxSocket = records[recordsNum].m_socketNum;
+		}
+		++recordsNum;
+	}
+	printf("%u messages captured\n", recordsNum);
+	if (0 == recordsNum)
+	{
+		free(records);
+		TCP_CaptureClose(reader);
+		return 0;
+	}
+	g_firstRecordUS = records[0].m_timeUS;
+
+	/* captured sockets go to connections in the order they were first seen */
+	replayers = calloc(connections, sizeof(Replayer_t) );
+	connectionOf = calloc(maxSocket + 1, sizeof(uint) );
+	if (! replayers || ! connectionOf)
+	{
+		printf("\nERROR. out of memory.\n\n");
+		return 1;
+	}
+	for (i = 0; i < recordsNum; ++i)
+	{
+		if (0 == connectionOf[records[i].m_socketNum])
+		{
+			connectionOf[records[i].m_socketNum] = socketsSeen++ % connections + 1;
+		}
+		if (! AddRecord(&replayers[connectionOf[records[i].m_socketNum] - 1], &records[i]) )
+		{
+			printf("\nERROR. out of memory.\n\n");
+			return 1;
+		}
+	}
+
+	pthread_barrier_init(&g_startLine, NULL, connections + 1);
+	for (i = 0; i < connections; ++i)
+	{
+		pthread_create(&replayers[i].m_thread, NULL, Replay, &replayers[i]);
+	}
+	g_startUS = NowUS();
+	pthread_barrier_wait(&g_startLine);
+	for (i = 0; i < connections; ++i)
+	{
+		pthread_join(replayers[i].m_thread, NULL);
+	}
+	elapsedUS = NowUS() - g_startUS;
+
+	Report(replayers, connections, elapsedUS);
+
+	for (i = 0; i < connections; ++i)
+	{
+		free(replayers[i].m_records);
+		free(replayers[i].m_latencyUS);
+	}
+	free(replayers);
+	free(connectionOf);
+	free(records);
+	TCP_CaptureClose(reader);
+	printf("--END--\n");
+	return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * client_rpcTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Calls the methods of SERVERapp -R. First a few waited calls, errors included, then one slow call (RPC_LATER) with
+ *  quick ones behind it on the same connection, whose answers must come first. Then keeps many echo calls in flight
+ *  until stopped, checking every answer against its call, and prints calls per second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h> /* htonl */
+
+#include "tcp_client.h"
+#include "tcp_rpc_client.h"
+
+/* as server.c registers them */
+#define RPC_ECHO 1
+#define RPC_ADD 2
+#define RPC_LATER 3
+#define RPC_NO_SUCH_METHOD 99
+
+#define DEFAULT_DEPTH 1024
+#define MAX_DEPTH 4096 /* power of 2, at least the depth */
+#define LATER_MS 200
+#define QUICK_CALLS 8
+
+/* global for sigaction */
+bool g_isClientRun = TRUE;
+
+typedef struct CallStats
+{
+	unsigned long m_sent;
+	unsigned long m_answered;
+	unsigned long m_mismatch;
+	unsigned long m_failed;
+	unsigned long m_sentSeq[MAX_DEPTH]; /* the argument, by request ID */
+	uint m_order; /* answers so far in the out of order check */
+	uint m_laterOrder; /* which one was the slow call */
+} CallStats_t;
+
+void sigAbortHandler(int dummy)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit\n\n";
+	write(STDOUT_FILENO, notify, strlen(notify));
+
+	g_isClientRun = FALSE;
+
+	return;
+}
+
+void OnEcho(uint _requestID, TCP_RPC_STATUS _status, void* _result, size_t _resultSize, void* _userData)
+{
+	CallStats_t* stats = _userData;
+	unsigned long seq;
+
+	stats->m_answered++;
+	if (_status != TCP_RPC_OK)
+	{
+		stats->m_failed++;
+		return;
+	}
+	memcpy(&seq, _result, _resultSize == sizeof(seq) ? sizeof(seq) : 0);
+	if (_resultSize != sizeof(seq) || seq != stats->m_sentSeq[_requestID % MAX_DEPTH])
+	{
+		stats->m_mismatch++;
+	}
+}
+
+void OnOrdered(uint _requestID, TCP_RPC_STATUS _status, void* _result, size_t _resultSize, void* _userData)
+{
+	CallStats_t* stats = _userData;
+
+	if (_status != TCP_RPC_OK)
+	{
+		stats->m_failed++;
+	}
+	stats->m_order++;
+}
+
+void OnLater(uint _requestID, TCP_RPC_STATUS _status, void* _result, size_t _resultSize, void* _userData)
+{
+	CallStats_t* stats = _userData;
+
+	OnOrdered(_requestID, _status, _result, _resultSize, _userData);
+	stats->m_laterOrder = stats->m_order;
+}
+
+/* waited calls, and their statuses */
+static bool CheckCalls(TCP_RpcClient_t* _rpc)
+{
+	uint32_t numbers[2] = {htonl(2), htonl(3)};
+	uint32_t sum = 0;
+	TCP_RPC_STATUS status;
+	int length;
+
+	length = TCP_RpcCallWait(_rpc, RPC_ADD, numbers, sizeof(numbers), &sum, sizeof(sum), 1000, &status);
+	printf("add 2 + 3: length %d, status %d, sum %u\n", length, status, ntohl(sum) );
+	if (length != sizeof(sum) || ntohl(sum) != 5)
+	{
+		printf("no answer to the first call. is the server in RPC mode (SERVERapp -R)?\n");
+		return FALSE;
+	}
+
+	TCP_RpcCallWait(_rpc, RPC_ADD, numbers, sizeof(numbers[0]), &sum, sizeof(sum), 1000, &status);
+	printf("add of one number: status %d (expected %d)\n", status, TCP_RPC_BAD_ARGS);
+	TCP_RpcCallWait(_rpc, RPC_NO_SUCH_METHOD, NULL, 0, &sum, sizeof(sum), 1000, &status);
+	printf("method %d: status %d (expected %d)\n", RPC_NO_SUCH_METHOD, status, TCP_RPC_NO_METHOD);
+	return TRUE;
+}
+
+/* the slow call first, its answer should come last */
+static void CheckOrder(TCP_RpcClient_t* _rpc, CallStats_t* _stats)
+{
+	uint32_t delayMS = htonl(LATER_MS);
+	uint i;
+
+	TCP_RpcCall(_rpc, RPC_LATER, &delayMS, sizeof(delayMS), OnLater, _stats);
+	for (i = 0; i < QUICK_CALLS; ++i)
+	{
+		TCP_RpcCall(_rpc, RPC_ECHO, &i, sizeof(i), OnOrdered, _stats);
+	}
+	while (g_isClientRun && TCP_RpcInFlight(_rpc) > 0)
+	{
+		if (TCP_RpcPoll(_rpc, 1000) < 0)
+		{
+			return;
+		}
+	}
+	printf("slow call answered %u of %u (expected last)\n", _stats->m_laterOrder, QUICK_CALLS + 1);
+}
+
+int main(int argc, char* argv[])
+{
+	uint serverPort = 4848;  		/* Default value */
+	char serverIP[16] = "127.0.0.1"; /* Default value */
+	uint depth = DEFAULT_DEPTH;
+	TCP_C_t* client;
+	TCP_RpcClient_t* rpc;
+	CallStats_t stats;
+	unsigned long lastAnswered = 0;
+	time_t lastPrint = time(NULL);
+	int requestID;
+
+	struct sigaction psa;
+	memset(&psa, 0, sizeof(psa));
+	psa.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &psa, NULL);
+
+	if (argc >= 3)
+	{
+		strncpy(serverIP , argv[1], sizeof(serverIP) - 1);
+		serverPort = atoi(argv[2]) ;
+	}
+	if (argc >= 4)
+	{
+		depth = atoi(argv[3]);
+		if (depth < 1 || depth > MAX_DEPTH)
+		{
+			depth = MAX_DEPTH;
+		}
+	}
+
+	printf("--START--\n");
+	client = TCP_CreateClient(serverIP, serverPort);
+	if (!client)
+	{
+		printf("\nERROR. coud not connect to server ip %s port %d.\n\n", serverIP, serverPort);
+		return 1;
+	}
+	rpc = TCP_CreateRpcClient(client, depth);
+	if (! rpc)
+	{
+		TCP_DestroyClient(client);
+		return 1;
+	}
+
+	memset(&stats, 0, sizeof(stats) );
+	if (! CheckCalls(rpc) )
+	{
+		g_isClientRun = FALSE;
+	}
+	else
+	{
+		CheckOrder(rpc, &stats);
+	}
+
+	while (g_isClientRun)
+	{
+		/* fill the pipe, then read whatever arrived */
+		while (TCP_RpcInFlight(rpc) < (int) depth)
+		{
+			++stats.m_sent;
+			requestID = TCP_RpcCall(rpc, RPC_ECHO, &stats.m_sent, sizeof(stats.m_sent), OnEcho, &stats);
+			if (requestID < 0)
+			{
+				g_isClientRun = FALSE;
+				break;
+			}
+			stats.m_sentSeq[requestID % MAX_DEPTH] = stats.m_sent;
+		}
+
+		if (TCP_RpcPoll(rpc, 1000) < 0)
+		{
+			printf("server closed connection. quitting client.\n");
+			break;
+		}
+
+		if (time(NULL) != lastPrint)
+		{
+			printf("calls/sec %lu, mismatched %lu, failed %lu, in flight %d\n",
+					stats.m_answered - lastAnswered, stats.m_mismatch, stats.m_failed, TCP_RpcInFlight(rpc) );
+			lastAnswered = stats.m_answered;
+			lastPrint = time(NULL);
+		}
+	}
+
+	TCP_DestroyRpcClient(rpc);
+	TCP_DestroyClient(client);
+	printf("--END--\n");
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * client_shmTest.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Round trip latency of the socket against the shared memory rings. The server should run with -s.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tcp_client.h"
+#include "tcp_shm.h"
+
+#define MAX_MSG_SIZE 1024
+#define DEFAULT_ROUND_TRIPS 10000
+
+static int CompareLong(const void* _a, const void* _b)
+{
+	long a = *(const long*) _a;
+	long b = *(const long*) _b;
+	return (a > b) - (a < b);
+}
+
+static long NowNS(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/* returns FALSE if the server stopped answering */
+static bool Measure(const char* _name, TCP_C_t* _client, uint _roundTrips, long* _samples)
+{
+	char msg[] = "Start MSG:latency:END";
+	char response[MAX_MSG_SIZE];
+	uint i;
+	long start;
+
+	for (i = 0; i < _roundTrips; ++i)
+	{
+		start = NowNS();
+		if (TCP_ClientSend(_client, msg, sizeof(msg) ) <= 0 || TCP_ClientRecive(_client, response, MAX_MSG_SIZE) <= 0)
+		{
+			printf("%s: no response from server.\n", _name);
+			return FALSE;
+		}
+		_samples[i] = NowNS() - start;
+	}
+
+	qsort(_samples, _roundTrips, sizeof(long), CompareLong);
+	printf("%-7s round trip usec: p50 %.1f  p99 %.1f  max %.1f\n", _name,
+			_samples[_roundTrips / 2] / 1000.0, _samples[_roundTrips * 99 / 100] / 1000.0, _samples[_roundTrips - 1] / 1000.0);
+	return TRUE;
+}
+
+int main(int argc, char* argv[])
+{
+	uint serverPort = 4848;  		/* Default value */
+	char serverIP[128] = "127.0.0.1"; /* Default value */
+	uint roundTrips = DEFAULT_ROUND_TRIPS;
+	TCP_C_t* socketClient;
+	TCP_C_t* shmClient;
+	long* samples;
+
+	if (argc >= 3)
+	{
+		strncpy(serverIP , argv[1], sizeof(serverIP) - 1);
+		serverPort = atoi(argv[2]) ;
+	}
+	if (argc >= 4 && atoi(argv[3]) > 0)
+	{
+		roundTrips = atoi(argv[3]);
+	}
+
+	printf("--START--\n");
+	samples = malloc(roundTrips * sizeof(long) );
+	socketClient = TCP_CreateClient(serverIP, serverPort);
+	shmClient = TCP_CreateClient(serverIP, serverPort);
+	if (! samples || ! socketClient || ! shmClient)
+	{
+		printf("\nERROR. coud not connect to server ip %s port %d.\n\n", serverIP, serverPort);
+		return 1;
+	}
+
+	if (! TCP_ClientUseSharedMemory(shmClient, TCP_SHM_DEFAULT_RING_SIZE) )
+	{
+		printf("server refused shared memory. is it running with -s?\n");
+		return 1;
+	}
+
+	if (Measure("socket", socketClient, roundTrips, samples) )
+	{
+		Measure("shm", shmClient, roundTrips, samples);
+	}
+
+	TCP_DestroyClient(shmClient);
+	TCP_DestroyClient(socketClient);
+	free(samples);
+	printf("--END--\n");
+	return 0;
+}
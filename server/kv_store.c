@@ -0,0 +1,444 @@
+/*
+ * kv_store.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "kv_store.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER 0xfadeface
+#define DEAD_MAGIC_NUMBER 0xdeadface
+
+#define MAX_CLASSES 64
+#define INITIAL_CAPACITY 1024 /* slots, a power of 2 */
+/* the table grows when it is this full, in quarters. linear probing slows down fast above it */
+#define MAX_LOAD_QUARTERS 3
+
+#define FNV64_OFFSET 14695981039346656037ull
+#define FNV64_PRIME 1099511628211ull
+
+#define ALIGN8(length) (((length) + 7) & ~((size_t) 7))
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Item
+{
+	uint32_t m_valueLength;
+	uint16_t m_keyLength;
+	uint8_t m_class;
+	unsigned char m_data[]; /* the key, then the value */
+} Item_t;
+
+/* the hash is kept, so probing compares keys only when the hashes match, and growing does not hash again */
+typedef struct Slot
+{
+	uint64_t m_hash;
+	Item_t* m_item; /* NULL when empty */
+} Slot_t;
+
+typedef struct SlabClass
+{
+	uint m_chunkSize;
+	void* m_free; /* freed chunks, each points to the next */
+	unsigned char* m_page; /* the rest of the page being cut */
+	uint m_pageLeft; /* chunks left in it */
+} SlabClass_t;
+
+struct KV_Store
+{
+	uint m_magicNumber;
+
+	Slot_t* m_table;
+	size_t m_capacity;
+	size_t m_items;
+
+	SlabClass_t m_classes[MAX_CLASSES];
+	uint m_classesNum;
+	void** m_pages;
+	size_t m_pagesNum;
+	size_t m_pagesCapacity;
+	size_t m_memoryLimit;
+
+	KV_Stats_t m_stats;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static size_t FindSlot(KV_Store_t* _store, uint64_t _hash, const void* _key, uint _keyLength);
+static bool Grow(KV_Store_t* _store);
+static void RemoveSlot(KV_Store_t* _store, size_t _slot);
+static uint ClassOf(KV_Store_t* _store, size_t _size);
+static Item_t* AllocItem(KV_Store_t* _store, uint _keyLength, uint _valueLength);
+static void FreeItem(KV_Store_t* _store, Item_t* _item);
+static bool AddPage(KV_Store_t* _store, SlabClass_t* _class);
+static uint64_t Hash(const void* _key, uint _keyLength);
+static bool IsStructValid(KV_Store_t* _store);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+KV_Store_t* KV_CreateStore(size_t _memoryLimit)
+{
+	KV_Store_t* aStore;
+	double size;
+
+	aStore = calloc(1, sizeof(KV_Store_t) );
+	if (! aStore)
+	{
+		return NULL;
+	}
+
+	aStore->m_table = calloc(INITIAL_CAPACITY, sizeof(Slot_t) );
+	if (! aStore->m_table)
+	{
+		free(aStore);
+		return NULL;
+	}
+	aStore->m_capacity = INITIAL_CAPACITY;
+	aStore->m_memoryLimit = _memoryLimit;
+
+	/* the classes, each KV_SLAB_GROWTH bigger than the one before it. the last is a whole page */
+	for (size = KV_SLAB_MIN_CHUNK; size < KV_SLAB_PAGE_SIZE && aStore->m_classesNum < MAX_CLASSES - 1; size *= KV_SLAB_GROWTH)
+	{
+		aStore->m_classes[aStore->m_classesNum++].m_chunkSize = ALIGN8((size_t) size);
+	}
+	aStore->m_classes[aStore->m_classesNum++].m_chunkSize = KV_SLAB_PAGE_SIZE;
+
+	aStore->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return aStore;
+}
+
+void KV_DestroyStore(KV_Store_t* _store)
+{
+	size_t i;
+
+	if (! IsStructValid(_store) )
+	{
+		return;
+	}
+
+	_store->m_magicNumber = DEAD_MAGIC_NUMBER;
+	/* the items are in the pages */
+	for (i = 0; i < _store->m_pagesNum; ++i)
+	{
+		free(_store->m_pages[i]);
+	}
+	free(_store->m_pages);
+	free(_store->m_table);
+	free(_store);
+}
+
+bool KV_Set(KV_Store_t* _store, const void* _key, uint _keyLength, const void* _value, uint _valueLength)
+{
+	uint64_t hash;
+	size_t slot;
+	Item_t* item;
+	Item_t* old;
+
+	if (! IsStructValid(_store) || NULL == _key || 0 == _keyLength || _keyLength > KV_MAX_KEY_LENGTH
+		|| (NULL == _value && _valueLength > 0) || _valueLength > KV_MAX_VALUE_LENGTH)
+	{
+		return FALSE;
+	}
+	_store->m_stats.m_sets++;
+
+	hash = Hash(_key, _keyLength);
+	slot = FindSlot(_store, hash, _key, _keyLength);
+	old = _store->m_table[slot].m_item;
+
+	if (old && old->m_class == ClassOf(_store, sizeof(Item_t) + _keyLength + _valueLength) )
+	{
+		/* the new value fits the chunk it has */
+		memcpy(old->m_data + _keyLength, _value, _valueLength);
+		old->m_valueLength = _valueLength;
+		return TRUE;
+	}
+
+	item = AllocItem(_store, _keyLength, _valueLength);
+	if (! item)
+	{
+		_store->m_stats.m_outOfMemory++;
+		return FALSE;
+	}
+	memcpy(item->m_data, _key, _keyLength);
+	memcpy(item->m_data + _keyLength, _value, _valueLength);
+
+	if (old)
+	{
+		FreeItem(_store, old);
+		_store->m_table[slot].m_item = item;
+		return TRUE;
+	}
+
+	if ((_store->m_items + 1) * 4 > _store->m_capacity * MAX_LOAD_QUARTERS)
+	{
+		if (! Grow(_store) )
+		{
+			FreeItem(_store, item);
+			return FALSE;
+		}
+		slot = FindSlot(_store, hash, _key, _keyLength);
+	}
+	_store->m_table[slot].m_hash = hash;
+	_store->m_table[slot].m_item = item;
+	_store->m_items++;
+	return TRUE;
+}
+
+bool KV_Get(KV_Store_t* _store, const void* _key, uint _keyLength, const void** _value, uint* _valueLength)
+{
+	Item_t* item;
+
+	if (! IsStructValid(_store) || NULL == _key || NULL == _value || NULL == _valueLength)
+	{
+		return FALSE;
+	}
+	_store->m_stats.m_gets++;
+
+	item = _store->m_table[FindSlot(_store, Hash(_key, _keyLength), _key, _keyLength)].m_item;
+	if (! item)
+	{
+		return FALSE;
+	}
+	_store->m_stats.m_hits++;
+	*_value = item->m_data + item->m_keyLength;
+	*_valueLength = item->m_valueLength;
+	return TRUE;
+}
+
+bool KV_Del(KV_Store_t* _store, const void* _key, uint _keyLength)
+{
+	size_t slot;
+
+	if (! IsStructValid(_store) || NULL == _key)
+	{
+		return FALSE;
+	}
+	_store->m_stats.m_dels++;
+
+	slot = FindSlot(_store, Hash(_key, _keyLength), _key, _keyLength);
+	if (! _store->m_table[slot].m_item)
+	{
+		return FALSE;
+	}
+	FreeItem(_store, _store->m_table[slot].m_item);
+	RemoveSlot(_store, slot);
+	_store->m_items--;
+	return TRUE;
+}
+
+bool KV_GetStats(KV_Store_t* _store, KV_Stats_t* _stats)
+{
+	if (! IsStructValid(_store) || NULL == _stats)
+	{
+		return FALSE;
+	}
+
+	*_stats = _store->m_stats;
+	_stats->m_items = _store->m_items;
+	_stats->m_tableCapacity = _store->m_capacity;
+	_stats->m_pagesBytes = _store->m_pagesNum * (size_t) KV_SLAB_PAGE_SIZE;
+	return TRUE;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the slot of the key, or the empty slot it would go to. the table is never full, so there always is one */
+static size_t FindSlot(KV_Store_t* _store, uint64_t _hash, const void* _key, uint _keyLength)
+{
+	size_t mask = _store->m_capacity - 1;
+	size_t slot = _hash & mask;
+	Slot_t* entry;
+
+	for (;;)
+	{
+		entry = &_store->m_table[slot];
+		if (! entry->m_item || (entry->m_hash == _hash && entry->m_item->m_keyLength == _keyLength
+								&& 0 == memcmp(entry->m_item->m_data, _key, _keyLength) ) )
+		{
+			return slot;
+		}
+		slot = (slot + 1) & mask;
+	}
+}
+
+/* twice the slots. every key is placed again, a pause of a few milliseconds per million keys */
+static bool Grow(KV_Store_t* _store)
+{
+	size_t newCapacity = _store->m_capacity * 2;
+	size_t mask = newCapacity - 1;
+	Slot_t* newTable;
+	size_t slot;
+	size_t i;
+
+	newTable = calloc(newCapacity, sizeof(Slot_t) );
+	if (! newTable)
+	{
+		return FALSE;
+	}
+
+	for (i = 0; i < _store->m_capacity; ++i)
+	{
+		if (! _store->m_table[i].m_item)
+		{
+			continue;
+		}
+		for (slot = _store->m_table[i].m_hash & mask; newTable[slot].m_item; slot = (slot + 1) & mask)
+		{
+		}
+		newTable[slot] = _store->m_table[i];
+	}
+
+	free(_store->m_table);
+	_store->m_table = newTable;
+	_store->m_capacity = newCapacity;
+	return TRUE;
+}
+
+/* empties the slot, and moves back the entries after it that probed past it, so no search stops short at the hole */
+static void RemoveSlot(KV_Store_t* _store, size_t _slot)
+{
+	size_t mask = _store->m_capacity - 1;
+	size_t next = _slot;
+	size_t home;
+
+	for (;;)
+	{
+		next = (next + 1) & mask;
+		if (! _store->m_table[next].m_item)
+		{
+			break;
+		}
+		home = _store->m_table[next].m_hash & mask;
+		/* it may fill the hole when its home is not between the hole and it */
+		if (((next - home) & mask) >= ((next - _slot) & mask) )
+		{
+			_store->m_table[_slot] = _store->m_table[next];
+			_slot = next;
+		}
+	}
+	_store->m_table[_slot].m_item = NULL;
+}
+
+/* the smallest class with chunks of _size */
+static uint ClassOf(KV_Store_t* _store, size_t _size)
+{
+	uint low = 0;
+	uint high = _store->m_classesNum - 1;
+	uint middle;
+
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+		if (_store->m_classes[middle].m_chunkSize < _size)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+static Item_t* AllocItem(KV_Store_t* _store, uint _keyLength, uint _valueLength)
+{
+	uint classIndex = ClassOf(_store, sizeof(Item_t) + _keyLength + _valueLength);
+	SlabClass_t* class = &_store->m_classes[classIndex];
+	Item_t* item;
+
+	if (class->m_free)
+	{
+		item = class->m_free;
+		class->m_free = *(void**) item;
+	}
+	else
+	{
+		if (0 == class->m_pageLeft && ! AddPage(_store, class) )
+		{
+			return NULL;
+		}
+		item = (Item_t*) class->m_page;
+		class->m_page += class->m_chunkSize;
+		class->m_pageLeft--;
+	}
+
+	item->m_keyLength = _keyLength;
+	item->m_valueLength = _valueLength;
+	item->m_class = classIndex;
+	_store->m_stats.m_chunksBytes += class->m_chunkSize;
+	return item;
+}
+
+static void FreeItem(KV_Store_t* _store, Item_t* _item)
+{
+	SlabClass_t* class = &_store->m_classes[_item->m_class];
+
+	_store->m_stats.m_chunksBytes -= class->m_chunkSize;
+	*(void**) _item = class->m_free;
+	class->m_free = _item;
+}
+
+static bool AddPage(KV_Store_t* _store, SlabClass_t* _class)
+{
+	void** newPages;
+	void* page;
+
+	if (_store->m_memoryLimit > 0 && (_store->m_pagesNum + 1) * (size_t) KV_SLAB_PAGE_SIZE > _store->m_memoryLimit)
+	{
+		return FALSE;
+	}
+
+	if (_store->m_pagesNum == _store->m_pagesCapacity)
+	{
+		_store->m_pagesCapacity = _store->m_pagesCapacity ? _store->m_pagesCapacity * 2 : 64;
+		newPages = realloc(_store->m_pages, _store->m_pagesCapacity * sizeof(void*) );
+		if (! newPages)
+		{
+			return FALSE;
+		}
+		_store->m_pages = newPages;
+	}
+
+	page = malloc(KV_SLAB_PAGE_SIZE);
+	if (! page)
+	{
+		return FALSE;
+	}
+	_store->m_pages[_store->m_pagesNum++] = page;
+	_class->m_page = page;
+	_class->m_pageLeft = KV_SLAB_PAGE_SIZE / _class->m_chunkSize;
+	return TRUE;
+}
+
+/* FNV-1a. the low bits index the table, the splitmix64 finalizer spreads similar keys over them */
+static uint64_t Hash(const void* _key, uint _keyLength)
+{
+	const unsigned char* bytes = _key;
+	uint64_t hash = FNV64_OFFSET;
+	uint i;
+
+	for (i = 0; i < _keyLength; ++i)
+	{
+		hash = (hash ^ bytes[i]) * FNV64_PRIME;
+	}
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ull;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebull;
+	hash ^= hash >> 31;
+	return hash;
+}
+
+static bool IsStructValid(KV_Store_t* _store)
+{
+	return (_store && _store->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
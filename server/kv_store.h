@@ -0,0 +1,106 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief The in-memory store of the key-value server (server_kv.c).
+ * Keys are found in an open addressing hash table (linear probing, deletes shift the following entries back, so there
+ * are no tombstones). Each item, its key and value together, is one chunk of a slab: memory is taken from the system in
+ * pages of KV_SLAB_PAGE_SIZE, each page cut into chunks of one size class, the classes KV_SLAB_GROWTH apart. A freed
+ * chunk goes back to the free list of its class, so a busy store does not call malloc at all.
+ * Not thread safe. one store for one loop.
+ *
+ * @bug a page stays with the class it was first cut for. when the sizes of the values change over time, the memory
+ * limit may be reached with free chunks of other classes. nothing is evicted, a set over the limit fails.
+ */
+
+#ifndef KV_STORE_H_
+#define KV_STORE_H_
+
+#include <stddef.h>
+
+typedef unsigned int uint;
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define KV_SLAB_PAGE_SIZE (1 << 20)
+#define KV_SLAB_MIN_CHUNK 64
+#define KV_SLAB_GROWTH 1.25
+#define KV_MAX_KEY_LENGTH 250
+/* an item takes a chunk, a chunk is at most a page */
+#define KV_MAX_VALUE_LENGTH (KV_SLAB_PAGE_SIZE - KV_MAX_KEY_LENGTH - 16)
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct KV_Store KV_Store_t;
+
+typedef struct KV_Stats
+{
+	size_t m_items;
+	size_t m_tableCapacity; /* slots of the hash table */
+	size_t m_pagesBytes; /* taken from the system for the items */
+	size_t m_chunksBytes; /* of them, in chunks holding items */
+	unsigned long m_gets;
+	unsigned long m_hits;
+	unsigned long m_sets;
+	unsigned long m_dels;
+	unsigned long m_outOfMemory; /* sets that failed on the limit */
+} KV_Stats_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create an empty store.
+ * @param _memoryLimit bytes of pages for the items. 0 for no limit.
+ * @return pointer to the newly create struct. NULL if failed.
+ */
+KV_Store_t* KV_CreateStore(size_t _memoryLimit);
+
+/**
+ * @brief Free the store and all its items.
+ * @param _store pointer to the struct
+ * @return void. silent fail.
+ */
+void KV_DestroyStore(KV_Store_t* _store);
+
+/**
+ * @brief Set the value of a key, adding the key if it is new.
+ * @param _store pointer to the struct
+ * @param _key 1 to KV_MAX_KEY_LENGTH bytes
+ * @param _keyLength its size
+ * @param _value copied into the store
+ * @param _valueLength up to KV_MAX_VALUE_LENGTH
+ * @return TRUE if success or FALSE if failed (bad sizes, or over the memory limit).
+ */
+bool KV_Set(KV_Store_t* _store, const void* _key, uint _keyLength, const void* _value, uint _valueLength);
+
+/**
+ * @brief Find the value of a key.
+ * @param _store pointer to the struct
+ * @param _key the key
+ * @param _keyLength its size
+ * @param _value output. points into the store, valid until the next set or delete.
+ * @param _valueLength output.
+ * @return TRUE if found or FALSE if not.
+ */
+bool KV_Get(KV_Store_t* _store, const void* _key, uint _keyLength, const void** _value, uint* _valueLength);
+
+/**
+ * @brief Delete a key and its value.
+ * @param _store pointer to the struct
+ * @param _key the key
+ * @param _keyLength its size
+ * @return TRUE if it was there or FALSE if not.
+ */
+bool KV_Del(KV_Store_t* _store, const void* _key, uint _keyLength);
+
+/**
+ * @brief The numbers of the store.
+ * @param _store pointer to the struct
+ * @param _stats out
+ * @return TRUE if success or FALSE if failed.
+ */
+bool KV_GetStats(KV_Store_t* _store, KV_Stats_t* _stats);
+
+#endif /* KV_STORE_H_ */
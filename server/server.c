@@ -10,13 +10,45 @@
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <arpa/inet.h> /* htonl */
 
 #include "tcp.h"
+#include "tcp_pubsub.h"
+#include "tcp_group.h"
+#include "tcp_log.h"
+#include "tcp_rpc.h"
 
 /* global for sigaction */
 TCP_S_t* g_tcp = NULL;
+TCP_Group_t* g_group = NULL;
+bool g_isFramed = FALSE;
+bool g_isRxTimestamps = FALSE;
+const char* g_upstream = NULL; /* proxy mode (-x) */
+size_t g_memoryBudget = 0; /* of each loop (-M) */
+uint g_pauseQueue = 0; /* bytes queued to a connection that pause reading it (-q) */
+TCP_PubSub_t* g_pubsub = NULL;
+TCP_Rpc_t* g_rpc = NULL;
+unsigned long g_messages = 0; /* since the last stats timer. counted by all the loops */
 
 #define MAX_CONNECTIONS_ALLWAED 1000
+#define FAST_OPEN_QUEUE 256
+#define MAX_TOPIC_LENGTH 128
+#define CPUS_SEPARATORS ","
+
+/* the methods of RPC mode (-R), as rpcClient calls them */
+#define RPC_ECHO 1 /* answers with the arguments */
+#define RPC_ADD 2 /* two uint32, network order. answers with their sum */
+#define RPC_LATER 3 /* uint32 milliseconds, network order. answers with the arguments after that long */
+#define RPC_METHODS_NUM 3
+
+/* an answer RPC_LATER still owes */
+typedef struct Later
+{
+	uint m_socketNum;
+	uint m_requestID;
+	uint32_t m_delayMS;
+} Later_t;
 
 typedef void (*sigHandler)(int sig, siginfo_t *siginfo, void *context);
 void sigAbortHandler(int sig, siginfo_t *siginfo, void *context)
@@ -24,7 +56,14 @@ void sigAbortHandler(int sig, siginfo_t *siginfo, void *context)
 	const char notify[] = "\nGot Signal, lets Clean and exit server\n\n";
 	write(STDERR_FILENO, notify, strlen(notify));
 
-	TCP_StopServer(g_tcp);
+	if (g_group)
+	{
+		TCP_StopServerGroup(g_group);
+	}
+	else
+	{
+		TCP_StopServer(g_tcp);
+	}
 
 	return;
 }
@@ -53,20 +92,300 @@ bool signalHangelSet(sigHandler _func)
 	return TRUE;
 }
 
-int MyFunc(void* _data, size_t _sizeData, uint _socketNum, void* _contex)
+/* the server of the loop calling, with several loops each runs its own */
+TCP_S_t* ThisServer(void)
+{
+	return g_group ? TCP_GroupThisServer() : g_tcp;
+}
+
+int MyFramedFunc(void* _data, size_t _sizeData, uint _socketNum, void* _contex, void* _connContex)
+{
+	__atomic_fetch_add(&g_messages, 1, __ATOMIC_RELAXED);
+	TCP_LOG_TEXT(TCP_LOG_DEBUG, "Recive:%.*s. #%lu", _data, _sizeData, TCP_GetRequestID(ThisServer() ), 0);
+	if (_sizeData > 0)
+	{
+		memcpy(_data, "!", 1);
+	}
+
+	/* echo back with the same request ID, so a pipelined client can match it */
+	/* the data is a pooled buffer, it is queued as it is if the socket is busy */
+	if ( TCP_SendFrameBuffer(_socketNum, TCP_GetRequestID(ThisServer() ), _data, _sizeData) <= 0)
+	{
+		TCP_LOG_ERRNO(TCP_LOG_ERROR, "Send response from server failed, socket #%ld", _socketNum, 0);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* broker mode. frames of "SUB topic", "UNSUB topic" or "PUB topic message" */
+int MyBrokerFunc(void* _data, size_t _sizeData, uint _socketNum, void* _contex, void* _connContex)
+{
+	char topic[MAX_TOPIC_LENGTH];
+	char* data = _data;
+	char* end = data + _sizeData;
+	char* topicStart;
+	char* topicEnd;
+	int reached;
+
+	__atomic_fetch_add(&g_messages, 1, __ATOMIC_RELAXED);
+	topicStart = memchr(data, ' ', _sizeData);
+	if (! topicStart)
+	{
+		return FALSE;
+	}
+	++topicStart;
+	topicEnd = memchr(topicStart, ' ', end - topicStart);
+	if (! topicEnd)
+	{
+		topicEnd = end;
+	}
+	if (topicEnd - topicStart >= MAX_TOPIC_LENGTH)
+	{
+		return FALSE;
+	}
+	memcpy(topic, topicStart, topicEnd - topicStart);
+	topic[topicEnd - topicStart] = '\0';
+
+	if (strncmp(data, "SUB ", 4) == 0)
+	{
+		return TCP_Subscribe(g_pubsub, _socketNum, topic);
+	}
+	if (strncmp(data, "UNSUB ", 6) == 0)
+	{
+		return TCP_Unsubscribe(g_pubsub, _socketNum, topic);
+	}
+	if (strncmp(data, "PUB ", 4) == 0 && topicEnd < end)
+	{
+		reached = TCP_Publish(g_pubsub, topic, topicEnd + 1, end - topicEnd - 1);
+		return reached >= 0;
+	}
+
+	return FALSE;
+}
+
+int MyFunc(void* _data, size_t _sizeData, uint _socketNum, void* _contex, void* _connContex)
 {
-	printf("Recive:%s. \n", (char*) _data);
+	__atomic_fetch_add(&g_messages, 1, __ATOMIC_RELAXED);
+	TCP_LOG_TEXT(TCP_LOG_DEBUG, "Recive:%.*s.", _data, _sizeData, 0, 0);
 	memcpy(_data, "!", 1);
 
-	if ( TCP_Send(_socketNum, _data, _sizeData) <= 0)
+	if ( TCP_SendBuffer(_socketNum, _data, _sizeData) <= 0)
 	{
-		perror("Send response from server failed.\n");
+		TCP_LOG_ERRNO(TCP_LOG_ERROR, "Send response from server failed, socket #%ld", _socketNum, 0);
 		return FALSE;
 	}
 
 	return TRUE;
 }
 
+/* RPC mode. the method number is in the frame header, the table calls it */
+int MyRpcFunc(void* _data, size_t _sizeData, uint _socketNum, void* _contex, void* _connContex)
+{
+	__atomic_fetch_add(&g_messages, 1, __ATOMIC_RELAXED);
+	return TCP_RpcDispatch(g_rpc, ThisServer(), _data, _sizeData, _socketNum) == TCP_RPC_OK;
+}
+
+TCP_RPC_STATUS RpcEcho(uint _socketNum, uint _requestID, void* _args, size_t _argsSize, void* _contex)
+{
+	/* the arguments are a pooled buffer, they go back without a copy */
+	return TCP_RpcReply(_socketNum, _requestID, _args, _argsSize) > 0 ? TCP_RPC_OK : TCP_RPC_FAILED;
+}
+
+TCP_RPC_STATUS RpcAdd(uint _socketNum, uint _requestID, void* _args, size_t _argsSize, void* _contex)
+{
+	uint32_t numbers[2];
+	uint32_t sum;
+
+	if (_argsSize != sizeof(numbers) )
+	{
+		return TCP_RPC_BAD_ARGS;
+	}
+	memcpy(numbers, _args, sizeof(numbers) );
+	sum = htonl(ntohl(numbers[0]) + ntohl(numbers[1]) );
+	return TCP_RpcReply(_socketNum, _requestID, &sum, sizeof(sum) ) > 0 ? TCP_RPC_OK : TCP_RPC_FAILED;
+}
+
+int RpcLaterTimer(uint _timerID, void* _later)
+{
+	Later_t* later = _later;
+	uint32_t delayMS = htonl(later->m_delayMS);
+
+	/* the connection may be gone meanwhile, then the answer fails */
+	TCP_RpcReply(later->m_socketNum, later->m_requestID, &delayMS, sizeof(delayMS) );
+	free(later);
+	return FALSE;
+}
+
+/* answers after the calls that came later, on the same connection */
+TCP_RPC_STATUS RpcLater(uint _socketNum, uint _requestID, void* _args, size_t _argsSize, void* _contex)
+{
+	Later_t* later;
+
+	if (_argsSize != sizeof(uint32_t) )
+	{
+		return TCP_RPC_BAD_ARGS;
+	}
+	later = malloc(sizeof(Later_t) );
+	if (! later)
+	{
+		return TCP_RPC_FAILED;
+	}
+	later->m_socketNum = _socketNum;
+	later->m_requestID = _requestID;
+	memcpy(&later->m_delayMS, _args, sizeof(uint32_t) );
+	later->m_delayMS = ntohl(later->m_delayMS);
+
+	if (0 == TCP_AddTimer(ThisServer(), later->m_delayMS, 0, RpcLaterTimer, later) )
+	{
+		free(later);
+		return TCP_RPC_FAILED;
+	}
+	return TCP_RPC_OK;
+}
+
+TCP_Rpc_t* CreateRpcMethods(void)
+{
+	TCP_Rpc_t* rpc = TCP_CreateRpc(RPC_METHODS_NUM);
+
+	TCP_RpcRegister(rpc, RPC_ECHO, RpcEcho, NULL);
+	TCP_RpcRegister(rpc, RPC_ADD, RpcAdd, NULL);
+	TCP_RpcRegister(rpc, RPC_LATER, RpcLater, NULL);
+	return rpc;
+}
+
+/* periodic, on the server thread */
+void PrintMemory(TCP_S_t* _server)
+{
+	TCP_MemoryStats_t stats;
+
+	TCP_ServerMemoryStats(_server, &stats);
+	printf("memory: %zu bytes of %zu, per connection %zu (idle %zu, largest %zu), shed %lu, refused %lu\n", stats.m_used,
+			stats.m_budget, stats.m_perConnection, stats.m_idleConnection, stats.m_largest, stats.m_shed, stats.m_refused);
+}
+
+void PrintFlow(TCP_S_t* _server)
+{
+	TCP_FlowStats_t stats;
+
+	if (g_pauseQueue > 0)
+	{
+		TCP_ServerFlowStats(_server, &stats);
+		printf("flow: %u connections not read (%u for their queue), queues over %u bytes %lu times\n", stats.m_paused,
+				stats.m_queuePaused, g_pauseQueue, stats.m_queuePauses);
+	}
+}
+
+int StatsTimer(uint _timerID, void* _contex)
+{
+	uint intervalSec = *(uint*) _contex;
+
+	printf("messages/sec %lu\n", __atomic_exchange_n(&g_messages, 0, __ATOMIC_RELAXED) / intervalSec);
+	if (g_memoryBudget > 0)
+	{
+		PrintMemory(ThisServer() );
+	}
+	PrintFlow(ThisServer() );
+	return TRUE;
+}
+
+/* "0,2,4" to _cpus. returns how many, 0 if not a list */
+uint ParseCpus(char* _list, int* _cpus, uint _maxCpus)
+{
+	uint cpusNum = 0;
+	char* cpu;
+
+	for (cpu = strtok(_list, CPUS_SEPARATORS); cpu && cpusNum < _maxCpus; cpu = strtok(NULL, CPUS_SEPARATORS) )
+	{
+		_cpus[cpusNum++] = atoi(cpu);
+	}
+	return cpusNum;
+}
+
+/* the same settings for every loop */
+void SetupServer(TCP_S_t* _server, bool _isFastOpen, bool _isShm, bool _isCompress, uint _spinUS, uint _kernelPollUS)
+{
+	TCP_ServerSetFraming(_server, g_isFramed);
+	if (_isFastOpen)
+	{
+		TCP_ServerSetFastOpen(_server, FAST_OPEN_QUEUE);
+	}
+	TCP_ServerSetSharedMemory(_server, _isShm);
+	TCP_ServerSetCompression(_server, _isCompress, NULL, TCP_COMPRESS_DEFAULT_THRESHOLD);
+	TCP_ServerSetBusyPoll(_server, _spinUS, _kernelPollUS);
+	TCP_ServerSetRxTimestamps(_server, g_isRxTimestamps);
+	if (g_upstream)
+	{
+		TCP_ServerSetProxy(_server, g_upstream);
+	}
+	TCP_ServerSetMemoryBudget(_server, g_memoryBudget);
+	/* reading resumes once the queue is half gone */
+	TCP_ServerSetReadPause(_server, g_pauseQueue, g_pauseQueue / 2);
+}
+
+void PrintProxyBytes(TCP_S_t* _server)
+{
+	if (g_upstream)
+	{
+		printf("proxy: %lu bytes relayed to and from %s\n", TCP_ServerProxyBytes(_server), g_upstream);
+	}
+}
+
+void PrintPollStats(TCP_S_t* _server)
+{
+	TCP_PollStats_t stats;
+
+	TCP_ServerPollStats(_server, &stats);
+	printf("busy poll: %lu polls, %lu found work, %lu sleeps\n", stats.m_polls, stats.m_pollHits, stats.m_sleeps);
+}
+
+/* time from the kernel to MyFunc, one line per bucket that has messages */
+void PrintRxDelay(TCP_S_t* _server)
+{
+	TCP_RxDelayStats_t stats;
+	uint i;
+
+	if (! g_isRxTimestamps || ! TCP_ServerRxDelayStats(_server, &stats) || 0 == stats.m_messages)
+	{
+		return;
+	}
+	printf("kernel to handler: %lu messages, avg %.1f usec, max %.1f usec\n", stats.m_messages,
+			stats.m_sumNS / 1e3 / stats.m_messages, stats.m_maxNS / 1e3);
+	for (i = 0; i < TCP_RX_DELAY_BUCKETS; ++i)
+	{
+		if (stats.m_buckets[i] > 0)
+		{
+			printf("  %10lu - %10lu usec: %lu\n", i ? 1UL << (i - 1) : 0, 1UL << i, stats.m_buckets[i]);
+		}
+	}
+}
+
+void PrintLoopsStats(TCP_Group_t* _group)
+{
+	TCP_LoopStats_t stats;
+	uint i;
+
+	for (i = 0; i < TCP_GroupLoopsNum(_group); ++i)
+	{
+		TCP_GroupLoopStats(_group, i, &stats);
+		printf("loop %u cpu %d: accepted %lu, arrived on its cpu %lu\n", i, stats.m_cpu, stats.m_accepted, stats.m_acceptedOnCpu);
+		PrintPollStats(TCP_GroupServer(_group, i) );
+		PrintRxDelay(TCP_GroupServer(_group, i) );
+		PrintProxyBytes(TCP_GroupServer(_group, i) );
+		PrintMemory(TCP_GroupServer(_group, i) );
+		PrintFlow(TCP_GroupServer(_group, i) );
+	}
+}
+
+void StopLog(void)
+{
+	TCP_LogStop();
+	if (TCP_LogDropped() > 0)
+	{
+		printf("log records dropped: %lu\n", TCP_LogDropped() );
+	}
+}
+
 int main(int argc, char* argv[])
 {
 	printf("--START--\n");
@@ -74,17 +393,212 @@ int main(int argc, char* argv[])
 	uint portNum = 4848;
 	TCP_S_t* server;
 	uint timeoutMS = 300000; /* 5 min */
+	uint maxConnections = MAX_CONNECTIONS_ALLWAED;
+
+	int opt;
+	bool isFastOpen = FALSE;
+	bool isShm = FALSE;
+	bool isCompress = FALSE;
+	bool isBroker = FALSE;
+	bool isRpc = FALSE;
+	char inetEndpoint[32];
+	const char* endpoints[2];
+	uint endpointsNum = 1;
+	uint statsSec = 0;
+	uint loopsNum = 1;
+	int cpus[TCP_GROUP_MAX_LOOPS];
+	uint cpusNum = 0;
+	uint spinUS = 0;
+	uint kernelPollUS = 0;
+	const char* capturePath = NULL;
+	TCP_Capture_t* capture = NULL;
 
-	/* TODO option get ip and port from agrc */
+	/* TODO option get ip from agrc */
+	while ((opt = getopt(argc, argv, "p:fosu:zbRt:l:c:w:k:r:m:Tx:M:q:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p':
+			portNum = atoi(optarg);
+			break;
+		case 'f':
+			g_isFramed = TRUE;
+			break;
+		case 'o':
+			isFastOpen = TRUE;
+			break;
+		case 's':
+			isShm = TRUE;
+			break;
+		case 'z':
+			isCompress = TRUE;
+			break;
+		case 'b':
+			/* publish/subscribe needs message boundaries */
+			isBroker = TRUE;
+			g_isFramed = TRUE;
+			break;
+		case 'R':
+			/* calls need the method and the request ID of the frame header */
+			isRpc = TRUE;
+			g_isFramed = TRUE;
+			break;
+		case 't':
+			statsSec = atoi(optarg);
+			break;
+		case 'l':
+			loopsNum = atoi(optarg);
+			break;
+		case 'c':
+			cpusNum = ParseCpus(optarg, cpus, TCP_GROUP_MAX_LOOPS);
+			break;
+		case 'w':
+			spinUS = atoi(optarg);
+			break;
+		case 'k':
+			kernelPollUS = atoi(optarg);
+			break;
+		case 'm':
+			maxConnections = atoi(optarg);
+			break;
+		case 'T':
+			/* kernel receive stamps, the delay histogram is printed at the end */
+			g_isRxTimestamps = TRUE;
+			break;
+		case 'M':
+			/* megabytes for the connections, divided between the loops below */
+			g_memoryBudget = (size_t) atoi(optarg) << 20;
+			break;
+		case 'q':
+			/* kilobytes queued to a slow reader before the server stops reading its requests */
+			g_pauseQueue = (uint) atoi(optarg) << 10;
+			break;
+		case 'x':
+			/* the connections are relayed to another server, this one only moves the bytes */
+			g_upstream = optarg;
+			break;
+		case 'r':
+			/* for replayClient */
+			capturePath = optarg;
+			break;
+		case 'u':
+			/* local clients can skip the TCP stack */
+			endpoints[endpointsNum++] = optarg;
+			break;
+		default:
+			printf("usage: %s [-p port] [-f (framed mode)] [-o (TCP fast open)] [-s (shared memory clients)] [-z (compression, framed mode)] [-u unix:/socket/path] [-b (publish/subscribe broker, framed)] [-R (RPC methods, framed)] [-t seconds (print stats)] [-l loops (threads)] [-c cpu,list (pin the loops)] [-w usec (spin before sleeping)] [-k usec (SO_BUSY_POLL)] [-r capture/file] [-m max connections] [-T (kernel to handler delay)] [-x host:port (proxy to upstream)] [-M megabytes (connections memory budget)] [-q kilobytes (queue that pauses reading)]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (cpusNum > 0 && loopsNum == 1)
+	{
+		loopsNum = cpusNum;
+	}
+	if ((loopsNum > 1 || cpusNum > 0) && (isBroker || endpointsNum > 1 || capturePath || (cpusNum > 0 && cpusNum != loopsNum) ) )
+	{
+		printf("ERROR. several loops take a cpu for each loop, and no broker, unix socket or capture.\n");
+		return 1;
+	}
+
+	g_memoryBudget /= (loopsNum > 0) ? loopsNum : 1;
+
+	if (isRpc)
+	{
+		/* read only while serving, one table for all the loops */
+		g_rpc = CreateRpcMethods();
+		if (! g_rpc)
+		{
+			printf("ERROR. could not create the RPC methods.\n");
+			return 1;
+		}
+	}
 
 	signalHangelSet(sigAbortHandler);
+	/* the loops only queue their log records, this thread writes them */
+	TCP_LogStart(stdout);
+
+	snprintf(inetEndpoint, sizeof(inetEndpoint), "*:%u", portNum);
+	endpoints[0] = inetEndpoint;
+
+	if (loopsNum > 1 || cpusNum > 0)
+	{
+		g_group = TCP_CreateServerGroup(inetEndpoint, loopsNum, cpusNum > 0 ? cpus : NULL, maxConnections, timeoutMS,
+							g_rpc ? MyRpcFunc : g_isFramed ? MyFramedFunc : MyFunc, NULL, NULL, NULL, NULL);
+		if (! g_group)
+		{
+			printf("ERROR. could not create %u loops on port %u.\n", loopsNum, portNum);
+			return 1;
+		}
+		for (uint i = 0; i < loopsNum; ++i)
+		{
+			SetupServer(TCP_GroupServer(g_group, i), isFastOpen, isShm, isCompress, spinUS, kernelPollUS);
+		}
+		if (statsSec > 0)
+		{
+			/* the count is of all the loops, one of them prints it */
+			TCP_AddTimer(TCP_GroupServer(g_group, 0), statsSec * 1000, statsSec * 1000, StatsTimer, &statsSec);
+		}
+
+		TCP_RunServerGroup(g_group);
 
-	server = TCP_CreateServer(portNum, NULL, MAX_CONNECTIONS_ALLWAED, timeoutMS, MyFunc, NULL, NULL, NULL, NULL);
+		PrintLoopsStats(g_group);
+		TCP_DestroyServerGroup(g_group);
+		g_group = NULL;
+		TCP_DestroyRpc(g_rpc);
+		StopLog();
+		printf("--END--\n");
+		return 0;
+	}
+
+	server = TCP_CreateServerEndpoints(endpoints, endpointsNum, maxConnections, timeoutMS,
+							isBroker ? MyBrokerFunc : g_rpc ? MyRpcFunc : g_isFramed ? MyFramedFunc : MyFunc, NULL, NULL, NULL, NULL);
+	if (! server)
+	{
+		printf("ERROR. could not create server on port %u.\n", portNum);
+		return 1;
+	}
+	SetupServer(server, isFastOpen, isShm, isCompress, spinUS, kernelPollUS);
+	if (isBroker)
+	{
+		g_pubsub = TCP_CreatePubSub(server, TCP_PUBSUB_DEFAULT_MAX_QUEUED, TCP_SLOW_DROP);
+	}
+	if (capturePath)
+	{
+		capture = TCP_CaptureCreate(capturePath);
+		if (! capture)
+		{
+			printf("ERROR. could not create capture file %s.\n", capturePath);
+			TCP_DestroyServer(server);
+			return 1;
+		}
+		TCP_ServerSetCapture(server, capture);
+	}
+	if (statsSec > 0)
+	{
+		TCP_AddTimer(server, statsSec * 1000, statsSec * 1000, StatsTimer, &statsSec);
+	}
 	g_tcp = server;
 
 	TCP_RunServer(server);
 
 	g_tcp = NULL;
+	if (g_pubsub)
+	{
+		printf("messages dropped for slow subscribers: %lu\n", TCP_PubSubDropped(g_pubsub) );
+		TCP_DestroyPubSub(g_pubsub);
+	}
+	PrintPollStats(server);
+	PrintRxDelay(server);
+	PrintProxyBytes(server);
+	PrintMemory(server);
+	PrintFlow(server);
 	TCP_DestroyServer(server);
+	TCP_DestroyRpc(g_rpc);
+	if (capture)
+	{
+		printf("messages captured: %lu\n", TCP_CaptureRecordsNum(capture) );
+		TCP_CaptureDestroy(capture);
+	}
+	StopLog();
 	printf("--END--\n");
 }
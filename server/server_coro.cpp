@@ -0,0 +1,91 @@
+/*
+ * server_coro.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Echo server written with the coroutine layer. One coroutine per connection.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include <unistd.h>
+
+#include "tcp_coro.hpp"
+
+#define MAX_CONNECTIONS_ALLWAED 1000
+
+/* global for sigaction */
+static tcp::Server* g_server = nullptr;
+
+static void sigAbortHandler(int _sig)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit server\n\n";
+	write(STDERR_FILENO, notify, strlen(notify) );
+
+	if (g_server)
+	{
+		g_server->Stop();
+	}
+}
+
+/* what was read goes back as it is. in framed mode with the request ID it came with */
+static tcp::Task Echo(tcp::Connection& _conn)
+{
+	while (tcp::Message msg = co_await _conn.read() )
+	{
+		if (co_await _conn.write(msg) <= 0)
+		{
+			break;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::printf("--START--\n");
+
+	uint portNum = 4848;
+	uint timeoutMS = 300000; /* 5 min */
+	bool isFramed = false;
+	struct sigaction act;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:f")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p':
+			portNum = std::atoi(optarg);
+			break;
+		case 'f':
+			isFramed = true;
+			break;
+		default:
+			std::printf("usage: %s [-p port] [-f (framed mode)]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::unique_ptr<tcp::Server> server = tcp::Server::Create(portNum, Echo, isFramed, MAX_CONNECTIONS_ALLWAED, timeoutMS);
+	if (! server)
+	{
+		std::printf("ERROR. could not create server on port %u.\n", portNum);
+		return 1;
+	}
+
+	std::memset(&act, 0, sizeof(act) );
+	act.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+	g_server = server.get();
+
+	server->Run();
+
+	g_server = nullptr;
+	server.reset();
+	std::printf("--END--\n");
+	return 0;
+}
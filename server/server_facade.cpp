@@ -0,0 +1,110 @@
+/*
+ * server_facade.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  Echo server written with the template facade, tcp.hpp.
+ *  The framing is a template parameter, so each mode is its own instantiation.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include <unistd.h>
+
+#include "tcp.hpp"
+
+#define MAX_CONNECTIONS_ALLWAED 1000
+#define MAX_MESSAGE_SIZE 65536
+
+/* global for sigaction */
+static TCP_S_t* g_tcp = nullptr;
+
+static void sigAbortHandler(int _sig)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit server\n\n";
+	write(STDERR_FILENO, notify, strlen(notify) );
+
+	TCP_StopServer(g_tcp);
+}
+
+struct Echo
+{
+	unsigned long m_connections = 0;
+	unsigned long m_messages = 0;
+
+	template <class Session>
+	void operator()(Session& _session, std::string_view _msg)
+	{
+		++m_messages;
+		if (_session.send_back(_msg) <= 0)
+		{
+			_session.close();
+		}
+	}
+
+	template <class Session>
+	void on_connect(Session&)
+	{
+		++m_connections;
+	}
+};
+
+template <class Framing>
+static int Serve(uint _portNum, uint _timeoutMS)
+{
+	tcp::server<Echo, Framing, tcp::max_size<MAX_MESSAGE_SIZE> > server(_portNum, Echo(), {}, MAX_CONNECTIONS_ALLWAED, _timeoutMS);
+
+	if (! server)
+	{
+		std::printf("ERROR. could not create server on port %u.\n", _portNum);
+		return 1;
+	}
+	g_tcp = server.native();
+
+	server.run();
+
+	g_tcp = nullptr;
+	std::printf("%lu connections, %lu messages\n", server.handler().m_connections, server.handler().m_messages);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::printf("--START--\n");
+
+	uint portNum = 4848;
+	uint timeoutMS = 300000; /* 5 min */
+	bool isFramed = false;
+	struct sigaction act;
+	int result;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:f")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p':
+			portNum = std::atoi(optarg);
+			break;
+		case 'f':
+			isFramed = true;
+			break;
+		default:
+			std::printf("usage: %s [-p port] [-f (framed mode)]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::memset(&act, 0, sizeof(act) );
+	act.sa_handler = sigAbortHandler;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+
+	result = isFramed ? Serve<tcp::framed>(portNum, timeoutMS) : Serve<tcp::raw>(portNum, timeoutMS);
+
+	std::printf("--END--\n");
+	return result;
+}
@@ -0,0 +1,197 @@
+/*
+ * server_kv.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ *
+ *  In-memory key-value server, the reference for what the library sustains (kvClient is its benchmark).
+ *  A framed server with three RPC methods (tcp_rpc.h), so a client pipelines as many requests as it likes and
+ *  matches the answers by request ID:
+ *      KV_GET 1  args: the key.                                answer: the value. TCP_RPC_FAILED when not found.
+ *      KV_SET 2  args: key length (uint16, network order),
+ *                      the key, the value.                     answer: empty. TCP_RPC_FAILED over the memory limit.
+ *      KV_DEL 3  args: the key.                                answer: empty. TCP_RPC_FAILED when not found.
+ *  The store (kv_store.h) is of the one loop, nothing is locked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h> /* ntohs */
+
+#include "tcp.h"
+#include "tcp_rpc.h"
+#include "tcp_log.h"
+#include "kv_store.h"
+
+#define MAX_CONNECTIONS_ALLWAED 1000
+#define DEFAULT_MEMORY_MB 1024
+#define TIMEOUT_MS 300000 /* 5 min */
+
+#define KV_GET 1
+#define KV_SET 2
+#define KV_DEL 3
+#define KV_METHODS_NUM 3
+
+/* global for sigaction */
+TCP_S_t* g_tcp = NULL;
+TCP_Rpc_t* g_rpc = NULL;
+unsigned long g_requests = 0; /* since the last stats timer */
+
+void sigAbortHandler(int _sig)
+{
+	const char notify[] = "\nGot Signal, lets Clean and exit server\n\n";
+	write(STDERR_FILENO, notify, strlen(notify) );
+
+	TCP_StopServer(g_tcp);
+}
+
+int KvFunc(void* _data, size_t _sizeData, uint _socketNum, void* _contex, void* _connContex)
+{
+	++g_requests;
+	return TCP_RpcDispatch(g_rpc, g_tcp, _data, _sizeData, _socketNum) == TCP_RPC_OK;
+}
+
+TCP_RPC_STATUS KvGet(uint _socketNum, uint _requestID, void* _args, size_t _argsSize, void* _contex)
+{
+	const void* value;
+	uint valueLength;
+
+	if (! KV_Get(_contex, _args, _argsSize, &value, &valueLength) )
+	{
+		return TCP_RPC_FAILED;
+	}
+	/* the value is in the store, not a pooled buffer. it is copied as it is sent, a later set does not touch it */
+	return TCP_SendFrame(_socketNum, _requestID, (void*) value, valueLength) > 0 ? TCP_RPC_OK : TCP_RPC_FAILED;
+}
+
+TCP_RPC_STATUS KvSet(uint _socketNum, uint _requestID, void* _args, size_t _argsSize, void* _contex)
+{
+	unsigned char* args = _args;
+	uint16_t keyLength;
+
+	if (_argsSize < sizeof(keyLength) )
+	{
+		return TCP_RPC_BAD_ARGS;
+	}
+	memcpy(&keyLength, args, sizeof(keyLength) );
+	keyLength = ntohs(keyLength);
+	if (0 == keyLength || keyLength > KV_MAX_KEY_LENGTH || sizeof(keyLength) + keyLength > _argsSize)
+	{
+		return TCP_RPC_BAD_ARGS;
+	}
+
+	if (! KV_Set(_contex, args + sizeof(keyLength), keyLength, args + sizeof(keyLength) + keyLength,
+				_argsSize - sizeof(keyLength) - keyLength) )
+	{
+		return TCP_RPC_FAILED;
+	}
+	return TCP_RpcReply(_socketNum, _requestID, NULL, 0) > 0 ? TCP_RPC_OK : TCP_RPC_FAILED;
+}
+
+TCP_RPC_STATUS KvDel(uint _socketNum, uint _requestID, void* _args, size_t _argsSize, void* _contex)
+{
+	if (! KV_Del(_contex, _args, _argsSize) )
+	{
+		return TCP_RPC_FAILED;
+	}
+	return TCP_RpcReply(_socketNum, _requestID, NULL, 0) > 0 ? TCP_RPC_OK : TCP_RPC_FAILED;
+}
+
+void PrintStore(KV_Store_t* _store)
+{
+	KV_Stats_t stats;
+
+	KV_GetStats(_store, &stats);
+	printf("items %zu (table %zu), memory %zu MB in items of %zu MB taken, gets %lu (hits %lu), sets %lu (out of memory %lu), dels %lu\n",
+			stats.m_items, stats.m_tableCapacity, stats.m_chunksBytes >> 20, stats.m_pagesBytes >> 20, stats.m_gets, stats.m_hits,
+			stats.m_sets, stats.m_outOfMemory, stats.m_dels);
+}
+
+int StatsTimer(uint _timerID, void* _contex)
+{
+	printf("requests/sec %lu. ", g_requests);
+	g_requests = 0;
+	PrintStore(_contex);
+	return TRUE;
+}
+
+int main(int argc, char* argv[])
+{
+	uint portNum = 4848;
+	uint maxConnections = MAX_CONNECTIONS_ALLWAED;
+	size_t memoryMB = DEFAULT_MEMORY_MB;
+	uint spinUS = 0;
+	bool isStats = FALSE;
+	KV_Store_t* store;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:M:m:w:t")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p':
+			portNum = atoi(optarg);
+			break;
+		case 'M':
+			memoryMB = atoi(optarg);
+			break;
+		case 'm':
+			maxConnections = atoi(optarg);
+			break;
+		case 'w':
+			spinUS = atoi(optarg);
+			break;
+		case 't':
+			isStats = TRUE;
+			break;
+		default:
+			printf("usage: %s [-p port] [-M megabytes (of items)] [-m max connections] [-w usec (spin before sleeping)] [-t (print stats every second)]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("--START--\n");
+	store = KV_CreateStore(memoryMB << 20);
+	g_rpc = TCP_CreateRpc(KV_METHODS_NUM);
+	if (! store || ! g_rpc)
+	{
+		printf("ERROR. out of memory.\n");
+		return 1;
+	}
+	TCP_RpcRegister(g_rpc, KV_GET, KvGet, store);
+	TCP_RpcRegister(g_rpc, KV_SET, KvSet, store);
+	TCP_RpcRegister(g_rpc, KV_DEL, KvDel, store);
+
+	/* the answers are what the clients wait for. no per request print, only the errors are logged */
+	TCP_LogSetLevel(TCP_LOG_WARN);
+	TCP_LogStart(stdout);
+
+	g_tcp = TCP_CreateServer(portNum, NULL, maxConnections, TIMEOUT_MS, KvFunc, NULL, NULL, NULL, NULL);
+	if (! g_tcp)
+	{
+		printf("ERROR. could not create server on port %u.\n", portNum);
+		return 1;
+	}
+	TCP_ServerSetFraming(g_tcp, TRUE);
+	TCP_ServerSetBusyPoll(g_tcp, spinUS, 0);
+	if (isStats)
+	{
+		TCP_AddTimer(g_tcp, 1000, 1000, StatsTimer, store);
+	}
+	signal(SIGINT, sigAbortHandler);
+
+	TCP_RunServer(g_tcp);
+
+	PrintStore(store);
+	TCP_DestroyServer(g_tcp);
+	g_tcp = NULL;
+	TCP_DestroyRpc(g_rpc);
+	KV_DestroyStore(store);
+	TCP_LogStop();
+	printf("--END--\n");
+	return 0;
+}
@@ -12,14 +12,31 @@
 #include <sys/types.h>
 #include <sys/time.h>  /* FD_SET, FD_ISSET, FD_ZERO macros , timeval */
 #include <sys/select.h>
+#include <sys/uio.h> /* iovec */
+#include <netinet/tcp.h> /* TCP_FASTOPEN */
+#include <sys/un.h>
 #include <arpa/inet.h>    /* close */
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <time.h> /* clock_gettime */
+#include <linux/net_tstamp.h> /* SOF_TIMESTAMPING_* */
+#include <linux/errqueue.h> /* scm_timestamping */
 
 #include "list.h"
 #include "tcp.h"
+#include "tcp_frame.h"
+#include "tcp_address.h"
+#include "tcp_shm.h"
+#include "tcp_compress.h"
+#include "tcp_buffer.h"
+#include "tcp_internal.h"
+#include "tcp_timer.h"
+#include "tcp_log.h"
+#include "tcp_relay.h"
 
 /* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -30,31 +47,78 @@
 #define GENERAL_ERROR -9
 #define BACK_LOG_CAPACITY 128
 
-/* This server can work on two methods. if TRUE a busy-wait read would occur. if FALSE a select waiting on all socket would occur. */
-#define IS_NON_BLOCKING_METHOD FALSE
+#define MAX_LISTENERS 8
+
+/* framed mode reads in bigger chunks, as many small frames are expected per read */
+#define FRAME_READ_SIZE 16384
+
+/* messages written by one system call when a connection queue is flushed */
+#define FLUSH_IOV_MAX 64
+
+/* the socket table, in chunks. covers socket numbers up to 1M, the usual hard limit of open files */
+#define SOCKET_CHUNK_SIZE 1024
+#define SOCKET_CHUNKS_NUM 1024
 
 typedef struct timeval timeval_t;
 
 
 /* ~~~ Global ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* a place in the socket table. m_server and m_generation stay after the connection is closed, so another thread can
+ * tell which loop to ask, and the loop can tell whether the number went to a new connection since */
+typedef struct SocketSlot
+{
+	struct SocketInfo* m_SI; /* NULL when closed */
+	struct TCP_S* m_server;
+	uint m_generation;
+} SocketSlot_t;
+
+/* connections by socket number, so TCP_Send can find what was set up for the connection (ring, codec).
+ * chunks are added under the lock and never move, so the loops of a group (tcp_group.h) read it without one */
+static SocketSlot_t* g_socketSlots[SOCKET_CHUNKS_NUM];
+static pthread_mutex_t g_socketInfosLock = PTHREAD_MUTEX_INITIALIZER;
+static uint g_generation; /* of the last connection registered, by any loop */
+
 /* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+typedef struct Listener
+{
+	int m_socketFD;
+	int m_family;
+	char m_unixPath[TCP_ADDRESS_MAX_LENGTH]; /* Unix sockets only, removed on destroy */
+} Listener_t;
+
 struct TCP_S
 {
 	int m_magicNumber;
 
 	int m_connectionCapacity;
 	int m_connectedNum; /* count the amount of open connections */
-	int m_listenSocket;
+	Listener_t m_listeners[MAX_LISTENERS]; /* all feed the same list of sockets */
+	uint m_listenersNum;
 	list_t* m_sockets; /* list of sockets */
 
-	uint m_serverPort;
-	char m_serverIP[INET6_ADDRSTRLEN];
-
 	uint m_timeoutMS;
+	uint m_fastOpenQueue; /* 0 when TCP Fast Open is off */
 
 	bool m_isServerRun;
+	int m_wakeFD; /* eventfd, wakes the select on stop */
+
+	bool m_isFramed;
+	uint m_currentRequestID; /* of the frame being handled, in framed mode */
+	uint m_currentMethod; /* its RPC method, tcp_rpc.h */
+
+	bool m_isShmEnabled;
+	/* pooled (tcp_buffer.h), handed to the user function. replaced when it kept one */
+	unsigned char* m_readBuf; /* FRAME_READ_SIZE bytes, for any socket */
+	unsigned char* m_shmReadBuf; /* TCP_FRAME_MAX_PAYLOAD bytes, for shared memory clients */
+
+	/* compression, framed mode only. offered by the client, see tcp_compress.h */
+	bool m_isCompressEnabled;
+	const TCP_Dict_t* m_dict;
+	uint m_compressThreshold;
+	unsigned char* m_packBuf; /* TCP_FRAME_MAX_PAYLOAD bytes */
+	unsigned char* m_unpackBuf; /* pooled, as m_readBuf */
 
 	userActionFunc m_reciveDataFunc;
 	clientConnectionChangeFunc m_newConnectionFunc;
@@ -63,16 +127,131 @@ struct TCP_S
 
 	void* m_contex;
 
+	connectionClosedHook m_closedHook;
+	void* m_closedHookContex;
+	uint m_closingNum; /* connections waiting to be closed at the start of the next loop */
+
+	TCP_Timers_t* m_timers; /* created with the first timer */
+
+	/* a loop of a group (tcp_group.h) */
+	bool m_isReusePort; /* listeners share the port with the other loops */
+	int m_cpu; /* the loop is pinned to, -1 if not */
+	unsigned long m_accepted;
+	unsigned long m_acceptedOnCpu; /* whose packets arrive on m_cpu */
+
+	/* low latency mode (TCP_ServerSetBusyPoll) */
+	uint m_spinUS; /* polls without sleeping for this long after any activity. 0 always sleeps */
+	uint m_kernelPollUS; /* SO_BUSY_POLL of the connections. 0 leaves it to the system */
+	uint64_t m_lastActivityUS;
+	TCP_PollStats_t m_pollStats;
+
+	TCP_Capture_t* m_capture; /* NULL when not recording */
+
+	/* kernel receive stamps (TCP_ServerSetRxTimestamps) */
+	bool m_isRxTimestamps;
+	struct timespec m_rxTime; /* of the last read, tv_sec 0 when it had none */
+	uint64_t m_rxDelayNS; /* of the message being handled */
+	TCP_RxDelayStats_t m_rxDelayStats;
+
+	/* proxy mode (TCP_ServerSetProxy) */
+	bool m_isProxy;
+	struct sockaddr_storage m_upstream;
+	socklen_t m_upstreamLength;
+	unsigned long m_proxyBytes;
+
+	/* memory of the connections (TCP_ServerSetMemoryBudget). m_memoryUsed is changed by the loop only, and read by stats anywhere */
+	size_t m_memoryUsed;
+	size_t m_memoryBudget;
+	unsigned long m_memoryShed;
+	unsigned long m_memoryRefused;
+
+	/* inbound flow control (TCP_ServerSetReadPause). 0 high mark when off */
+	uint m_pauseHighBytes;
+	uint m_pauseLowBytes;
+	unsigned long m_queuePauses;
+
+	/* TCP_PauseRead, TCP_ResumeRead and the sends of other threads, applied by the loop on its next round */
+	pthread_t m_loopThread; /* valid while m_isServerRun */
+	pthread_mutex_t m_requestLock;
+	struct PauseRequest* m_pauseRequests;
+	uint m_pauseRequestsNum;
+	uint m_pauseRequestsCapacity;
+	struct SendRequest* m_sendRequests;
+	uint m_sendRequestsNum;
+	uint m_sendRequestsCapacity;
 };
 
+typedef struct PauseRequest
+{
+	uint m_socketNum;
+	uint m_generation; /* of the connection the caller meant */
+	bool m_isPaused;
+} PauseRequest_t;
+
+/* a copy of a message of another thread, sent by the loop as TCP_Send or TCP_SendFrame */
+typedef struct SendRequest
+{
+	uint m_socketNum;
+	uint m_generation;
+	bool m_isFrame;
+	uint m_requestID;
+	uint m_flags;
+	void* m_msg; /* owned */
+	uint m_msgLength;
+} SendRequest_t;
+
+/* a queued message. a hold on a pooled buffer */
+typedef struct OutEntry
+{
+	const unsigned char* m_data;
+	uint m_length;
+} OutEntry_t;
+
 typedef struct SocketInfo
 {
 	int m_magicNumber;
 
 	int m_socketFD;
 	timeval_t m_timeToDie;
+
+	/* framed mode. bytes of a frame that did not fully arrive yet. pooled, only while a frame is partial */
+	unsigned char* m_inBuf;
+	uint m_inLength;
+	uint m_inCapacity;
+
+	bool m_isFirstRead; /* only the first bytes of a connection can be a shared memory handshake */
+	TCP_Shm_t* m_shm; /* NULL unless the client moved to shared memory */
+	TCP_Relay_t* m_relay; /* NULL unless the server is a proxy */
+
+	TCP_S_t* m_server;
+	uint m_codec; /* agreed with the client. TCP_CODEC_NONE until it offers */
+	const TCP_Dict_t* m_dict; /* NULL when the client has another dictionary */
+
+	/* what the kernel did not take yet, sent when the socket is writable. a circular array, allocated on first use */
+	struct OutEntry* m_outQueue;
+	uint m_outCapacity;
+	uint m_outHead;
+	uint m_outNum;
+	uint m_outOffset; /* bytes of the head message already sent */
+
+	bool m_isClosing;
+
+	void* m_userContex; /* TCP_SetConnectionContext */
+
+	uint m_outBytes; /* of the queued messages */
+	size_t m_memory; /* what it holds, its share in m_memoryUsed. see AccountMemory */
+	uint m_generation; /* as in its socket table slot */
+
+	/* not read while either is set, so the kernel buffer fills and the sender is held back by TCP itself */
+	bool m_isReadPaused; /* TCP_PauseRead */
+	bool m_isQueuePaused; /* its queue went over the high mark, see UpdateQueuePause */
 } SocketInfo_t ;
 
+/* what every connection holds, idle or not. its slot in the socket table is counted too */
+#define CONNECTION_FIXED_MEMORY (sizeof(SocketInfo_t) + sizeof(list_node_t) + sizeof(SocketInfo_t*) )
+/* connections closed by one loop for the budget. the rest wait for the next loop, so one loop never scans for long */
+#define MEMORY_SHED_PER_LOOP 16
+
 /* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /**
@@ -80,7 +259,7 @@ typedef struct SocketInfo
  * @param _TCP pointer to the struct
  * @return the status of return. TRUE when stopped normally or FALSE when failed
  */
-static bool TCP_Server_ConnectNewClient(TCP_S_t* _TCP);
+static bool TCP_Server_ConnectNewClient(TCP_S_t* _TCP, int _listenSocket);
 
 /**
  * @brief when a client has disconnected is detected, this function is called and handles the connection on server side.
@@ -89,24 +268,74 @@ static bool TCP_Server_ConnectNewClient(TCP_S_t* _TCP);
  * @return the status of return. TRUE when normally or FALSE when failed
  */
 static bool TCP_ServerDisconnectClient(TCP_S_t* _TCP, uint _socketNum);
-
+static void CountAccepted(TCP_S_t* _TCP, int _socket);
+static void SetKernelBusyPoll(TCP_S_t* _TCP, int _socket);
+static uint64_t NowUS(void);
+static void Deliver(TCP_S_t* _TCP, SocketInfo_t* _SI, void* _data, uint _length);
+static int Recive(TCP_S_t* _TCP, uint _socketNum, void* _buffer, uint _bufferMaxLength);
+static int ReadSocket(TCP_S_t* _TCP, int _socketNum, void* _buffer, uint _length);
+static void SetRxTimestamps(TCP_S_t* _TCP, int _socket);
+static void CountRxDelay(TCP_S_t* _TCP);
+static void DisconnectNode(TCP_S_t* _TCP, list_node_t* _node);
+static void CloseClosing(TCP_S_t* _TCP);
+
+static TCP_S_t* CreateServer(const char* const* _endpoints, uint _endpointsNum, uint _maxConnections, uint _timeoutMS,
+		userActionFunc _reciveDataFunc, clientConnectionChangeFunc _newClientConnected, clientConnectionChangeFunc _clientDissconected,
+		errorFunc _errorFunc, void* _contex, bool _isReusePort);
 static bool SelectServer(TCP_S_t* _TCP);
-static bool NonBlockingServer(TCP_S_t* _TCP);
-static int SetupSelect(int _listenSocket, list_t* _socketList, fd_set* _readfds);
-static int ReadFromSelect(TCP_S_t* _TCP, fd_set* _readfds);
+static int SetupSelect(TCP_S_t* _TCP, fd_set* _readfds, fd_set* _writefds);
+static void FlushWritable(TCP_S_t* _TCP, fd_set* _writefds);
+static void AcceptAll(TCP_S_t* _TCP, fd_set* _readfds);
+static int ReadFromSelect(TCP_S_t* _TCP, fd_set* _readfds, fd_set* _writefds);
+static int ReadFrames(TCP_S_t* _TCP, SocketInfo_t* _SI);
+static int DispatchFrames(TCP_S_t* _TCP, SocketInfo_t* _SI, unsigned char* _data, uint _length);
+static bool DispatchFrame(TCP_S_t* _TCP, SocketInfo_t* _SI, TCP_FrameHeader_t* _header, unsigned char* _payload);
+static bool AgreeCompression(TCP_S_t* _TCP, SocketInfo_t* _SI, uint _requestID, unsigned char* _payload, uint _length);
+static int SendFrameFlags(int _socketNum, uint _requestID, uint _flags, const void* _msg, uint _msgLength);
+static int SendFrame(uint _socketNum, uint _requestID, uint _flags, const void* _msg, uint _msgLength);
+static bool KeepPartialFrame(SocketInfo_t* _SI, unsigned char* _data, uint _length);
+static bool IsShmHello(int _socketNum);
+static int ShmHandshake(TCP_S_t* _TCP, SocketInfo_t* _SI);
+static int ReadShm(TCP_S_t* _TCP, SocketInfo_t* _SI);
+static bool RegisterSocketInfo(SocketInfo_t* _SI);
+static SocketSlot_t* FindSocketSlot(uint _socketNum);
+static SocketInfo_t* FindSocketInfo(uint _socketNum);
+
+static TCP_SharedBuf_t* CreateShared(const void* _header, uint _headerLength, const void* _msg, uint _msgLength);
+static int SendPooled(SocketInfo_t* _SI, const unsigned char** _pieces, const uint* _lengths, uint _piecesNum);
+static int SendCopy(SocketInfo_t* _SI, const void* _header, uint _headerLength, const void* _msg, uint _msgLength);
+static bool EnqueueOut(SocketInfo_t* _SI, const unsigned char* _data, uint _length, uint _sentBytes);
+static unsigned char* FreshBuffer(unsigned char** _buf, uint _size);
+static int FlushOut(SocketInfo_t* _SI);
+static void ReleaseOut(SocketInfo_t* _SI);
 
 static bool IsStructValid(TCP_S_t* _TCP);
 static bool IsConnected(TCP_S_t* _TCP);
 
-static bool ServerSetup(TCP_S_t* _TCP);
+static bool ServerSetup(TCP_S_t* _TCP, const char* _endpoint);
+static void CloseListeners(TCP_S_t* _TCP);
+static bool SetFastOpen(int _listenSocket, uint _queueLength);
 static bool SetSocketBlockingEnabled(int fd, bool blocking);
 static bool IsFail_nonBlocking(int _result);
 
 static bool MoveNodeToHead(list_t* _socketsContiner, list_node_t* node, uint _timeoutMS);
 static bool KillOldestClient(TCP_S_t* _TCP);
+static void ShedMemory(TCP_S_t* _TCP);
+static size_t NodeMemory(list_node_t* _node);
+static void SiftUp(list_node_t** _heap, uint _index);
+static void SiftDown(list_node_t** _heap, uint _num, uint _index);
+static void AccountMemory(SocketInfo_t* _SI);
+static void UpdateQueuePause(TCP_S_t* _TCP, SocketInfo_t* _SI);
+static bool IsReadPaused(SocketInfo_t* _SI);
+static bool SetReadPaused(uint _socketNum, bool _isPaused);
+static void ApplyPauseRequests(TCP_S_t* _TCP);
+static SocketSlot_t* OffLoopSlot(uint _socketNum);
+static int PostSend(SocketSlot_t* _slot, uint _socketNum, bool _isFrame, uint _requestID, uint _flags, const void* _msg, uint _msgLength);
+static void ApplySendRequests(TCP_S_t* _TCP);
+static void WakeLoop(TCP_S_t* _TCP);
 static timeval_t DealWithTimeout(TCP_S_t* _TCP);
 
-static SocketInfo_t* CreateSocketInfo(int _socket, uint _timeoutMS);
+static SocketInfo_t* CreateSocketInfo(TCP_S_t* _TCP, int _socket, uint _timeoutMS);
 static void DestorySocketInfo(SocketInfo_t* _SI);
 static int getSocket(list_node_t* _node);
 /* static int setSocket(list_node_t* _node, int _socketNum); */ /* un used */
@@ -125,10 +354,66 @@ TCP_S_t* TCP_CreateServer(uint _port, const char* _serverIP, uint _maxConnection
 		errorFunc _errorFunc,
 		void* _contex
 		)
+{
+	char endpoint[TCP_ADDRESS_MAX_LENGTH + 8];
+	const char* endpoints[1];
+
+	if (NULL == _serverIP || strlen(_serverIP) == 0)
+	{
+		_serverIP = "*";
+	}
+	if (strchr(_serverIP, ':') && _serverIP[0] != '[')
+	{
+		/* bare IPv6 address, the port needs the brackets to be told apart */
+		snprintf(endpoint, sizeof(endpoint), "[%s]:%u", _serverIP, _port);
+	}
+	else
+	{
+		snprintf(endpoint, sizeof(endpoint), "%s:%u", _serverIP, _port);
+	}
+	endpoints[0] = endpoint;
+
+	return TCP_CreateServerEndpoints(endpoints, 1, _maxConnections, _timeoutMS,
+									_reciveDataFunc, _newClientConnected, _clientDissconected, _errorFunc, _contex);
+}
+
+TCP_S_t* TCP_CreateServerEndpoints(const char* const* _endpoints, uint _endpointsNum, uint _maxConnections, uint _timeoutMS,
+		userActionFunc _reciveDataFunc,
+		clientConnectionChangeFunc _newClientConnected,
+		clientConnectionChangeFunc _clientDissconected,
+		errorFunc _errorFunc,
+		void* _contex
+		)
+{
+	return CreateServer(_endpoints, _endpointsNum, _maxConnections, _timeoutMS,
+						_reciveDataFunc, _newClientConnected, _clientDissconected, _errorFunc, _contex, FALSE);
+}
+
+TCP_S_t* TCP_CreateServerReusePort(const char* _endpoint, uint _maxConnections, uint _timeoutMS,
+		userActionFunc _reciveDataFunc,
+		clientConnectionChangeFunc _newClientConnected,
+		clientConnectionChangeFunc _clientDissconected,
+		errorFunc _errorFunc,
+		void* _contex
+		)
+{
+	return CreateServer(&_endpoint, 1, _maxConnections, _timeoutMS,
+						_reciveDataFunc, _newClientConnected, _clientDissconected, _errorFunc, _contex, TRUE);
+}
+
+static TCP_S_t* CreateServer(const char* const* _endpoints, uint _endpointsNum, uint _maxConnections, uint _timeoutMS,
+		userActionFunc _reciveDataFunc,
+		clientConnectionChangeFunc _newClientConnected,
+		clientConnectionChangeFunc _clientDissconected,
+		errorFunc _errorFunc,
+		void* _contex,
+		bool _isReusePort
+		)
 {
 	TCP_S_t* aTCP = 0;
+	uint i;
 
-	if (_reciveDataFunc == NULL)
+	if (_reciveDataFunc == NULL || NULL == _endpoints || 0 == _endpointsNum || _endpointsNum > MAX_LISTENERS)
 	{
 		return NULL;
 	}
@@ -140,38 +425,90 @@ TCP_S_t* TCP_CreateServer(uint _port, const char* _serverIP, uint _maxConnection
 		return NULL;
 	}
 
-	if (_serverIP != NULL)
-	{
-		strncpy(aTCP->m_serverIP , _serverIP , INET6_ADDRSTRLEN);
-	}
-	else
-	{
-		aTCP->m_serverIP[0] = '\0';
-	}
-
-	aTCP->m_serverPort = _port;
+	aTCP->m_listenersNum = 0;
 	aTCP->m_connectedNum = 0;
 	aTCP->m_connectionCapacity = _maxConnections;
 	aTCP->m_timeoutMS = _timeoutMS;
+	aTCP->m_fastOpenQueue = 0;
+	aTCP->m_isServerRun = FALSE;
+	aTCP->m_isFramed = FALSE;
+	aTCP->m_currentRequestID = 0;
+	aTCP->m_currentMethod = 0;
+	aTCP->m_isShmEnabled = FALSE;
+	aTCP->m_readBuf = NULL;
+	aTCP->m_shmReadBuf = NULL;
+	aTCP->m_isCompressEnabled = FALSE;
+	aTCP->m_dict = NULL;
+	aTCP->m_compressThreshold = TCP_COMPRESS_DEFAULT_THRESHOLD;
+	aTCP->m_packBuf = NULL;
+	aTCP->m_unpackBuf = NULL;
 
 	aTCP->m_reciveDataFunc = _reciveDataFunc;
 	aTCP->m_newConnectionFunc = _newClientConnected;
 	aTCP->m_closedConnectionFunc = _clientDissconected;
 	aTCP->m_errorFunc = _errorFunc;
 	aTCP->m_contex = _contex;
-
-	if (! ServerSetup(aTCP) )
+	aTCP->m_closedHook = NULL;
+	aTCP->m_closedHookContex = NULL;
+	aTCP->m_closingNum = 0;
+	aTCP->m_timers = NULL;
+	aTCP->m_isReusePort = _isReusePort;
+	aTCP->m_cpu = -1;
+	aTCP->m_accepted = 0;
+	aTCP->m_acceptedOnCpu = 0;
+	aTCP->m_spinUS = 0;
+	aTCP->m_kernelPollUS = 0;
+	aTCP->m_lastActivityUS = 0;
+	memset(&aTCP->m_pollStats, 0, sizeof(aTCP->m_pollStats) );
+	aTCP->m_capture = NULL;
+	aTCP->m_isRxTimestamps = FALSE;
+	aTCP->m_rxTime.tv_sec = 0;
+	aTCP->m_rxDelayNS = 0;
+	memset(&aTCP->m_rxDelayStats, 0, sizeof(aTCP->m_rxDelayStats) );
+	aTCP->m_isProxy = FALSE;
+	aTCP->m_upstreamLength = 0;
+	aTCP->m_proxyBytes = 0;
+	aTCP->m_memoryUsed = 0;
+	aTCP->m_memoryBudget = 0;
+	aTCP->m_memoryShed = 0;
+	aTCP->m_memoryRefused = 0;
+	aTCP->m_pauseHighBytes = 0;
+	aTCP->m_pauseLowBytes = 0;
+	aTCP->m_queuePauses = 0;
+	aTCP->m_pauseRequests = NULL;
+	aTCP->m_pauseRequestsNum = 0;
+	aTCP->m_pauseRequestsCapacity = 0;
+	aTCP->m_sendRequests = NULL;
+	aTCP->m_sendRequestsNum = 0;
+	aTCP->m_sendRequestsCapacity = 0;
+	pthread_mutex_init(&aTCP->m_requestLock, NULL);
+
+	aTCP->m_wakeFD = eventfd(0, EFD_NONBLOCK);
+	if (aTCP->m_wakeFD < 0)
 	{
-		perror("ServerSetup Failed");
+		perror("CreateServer, eventfd Failed");
 		free(aTCP);
 		return NULL;
 	}
 
+	for (i = 0; i < _endpointsNum; ++i)
+	{
+		if (! ServerSetup(aTCP, _endpoints[i]) )
+		{
+			fprintf(stderr, "ServerSetup Failed for %s\n", _endpoints[i]);
+			CloseListeners(aTCP);
+			close(aTCP->m_wakeFD);
+			free(aTCP);
+			return NULL;
+		}
+	}
+
 	aTCP->m_sockets = list_new();
 	if (! aTCP->m_sockets)
 	{
 		perror("List_Create Failed");
-		close(aTCP->m_listenSocket);
+		CloseListeners(aTCP);
+		close(aTCP->m_wakeFD);
 		free(aTCP);
 		return NULL;
 	}
@@ -183,6 +520,8 @@ TCP_S_t* TCP_CreateServer(uint _port, const char* _serverIP, uint _maxConnection
 
 void TCP_DestroyServer(TCP_S_t* _TCP)
 {
+	uint i;
+
 	if ( !IsStructValid(_TCP) )
 	{
 		return;
@@ -190,8 +529,8 @@ void TCP_DestroyServer(TCP_S_t* _TCP)
 
 	_TCP->m_magicNumber = DEAD_MAGIC_NUMBER;
 
-	/* close the socket */
-	close (_TCP->m_listenSocket);
+	/* close the listening sockets */
+	CloseListeners(_TCP);
 
 	if ( _TCP->m_sockets )
 	{
@@ -199,12 +538,27 @@ void TCP_DestroyServer(TCP_S_t* _TCP)
 		list_iterator_t *it = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
 		while ((node = list_iterator_next(it)))
 		{
-			/* close (*(int*)(node->val)); */
-			close ( getSocket(node) );
+			/* closes the socket, and lets a shared memory client know */
+			DestorySocketInfo(node->val);
 		}
+		list_iterator_destroy(it);
 		list_destroy(_TCP->m_sockets);
 	}
 
+	TCP_TimersDestroy(_TCP->m_timers);
+	close(_TCP->m_wakeFD);
+	TCP_BufferRelease(_TCP->m_readBuf);
+	TCP_BufferRelease(_TCP->m_shmReadBuf);
+	TCP_BufferRelease(_TCP->m_unpackBuf);
+	free(_TCP->m_packBuf);
+	pthread_mutex_destroy(&_TCP->m_requestLock);
+	free(_TCP->m_pauseRequests);
+	for (i = 0; i < _TCP->m_sendRequestsNum; ++i)
+	{
+		/* never sent, the loop did not run again */
+		free(_TCP->m_sendRequests[i].m_msg);
+	}
+	free(_TCP->m_sendRequests);
 	free(_TCP);
 	return;
 }
@@ -218,535 +572,2527 @@ bool TCP_RunServer(TCP_S_t* _TCP)
 
 	printf("Server is Ready. Waiting for clients...\n");
 
-	if (IS_NON_BLOCKING_METHOD == TRUE)
-	{
-		return NonBlockingServer(_TCP);
-	}
-	else
+	return SelectServer(_TCP);
+}
+
+bool TCP_StopServer(TCP_S_t* _TCP)
+{
+	if (! IsStructValid(_TCP) || _TCP->m_isServerRun == FALSE)
 	{
-		return SelectServer(_TCP);
+		return FALSE;
 	}
+	_TCP->m_isServerRun = FALSE;
+
+	/* the loop may be asleep in select. safe in a signal handler */
+	WakeLoop(_TCP);
+	return TRUE;
 }
 
-static bool NonBlockingServer(TCP_S_t* _TCP)
+bool TCP_ServerSetBusyPoll(TCP_S_t* _TCP, uint _spinUS, uint _kernelPollUS)
 {
-	char buffer[BUFFER_MAX_SIZE];
-	int resultSize = 0;
+	if (! IsStructValid(_TCP) )
+	{
+		return FALSE;
+	}
 
-	_TCP->m_isServerRun = TRUE;
+	/* connections accepted from now on */
+	_TCP->m_spinUS = _spinUS;
+	_TCP->m_kernelPollUS = _kernelPollUS;
+	return TRUE;
+}
 
-	while( _TCP->m_isServerRun )
+bool TCP_ServerPollStats(TCP_S_t* _TCP, TCP_PollStats_t* _stats)
+{
+	if (! IsStructValid(_TCP) || NULL == _stats)
 	{
-		while ( TCP_Server_ConnectNewClient(_TCP) == TRUE)
-		{
-			/* keep on accepting all waiting client while there are some */
-		}
-
-		list_node_t *node;
-		list_iterator_t *itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
-		while ((node = list_iterator_next(itr)))
-		{
-			resultSize = TCP_Recive( getSocket(node) , buffer, BUFFER_MAX_SIZE);
-			if (resultSize == 0)
-			{
-				/* socket was closed */
-				break;
-			}
-			else if (resultSize > 0)
-			{
-				_TCP->m_reciveDataFunc(buffer, resultSize, getSocket(node) , _TCP->m_contex);
-			}
-		}
+		return FALSE;
 	}
 
+	*_stats = _TCP->m_pollStats;
 	return TRUE;
 }
 
-bool TCP_StopServer(TCP_S_t* _TCP)
+bool TCP_ServerSetRxTimestamps(TCP_S_t* _TCP, bool _isEnabled)
 {
-	if (! IsStructValid(_TCP) || _TCP->m_isServerRun == FALSE)
+	if (! IsStructValid(_TCP) )
 	{
 		return FALSE;
 	}
-	_TCP->m_isServerRun = FALSE;
+
+	/* connections accepted from now on */
+	_TCP->m_isRxTimestamps = _isEnabled;
 	return TRUE;
 }
 
-int TCP_Send(uint _socketNum, void* _msg, uint _msgLength)
+bool TCP_ServerSetProxy(TCP_S_t* _TCP, const char* _upstream)
 {
-	if ( NULL == _msg)
+	struct sockaddr_storage upstream;
+	socklen_t upstreamLength;
+
+	if (! IsStructValid(_TCP) )
 	{
-		return GENERAL_ERROR;
+		return FALSE;
 	}
 
-	int sent_bytes;
-	sent_bytes = send( _socketNum, _msg, _msgLength, 0 );
-
-	if (0 > sent_bytes)
+	/* connections accepted from now on */
+	if (NULL == _upstream)
+	{
+		_TCP->m_isProxy = FALSE;
+		return TRUE;
+	}
+	if (! TCP_ParseEndpoint(_upstream, &upstream, &upstreamLength) )
 	{
-		perror("Send Failed");
+		return FALSE;
 	}
+	_TCP->m_upstream = upstream;
+	_TCP->m_upstreamLength = upstreamLength;
+	_TCP->m_isProxy = TRUE;
+	return TRUE;
+}
 
-	return sent_bytes;
+unsigned long TCP_ServerProxyBytes(TCP_S_t* _TCP)
+{
+	return IsStructValid(_TCP) ? _TCP->m_proxyBytes : 0;
 }
 
+bool TCP_ServerSetMemoryBudget(TCP_S_t* _TCP, size_t _bytes)
+{
+	if (! IsStructValid(_TCP) )
+	{
+		return FALSE;
+	}
 
+	/* the loop gets under it on its next round */
+	_TCP->m_memoryBudget = _bytes;
+	return TRUE;
+}
 
-int TCP_Recive(uint _socketNum, void* _buffer, uint _bufferMaxLength)
+bool TCP_ServerMemoryStats(TCP_S_t* _TCP, TCP_MemoryStats_t* _stats)
 {
-	int nBytesRead;
+	list_iterator_t* itr;
+	list_node_t* node;
 
-	if ( NULL == _buffer)
+	if (! IsStructValid(_TCP) || NULL == _stats)
 	{
-		return GENERAL_ERROR;
+		return FALSE;
 	}
 
-    nBytesRead = recv( _socketNum, _buffer, _bufferMaxLength , 0 );
-
-    if (nBytesRead == 0)
-    {
-		/* socket was closed on client side. do nothing, transfer 0 up a function where it would be disconnected */
-    }
-    else if ( IsFail_nonBlocking(nBytesRead) )
-    {
-    	perror("Read Failed.");
-    }
-    else
-    { /* good read value */
-    	sanity_check(_buffer, _bufferMaxLength, '_');
-    }
+	_stats->m_used = __atomic_load_n(&_TCP->m_memoryUsed, __ATOMIC_RELAXED);
+	_stats->m_budget = _TCP->m_memoryBudget;
+	_stats->m_perConnection = _TCP->m_connectedNum ? _stats->m_used / _TCP->m_connectedNum : 0;
+	_stats->m_idleConnection = CONNECTION_FIXED_MEMORY;
+	_stats->m_shed = _TCP->m_memoryShed;
+	_stats->m_refused = _TCP->m_memoryRefused;
 
-    return nBytesRead;
+	_stats->m_largest = 0;
+	itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
+	while ((node = list_iterator_next(itr)))
+	{
+		if (((SocketInfo_t*) node->val)->m_memory > _stats->m_largest)
+		{
+			_stats->m_largest = ((SocketInfo_t*) node->val)->m_memory;
+		}
+	}
+	list_iterator_destroy(itr);
+	return TRUE;
 }
 
+bool TCP_ServerSetReadPause(TCP_S_t* _TCP, uint _highBytes, uint _lowBytes)
+{
+	if (! IsStructValid(_TCP) || _lowBytes > _highBytes)
+	{
+		return FALSE;
+	}
 
+	/* the connections are checked against it on the next round of the loop */
+	_TCP->m_pauseHighBytes = _highBytes;
+	_TCP->m_pauseLowBytes = _lowBytes;
+	return TRUE;
+}
 
+bool TCP_ServerFlowStats(TCP_S_t* _TCP, TCP_FlowStats_t* _stats)
+{
+	list_iterator_t* itr;
+	list_node_t* node;
 
-/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+	if (! IsStructValid(_TCP) || NULL == _stats)
+	{
+		return FALSE;
+	}
 
-bool IsStructValid(TCP_S_t* _TCP)
-{
-	return !(NULL == _TCP || ALIVE_MAGIC_NUMBER != _TCP->m_magicNumber);
+	_stats->m_paused = 0;
+	_stats->m_queuePaused = 0;
+	itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
+	while ((node = list_iterator_next(itr)))
+	{
+		_stats->m_paused += IsReadPaused(node->val);
+		_stats->m_queuePaused += ((SocketInfo_t*) node->val)->m_isQueuePaused;
+	}
+	list_iterator_destroy(itr);
+	_stats->m_queuePauses = _TCP->m_queuePauses;
+	return TRUE;
 }
 
-bool IsConnected(TCP_S_t* _TCP)
+bool TCP_PauseRead(uint _socketNum)
 {
-	return (bool) _TCP->m_connectedNum;
+	return SetReadPaused(_socketNum, TRUE);
 }
 
-
-static bool ServerSetup(TCP_S_t* _TCP)
+bool TCP_ResumeRead(uint _socketNum)
 {
-	/* setSocket. */
-	_TCP->m_listenSocket = socket(PF_INET, SOCK_STREAM, 0);
-	if (SetSocketBlockingEnabled(_TCP->m_listenSocket, FALSE) < 0)
-	{
-		perror("Socket Failed");
-		return FALSE;
-	}
+	return SetReadPaused(_socketNum, FALSE);
+}
 
-	/* Reusing port */
-	int optval = 1;
-	if ( setsockopt(_TCP->m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval) ) < 0)
+uint64_t TCP_GetRxDelayNS(TCP_S_t* _TCP)
+{
+	if (! IsStructValid(_TCP) )
 	{
-		perror("Socket setsockopt Failed");
-		close(_TCP->m_listenSocket);
-		return FALSE;
+		return 0;
 	}
 
-	/* bind */
-	struct sockaddr_in sIn;
-	memset(&sIn , 0 , sizeof(sIn) );
-	sIn.sin_family = AF_INET;
-	if ( strlen(_TCP->m_serverIP) == 0 || _TCP->m_serverIP[0] == '\0')
-	 {
-		sIn.sin_addr.s_addr = INADDR_ANY;
-	} else {
-		sIn.sin_addr.s_addr = inet_addr(_TCP->m_serverIP);
-	}
-	sIn.sin_port = htons(_TCP->m_serverPort);
+	return _TCP->m_rxDelayNS;
+}
 
-	/*Bind socket with address struct*/
-	if (0 < bind(_TCP->m_listenSocket, (struct sockaddr *) &sIn, sizeof(sIn)) )
+bool TCP_ServerRxDelayStats(TCP_S_t* _TCP, TCP_RxDelayStats_t* _stats)
+{
+	if (! IsStructValid(_TCP) || NULL == _stats)
 	{
-		perror("Bind ServerConnect Failed.");
-		close(_TCP->m_listenSocket);
 		return FALSE;
 	}
 
-	/* set socket to listen to new client */
-	if ( listen(_TCP->m_listenSocket , BACK_LOG_CAPACITY) < 0 )
+	*_stats = _TCP->m_rxDelayStats;
+	return TRUE;
+}
+
+bool TCP_ServerSetCapture(TCP_S_t* _TCP, TCP_Capture_t* _capture)
+{
+	if (! IsStructValid(_TCP) )
 	{
-		perror("Listen ServerConnect Failed.");
-		close(_TCP->m_listenSocket);
 		return FALSE;
 	}
 
+	_TCP->m_capture = _capture;
 	return TRUE;
 }
 
-static bool TCP_Server_ConnectNewClient(TCP_S_t* _TCP)
+bool TCP_ServerSetFastOpen(TCP_S_t* _TCP, uint _queueLength)
 {
+	uint i;
+
 	if (! IsStructValid(_TCP) )
 	{
 		return FALSE;
 	}
 
-	struct sockaddr_in sIn;
-	memset(&sIn , 0 , sizeof(sIn) );
-	uint addr_len;
-	addr_len = sizeof(sIn);
-	int socket;
-	SocketInfo_t* aSI;
+	for (i = 0; i < _TCP->m_listenersNum; ++i)
+	{
+		/* there is no fast open for Unix sockets, they have no handshake to save */
+		if (_TCP->m_listeners[i].m_family != AF_UNIX && ! SetFastOpen(_TCP->m_listeners[i].m_socketFD, _queueLength) )
+		{
+			return FALSE;
+		}
+	}
+	_TCP->m_fastOpenQueue = _queueLength;
+	return TRUE;
+}
 
-	socket = accept(_TCP->m_listenSocket,  (struct sockaddr *) &sIn, &addr_len ) ;
+int TCP_Send(uint _socketNum, void* _msg, uint _msgLength)
+{
+	SocketSlot_t* slot;
+	SocketInfo_t* SI;
 
-	/* got real new socket but over capacity, so close connection */
-	if (0 < socket && _TCP->m_connectionCapacity <= _TCP->m_connectedNum)
+	if ( NULL == _msg)
 	{
-		#if !defined(NDEBUG) /* DEBUG */
-    	printf("server has too many (%d) connection. dropping new socket #%d.\n", _TCP->m_connectedNum, socket);
-		#endif
+		return GENERAL_ERROR;
+	}
 
-    	if(_TCP->m_errorFunc)
-    	{
-    		_TCP->m_errorFunc(TOO_MANY_CONNECTION, socket, NULL);
-    	}
+	slot = OffLoopSlot(_socketNum);
+	if (slot)
+	{
+		/* the connection is its loop's. a copy is handed to it */
+		return PostSend(slot, _socketNum, FALSE, 0, 0, _msg, _msgLength);
+	}
 
-		close(socket);
-		return FALSE;
+	SI = FindSocketInfo(_socketNum);
+	if (SI && SI->m_isClosing)
+	{
+		return GENERAL_ERROR;
 	}
 
-	if (socket > 0)
-	{ /* Success accept link */
+	if (SI && SI->m_shm)
+	{
+		/* never wait for room, a slow client must not stall the server */
+		return TCP_ShmWrite(SI->m_shm, _msg, _msgLength, 0, 0);
+	}
 
-		if (IS_NON_BLOCKING_METHOD == TRUE)
-		{
-			SetSocketBlockingEnabled(socket, FALSE);
-		}
+	if (SI)
+	{
+		/* never waits. a slow reader gets a queue, which pauses its reads (TCP_ServerSetReadPause), not the loop */
+		return SendCopy(SI, NULL, 0, _msg, _msgLength);
+	}
 
+	int sent_bytes;
+	sent_bytes = send( _socketNum, _msg, _msgLength, 0 );
 
-		/* add new socket to list of sockets */
-		aSI = CreateSocketInfo(socket, _TCP->m_timeoutMS);
-		if (!aSI)
+	if (0 > sent_bytes)
+	{
+		TCP_LOG_ERRNO(TCP_LOG_ERROR, "Send Failed, socket #%ld", _socketNum, 0);
+	}
+
+	return sent_bytes;
+}
+
+
+
+bool TCP_SetConnectionContext(uint _socketNum, void* _connContex)
+{
+	SocketInfo_t* SI = FindSocketInfo(_socketNum);
+	if (! SI)
+	{
+		return FALSE;
+	}
+
+	SI->m_userContex = _connContex;
+	return TRUE;
+}
+
+void* TCP_GetConnectionContext(uint _socketNum)
+{
+	SocketInfo_t* SI = FindSocketInfo(_socketNum);
+
+	return SI ? SI->m_userContex : NULL;
+}
+
+int TCP_Recive(uint _socketNum, void* _buffer, uint _bufferMaxLength)
+{
+	return Recive(NULL, _socketNum, _buffer, _bufferMaxLength);
+}
+
+/* TCP_Recive, with the kernel stamp when the server reads it */
+static int Recive(TCP_S_t* _TCP, uint _socketNum, void* _buffer, uint _bufferMaxLength)
+{
+	int nBytesRead;
+
+	if ( NULL == _buffer)
+	{
+		return GENERAL_ERROR;
+	}
+
+    nBytesRead = ReadSocket(_TCP, _socketNum, _buffer, _bufferMaxLength);
+
+    if (nBytesRead == 0)
+    {
+		/* socket was closed on client side. do nothing, transfer 0 up a function where it would be disconnected */
+    }
+    else if ( IsFail_nonBlocking(nBytesRead) )
+    {
+    	TCP_LOG_ERRNO(TCP_LOG_ERROR, "Read Failed, socket #%ld", _socketNum, 0);
+    }
+    else
+    { /* good read value */
+    	sanity_check(_buffer, _bufferMaxLength, '_');
+    }
+
+    return nBytesRead;
+}
+
+bool TCP_ServerSetFraming(TCP_S_t* _TCP, bool _isFramed)
+{
+	if (! IsStructValid(_TCP) || _TCP->m_isServerRun)
+	{
+		return FALSE;
+	}
+
+	_TCP->m_isFramed = _isFramed;
+	return TRUE;
+}
+
+uint TCP_GetRequestID(TCP_S_t* _TCP)
+{
+	if (! IsStructValid(_TCP) )
+	{
+		return 0;
+	}
+
+	return _TCP->m_currentRequestID;
+}
+
+uint TCP_GetMethod(TCP_S_t* _TCP)
+{
+	if (! IsStructValid(_TCP) )
+	{
+		return 0;
+	}
+
+	return _TCP->m_currentMethod;
+}
+
+int TCP_SendFrame(uint _socketNum, uint _requestID, void* _msg, uint _msgLength)
+{
+	return SendFrame(_socketNum, _requestID, 0, _msg, _msgLength);
+}
+
+int TCP_SendBuffer(uint _socketNum, void* _data, uint _dataLength)
+{
+	SocketInfo_t* SI;
+	const unsigned char* data = _data;
+
+	if ( NULL == _data)
+	{
+		return GENERAL_ERROR;
+	}
+
+	if (OffLoopSlot(_socketNum) )
+	{
+		/* the buffer is of this thread's pool, and the queue is the loop's. a copy goes to the loop */
+		return TCP_Send(_socketNum, _data, _dataLength);
+	}
+
+	SI = FindSocketInfo(_socketNum);
+	if (! SI || SI->m_shm || SI->m_isClosing || 0 == TCP_BufferCapacity(_data) )
+	{
+		/* nothing to save. a ring write is a copy anyway */
+		return TCP_Send(_socketNum, _data, _dataLength);
+	}
+
+	return SendPooled(SI, &data, &_dataLength, 1);
+}
+
+int TCP_SendFrameBuffer(uint _socketNum, uint _requestID, void* _data, uint _dataLength)
+{
+	TCP_FrameHeader_t frameHeader;
+	SocketInfo_t* SI;
+	const unsigned char* pieces[2];
+	uint lengths[2];
+	unsigned char* header;
+	int result;
+
+	if (NULL == _data || _dataLength > TCP_FRAME_MAX_PAYLOAD)
+	{
+		return GENERAL_ERROR;
+	}
+
+	if (OffLoopSlot(_socketNum) )
+	{
+		return TCP_SendFrame(_socketNum, _requestID, _data, _dataLength);
+	}
+
+	SI = FindSocketInfo(_socketNum);
+	if (! SI || SI->m_shm || SI->m_isClosing || 0 == TCP_BufferCapacity(_data)
+		|| (SI->m_codec == TCP_CODEC_LZ && _dataLength >= SI->m_server->m_compressThreshold) )
+	{
+		/* compression makes a new copy anyway */
+		return TCP_SendFrame(_socketNum, _requestID, _data, _dataLength);
+	}
+
+	/* the header goes in a buffer of its own, the payload is queued as it is */
+	header = TCP_BufferAlloc(TCP_FRAME_HEADER_SIZE);
+	if (! header)
+	{
+		return GENERAL_ERROR;
+	}
+	frameHeader.m_length = _dataLength;
+	frameHeader.m_requestID = _requestID;
+	frameHeader.m_flags = 0;
+	frameHeader.m_method = 0;
+	TCP_FrameEncode(&frameHeader, header);
+
+	pieces[0] = header;
+	lengths[0] = TCP_FRAME_HEADER_SIZE;
+	pieces[1] = _data;
+	lengths[1] = _dataLength;
+	result = SendPooled(SI, pieces, lengths, 2);
+
+	TCP_BufferRelease(header);
+	return result;
+}
+
+bool TCP_ServerSetSharedMemory(TCP_S_t* _TCP, bool _isEnabled)
+{
+	if (! IsStructValid(_TCP) || _TCP->m_isServerRun)
+	{
+		return FALSE;
+	}
+
+	if (_isEnabled && ! _TCP->m_shmReadBuf)
+	{
+		_TCP->m_shmReadBuf = TCP_BufferAlloc(TCP_FRAME_MAX_PAYLOAD);
+		if (! _TCP->m_shmReadBuf)
+		{
+			return FALSE;
+		}
+	}
+
+	_TCP->m_isShmEnabled = _isEnabled;
+	return TRUE;
+}
+
+
+
+bool TCP_ServerSetCompression(TCP_S_t* _TCP, bool _isEnabled, const TCP_Dict_t* _dict, uint _threshold)
+{
+	if (! IsStructValid(_TCP) || _TCP->m_isServerRun)
+	{
+		return FALSE;
+	}
+
+	if (_isEnabled && ! _TCP->m_packBuf)
+	{
+		/* the unpack buffer is taken from the pool when a compressed frame arrives */
+		_TCP->m_packBuf = malloc(TCP_FRAME_MAX_PAYLOAD);
+		if (! _TCP->m_packBuf)
+		{
+			return FALSE;
+		}
+	}
+
+	_TCP->m_isCompressEnabled = _isEnabled;
+	_TCP->m_dict = _dict;
+	_TCP->m_compressThreshold = _threshold;
+	return TRUE;
+}
+
+uint TCP_AddTimer(TCP_S_t* _TCP, uint _delayMS, uint _periodMS, timerFunc _func, void* _contex)
+{
+	if (! IsStructValid(_TCP) )
+	{
+		return 0;
+	}
+
+	if (! _TCP->m_timers)
+	{
+		_TCP->m_timers = TCP_TimersCreate();
+		if (! _TCP->m_timers)
+		{
+			return 0;
+		}
+	}
+
+	return TCP_TimersAdd(_TCP->m_timers, _delayMS, _periodMS, _func, _contex);
+}
+
+bool TCP_CancelTimer(TCP_S_t* _TCP, uint _timerID)
+{
+	if (! IsStructValid(_TCP) )
+	{
+		return FALSE;
+	}
+
+	return TCP_TimersCancel(_TCP->m_timers, _timerID);
+}
+
+/* ~~~ Internal API function (tcp_internal.h) ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_SharedBuf_t* TCP_ServerCreateShared(TCP_S_t* _TCP, const void* _msg, uint _msgLength)
+{
+	unsigned char header[TCP_FRAME_HEADER_SIZE];
+	TCP_FrameHeader_t frameHeader;
+
+	if (! IsStructValid(_TCP) || (NULL == _msg && _msgLength > 0) || _msgLength > TCP_FRAME_MAX_PAYLOAD)
+	{
+		return NULL;
+	}
+
+	if (! _TCP->m_isFramed)
+	{
+		return CreateShared(NULL, 0, _msg, _msgLength);
+	}
+
+	/* not an answer to any request */
+	frameHeader.m_length = _msgLength;
+	frameHeader.m_requestID = 0;
+	frameHeader.m_flags = 0;
+	frameHeader.m_method = 0;
+	TCP_FrameEncode(&frameHeader, header);
+
+	return CreateShared(header, TCP_FRAME_HEADER_SIZE, _msg, _msgLength);
+}
+
+int TCP_ServerSendFrameFlags(uint _socketNum, uint _requestID, uint _flags, const void* _msg, uint _msgLength)
+{
+	return SendFrame(_socketNum, _requestID, _flags & ~(TCP_FRAME_FLAG_COMPRESSED | TCP_FRAME_FLAG_HELLO), _msg, _msgLength);
+}
+
+void TCP_SharedRelease(TCP_SharedBuf_t* _buf)
+{
+	TCP_BufferRelease(_buf);
+}
+
+int TCP_ServerSendShared(TCP_S_t* _TCP, uint _socketNum, TCP_SharedBuf_t* _buf, uint _maxQueued)
+{
+	SocketInfo_t* SI;
+	const unsigned char* data;
+	int result;
+
+	if (! IsStructValid(_TCP) || NULL == _buf)
+	{
+		return GENERAL_ERROR;
+	}
+
+	SI = FindSocketInfo(_socketNum);
+	if (! SI || SI->m_server != _TCP || SI->m_isClosing)
+	{
+		return GENERAL_ERROR;
+	}
+
+	if (SI->m_shm)
+	{
+		/* the ring is the queue. the record carries no frame header */
+		result = TCP_ShmWrite(SI->m_shm, _buf->m_data + _buf->m_payloadOffset, _buf->m_length - _buf->m_payloadOffset, 0, 0);
+		return (result > 0) ? TCP_SHARED_QUEUED : (result == 0) ? TCP_SHARED_FULL : GENERAL_ERROR;
+	}
+
+	if (_maxQueued > 0 && SI->m_outNum >= _maxQueued)
+	{
+		return TCP_SHARED_FULL;
+	}
+
+	data = _buf->m_data;
+	return (SendPooled(SI, &data, &_buf->m_length, 1) >= 0) ? TCP_SHARED_QUEUED : GENERAL_ERROR;
+}
+
+bool TCP_ServerCloseLater(TCP_S_t* _TCP, uint _socketNum)
+{
+	SocketInfo_t* SI;
+
+	if (! IsStructValid(_TCP) )
+	{
+		return FALSE;
+	}
+
+	SI = FindSocketInfo(_socketNum);
+	if (! SI || SI->m_server != _TCP)
+	{
+		return FALSE;
+	}
+
+	if (! SI->m_isClosing)
+	{
+		SI->m_isClosing = TRUE;
+		_TCP->m_closingNum++;
+	}
+	return TRUE;
+}
+
+bool TCP_ServerSetClosedHook(TCP_S_t* _TCP, connectionClosedHook _hook, void* _contex)
+{
+	if (! IsStructValid(_TCP) || (_hook && _TCP->m_closedHook) )
+	{
+		/* one per server. another would take the close notices of the first */
+		return FALSE;
+	}
+
+	_TCP->m_closedHook = _hook;
+	_TCP->m_closedHookContex = _contex;
+	return TRUE;
+}
+
+bool TCP_ServerSetCpu(TCP_S_t* _TCP, int _cpu)
+{
+	uint i;
+
+	if (! IsStructValid(_TCP) )
+	{
+		return FALSE;
+	}
+
+	_TCP->m_cpu = _cpu;
+	for (i = 0; i < _TCP->m_listenersNum; ++i)
+	{
+		/* a hint to the kernel, for listeners without a steering program */
+		setsockopt(_TCP->m_listeners[i].m_socketFD, SOL_SOCKET, SO_INCOMING_CPU, &_cpu, sizeof(_cpu) );
+	}
+	return TRUE;
+}
+
+bool TCP_ServerCpuStats(TCP_S_t* _TCP, unsigned long* _accepted, unsigned long* _acceptedOnCpu)
+{
+	if (! IsStructValid(_TCP) || NULL == _accepted || NULL == _acceptedOnCpu)
+	{
+		return FALSE;
+	}
+
+	*_accepted = _TCP->m_accepted;
+	*_acceptedOnCpu = _TCP->m_acceptedOnCpu;
+	return TRUE;
+}
+
+int TCP_ServerListenSocket(TCP_S_t* _TCP)
+{
+	if (! IsStructValid(_TCP) || 0 == _TCP->m_listenersNum)
+	{
+		return GENERAL_ERROR;
+	}
+
+	return _TCP->m_listeners[0].m_socketFD;
+}
+
+
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool IsStructValid(TCP_S_t* _TCP)
+{
+	return !(NULL == _TCP || ALIVE_MAGIC_NUMBER != _TCP->m_magicNumber);
+}
+
+bool IsConnected(TCP_S_t* _TCP)
+{
+	return (bool) _TCP->m_connectedNum;
+}
+
+
+static bool ServerSetup(TCP_S_t* _TCP, const char* _endpoint)
+{
+	struct sockaddr_storage sAddr;
+	socklen_t sAddrLength;
+	Listener_t* listener = &_TCP->m_listeners[_TCP->m_listenersNum];
+	int listenSocket;
+
+	if (! TCP_ParseEndpoint(_endpoint, &sAddr, &sAddrLength) )
+	{
+		return FALSE;
+	}
+
+	/* setSocket. */
+	listenSocket = socket(sAddr.ss_family, SOCK_STREAM, 0);
+	if (listenSocket < 0 || SetSocketBlockingEnabled(listenSocket, FALSE) == FALSE)
+	{
+		perror("Socket Failed");
+		if (listenSocket >= 0)
+		{
+			close(listenSocket);
+		}
+		return FALSE;
+	}
+
+	int optval = 1;
+	if (sAddr.ss_family == AF_UNIX)
+	{
+		/* a file left by a server that did not exit cleanly would fail the bind */
+		unlink(((struct sockaddr_un*) &sAddr)->sun_path);
+	}
+	else if ( setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval) ) < 0)
+	{
+		/* Reusing port */
+		perror("Socket setsockopt Failed");
+		close(listenSocket);
+		return FALSE;
+	}
+	else if (_TCP->m_isReusePort && setsockopt(listenSocket, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval) ) < 0)
+	{
+		/* every loop of a group listens on the port, the kernel picks one for each connection */
+		perror("Socket setsockopt SO_REUSEPORT Failed");
+		close(listenSocket);
+		return FALSE;
+	}
+
+	if (sAddr.ss_family == AF_INET6 && setsockopt(listenSocket, IPPROTO_IPV6, IPV6_V6ONLY, &optval, sizeof(optval) ) < 0)
+	{
+		/* so an IPv4 listener can share the port */
+		perror("Socket setsockopt Failed");
+		close(listenSocket);
+		return FALSE;
+	}
+
+	/*Bind socket with address struct*/
+	if (bind(listenSocket, (struct sockaddr *) &sAddr, sAddrLength) < 0 )
+	{
+		perror("Bind ServerConnect Failed.");
+		close(listenSocket);
+		return FALSE;
+	}
+
+	/* set socket to listen to new client */
+	if ( listen(listenSocket , BACK_LOG_CAPACITY) < 0 )
+	{
+		perror("Listen ServerConnect Failed.");
+		close(listenSocket);
+		return FALSE;
+	}
+
+	if (sAddr.ss_family != AF_UNIX && _TCP->m_fastOpenQueue && ! SetFastOpen(listenSocket, _TCP->m_fastOpenQueue) )
+	{
+		close(listenSocket);
+		return FALSE;
+	}
+
+	listener->m_socketFD = listenSocket;
+	listener->m_family = sAddr.ss_family;
+	listener->m_unixPath[0] = '\0';
+	if (sAddr.ss_family == AF_UNIX)
+	{
+		strcpy(listener->m_unixPath, ((struct sockaddr_un*) &sAddr)->sun_path);
+	}
+	_TCP->m_listenersNum++;
+
+	return TRUE;
+}
+
+static void CloseListeners(TCP_S_t* _TCP)
+{
+	uint i;
+
+	for (i = 0; i < _TCP->m_listenersNum; ++i)
+	{
+		close(_TCP->m_listeners[i].m_socketFD);
+		if (_TCP->m_listeners[i].m_unixPath[0] != '\0')
+		{
+			unlink(_TCP->m_listeners[i].m_unixPath);
+		}
+	}
+	_TCP->m_listenersNum = 0;
+}
+
+static bool SetFastOpen(int _listenSocket, uint _queueLength)
+{
+	int optval = _queueLength;
+
+	if ( setsockopt(_listenSocket, IPPROTO_TCP, TCP_FASTOPEN, &optval, sizeof(optval) ) < 0)
+	{
+		perror("Socket setsockopt TCP_FASTOPEN Failed");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static bool TCP_Server_ConnectNewClient(TCP_S_t* _TCP, int _listenSocket)
+{
+	if (! IsStructValid(_TCP) )
+	{
+		return FALSE;
+	}
+
+	struct sockaddr_storage sIn;
+	memset(&sIn , 0 , sizeof(sIn) );
+	socklen_t addr_len;
+	addr_len = sizeof(sIn);
+	int socket;
+	SocketInfo_t* aSI;
+
+	socket = accept(_listenSocket,  (struct sockaddr *) &sIn, &addr_len ) ;
+
+	/* select can not watch it. FD_SET past the end of the set would write over the stack */
+	if (0 < socket && FD_SETSIZE <= socket)
+	{
+		TCP_LOG(TCP_LOG_ERROR, "new socket #%ld is past FD_SETSIZE (%ld) of select. dropping it.", socket, FD_SETSIZE);
+
+		if(_TCP->m_errorFunc)
+		{
+			_TCP->m_errorFunc(TOO_MANY_CONNECTION, socket, NULL);
+		}
+
+		close(socket);
+		return FALSE;
+	}
+
+	/* got real new socket but over capacity, so close connection */
+	if (0 < socket && _TCP->m_connectionCapacity <= _TCP->m_connectedNum)
+	{
+		TCP_LOG(TCP_LOG_DEBUG, "server has too many (%ld) connection. dropping new socket #%ld.", _TCP->m_connectedNum, socket);
+
+    	if(_TCP->m_errorFunc)
+    	{
+    		_TCP->m_errorFunc(TOO_MANY_CONNECTION, socket, NULL);
+    	}
+
+		close(socket);
+		return FALSE;
+	}
+
+	/* over the memory budget. even an idle connection would take it further */
+	if (0 < socket && _TCP->m_memoryBudget > 0 && _TCP->m_memoryUsed + CONNECTION_FIXED_MEMORY > _TCP->m_memoryBudget)
+	{
+		TCP_LOG(TCP_LOG_DEBUG, "server is over its memory budget (%ld bytes used). dropping new socket #%ld.", _TCP->m_memoryUsed, socket);
+		_TCP->m_memoryRefused++;
+
+		if(_TCP->m_errorFunc)
+		{
+			_TCP->m_errorFunc(OVER_MEMORY_BUDGET, socket, NULL);
+		}
+
+		close(socket);
+		return FALSE;
+	}
+
+	if (socket > 0)
+	{ /* Success accept link */
+
+		SetKernelBusyPoll(_TCP, socket);
+		SetRxTimestamps(_TCP, socket);
+
+		/* add new socket to list of sockets. at the head, as the most recent, or it would be the first evicted */
+		aSI = CreateSocketInfo(_TCP, socket, _TCP->m_timeoutMS);
+		if (!aSI)
+		{
+			close(socket);
+			return FALSE;
+		}
+
+		if (_TCP->m_isProxy)
+		{
+			aSI->m_relay = TCP_RelayCreate(socket, (struct sockaddr*) &_TCP->m_upstream, _TCP->m_upstreamLength);
+			if (! aSI->m_relay)
+			{
+				/* no upstream, nothing to serve it with */
+				DestorySocketInfo(aSI);
+				return FALSE;
+			}
+		}
+
+		if (! list_lpush(_TCP->m_sockets, list_node_new(aSI)) )
+		{
+			/* check list fail. closes the socket */
+			DestorySocketInfo(aSI);
+			return FALSE;
+		}
+
+		_TCP->m_connectedNum++;
+		CountAccepted(_TCP, socket);
+
+		if (_TCP->m_newConnectionFunc)
+		{
+			/* if user provide a function to invoke when new client connected. nothing is attached to it yet, the function
+			 * may attach it with TCP_SetConnectionContext */
+			_TCP->m_newConnectionFunc(socket, _TCP->m_contex, NULL);
+		}
+
+		return TRUE;
+	}
+	else if ( IsFail_nonBlocking( socket) )
+	{ /* Failed accept link */
+		TCP_LOG_ERRNO(TCP_LOG_ERROR, "TCP_ServerConnect accept Failed", 0, 0);
+		return FALSE;
+	}
+	else
+	{ /* no one on the other side, all is well */
+		return FALSE;
+	}
+}
+
+/* for the stats of a pinned loop. the kernel tells on which CPU the packets of the connection arrive */
+static void CountAccepted(TCP_S_t* _TCP, int _socket)
+{
+	int incomingCpu;
+	socklen_t length = sizeof(incomingCpu);
+
+	_TCP->m_accepted++;
+	if (_TCP->m_cpu >= 0 && getsockopt(_socket, SOL_SOCKET, SO_INCOMING_CPU, &incomingCpu, &length) == 0 && incomingCpu == _TCP->m_cpu)
+	{
+		_TCP->m_acceptedOnCpu++;
+	}
+}
+
+/* the kernel polls the device queue in blocking reads of the socket, instead of waiting for the interrupt.
+ * more than net.core.busy_read needs CAP_NET_ADMIN, without it the socket keeps the system value */
+static void SetKernelBusyPoll(TCP_S_t* _TCP, int _socket)
+{
+	int busyPollUS = _TCP->m_kernelPollUS;
+	int isPrefer = 1;
+
+	if (0 == busyPollUS)
+	{
+		return;
+	}
+	if (setsockopt(_socket, SOL_SOCKET, SO_BUSY_POLL, &busyPollUS, sizeof(busyPollUS)) < 0
+		|| setsockopt(_socket, SOL_SOCKET, SO_PREFER_BUSY_POLL, &isPrefer, sizeof(isPrefer)) < 0)
+	{
+		TCP_LOG_ERRNO(TCP_LOG_DEBUG, "Socket setsockopt SO_BUSY_POLL Failed, socket #%ld", _socket, 0);
+	}
+}
+
+/* every message reaches the user function through here */
+static void Deliver(TCP_S_t* _TCP, SocketInfo_t* _SI, void* _data, uint _length)
+{
+	if (_TCP->m_capture && ! TCP_CaptureWrite(_TCP->m_capture, _SI->m_socketFD, _TCP->m_currentRequestID, _data, _length) )
+	{
+		/* the disk is full. serving goes on without it */
+		_TCP->m_capture = NULL;
+	}
+	CountRxDelay(_TCP);
+	_TCP->m_reciveDataFunc(_data, _length, _SI->m_socketFD, _TCP->m_contex, _SI->m_userContex);
+	_TCP->m_rxDelayNS = 0;
+}
+
+/* recv, and the kernel stamp of the packets read into m_rxTime when the connection has them */
+static int ReadSocket(TCP_S_t* _TCP, int _socketNum, void* _buffer, uint _length)
+{
+	char control[CMSG_SPACE(sizeof(struct scm_timestamping) )];
+	struct iovec piece = {_buffer, _length};
+	struct msghdr message;
+	struct cmsghdr* cmsg;
+	int nBytesRead;
+
+	if (NULL == _TCP || ! _TCP->m_isRxTimestamps)
+	{
+		return recv(_socketNum, _buffer, _length, 0);
+	}
+
+	memset(&message, 0, sizeof(message) );
+	message.msg_iov = &piece;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	_TCP->m_rxTime.tv_sec = 0;
+	nBytesRead = recvmsg(_socketNum, &message, 0);
+	for (cmsg = CMSG_FIRSTHDR(&message); nBytesRead > 0 && cmsg; cmsg = CMSG_NXTHDR(&message, cmsg) )
+	{
+		if (SOL_SOCKET == cmsg->cmsg_level && SCM_TIMESTAMPING == cmsg->cmsg_type)
+		{
+			/* ts[0] is the software stamp, ts[2] the hardware one */
+			_TCP->m_rxTime = ((struct scm_timestamping*) CMSG_DATA(cmsg))->ts[0];
+		}
+	}
+	return nBytesRead;
+}
+
+/* the stamp is taken as the packet enters the stack, on CLOCK_REALTIME */
+static void SetRxTimestamps(TCP_S_t* _TCP, int _socket)
+{
+	int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+
+	if (! _TCP->m_isRxTimestamps)
+	{
+		return;
+	}
+	if (setsockopt(_socket, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+	{
+		TCP_LOG_ERRNO(TCP_LOG_DEBUG, "Socket setsockopt SO_TIMESTAMPING Failed, socket #%ld", _socket, 0);
+	}
+}
+
+/* the delay of the message about to be delivered, from the stamp of the read that completed it */
+static void CountRxDelay(TCP_S_t* _TCP)
+{
+	TCP_RxDelayStats_t* stats = &_TCP->m_rxDelayStats;
+	struct timespec now;
+	uint64_t delayUS;
+	uint bucket = 0;
+
+	if (0 == _TCP->m_rxTime.tv_sec)
+	{
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	_TCP->m_rxDelayNS = (now.tv_sec - _TCP->m_rxTime.tv_sec) * 1000000000LL + (now.tv_nsec - _TCP->m_rxTime.tv_nsec);
+	if ((int64_t) _TCP->m_rxDelayNS < 0)
+	{
+		/* the clock was set back */
+		_TCP->m_rxDelayNS = 0;
+	}
+
+	for (delayUS = _TCP->m_rxDelayNS / 1000; delayUS > 0 && bucket < TCP_RX_DELAY_BUCKETS - 1; delayUS >>= 1)
+	{
+		++bucket;
+	}
+	stats->m_buckets[bucket]++;
+	stats->m_messages++;
+	stats->m_sumNS += _TCP->m_rxDelayNS;
+	if (_TCP->m_rxDelayNS > stats->m_maxNS)
+	{
+		stats->m_maxNS = _TCP->m_rxDelayNS;
+	}
+}
+
+static uint64_t NowUS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static bool TCP_ServerDisconnectClient(TCP_S_t* _TCP, uint _socketNum)
+{
+	if (! IsStructValid(_TCP) )
+	{
+		return FALSE;
+	}
+	if (NULL == _TCP->m_sockets)
+	{
+		/* no list means big probalmes */
+		return FALSE;
+	}
+
+	/* TODO for better preformance search from tail to head as most of the sockes to remove are at the tail */
+	list_node_t *node;
+	list_iterator_t *it = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
+	while ((node = list_iterator_next(it)))
+	{
+		if ( getSocket(node) == _socketNum)
+		{
+			/* found the socket looking to remove			 */
+			list_iterator_destroy(it);
+			DisconnectNode(_TCP, node);
+			return TRUE;
+		}
+	}
+	list_iterator_destroy(it);
+	return FALSE;
+}
+
+/* the node is removed, so an iterator may only be past it */
+static void DisconnectNode(TCP_S_t* _TCP, list_node_t* _node)
+{
+	SocketInfo_t* SI = _node->val;
+
+	if (SI->m_isClosing)
+	{
+		_TCP->m_closingNum--;
+	}
+
+	if (_TCP->m_closedHook)
+	{
+		/* the modules built on the server forget the connection before the user hears of it */
+		_TCP->m_closedHook(SI->m_socketFD, _TCP->m_closedHookContex);
+	}
+
+	if (_TCP->m_closedConnectionFunc)
+	{
+		/* if user provide a function to invoke when a client disconnect */
+		_TCP->m_closedConnectionFunc(SI->m_socketFD, _TCP->m_contex, SI->m_userContex);
+	}
+
+	/* closes the socket */
+	DestorySocketInfo(SI);
+	list_remove(_TCP->m_sockets, _node);
+	_TCP->m_connectedNum--;
+}
+
+/* connections closed by TCP_ServerCloseLater, while the list was iterated */
+static void CloseClosing(TCP_S_t* _TCP)
+{
+	list_iterator_t* itr;
+	list_node_t *node;
+
+	if (0 == _TCP->m_closingNum)
+	{
+		return;
+	}
+
+	itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
+	while (_TCP->m_closingNum > 0 && (node = list_iterator_next(itr)))
+	{
+		if (((SocketInfo_t*) node->val)->m_isClosing)
+		{
+			DisconnectNode(_TCP, node);
+		}
+	}
+	list_iterator_destroy(itr);
+}
+
+static bool MoveNodeToHead(list_t* _socketsContiner, list_node_t* node, uint _timeoutMS)
+{
+	list_node_t* newNode;
+	SocketInfo_t* SI;
+
+	/* store value */
+	int socketTemp = getSocket(node);
+	SI = node->val;
+	node->val = NULL;
+
+	/* remove old node */
+	list_remove(_socketsContiner, node);
+
+	//setTimeout(node, WhenIsTime2Die(_timeoutMS) );
+
+	/* TODO does the above line fits with the one below?! */
+
+	/* add socket to list of sockets at head */
+//	aSI = CreateSocketInfo(socketTemp, _timeoutMS);
+//	if (!aSI)
+//	{
+//		return FALSE;
+//	}
+
+	/* create new node with old data */
+	newNode = list_node_new(SI);
+	/* Calculate and update timeout */
+	setTimeout(newNode, WhenIsTime2Die(_timeoutMS) );
+
+	if (! list_lpush(_socketsContiner, newNode ) )
+	{
+		/* check list fail */
+		close( socketTemp);
+		DestorySocketInfo(SI);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static timeval_t setTimeout(list_node_t* _node, timeval_t _when2die)
+{
+	SocketInfo_t* tempSocketInfo = _node->val;
+
+	tempSocketInfo->m_timeToDie = _when2die;
+
+	return tempSocketInfo->m_timeToDie;
+}
+
+static bool SelectServer(TCP_S_t* _TCP)
+{
+	int activity;
+	int max_sd;
+
+	//set of socket descriptors
+	fd_set readfds;
+	fd_set writefds; /* only connections with a queue */
+
+	timeval_t when2wakeup;
+	int waitMS;
+	bool isSpinning;
+
+	_TCP->m_loopThread = pthread_self();
+	_TCP->m_isServerRun = TRUE;
+	while( _TCP->m_isServerRun )
+	{
+		/* TODO next line bracks code */
+		//when2wakeup = DealWithTimeout(_TCP); /* close sockets that are open for longer than timeout */ /* TODO BUGs lay here!!! */
+		CloseClosing(_TCP);
+		KillOldestClient(_TCP); /* if capacity is full, close oldest connections */
+		ShedMemory(_TCP); /* if over the memory budget, close the biggest connections */
+		ApplyPauseRequests(_TCP); /* of other threads */
+		ApplySendRequests(_TCP);
+
+		max_sd = SetupSelect(_TCP, &readfds, &writefds);
+
+		//wait for an activity on one of the sockets, or until the nearest timer.
+		//without timers wait indefinitely
+		waitMS = TCP_TimersNextMS(_TCP->m_timers, TCP_TimersNowMS() );
+
+		/* in a burst, the next message is likely to come within the spin budget. polling finds it without the
+		 * sleep and wakeup. once the budget passes idle the loop sleeps, and the next message starts a new budget */
+		isSpinning = _TCP->m_spinUS > 0 && NowUS() - _TCP->m_lastActivityUS < _TCP->m_spinUS;
+		if (isSpinning)
+		{
+			waitMS = 0;
+		}
+		else
+		{
+			_TCP->m_pollStats.m_sleeps++;
+		}
+
+		when2wakeup.tv_sec = waitMS / 1000;
+		when2wakeup.tv_usec = (waitMS % 1000) * 1000;
+		activity = select( max_sd + 1 , &readfds , &writefds , NULL , (waitMS >= 0) ? &when2wakeup : NULL);
+
+		if (activity > 0 && _TCP->m_spinUS > 0)
+		{
+			_TCP->m_lastActivityUS = NowUS();
+		}
+		if (isSpinning)
+		{
+			_TCP->m_pollStats.m_polls++;
+			_TCP->m_pollStats.m_pollHits += (activity > 0);
+		}
+
+		if ((activity < 0) && (errno!=EINTR)) /* change to my function that check if real failed */
+		{
+			perror("select error");
+			return FALSE;
+		}
+		else if (activity == 0)
+		{
+			/* select woke-up because of timeout. */
+
+		}
+		else{
+			/* activity > 0 means found real activity. */
+
+			if (FD_ISSET(_TCP->m_wakeFD, &readfds) )
+			{
+				/* TCP_StopServer. the loop condition ends it */
+				uint64_t count;
+				if (read(_TCP->m_wakeFD, &count, sizeof(count)) < 0)
+				{
+					/* drained already */
+				}
+			}
+
+			/* queued messages first, they are older than anything an answer to a read would send */
+			FlushWritable(_TCP, &writefds);
+
+			//If something happened on the master sockets ,
+			//then its an incoming connection
+			AcceptAll(_TCP, &readfds);
+
+			/* find the sockets that woke the selector, read from it and activate user function */
+			ReadFromSelect(_TCP, &readfds, &writefds);
+		}
+
+		TCP_TimersRun(_TCP->m_timers, TCP_TimersNowMS() );
+	}
+
+	return TRUE;
+}
+
+static timeval_t DealWithTimeout(TCP_S_t* _TCP)
+{
+	timeval_t currentTime;
+	timeval_t time2die;
+	timeval_t when2wakeup = {60,0}; /* if list is empty this defualt value would be used as max sleep time */
+	list_node_t* tailNode;
+
+	if ( gettimeofday(&currentTime, NULL) )
+	{
+		perror("failed to get time.\n");
+	}
+
+	while (	(tailNode = list_at(_TCP->m_sockets, -1) ) != list_at(_TCP->m_sockets, 0))
+	{
+		/* test tailNode is not endNode = list is empty */
+
+		time2die = getTimeout(tailNode);
+		timersub(&time2die, &currentTime, &when2wakeup);
+
+		if ( timercmp(&time2die, &currentTime, >) )
+		{
+			/* time2die is later than current time */
+			/* just return when to wakeup */
+
+			return when2wakeup;
+		}
+		else
+		{
+			/* last node socket should be removed */
+			if (! TCP_ServerDisconnectClient(_TCP, getSocket(tailNode) ) )
+			{
+				perror("Can't remove at ShouldKillClient");
+			}
+
+			/* recursive loop until no more nodes to kill because of time */
+
+		}
+	}
+	return when2wakeup;
+}
+
+static void AcceptAll(TCP_S_t* _TCP, fd_set* _readfds)
+{
+	uint i;
+
+	for (i = 0; i < _TCP->m_listenersNum; ++i)
+	{
+		if (FD_ISSET(_TCP->m_listeners[i].m_socketFD, _readfds))
+		{
+			/* call server connect function */
+			while ( TCP_Server_ConnectNewClient(_TCP, _TCP->m_listeners[i].m_socketFD) == TRUE)
+			{
+				/* keep on accepting all waiting client while there are some */
+			}
+		}
+	}
+}
+
+static int SetupSelect(TCP_S_t* _TCP, fd_set* _readfds, fd_set* _writefds)
+{
+	int max_sd, sd;
+	list_iterator_t* itr;
+	list_node_t *node;
+	uint i;
+
+	//clear the socket set
+	FD_ZERO(_readfds);
+	FD_ZERO(_writefds);
+
+	//add master sockets to set
+	max_sd = _TCP->m_wakeFD;
+	FD_SET(_TCP->m_wakeFD, _readfds);
+	for (i = 0; i < _TCP->m_listenersNum; ++i)
+	{
+		FD_SET(_TCP->m_listeners[i].m_socketFD, _readfds);
+		if (_TCP->m_listeners[i].m_socketFD > max_sd)
+		{
+			max_sd = _TCP->m_listeners[i].m_socketFD;
+		}
+	}
+
+	//add child sockets to set
+	itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
+	while ((node = list_iterator_next(itr)))
+	{
+		//socket descriptor
+		sd = getSocket(node);
+
+		if (((SocketInfo_t*) node->val)->m_relay)
+		{
+			/* a proxy pair waits on its two sides by itself */
+			TCP_RelayWatch(((SocketInfo_t*) node->val)->m_relay, _readfds, _writefds, &max_sd);
+			continue;
+		}
+
+		//if valid socket descriptor then add to read list. a paused one is left to fill its kernel buffer
+		UpdateQueuePause(_TCP, node->val);
+		if (! IsReadPaused(node->val) )
+		{
+			FD_SET( sd , _readfds);
+		}
+		if (((SocketInfo_t*) node->val)->m_outNum > 0)
+		{
+			FD_SET( sd , _writefds);
+		}
+
+		//highest file descriptor number, need it for the select function
+		if(sd > max_sd)
+		{
+			max_sd = sd;
+		}
+	}
+	list_iterator_destroy(itr);
+	return max_sd;
+}
+
+static void FlushWritable(TCP_S_t* _TCP, fd_set* _writefds)
+{
+	list_iterator_t* itr;
+	list_node_t *node;
+	SocketInfo_t* SI;
+
+	itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
+	while ((node = list_iterator_next(itr)))
+	{
+		SI = node->val;
+		if (SI->m_outNum > 0 && FD_ISSET(SI->m_socketFD, _writefds) && FlushOut(SI) == GENERAL_ERROR)
+		{
+			/* the read side finds out on its own, or the next loop closes it */
+			TCP_ServerCloseLater(_TCP, SI->m_socketFD);
+		}
+	}
+	list_iterator_destroy(itr);
+}
+
+static int ReadFromSelect(TCP_S_t* _TCP, fd_set* _readfds, fd_set* _writefds)
+{
+	int sd;
+	int resultSize;
+	list_iterator_t* itr;
+	list_node_t *node;
+	char* buffer;
+
+	//else its some IO operation on some other socket
+	itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
+	while ((node = list_iterator_next(itr)))
+	{
+		sd = getSocket(node);
+
+		/* a user function may have paused it since the select */
+		if (((FD_ISSET( sd , _readfds) && ! IsReadPaused(node->val)) || ((SocketInfo_t*) node->val)->m_relay)
+			&& ! ((SocketInfo_t*) node->val)->m_isClosing)
+		{
+			SocketInfo_t* SI = node->val;
+
+			/* found the socket that woke. messages of the ring have no kernel stamp */
+			_TCP->m_rxTime.tv_sec = 0;
+			if (SI->m_relay)
+			{
+				/* proxy. either side may have woken, the pair checks its own. the user function is not involved */
+				resultSize = TCP_RelayMove(SI->m_relay, _readfds, _writefds);
+				if (resultSize > 0)
+				{
+					_TCP->m_proxyBytes += resultSize;
+				}
+			}
+			else if (SI->m_isFirstRead && IsShmHello(sd) )
+			{
+				resultSize = ShmHandshake(_TCP, SI);
+			}
+			else if (SI->m_shm)
+			{
+				/* a doorbell. the messages are in the ring */
+				resultSize = ReadShm(_TCP, SI);
+			}
+			else if (_TCP->m_isFramed)
+			{
+				/* frames are dispatched inside, as they are completed */
+				resultSize = ReadFrames(_TCP, node->val);
+			}
+			else if (! (buffer = (char*) FreshBuffer(&_TCP->m_readBuf, FRAME_READ_SIZE)) )
+			{
+				/* out of memory. try again on the next loop */
+				resultSize = -1;
+			}
+			else
+			{
+				/* the user function gets the pooled buffer itself, and may keep it */
+				resultSize = Recive(_TCP, getSocket(node), buffer, BUFFER_MAX_SIZE);
+				if (resultSize > 0)
+				{
+					Deliver(_TCP, SI, buffer, resultSize);
+				}
+			}
+			SI->m_isFirstRead = FALSE;
+			/* a partial frame was kept, or released */
+			AccountMemory(SI);
+
+			if (resultSize == 0)
+			{
+				/* socket was closed */
+				if (! TCP_ServerDisconnectClient(_TCP, sd) )
+				{
+					TCP_LOG(TCP_LOG_ERROR, "Problem removing empty client #%ld", sd, 0);
+				}
+			}
+			else if (resultSize > 0)
+			{
+				if (! MoveNodeToHead(_TCP->m_sockets, node, _TCP->m_timeoutMS) )
+				{
+					TCP_LOG(TCP_LOG_ERROR, "Error UpdateSocketTimeout, socket #%ld", sd, 0);
+				}
+			}
+			else if (resultSize == GENERAL_ERROR)
+			{
+				/* peer broke the framing. nothing that follows can be trusted */
+				if (! TCP_ServerDisconnectClient(_TCP, sd) )
+				{
+					TCP_LOG(TCP_LOG_ERROR, "Problem removing broken client #%ld", sd, 0);
+				}
+			}
+			else
+			{
+				/* Do nothing. it was dealt with.
+				 *perror("Error");
+				 */
+			}
+		}
+	}
+	list_iterator_destroy(itr);
+	return TRUE;
+}
+
+/* returns the bytes read, 0 on close, GENERAL_ERROR on a broken frame, or other negative on read failure */
+static int ReadFrames(TCP_S_t* _TCP, SocketInfo_t* _SI)
+{
+	unsigned char* buffer;
+	unsigned char* newBuf;
+	int nBytesRead;
+	int used;
+
+	buffer = FreshBuffer(&_TCP->m_readBuf, FRAME_READ_SIZE);
+	if (! buffer)
+	{
+		return -1;
+	}
+
+	nBytesRead = ReadSocket(_TCP, _SI->m_socketFD, buffer, FRAME_READ_SIZE);
+	if (nBytesRead <= 0)
+	{
+		if ( IsFail_nonBlocking(nBytesRead) )
+		{
+			TCP_LOG_ERRNO(TCP_LOG_ERROR, "Read Failed, socket #%ld", _SI->m_socketFD, 0);
+		}
+		return nBytesRead;
+	}
+
+	if (0 == _SI->m_inLength)
+	{
+		/* common case, nothing pending. frames are handled straight from the read buffer */
+		used = DispatchFrames(_TCP, _SI, buffer, nBytesRead);
+		if (used < 0 || ! KeepPartialFrame(_SI, buffer + used, nBytesRead - used) )
+		{
+			return GENERAL_ERROR;
+		}
+		return nBytesRead;
+	}
+
+	/* a frame is pending. complete it first */
+	if (! KeepPartialFrame(_SI, buffer, nBytesRead) )
+	{
+		return GENERAL_ERROR;
+	}
+	used = DispatchFrames(_TCP, _SI, _SI->m_inBuf, _SI->m_inLength);
+	if (used < 0)
+	{
+		return GENERAL_ERROR;
+	}
+	_SI->m_inLength -= used;
+
+	if (0 == _SI->m_inLength)
+	{
+		/* an idle connection should not hold memory */
+		TCP_BufferRelease(_SI->m_inBuf);
+		_SI->m_inBuf = NULL;
+		_SI->m_inCapacity = 0;
+	}
+	else if (used > 0 && TCP_BufferIsShared(_SI->m_inBuf) )
+	{
+		/* the user function kept a frame. the rest moves to a buffer of its own */
+		newBuf = TCP_BufferAlloc(_SI->m_inLength);
+		if (! newBuf)
+		{
+			return GENERAL_ERROR;
+		}
+		memcpy(newBuf, _SI->m_inBuf + used, _SI->m_inLength);
+		TCP_BufferRelease(_SI->m_inBuf);
+		_SI->m_inBuf = newBuf;
+		_SI->m_inCapacity = TCP_BufferCapacity(newBuf);
+	}
+	else
+	{
+		memmove(_SI->m_inBuf, _SI->m_inBuf + used, _SI->m_inLength);
+	}
+
+	return nBytesRead;
+}
+
+/* invoke the user function for every complete frame. returns the bytes consumed, or GENERAL_ERROR */
+static int DispatchFrames(TCP_S_t* _TCP, SocketInfo_t* _SI, unsigned char* _data, uint _length)
+{
+	TCP_FrameHeader_t header;
+	uint offset = 0;
+
+	while (_length - offset >= TCP_FRAME_HEADER_SIZE)
+	{
+		if (! TCP_FrameDecode(_data + offset, &header) )
 		{
-			close(socket);
-			return FALSE;
+			return GENERAL_ERROR;
+		}
+		if (_length - offset - TCP_FRAME_HEADER_SIZE < header.m_length)
+		{
+			/* payload did not fully arrive yet */
+			break;
 		}
 
-		if (! list_rpush(_TCP->m_sockets, list_node_new(aSI)) )
+		if (! DispatchFrame(_TCP, _SI, &header, _data + offset + TCP_FRAME_HEADER_SIZE) )
+		{
+			return GENERAL_ERROR;
+		}
+
+		offset += TCP_FRAME_HEADER_SIZE + header.m_length;
+	}
+
+	return offset;
+}
+
+/* one complete frame. returns FALSE when the client broke the protocol */
+static bool DispatchFrame(TCP_S_t* _TCP, SocketInfo_t* _SI, TCP_FrameHeader_t* _header, unsigned char* _payload)
+{
+	int length = _header->m_length;
+	unsigned char* unpacked;
+
+	if (_header->m_flags & TCP_FRAME_FLAG_HELLO)
+	{
+		/* between the server and the client only, the user never sees it */
+		return AgreeCompression(_TCP, _SI, _header->m_requestID, _payload, _header->m_length);
+	}
+
+	if (_header->m_flags & TCP_FRAME_FLAG_COMPRESSED)
+	{
+		if (_SI->m_codec != TCP_CODEC_LZ)
+		{
+			return FALSE;
+		}
+		unpacked = FreshBuffer(&_TCP->m_unpackBuf, TCP_FRAME_MAX_PAYLOAD);
+		if (! unpacked)
 		{
-			/* check list fail */
-			close(socket);
-			DestorySocketInfo(aSI);
 			return FALSE;
 		}
+		length = TCP_Decompress(_payload, _header->m_length, unpacked, TCP_FRAME_MAX_PAYLOAD, _SI->m_dict);
+		if (length < 0)
+		{
+			return FALSE;
+		}
+		_payload = unpacked;
+	}
 
-		_TCP->m_connectedNum++;
+	_TCP->m_currentRequestID = _header->m_requestID;
+	_TCP->m_currentMethod = _header->m_method;
+	Deliver(_TCP, _SI, _payload, length);
+	_TCP->m_currentRequestID = 0;
+	_TCP->m_currentMethod = 0;
 
-		if (_TCP->m_newConnectionFunc)
+	return TRUE;
+}
+
+/* answer a HELLO with what this server agrees to */
+static bool AgreeCompression(TCP_S_t* _TCP, SocketInfo_t* _SI, uint _requestID, unsigned char* _payload, uint _length)
+{
+	unsigned char reply[TCP_COMPRESS_HELLO_SIZE];
+	uint codec;
+	uint32_t dictID;
+
+	if (! TCP_CompressHelloDecode(_payload, _length, &codec, &dictID) )
+	{
+		return FALSE;
+	}
+
+	_SI->m_codec = (_TCP->m_isCompressEnabled && codec == TCP_CODEC_LZ) ? TCP_CODEC_LZ : TCP_CODEC_NONE;
+	/* a dictionary the client does not have is worse than none */
+	_SI->m_dict = (_SI->m_codec == TCP_CODEC_LZ && dictID != 0 && dictID == TCP_DictionaryID(_TCP->m_dict) ) ? _TCP->m_dict : NULL;
+
+	TCP_CompressHelloEncode(_SI->m_codec, TCP_DictionaryID(_SI->m_dict), reply);
+	return SendFrameFlags(_SI->m_socketFD, _requestID, TCP_FRAME_FLAG_HELLO, reply, TCP_COMPRESS_HELLO_SIZE) > 0;
+}
+
+/* TCP_SendFrame with header flags */
+static int SendFrame(uint _socketNum, uint _requestID, uint _flags, const void* _msg, uint _msgLength)
+{
+	SocketSlot_t* slot;
+	SocketInfo_t* SI;
+	uint packedLength;
+
+	if ( (NULL == _msg && _msgLength > 0) || _msgLength > TCP_FRAME_MAX_PAYLOAD)
+	{
+		return GENERAL_ERROR;
+	}
+
+	slot = OffLoopSlot(_socketNum);
+	if (slot)
+	{
+		/* the loop frames it, so it compresses with the connection's state, or writes the ring */
+		return PostSend(slot, _socketNum, TRUE, _requestID, _flags, _msg, _msgLength);
+	}
+
+	SI = FindSocketInfo(_socketNum);
+	if (SI && SI->m_isClosing)
+	{
+		return GENERAL_ERROR;
+	}
+
+	if (SI && SI->m_shm)
+	{
+		/* the ring record carries the request ID, no frame header needed. and no flags */
+		return _flags ? GENERAL_ERROR : TCP_ShmWrite(SI->m_shm, _msg ? _msg : "", _msgLength, _requestID, 0);
+	}
+
+	if (SI && SI->m_codec == TCP_CODEC_LZ && _msgLength >= SI->m_server->m_compressThreshold)
+	{
+		packedLength = TCP_Compress(_msg, _msgLength, SI->m_server->m_packBuf, TCP_FRAME_MAX_PAYLOAD, SI->m_dict);
+		if (packedLength > 0)
 		{
-			/* if user provide a function to invoke when new client connected */
-			_TCP->m_newConnectionFunc(socket, _TCP->m_contex);
+			return SendFrameFlags(_socketNum, _requestID, _flags | TCP_FRAME_FLAG_COMPRESSED, SI->m_server->m_packBuf, packedLength);
 		}
+		/* did not get smaller, send it as it is */
+	}
+
+	return SendFrameFlags(_socketNum, _requestID, _flags, _msg, _msgLength);
+}
+
+static int SendFrameFlags(int _socketNum, uint _requestID, uint _flags, const void* _msg, uint _msgLength)
+{
+	unsigned char header[TCP_FRAME_HEADER_SIZE];
+	TCP_FrameHeader_t frameHeader;
+	struct iovec iov[2];
+	struct msghdr msg;
+	int sent_bytes;
+	SocketInfo_t* SI;
+
+	frameHeader.m_length = _msgLength;
+	frameHeader.m_requestID = _requestID;
+	frameHeader.m_flags = _flags;
+	frameHeader.m_method = 0;
+	TCP_FrameEncode(&frameHeader, header);
+
+	SI = FindSocketInfo(_socketNum);
+	if (SI)
+	{
+		/* never waits, as TCP_Send */
+		return SendCopy(SI, header, TCP_FRAME_HEADER_SIZE, _msg, _msgLength);
+	}
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = TCP_FRAME_HEADER_SIZE;
+	iov[1].iov_base = (void*) _msg;
+	iov[1].iov_len = _msgLength;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	sent_bytes = sendmsg(_socketNum, &msg, MSG_NOSIGNAL);
+	if (0 > sent_bytes)
+	{
+		TCP_LOG_ERRNO(TCP_LOG_ERROR, "SendFrame Failed, socket #%ld", _socketNum, 0);
+	}
+
+	return sent_bytes;
+}
 
+/* append bytes to the connection pending buffer */
+static bool KeepPartialFrame(SocketInfo_t* _SI, unsigned char* _data, uint _length)
+{
+	unsigned char* newBuf;
+
+	if (0 == _length)
+	{
 		return TRUE;
 	}
-	else if ( IsFail_nonBlocking( socket) )
-	{ /* Failed accept link */
-		perror("TCP_ServerConnect accept Failed.");
+
+	if (_SI->m_inLength + _length > _SI->m_inCapacity)
+	{
+		/* the pool rounds up to its size class */
+		newBuf = TCP_BufferAlloc(_SI->m_inLength + _length);
+		if (! newBuf)
+		{
+			return FALSE;
+		}
+		if (_SI->m_inLength > 0)
+		{
+			memcpy(newBuf, _SI->m_inBuf, _SI->m_inLength);
+		}
+		TCP_BufferRelease(_SI->m_inBuf);
+		_SI->m_inBuf = newBuf;
+		_SI->m_inCapacity = TCP_BufferCapacity(newBuf);
+	}
+
+	memcpy(_SI->m_inBuf + _SI->m_inLength, _data, _length);
+	_SI->m_inLength += _length;
+
+	return TRUE;
+}
+
+/* peek, so a connection that does not start with a handshake is read as usual */
+static bool IsShmHello(int _socketNum)
+{
+	TCP_ShmHello_t hello;
+	int nBytesRead;
+
+	nBytesRead = recv(_socketNum, &hello, sizeof(hello), MSG_PEEK | MSG_DONTWAIT);
+
+	return (nBytesRead == sizeof(hello) && memcmp(hello.m_magic, TCP_SHM_MAGIC, TCP_SHM_MAGIC_LENGTH) == 0);
+}
+
+/* returns the bytes read, or GENERAL_ERROR when the reply could not be sent */
+static int ShmHandshake(TCP_S_t* _TCP, SocketInfo_t* _SI)
+{
+	TCP_ShmHello_t hello;
+	char reply = TCP_SHM_REJECT;
+	TCP_Shm_t* shm;
+
+	if (recv(_SI->m_socketFD, &hello, sizeof(hello), 0) != sizeof(hello) )
+	{
+		return GENERAL_ERROR;
+	}
+
+	if (_TCP->m_isShmEnabled)
+	{
+		/* refused, the client stays on the socket */
+		shm = TCP_ShmAttach(_SI->m_socketFD, &hello);
+		if (shm)
+		{
+			_SI->m_shm = shm;
+			reply = TCP_SHM_ACCEPT;
+		}
+	}
+
+	if (send(_SI->m_socketFD, &reply, 1, MSG_NOSIGNAL) != 1)
+	{
+		return GENERAL_ERROR;
+	}
+
+	return sizeof(hello);
+}
+
+/* drain the ring until it is empty and armed. returns as ReadFrames does */
+static int ReadShm(TCP_S_t* _TCP, SocketInfo_t* _SI)
+{
+	char doorbells[64];
+	unsigned char* buffer;
+	int nBytesRead;
+	int length = GENERAL_ERROR;
+	int total = 0;
+	uint requestID;
+
+	nBytesRead = recv(_SI->m_socketFD, doorbells, sizeof(doorbells), MSG_DONTWAIT);
+	if (nBytesRead == 0 || IsFail_nonBlocking(nBytesRead) )
+	{
+		return nBytesRead;
+	}
+	if (nBytesRead < 0)
+	{
+		/* woken for another socket. the ring may still have something */
+		nBytesRead = 0;
+	}
+
+	do
+	{
+		while ((buffer = FreshBuffer(&_TCP->m_shmReadBuf, TCP_FRAME_MAX_PAYLOAD))
+				&& (length = TCP_ShmRead(_SI->m_shm, buffer, TCP_FRAME_MAX_PAYLOAD, &requestID, FALSE)) > 0)
+		{
+			if (! _TCP->m_isFramed)
+			{
+				/* same as TCP_Recive does for the socket */
+				sanity_check((char*) buffer, length, '_');
+			}
+
+			_TCP->m_currentRequestID = _TCP->m_isFramed ? requestID : 0;
+			Deliver(_TCP, _SI, buffer, length);
+			_TCP->m_currentRequestID = 0;
+			total += length;
+		}
+
+		if (! buffer)
+		{
+			/* out of memory */
+			return GENERAL_ERROR;
+		}
+		if (length == TCP_SHM_BROKEN)
+		{
+			return GENERAL_ERROR;
+		}
+		if (length == 0)
+		{
+			/* client left. its socket close follows */
+			return 0;
+		}
+	} while (! TCP_ShmArm(_SI->m_shm) );
+
+	/* a doorbell with nothing behind it is not an error */
+	return (total + nBytesRead > 0) ? total + nBytesRead : -1;
+}
+
+static bool RegisterSocketInfo(SocketInfo_t* _SI)
+{
+	uint chunk = (uint) _SI->m_socketFD / SOCKET_CHUNK_SIZE;
+	SocketSlot_t* newChunk;
+	SocketSlot_t* slot;
+
+	if (chunk >= SOCKET_CHUNKS_NUM)
+	{
 		return FALSE;
 	}
-	else
-	{ /* no one on the other side, all is well */
+
+	if (! g_socketSlots[chunk])
+	{
+		pthread_mutex_lock(&g_socketInfosLock);
+		if (! g_socketSlots[chunk])
+		{
+			newChunk = calloc(SOCKET_CHUNK_SIZE, sizeof(SocketSlot_t) );
+			__atomic_store_n(&g_socketSlots[chunk], newChunk, __ATOMIC_RELEASE);
+		}
+		pthread_mutex_unlock(&g_socketInfosLock);
+		if (! g_socketSlots[chunk])
+		{
+			return FALSE;
+		}
+	}
+
+	slot = &g_socketSlots[chunk][_SI->m_socketFD % SOCKET_CHUNK_SIZE];
+	_SI->m_generation = __atomic_add_fetch(&g_generation, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->m_server, _SI->m_server, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->m_generation, _SI->m_generation, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->m_SI, _SI, __ATOMIC_RELEASE);
+	return TRUE;
+}
+
+/* the slot of _socketNum, NULL if it never had a connection */
+static SocketSlot_t* FindSocketSlot(uint _socketNum)
+{
+	SocketSlot_t* chunk;
+
+	if (_socketNum >= SOCKET_CHUNK_SIZE * SOCKET_CHUNKS_NUM)
+	{
+		return NULL;
+	}
+	chunk = __atomic_load_n(&g_socketSlots[_socketNum / SOCKET_CHUNK_SIZE], __ATOMIC_ACQUIRE);
+	return chunk ? &chunk[_socketNum % SOCKET_CHUNK_SIZE] : NULL;
+}
+
+static SocketInfo_t* FindSocketInfo(uint _socketNum)
+{
+	SocketSlot_t* slot = FindSocketSlot(_socketNum);
+
+	return slot ? __atomic_load_n(&slot->m_SI, __ATOMIC_ACQUIRE) : NULL;
+}
+
+/* one hold, for the caller */
+static TCP_SharedBuf_t* CreateShared(const void* _header, uint _headerLength, const void* _msg, uint _msgLength)
+{
+	TCP_SharedBuf_t* buf = TCP_BufferAlloc(sizeof(TCP_SharedBuf_t) + _headerLength + _msgLength);
+	if (! buf)
+	{
+		return NULL;
+	}
+
+	buf->m_length = _headerLength + _msgLength;
+	buf->m_payloadOffset = _headerLength;
+	if (_headerLength > 0)
+	{
+		memcpy(buf->m_data, _header, _headerLength);
+	}
+	if (_msgLength > 0)
+	{
+		memcpy(buf->m_data + _headerLength, _msg, _msgLength);
+	}
+	return buf;
+}
+
+/* send pooled pieces in order without blocking, and queue what the kernel did not take. returns the bytes, or GENERAL_ERROR */
+static int SendPooled(SocketInfo_t* _SI, const unsigned char** _pieces, const uint* _lengths, uint _piecesNum)
+{
+	struct iovec iov[2];
+	struct msghdr msg;
+	int sent_bytes = 0;
+	uint total = 0;
+	uint skip;
+	uint i;
+
+	for (i = 0; i < _piecesNum; ++i)
+	{
+		iov[i].iov_base = (void*) _pieces[i];
+		iov[i].iov_len = _lengths[i];
+		total += _lengths[i];
+	}
+
+	if (0 == _SI->m_outNum)
+	{
+		/* usually the kernel takes it all, and nothing is queued */
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = _piecesNum;
+
+		sent_bytes = sendmsg(_SI->m_socketFD, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (IsFail_nonBlocking(sent_bytes) )
+		{
+			return GENERAL_ERROR;
+		}
+		if (sent_bytes < 0)
+		{
+			sent_bytes = 0;
+		}
+	}
+
+	skip = sent_bytes;
+	for (i = 0; i < _piecesNum; ++i)
+	{
+		if (skip >= _lengths[i])
+		{
+			skip -= _lengths[i];
+			continue;
+		}
+		if (! EnqueueOut(_SI, _pieces[i], _lengths[i], skip) )
+		{
+			return GENERAL_ERROR;
+		}
+		skip = 0;
+	}
+
+	return total;
+}
+
+/* send memory that is not pooled without blocking. what the kernel does not take is copied to the queue, as is all of it
+ * when there is a queue already, or the client would get it out of order. returns the bytes, or GENERAL_ERROR */
+static int SendCopy(SocketInfo_t* _SI, const void* _header, uint _headerLength, const void* _msg, uint _msgLength)
+{
+	struct iovec iov[2];
+	struct msghdr msg;
+	TCP_SharedBuf_t* copy;
+	int sent_bytes = 0;
+
+	if (0 == _SI->m_outNum)
+	{
+		iov[0].iov_base = (void*) _header;
+		iov[0].iov_len = _headerLength;
+		iov[1].iov_base = (void*) _msg;
+		iov[1].iov_len = _msgLength;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = _headerLength ? iov : iov + 1;
+		msg.msg_iovlen = _headerLength ? 2 : 1;
+
+		sent_bytes = sendmsg(_SI->m_socketFD, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (IsFail_nonBlocking(sent_bytes) )
+		{
+			TCP_LOG_ERRNO(TCP_LOG_ERROR, "Send Failed, socket #%ld", _SI->m_socketFD, 0);
+			return GENERAL_ERROR;
+		}
+		if (sent_bytes < 0)
+		{
+			sent_bytes = 0;
+		}
+		if ((uint) sent_bytes == _headerLength + _msgLength)
+		{
+			return sent_bytes;
+		}
+	}
+
+	/* the part that went out is skipped by the queue */
+	copy = CreateShared(_header, _headerLength, _msg, _msgLength);
+	if (! copy || ! EnqueueOut(_SI, copy->m_data, copy->m_length, sent_bytes) )
+	{
+		TCP_SharedRelease(copy);
+		return GENERAL_ERROR;
+	}
+	TCP_SharedRelease(copy);
+	return _headerLength + _msgLength;
+}
+
+/* the queue takes its own hold. _sentBytes is what already went out, when the queue is empty */
+static bool EnqueueOut(SocketInfo_t* _SI, const unsigned char* _data, uint _length, uint _sentBytes)
+{
+	OutEntry_t* newQueue;
+	uint newCapacity;
+	uint i;
+
+	if (_SI->m_outNum == _SI->m_outCapacity)
+	{
+		newCapacity = _SI->m_outCapacity ? _SI->m_outCapacity * 2 : 16;
+		newQueue = malloc(newCapacity * sizeof(OutEntry_t) );
+		if (! newQueue)
+		{
+			return FALSE;
+		}
+		/* unwrap, so the head is at 0 again */
+		for (i = 0; i < _SI->m_outNum; ++i)
+		{
+			newQueue[i] = _SI->m_outQueue[(_SI->m_outHead + i) % _SI->m_outCapacity];
+		}
+		free(_SI->m_outQueue);
+		_SI->m_outQueue = newQueue;
+		_SI->m_outCapacity = newCapacity;
+		_SI->m_outHead = 0;
+	}
+
+	if (! TCP_BufferRetain(_data) )
+	{
 		return FALSE;
 	}
+
+	if (0 == _SI->m_outNum)
+	{
+		_SI->m_outOffset = _sentBytes;
+	}
+	i = (_SI->m_outHead + _SI->m_outNum) % _SI->m_outCapacity;
+	_SI->m_outQueue[i].m_data = _data;
+	_SI->m_outQueue[i].m_length = _length;
+	_SI->m_outNum++;
+	_SI->m_outBytes += _length;
+	AccountMemory(_SI);
+
+	return TRUE;
+}
+
+/* send as much of the queue as the kernel takes. returns the bytes sent, or GENERAL_ERROR */
+static int FlushOut(SocketInfo_t* _SI)
+{
+	struct iovec iov[FLUSH_IOV_MAX];
+	struct msghdr msg;
+	OutEntry_t* entry;
+	uint iovNum;
+	uint left;
+	int sent_bytes;
+
+	for (iovNum = 0; iovNum < _SI->m_outNum && iovNum < FLUSH_IOV_MAX; ++iovNum)
+	{
+		entry = &_SI->m_outQueue[(_SI->m_outHead + iovNum) % _SI->m_outCapacity];
+		iov[iovNum].iov_base = (void*) entry->m_data;
+		iov[iovNum].iov_len = entry->m_length;
+	}
+	iov[0].iov_base = (unsigned char*) iov[0].iov_base + _SI->m_outOffset;
+	iov[0].iov_len -= _SI->m_outOffset;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovNum;
+
+	sent_bytes = sendmsg(_SI->m_socketFD, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (sent_bytes < 0)
+	{
+		return IsFail_nonBlocking(sent_bytes) ? GENERAL_ERROR : 0;
+	}
+
+	/* release every message that fully went out */
+	left = sent_bytes;
+	while (_SI->m_outNum > 0)
+	{
+		entry = &_SI->m_outQueue[_SI->m_outHead];
+		if (left < entry->m_length - _SI->m_outOffset)
+		{
+			_SI->m_outOffset += left;
+			break;
+		}
+		left -= entry->m_length - _SI->m_outOffset;
+		_SI->m_outOffset = 0;
+		_SI->m_outHead = (_SI->m_outHead + 1) % _SI->m_outCapacity;
+		_SI->m_outNum--;
+		_SI->m_outBytes -= entry->m_length;
+		TCP_BufferRelease(entry->m_data);
+	}
+
+	if (0 == _SI->m_outNum)
+	{
+		/* drained. an idle connection should not hold memory */
+		ReleaseOut(_SI);
+	}
+	AccountMemory(_SI);
+
+	return sent_bytes;
 }
 
-static bool TCP_ServerDisconnectClient(TCP_S_t* _TCP, uint _socketNum)
+static void ReleaseOut(SocketInfo_t* _SI)
 {
-	if (! IsStructValid(_TCP) )
+	while (_SI->m_outNum > 0)
 	{
-		return FALSE;
+		TCP_BufferRelease(_SI->m_outQueue[_SI->m_outHead].m_data);
+		_SI->m_outHead = (_SI->m_outHead + 1) % _SI->m_outCapacity;
+		_SI->m_outNum--;
 	}
-	if (NULL == _TCP->m_sockets)
+	free(_SI->m_outQueue);
+	_SI->m_outQueue = NULL;
+	_SI->m_outCapacity = 0;
+	_SI->m_outHead = 0;
+	_SI->m_outBytes = 0;
+}
+
+/* the server buffer, or a new one if the user function kept it. NULL if the pool is out of memory */
+static unsigned char* FreshBuffer(unsigned char** _buf, uint _size)
+{
+	if (*_buf && TCP_BufferIsShared(*_buf) )
 	{
-		/* no list means big probalmes */
-		return FALSE;
+		TCP_BufferRelease(*_buf);
+		*_buf = NULL;
 	}
-
-	/* TODO for better preformance search from tail to head as most of the sockes to remove are at the tail */
-	list_node_t *node;
-	list_iterator_t *it = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
-	while ((node = list_iterator_next(it)))
+	if (! *_buf)
 	{
-		if ( getSocket(node) == _socketNum)
-		{
-			/* found the socket looking to remove			 */
+		*_buf = TCP_BufferAlloc(_size);
+	}
+	return *_buf;
+}
 
-			if (_TCP->m_closedConnectionFunc)
-			{
-				/* if user provide a function to invoke when a client disconnect */
-				_TCP->m_closedConnectionFunc( getSocket(node) , _TCP->m_contex);
-			}
+static bool KillOldestClient(TCP_S_t* _TCP)
+{
+	/* TODO remove hardcoded value */
 
-			close( getSocket(node) );
-			DestorySocketInfo(node->val); /* TODO might cause a core dump in next line */
-			list_remove(_TCP->m_sockets, node);
-			_TCP->m_connectedNum--;
+	if (_TCP->m_connectionCapacity * 0.99 <= _TCP->m_connectedNum)
+	{
+		/* server is almost full. lets disconnects the oldest connections */
+		list_node_t* tailNode = list_at(_TCP->m_sockets, -1);
 
-			return TRUE;
+		/* the least recently active, the tail. no need to search the list for it */
+		if (tailNode)
+		{
+			DisconnectNode(_TCP, tailNode);
 		}
+		//list_rpop(_TCP->m_sockets); /* TODO shopuld it be here? */
+		//list_remove(_TCP->m_sockets, tailNode);
 	}
-	return FALSE;
+
+	return TRUE;
 }
 
-static bool MoveNodeToHead(list_t* _socketsContiner, list_node_t* node, uint _timeoutMS)
+/* over the budget, the connections holding the most go first. they are the slow readers, and closing one of them
+ * frees what a thousand idle ones hold. one pass keeps the largest few in a small heap, smallest on top */
+static void ShedMemory(TCP_S_t* _TCP)
 {
-	list_node_t* newNode;
-	SocketInfo_t* SI;
+	list_node_t* heap[MEMORY_SHED_PER_LOOP];
+	list_iterator_t* itr;
+	list_node_t* node;
+	uint heapNum = 0;
+	uint i;
 
-	/* store value */
-	int socketTemp = getSocket(node);
-	SI = node->val;
-	node->val = NULL;
+	if (0 == _TCP->m_memoryBudget || _TCP->m_memoryUsed <= _TCP->m_memoryBudget)
+	{
+		return;
+	}
 
-	/* remove old node */
-	list_remove(_socketsContiner, node);
+	itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
+	while ((node = list_iterator_next(itr)))
+	{
+		if (heapNum < MEMORY_SHED_PER_LOOP)
+		{
+			heap[heapNum++] = node;
+			SiftUp(heap, heapNum - 1);
+		}
+		else if (NodeMemory(node) > NodeMemory(heap[0]) )
+		{
+			heap[0] = node;
+			SiftDown(heap, heapNum, 0);
+		}
+	}
+	list_iterator_destroy(itr);
 
-	//setTimeout(node, WhenIsTime2Die(_timeoutMS) );
+	/* taking the top off leaves them sorted, the largest last */
+	for (i = heapNum; i > 1; --i)
+	{
+		node = heap[0];
+		heap[0] = heap[i - 1];
+		heap[i - 1] = node;
+		SiftDown(heap, i - 1, 0);
+	}
 
-	/* TODO does the above line fits with the one below?! */
+	for (i = 0; i < heapNum && _TCP->m_memoryUsed > _TCP->m_memoryBudget; ++i)
+	{
+		node = heap[heapNum - 1 - i];
+		TCP_LOG(TCP_LOG_WARN, "server is over its memory budget (%ld bytes used). closing socket #%ld.", _TCP->m_memoryUsed,
+				((SocketInfo_t*) node->val)->m_socketFD);
+		_TCP->m_memoryShed++;
+		if (_TCP->m_errorFunc)
+		{
+			_TCP->m_errorFunc(OVER_MEMORY_BUDGET, ((SocketInfo_t*) node->val)->m_socketFD, NULL);
+		}
+		DisconnectNode(_TCP, node);
+	}
+}
 
-	/* add socket to list of sockets at head */
-//	aSI = CreateSocketInfo(socketTemp, _timeoutMS);
-//	if (!aSI)
-//	{
-//		return FALSE;
-//	}
+static size_t NodeMemory(list_node_t* _node)
+{
+	return ((SocketInfo_t*) _node->val)->m_memory;
+}
 
-	/* create new node with old data */
-	newNode = list_node_new(SI);
-	/* Calculate and update timeout */
-	setTimeout(newNode, WhenIsTime2Die(_timeoutMS) );
+static void SiftUp(list_node_t** _heap, uint _index)
+{
+	list_node_t* node;
+	uint parent;
 
-	if (! list_lpush(_socketsContiner, newNode ) )
+	while (_index > 0 && NodeMemory(_heap[parent = (_index - 1) / 2]) > NodeMemory(_heap[_index]) )
 	{
-		/* check list fail */
-		close( socketTemp);
-		DestorySocketInfo(SI);
-		return FALSE;
+		node = _heap[parent];
+		_heap[parent] = _heap[_index];
+		_heap[_index] = node;
+		_index = parent;
 	}
-
-	return TRUE;
 }
 
-static timeval_t setTimeout(list_node_t* _node, timeval_t _when2die)
+static void SiftDown(list_node_t** _heap, uint _num, uint _index)
 {
-	SocketInfo_t* tempSocketInfo = _node->val;
-
-	tempSocketInfo->m_timeToDie = _when2die;
+	list_node_t* node;
+	uint smallest;
+	uint child;
 
-	return tempSocketInfo->m_timeToDie;
+	for (;;)
+	{
+		smallest = _index;
+		child = 2 * _index + 1;
+		if (child < _num && NodeMemory(_heap[child]) < NodeMemory(_heap[smallest]) )
+		{
+			smallest = child;
+		}
+		if (child + 1 < _num && NodeMemory(_heap[child + 1]) < NodeMemory(_heap[smallest]) )
+		{
+			smallest = child + 1;
+		}
+		if (smallest == _index)
+		{
+			return;
+		}
+		node = _heap[smallest];
+		_heap[smallest] = _heap[_index];
+		_heap[_index] = node;
+		_index = smallest;
+	}
 }
 
-static bool SelectServer(TCP_S_t* _TCP)
+/* counts again what the connection holds, after its buffers changed */
+static void AccountMemory(SocketInfo_t* _SI)
 {
-	int activity;
-	int max_sd;
-
-	//set of socket descriptors
-	fd_set readfds;
+	size_t memory = CONNECTION_FIXED_MEMORY + _SI->m_inCapacity + _SI->m_outCapacity * sizeof(OutEntry_t) + _SI->m_outBytes;
 
-	timeval_t when2wakeup;
+	if (memory != _SI->m_memory)
+	{
+		/* unsigned, a smaller figure wraps to a subtraction */
+		__atomic_fetch_add(&_SI->m_server->m_memoryUsed, memory - _SI->m_memory, __ATOMIC_RELAXED);
+		_SI->m_memory = memory;
+	}
+}
 
-	_TCP->m_isServerRun = TRUE;
-	while( _TCP->m_isServerRun )
+/* pause reading a connection whose answers pile up faster than its peer reads them, until the queue is down to the
+ * low mark. its peer then waits on TCP instead of the server holding more of its answers */
+static void UpdateQueuePause(TCP_S_t* _TCP, SocketInfo_t* _SI)
+{
+	if (! _SI->m_isQueuePaused && _TCP->m_pauseHighBytes > 0 && _SI->m_outBytes >= _TCP->m_pauseHighBytes)
 	{
-		/* TODO next line bracks code */
-		//when2wakeup = DealWithTimeout(_TCP); /* close sockets that are open for longer than timeout */ /* TODO BUGs lay here!!! */
-		KillOldestClient(_TCP); /* if capacity is full, close oldest connections */
+		_SI->m_isQueuePaused = TRUE;
+		_TCP->m_queuePauses++;
+		TCP_LOG(TCP_LOG_DEBUG, "socket #%ld paused, %ld bytes queued", _SI->m_socketFD, _SI->m_outBytes);
+	}
+	else if (_SI->m_isQueuePaused && (0 == _TCP->m_pauseHighBytes || _SI->m_outBytes <= _TCP->m_pauseLowBytes) )
+	{
+		_SI->m_isQueuePaused = FALSE;
+	}
+}
 
-		max_sd = SetupSelect( _TCP->m_listenSocket, _TCP->m_sockets, &readfds);
+static bool IsReadPaused(SocketInfo_t* _SI)
+{
+	return _SI->m_isReadPaused || _SI->m_isQueuePaused;
+}
+
+/* on the loop thread at once. another thread may not touch the connection, the loop could be freeing it. it reads
+ * the slot only, which stays, and leaves the request to the loop */
+static bool SetReadPaused(uint _socketNum, bool _isPaused)
+{
+	SocketSlot_t* slot = FindSocketSlot(_socketNum);
+	PauseRequest_t* bigger;
+	SocketInfo_t* SI;
+	TCP_S_t* server;
+	uint newCapacity;
 
-		//wait for an activity on one of the sockets , timeout is NULL ,
-		//so wait indefinitely
-		//activity = select( max_sd + 1 , &readfds , NULL , NULL , &when2wakeup);
-		activity = select( max_sd + 1 , &readfds , NULL , NULL , NULL); /* after the timeout replace this line with the one above */
+	if (! slot || ! (SI = __atomic_load_n(&slot->m_SI, __ATOMIC_ACQUIRE)) )
+	{
+		return FALSE;
+	}
 
-		if ((activity < 0) && (errno!=EINTR)) /* change to my function that check if real failed */
+	server = __atomic_load_n(&slot->m_server, __ATOMIC_RELAXED);
+	if (server->m_isServerRun && pthread_equal(server->m_loopThread, pthread_self()) )
+	{
+		if (SI->m_relay)
 		{
-			perror("select error");
 			return FALSE;
 		}
-		else if (activity == 0)
-		{
-			/* select woke-up because of timeout. */
-
-		}
-		else{
-			/* activity > 0 means found real activity. */
-
-			//If something happened on the master socket ,
-			//then its an incoming connection
-			if (FD_ISSET(_TCP->m_listenSocket, &readfds))
-			{
-				/* call server connect function */
-				while ( TCP_Server_ConnectNewClient(_TCP) == TRUE)
-				{
-					/* keep on accepting all waiting client while there are some */
-				}
-			}
+		SI->m_isReadPaused = _isPaused;
+		return TRUE;
+	}
 
-			/* find the sockets that woke the selector, read from it and activate user function */
-			ReadFromSelect(_TCP, &readfds);
+	pthread_mutex_lock(&server->m_requestLock);
+	if (server->m_pauseRequestsNum == server->m_pauseRequestsCapacity)
+	{
+		newCapacity = server->m_pauseRequestsCapacity ? server->m_pauseRequestsCapacity * 2 : 16;
+		bigger = realloc(server->m_pauseRequests, newCapacity * sizeof(PauseRequest_t) );
+		if (! bigger)
+		{
+			pthread_mutex_unlock(&server->m_requestLock);
+			return FALSE;
 		}
+		server->m_pauseRequests = bigger;
+		server->m_pauseRequestsCapacity = newCapacity;
 	}
-
+	server->m_pauseRequests[server->m_pauseRequestsNum].m_socketNum = _socketNum;
+	server->m_pauseRequests[server->m_pauseRequestsNum].m_generation = __atomic_load_n(&slot->m_generation, __ATOMIC_RELAXED);
+	server->m_pauseRequests[server->m_pauseRequestsNum].m_isPaused = _isPaused;
+	/* read without the lock by the loop, to skip the lock when there is nothing */
+	__atomic_store_n(&server->m_pauseRequestsNum, server->m_pauseRequestsNum + 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&server->m_requestLock);
+
+	/* the loop may be asleep in a select without the socket */
+	WakeLoop(server);
 	return TRUE;
 }
 
-static timeval_t DealWithTimeout(TCP_S_t* _TCP)
+/* the requests of other threads, in order. one for a connection closed since, or for a proxy connection, is dropped */
+static void ApplyPauseRequests(TCP_S_t* _TCP)
 {
-	timeval_t currentTime;
-	timeval_t time2die;
-	timeval_t when2wakeup = {60,0}; /* if list is empty this defualt value would be used as max sleep time */
-	list_node_t* tailNode;
+	PauseRequest_t* request;
+	SocketInfo_t* SI;
+	uint i;
 
-	if ( gettimeofday(&currentTime, NULL) )
+	if (0 == __atomic_load_n(&_TCP->m_pauseRequestsNum, __ATOMIC_RELAXED) )
 	{
-		perror("failed to get time.\n");
+		return;
 	}
 
-	while (	(tailNode = list_at(_TCP->m_sockets, -1) ) != list_at(_TCP->m_sockets, 0))
+	pthread_mutex_lock(&_TCP->m_requestLock);
+	for (i = 0; i < _TCP->m_pauseRequestsNum; ++i)
 	{
-		/* test tailNode is not endNode = list is empty */
-
-		time2die = getTimeout(tailNode);
-		timersub(&time2die, &currentTime, &when2wakeup);
-
-		if ( timercmp(&time2die, &currentTime, >) )
-		{
-			/* time2die is later than current time */
-			/* just return when to wakeup */
-
-			return when2wakeup;
-		}
-		else
+		request = &_TCP->m_pauseRequests[i];
+		SI = FindSocketInfo(request->m_socketNum);
+		if (SI && SI->m_server == _TCP && SI->m_generation == request->m_generation && ! SI->m_relay)
 		{
-			/* last node socket should be removed */
-			if (! TCP_ServerDisconnectClient(_TCP, getSocket(tailNode) ) )
-			{
-				perror("Can't remove at ShouldKillClient");
-			}
-
-			/* recursive loop until no more nodes to kill because of time */
-
+			SI->m_isReadPaused = request->m_isPaused;
 		}
 	}
-	return when2wakeup;
+	__atomic_store_n(&_TCP->m_pauseRequestsNum, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&_TCP->m_requestLock);
 }
 
-static int SetupSelect(int _listenSocket, list_t* _socketList, fd_set* _readfds)
+/* the connection of the socket, if the caller is not the thread of its loop. NULL on that thread, or if there is none */
+static SocketSlot_t* OffLoopSlot(uint _socketNum)
 {
-	int max_sd, sd;
-	list_iterator_t* itr;
-	list_node_t *node;
+	SocketSlot_t* slot = FindSocketSlot(_socketNum);
+	TCP_S_t* server;
 
-	//clear the socket set
-	FD_ZERO(_readfds);
+	if (! slot || ! __atomic_load_n(&slot->m_SI, __ATOMIC_ACQUIRE) )
+	{
+		return NULL;
+	}
 
-	//add master socket to set
-	FD_SET(_listenSocket, _readfds);
-	max_sd = _listenSocket;
-	FD_SET(0, _readfds);
+	server = __atomic_load_n(&slot->m_server, __ATOMIC_RELAXED);
+	return (server->m_isServerRun && pthread_equal(server->m_loopThread, pthread_self()) ) ? NULL : slot;
+}
 
-	//add child sockets to set
-	itr = list_iterator_new(_socketList, LIST_HEAD);
-	while ((node = list_iterator_next(itr)))
+/* a send of another thread. it may not touch the connection, as SetReadPaused. the message is copied and left to the
+ * loop, so it goes out in order with the loop's own sends. returns the bytes, as if sent */
+static int PostSend(SocketSlot_t* _slot, uint _socketNum, bool _isFrame, uint _requestID, uint _flags, const void* _msg, uint _msgLength)
+{
+	TCP_S_t* server = __atomic_load_n(&_slot->m_server, __ATOMIC_RELAXED);
+	SendRequest_t* bigger;
+	SendRequest_t* request;
+	uint newCapacity;
+	void* copy;
+
+	copy = malloc(_msgLength ? _msgLength : 1);
+	if (! copy)
 	{
-		//socket descriptor
-		sd = getSocket(node);
-
-		//if valid socket descriptor then add to read list
-		FD_SET( sd , _readfds);
+		return GENERAL_ERROR;
+	}
+	if (_msgLength)
+	{
+		memcpy(copy, _msg, _msgLength);
+	}
 
-		//highest file descriptor number, need it for the select function
-		if(sd > max_sd)
+	pthread_mutex_lock(&server->m_requestLock);
+	if (server->m_sendRequestsNum == server->m_sendRequestsCapacity)
+	{
+		newCapacity = server->m_sendRequestsCapacity ? server->m_sendRequestsCapacity * 2 : 16;
+		bigger = realloc(server->m_sendRequests, newCapacity * sizeof(SendRequest_t) );
+		if (! bigger)
 		{
-			max_sd = sd;
+			pthread_mutex_unlock(&server->m_requestLock);
+			free(copy);
+			return GENERAL_ERROR;
 		}
+		server->m_sendRequests = bigger;
+		server->m_sendRequestsCapacity = newCapacity;
 	}
-	return max_sd;
+	request = &server->m_sendRequests[server->m_sendRequestsNum];
+	request->m_socketNum = _socketNum;
+	request->m_generation = __atomic_load_n(&_slot->m_generation, __ATOMIC_RELAXED);
+	request->m_isFrame = _isFrame;
+	request->m_requestID = _requestID;
+	request->m_flags = _flags;
+	request->m_msg = copy;
+	request->m_msgLength = _msgLength;
+	__atomic_store_n(&server->m_sendRequestsNum, server->m_sendRequestsNum + 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&server->m_requestLock);
+
+	WakeLoop(server);
+	return _isFrame ? _msgLength + TCP_FRAME_HEADER_SIZE : _msgLength;
 }
 
-static int ReadFromSelect(TCP_S_t* _TCP, fd_set* _readfds)
+/* the sends of other threads, in order, as the loop's own. one for a connection closed since is dropped */
+static void ApplySendRequests(TCP_S_t* _TCP)
 {
-	int sd;
-	int resultSize;
-	list_iterator_t* itr;
-	list_node_t *node;
-	char buffer[BUFFER_MAX_SIZE];
+	SendRequest_t* request;
+	SocketInfo_t* SI;
+	uint i;
 
-	//else its some IO operation on some other socket
-	itr = list_iterator_new(_TCP->m_sockets, LIST_HEAD);
-	while ((node = list_iterator_next(itr)))
+	if (0 == __atomic_load_n(&_TCP->m_sendRequestsNum, __ATOMIC_RELAXED) )
 	{
-		sd = getSocket(node);
+		return;
+	}
 
-		if (FD_ISSET( sd , _readfds))
+	pthread_mutex_lock(&_TCP->m_requestLock);
+	for (i = 0; i < _TCP->m_sendRequestsNum; ++i)
+	{
+		request = &_TCP->m_sendRequests[i];
+		SI = FindSocketInfo(request->m_socketNum);
+		if (SI && SI->m_server == _TCP && SI->m_generation == request->m_generation)
 		{
-			/* found the socket that woke */
-			resultSize = TCP_Recive( getSocket(node), buffer, BUFFER_MAX_SIZE);
-			if (resultSize == 0)
+			if (request->m_isFrame)
 			{
-				/* socket was closed */
-				if (! TCP_ServerDisconnectClient(_TCP, sd) )
-				{
-					perror("Problem removing empty client");
-				}
-			}
-			else if (resultSize > 0)
-			{
-				_TCP->m_reciveDataFunc(buffer, resultSize, getSocket(node), _TCP->m_contex);
-
-				if (! MoveNodeToHead(_TCP->m_sockets, node, _TCP->m_timeoutMS) )
-				{
-					perror("Error UpdateSocketTimeout.\n");
-				}
+				SendFrame(request->m_socketNum, request->m_requestID, request->m_flags, request->m_msg, request->m_msgLength);
 			}
 			else
 			{
-				/* Do nothing. it was dealt with.
-				 *perror("Error");
-				 */
+				TCP_Send(request->m_socketNum, request->m_msg, request->m_msgLength);
 			}
 		}
+		free(request->m_msg);
 	}
-	return TRUE;
+	__atomic_store_n(&_TCP->m_sendRequestsNum, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&_TCP->m_requestLock);
 }
 
-static bool KillOldestClient(TCP_S_t* _TCP)
+static void WakeLoop(TCP_S_t* _TCP)
 {
-	/* TODO remove hardcoded value */
+	uint64_t one = 1;
 
-	if (_TCP->m_connectionCapacity * 0.99 <= _TCP->m_connectedNum)
+	if (write(_TCP->m_wakeFD, &one, sizeof(one)) < 0)
 	{
-		/* server is almost full. lets disconnects the oldest connections */
-		list_node_t* tailNode = list_at(_TCP->m_sockets, -1);
-
-		if (! TCP_ServerDisconnectClient(_TCP, getSocket(tailNode) ) )
-		{
-			perror("Can't remove at ShouldKillClient");
-		}
-		//list_rpop(_TCP->m_sockets); /* TODO shopuld it be here? */
-		//list_remove(_TCP->m_sockets, tailNode);
+		/* the counter is already set, the loop wakes anyway */
 	}
-
-	return TRUE;
 }
 
-static SocketInfo_t* CreateSocketInfo(int _socket, uint _timeoutMS)
+static SocketInfo_t* CreateSocketInfo(TCP_S_t* _TCP, int _socket, uint _timeoutMS)
 {
 	SocketInfo_t* aSI = malloc(1 * sizeof(SocketInfo_t) );
 	if (! aSI)
@@ -756,8 +3102,35 @@ static SocketInfo_t* CreateSocketInfo(int _socket, uint _timeoutMS)
 
 	aSI->m_socketFD = _socket;
 	aSI->m_timeToDie = WhenIsTime2Die(_timeoutMS);
+	aSI->m_inBuf = NULL;
+	aSI->m_inLength = 0;
+	aSI->m_inCapacity = 0;
+	aSI->m_isFirstRead = TRUE;
+	aSI->m_shm = NULL;
+	aSI->m_relay = NULL;
+	aSI->m_server = _TCP;
+	aSI->m_codec = TCP_CODEC_NONE;
+	aSI->m_dict = NULL;
+	aSI->m_outQueue = NULL;
+	aSI->m_outCapacity = 0;
+	aSI->m_outHead = 0;
+	aSI->m_outNum = 0;
+	aSI->m_outOffset = 0;
+	aSI->m_isClosing = FALSE;
+	aSI->m_userContex = NULL;
+	aSI->m_outBytes = 0;
+	aSI->m_memory = 0;
+	aSI->m_isReadPaused = FALSE;
+	aSI->m_isQueuePaused = FALSE;
+
+	if (! RegisterSocketInfo(aSI) )
+	{
+		free(aSI);
+		return NULL;
+	}
 
 	aSI->m_magicNumber = SI_MAGIC_NUMBER;
+	AccountMemory(aSI);
 
 	return aSI;
 }
@@ -770,7 +3143,17 @@ static void DestorySocketInfo(SocketInfo_t* _SI)
 	}
 
 	_SI->m_magicNumber = -1;
+	if (FindSocketInfo(_SI->m_socketFD) == _SI)
+	{
+		/* before the close, so the number is free in the table when another loop gets it */
+		__atomic_store_n(&FindSocketSlot(_SI->m_socketFD)->m_SI, NULL, __ATOMIC_RELEASE);
+	}
+	TCP_ShmDetach(_SI->m_shm);
+	TCP_RelayDestroy(_SI->m_relay);
 	close(_SI->m_socketFD);
+	TCP_BufferRelease(_SI->m_inBuf);
+	ReleaseOut(_SI);
+	__atomic_fetch_sub(&_SI->m_server->m_memoryUsed, _SI->m_memory, __ATOMIC_RELAXED);
 	free(_SI);
 	return;
 }
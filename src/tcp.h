@@ -5,7 +5,6 @@
  * @brief A TCP server and client ADT for future projects use.
  *
  * @bug not a possible TCP_SERVER_USER_ERROR were included.
- * @bug when calling stop Server function and server is waiting on select nothing would happen until next transmission would arrive
  * @bug timeout function has some undefined behavior
  */
 
@@ -14,6 +13,15 @@
 
 #include "sys/types.h" /* size_t */
 
+#include "tcp_compress.h"
+#include "tcp_buffer.h"
+#include "tcp_timer.h"
+#include "tcp_capture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 #define MAX_CLIENTS_NUM 1000
@@ -25,25 +33,71 @@ typedef int bool;
 #define FALSE 0
 
 typedef enum TCP_SERVER_USER_ERROR {
-	TOO_MANY_CONNECTION = 1
+	TOO_MANY_CONNECTION = 1, /* over _maxConnections, or a socket number select can not watch (FD_SETSIZE) */
+	OVER_MEMORY_BUDGET /* a new connection refused, or an open one closed, see TCP_ServerSetMemoryBudget */
 } TCP_SERVER_USER_ERROR;
 
-typedef int (*userActionFunc)(void* _data, size_t _sizeData, uint _socketNum, void* _contex);
-typedef int (*clientConnectionChangeFunc)(uint _socketNum, void* _contex);
+/* _data is a pooled buffer (tcp_buffer.h). it is reused after the function returns, unless held with TCP_BufferRetain.
+ * _connContex is what was attached to the connection with TCP_SetConnectionContext, NULL until then */
+typedef int (*userActionFunc)(void* _data, size_t _sizeData, uint _socketNum, void* _contex, void* _connContex);
+/* on a new connection _connContex is always NULL, nothing was attached yet. it is the place to attach it */
+typedef int (*clientConnectionChangeFunc)(uint _socketNum, void* _contex, void* _connContex);
 typedef int (*errorFunc)(TCP_SERVER_USER_ERROR _status, uint _socketNum, void* _contex);
 
 /* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 typedef struct TCP_S TCP_S_t;
 
+/* how the loop waited, see TCP_ServerSetBusyPoll */
+typedef struct TCP_PollStats
+{
+	unsigned long m_polls; /* checks without sleeping, while spinning */
+	unsigned long m_pollHits; /* of them, found something to do */
+	unsigned long m_sleeps; /* blocking waits */
+} TCP_PollStats_t;
+
+/* what the connections hold, see TCP_ServerSetMemoryBudget */
+typedef struct TCP_MemoryStats
+{
+	size_t m_used; /* bytes held by all the connections */
+	size_t m_budget; /* 0 when there is none */
+	size_t m_perConnection; /* m_used by the connections, on average */
+	size_t m_idleConnection; /* of a connection with nothing pending, its state and list node only */
+	size_t m_largest; /* of the connection holding the most */
+	unsigned long m_shed; /* connections closed to get back under the budget */
+	unsigned long m_refused; /* connections not accepted over the budget */
+} TCP_MemoryStats_t;
+
+/* connections not read, see TCP_PauseRead and TCP_ServerSetReadPause */
+typedef struct TCP_FlowStats
+{
+	uint m_paused; /* connections not read now, for either reason */
+	uint m_queuePaused; /* of them, because of their queue */
+	unsigned long m_queuePauses; /* times a queue went over the high mark */
+} TCP_FlowStats_t;
+
+/* log2 buckets of TCP_RxDelayStats_t. bucket 0 is under 1 usec, bucket i from 2^(i-1) usec to 2^i, the last is all above */
+#define TCP_RX_DELAY_BUCKETS 32
+
+/* how long messages waited between their arrival in the kernel and the user function, see TCP_ServerSetRxTimestamps */
+typedef struct TCP_RxDelayStats
+{
+	unsigned long m_messages; /* with a kernel time. shared memory messages have none */
+	uint64_t m_sumNS;
+	uint64_t m_maxNS;
+	unsigned long m_buckets[TCP_RX_DELAY_BUCKETS];
+} TCP_RxDelayStats_t;
+
 /* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 /**
  * @brief Create the server and setup all is needed of work
  * @param _port the server listing port for new client connections.
- * @param _serverIP The server IP address in case of a few interfaces for the same computer. Can be left NULL for defualt ip selected.
+ * @param _serverIP The server IP address (ipv4 or ipv6) in case of a few interfaces for the same computer. Can be left NULL for defualt ip selected.
  * @param _maxConnections if more connection than this number are simultansly try to connect, clients would be dealt and probably droped.
+ * the server waits with select, so a connection whose socket number is FD_SETSIZE (1024) or more is droped as well.
  * @param _timeoutMS any connection not used for this amount of time (miliSeconds) would be droped
  * @param _reciveDataFunc user function to invoke when data is recived at server
  * @param _newClientConnected user function to invoke when new client is connected. can be left NULL.
+ * its _connContex is always NULL, attach one with TCP_SetConnectionContext.
  * @param _clientDissconected user function to invoke when client is disconnected, either because of server of client induces. can be left NULL.
  * @param _errorFunc user function to invoke when errors occur in server. can be left NULL.
  * @return a pointer to the struct. NULL if failed.
@@ -55,6 +109,21 @@ TCP_S_t* TCP_CreateServer(uint _port, const char* _serverIP, uint _maxConnection
 						errorFunc _errorFunc,
 						void* _contex
 						);
+/**
+ * @brief Create a server that listens on several endpoints at once. all of them feed the same connections and user functions.
+ * @param _endpoints array of endpoints. "127.0.0.1:4848", "[::]:4848", "*:4848" or "unix:/tmp/server.sock" (see tcp_address.h).
+ * @param _endpointsNum number of endpoints in the array. up to 8.
+ * other parameters are the same as TCP_CreateServer.
+ * @return a pointer to the struct. NULL if failed.
+ */
+TCP_S_t* TCP_CreateServerEndpoints(const char* const* _endpoints, uint _endpointsNum, uint _maxConnections, uint _timeoutMS,
+						userActionFunc _reciveDataFunc,
+						clientConnectionChangeFunc _newClientConnected,
+						clientConnectionChangeFunc _clientDissconected,
+						errorFunc _errorFunc,
+						void* _contex
+						);
+
 /**
  * @brief Cleans up and free after the program.
  * @param _TCP pointer to the struct
@@ -70,15 +139,141 @@ void TCP_DestroyServer(TCP_S_t* _TCP);
 bool TCP_RunServer(TCP_S_t* _TCP);
 
 /**
- * @brief stop the TCP_RunServer loop.
+ * @brief stop the TCP_RunServer loop. it wakes from its wait at once. safe to call from a signal handler or another thread.
  * @param _TCP a pointer to the TCP server struct
  * @return bool TRUE 1 is success or FALSE 0 if failed.
  */
 bool TCP_StopServer(TCP_S_t* _TCP);
 
+/**
+ * @brief low latency mode. after any activity the loop keeps checking its sockets without sleeping, for up to _spinUS.
+ * a burst is served without a sleep and wakeup for every message, and an idle server sleeps as usual.
+ * spinning takes the CPU from others for the time of the budget, on a shared core the client may be the one slowed.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _spinUS microseconds to poll after the last activity. 0 to always sleep (the default).
+ * @param _kernelPollUS SO_BUSY_POLL and SO_PREFER_BUSY_POLL for the connections accepted from now on, so the kernel too
+ * polls the device instead of waiting for its interrupt. 0 to leave the system setting. over net.core.busy_read it needs CAP_NET_ADMIN.
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerSetBusyPoll(TCP_S_t* _TCP, uint _spinUS, uint _kernelPollUS);
+
+/**
+ * @brief how the loop waited so far. m_pollHits against m_sleeps is how much of the traffic spinning caught.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _stats out
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerPollStats(TCP_S_t* _TCP, TCP_PollStats_t* _stats);
+
+/**
+ * @brief ask the kernel to stamp the packets of the connections accepted from now on as they arrive (SO_TIMESTAMPING,
+ * software receive), and read the stamps with every read. each message then has its delay, the time it sat in the kernel
+ * and in the loop before the user function got it, apart from the time the user function itself takes.
+ * a read of several packets carries the stamp of the newest, so a message that spanned packets waited at least its delay.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _isEnabled TRUE to stamp, FALSE to stop
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerSetRxTimestamps(TCP_S_t* _TCP, bool _isEnabled);
+
+/**
+ * @brief the delay of the message being handled, from its arrival in the kernel. valid only inside the _reciveDataFunc.
+ * @param _TCP pointer to the struct
+ * @return nano seconds. 0 when not stamped.
+ */
+uint64_t TCP_GetRxDelayNS(TCP_S_t* _TCP);
+
+/**
+ * @brief the delays of all the stamped messages so far.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _stats out
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerRxDelayStats(TCP_S_t* _TCP, TCP_RxDelayStats_t* _stats);
+
+
+/**
+ * @brief cap the memory the connections hold: their state and list nodes, partial frames and queued messages, which are
+ * held only while there is something in them, so an idle connection holds m_idleConnection bytes.
+ * over the budget new connections are refused, and the connections holding the most are closed, slow readers with
+ * long queues first, until the server is back under it. both are reported to the error function as OVER_MEMORY_BUDGET.
+ * the budget is of this loop only, a group divides its budget between its loops.
+ * it counts what the connections hold now, not the memory of the process: the buffers come from the pool of the thread
+ * (tcp_buffer.h), which keeps its slabs for reuse, so the process stays at the most the connections ever held.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _bytes the budget. 0 for none.
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerSetMemoryBudget(TCP_S_t* _TCP, size_t _bytes);
+
+/**
+ * @brief the memory of the connections now. m_largest is found by going over all of them.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _stats out
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerMemoryStats(TCP_S_t* _TCP, TCP_MemoryStats_t* _stats);
+
+/**
+ * @brief stop reading a connection whose queue of unsent messages (the answers its peer does not read) reaches
+ * _highBytes, and read it again when the queue is down to _lowBytes. meanwhile its kernel buffer fills, and TCP holds
+ * its peer back, so a peer sending faster than it reads does not make the server keep its answers.
+ * on top of TCP_PauseRead, a connection is read only when neither paused it.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _highBytes the queue that pauses reading. 0 to disable.
+ * @param _lowBytes the queue that resumes it. up to _highBytes.
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerSetReadPause(TCP_S_t* _TCP, uint _highBytes, uint _lowBytes);
+
+/**
+ * @brief the paused connections now, found by going over all of them.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _stats out
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerFlowStats(TCP_S_t* _TCP, TCP_FlowStats_t* _stats);
+
+/**
+ * @brief Enable TCP Fast Open on the listening socket, so a returning client can send its first request inside the SYN.
+ * the host must allow it too (bit 2 of net.ipv4.tcp_fastopen).
+ * @param _TCP a pointer to the TCP server struct
+ * @param _queueLength max number of fast open connections not yet accepted. 0 to disable.
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerSetFastOpen(TCP_S_t* _TCP, uint _queueLength);
+
+/**
+ * @brief record every message received from now on, before the user function gets it. see tcp_capture.h.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _capture created by the user, who destroys it after the server. NULL to stop recording.
+ * @return bool TRUE 1 is success or FALSE 0 if failed.
+ */
+bool TCP_ServerSetCapture(TCP_S_t* _TCP, TCP_Capture_t* _capture);
+
+/**
+ * @brief proxy mode. every connection accepted from now on is paired with a new connection to _upstream, and the bytes
+ * of the two are moved between them by the loop with splice, without reaching user space (see tcp_relay.h).
+ * the user function is not called for their data, the connect and disconnect functions are. framing, shared memory
+ * and compression do not apply to them. a connection the upstream refuses is closed.
+ * @param _TCP a pointer to the TCP server struct
+ * @param _upstream "host:port", "[v6]:port" or "unix:/path" (tcp_address.h). NULL to stop.
+ * @return bool TRUE 1 is success or FALSE 0 if failed (bad address).
+ */
+bool TCP_ServerSetProxy(TCP_S_t* _TCP, const char* _upstream);
+
+/**
+ * @brief bytes the proxy connections delivered so far, both directions.
+ * @param _TCP a pointer to the TCP server struct
+ * @return the bytes. 0 if failed.
+ */
+unsigned long TCP_ServerProxyBytes(TCP_S_t* _TCP);
 
 /**
  * @brief Function to send data (back?) to a client.
+ * may be called from any thread. on the thread of the loop the connection belongs to (its user functions and timers) it
+ * sends at once. another thread hands a copy to the loop, which sends it on its next round, in order with the others of
+ * that thread. it is dropped if the connection closed by then. the same for every send below.
  * @param _socketNum a number representing the client the information would be send to.
  * @param _msg the data to be send. up to BUFFER_MAX_SIZE bytes.
  * @param _msgLength the data send size.
@@ -86,6 +281,41 @@ bool TCP_StopServer(TCP_S_t* _TCP);
  */
 int TCP_Send(uint _socketNum, void* _msg, uint _msgLength);
 
+/**
+ * @brief attach a user pointer to a connection, usually in the _newClientConnected function. it is given to every user function
+ * of the connection, the _clientDissconected one included, so per connection state needs no lookup by socket number.
+ * @param _socketNum a number representing the client
+ * @param _connContex the pointer. the server does not own it, free it in the _clientDissconected function if needed.
+ * @return TRUE if success or FALSE if there is no such connection.
+ */
+bool TCP_SetConnectionContext(uint _socketNum, void* _connContex);
+
+/**
+ * @brief get what was attached to a connection with TCP_SetConnectionContext.
+ * @param _socketNum a number representing the client
+ * @return the pointer. NULL if none was attached or there is no such connection.
+ */
+void* TCP_GetConnectionContext(uint _socketNum);
+
+/**
+ * @brief stop reading from a connection, as when whatever handles its messages is behind. nothing more is read from
+ * it, so its kernel buffer fills and TCP holds its peer back. messages already read are still handed to the user function.
+ * its answers are still sent. while paused, a close by the peer is found only after TCP_ResumeRead.
+ * may be called from any thread while the server exists. on the loop thread it takes effect at once, from another thread
+ * on the next round of the loop, and it is dropped if the connection is closed by then, even when a new one got its number.
+ * not for the connections of a proxy (TCP_ServerSetProxy), they pace themselves.
+ * @param _socketNum a number representing the client
+ * @return TRUE if success or FALSE if there is no such connection, or it is a proxy one (loop thread only).
+ */
+bool TCP_PauseRead(uint _socketNum);
+
+/**
+ * @brief read from a connection paused by TCP_PauseRead again. may be called from any thread, as TCP_PauseRead. the loop wakes for it.
+ * @param _socketNum a number representing the client
+ * @return TRUE if success or FALSE if there is no such connection.
+ */
+bool TCP_ResumeRead(uint _socketNum);
+
 /**
  * @brief Function to invoke data read from clients without looping. just a singal read.
  * @param _socketNum a number representing the client the information would be read from.
@@ -95,10 +325,112 @@ int TCP_Send(uint _socketNum, void* _msg, uint _msgLength);
  */
 int TCP_Recive(uint _socketNum, void* _buffer, uint _bufferMaxLength);
 
+/**
+ * @brief Switch the server to framed mode (see tcp_frame.h). must be called before TCP_RunServer.
+ * In framed mode the incoming bytes of each client are reassembled, and the _reciveDataFunc is invoked once per complete frame
+ * with the frame payload. the payload is binary, no sanity check is done on it and it is not null terminated.
+ * @param _TCP pointer to the struct
+ * @param _isFramed TRUE for framed mode, FALSE for the default raw mode.
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_ServerSetFraming(TCP_S_t* _TCP, bool _isFramed);
+
+/**
+ * @brief In framed mode, get the request ID of the frame being handled. valid only inside the _reciveDataFunc.
+ * @param _TCP pointer to the struct
+ * @return the request ID. 0 when not in framed mode.
+ */
+uint TCP_GetRequestID(TCP_S_t* _TCP);
+
+/**
+ * @brief In framed mode, get the RPC method the frame being handled calls (see tcp_rpc.h). valid only inside the _reciveDataFunc.
+ * @param _TCP pointer to the struct
+ * @return the method. 0 for a plain frame, and when not in framed mode.
+ */
+uint TCP_GetMethod(TCP_S_t* _TCP);
+
+/**
+ * @brief Send one frame to a client, with a header carring the request ID. header and payload are sent in one system call.
+ * from any thread, as TCP_Send.
+ * @param _socketNum a number representing the client the information would be send to.
+ * @param _requestID the ID of the request this frame respond to. usually from TCP_GetRequestID.
+ * @param _msg the payload. up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * @param _msgLength the payload size.
+ * @return positive number represent the number of bytes send, header included. negative number represent error.
+ */
+int TCP_SendFrame(uint _socketNum, uint _requestID, void* _msg, uint _msgLength);
+
+/**
+ * @brief Send a pooled buffer (tcp_buffer.h) as TCP_Send does, without a copy. never waits.
+ * What the socket does not take at once is queued with a hold on the buffer, and sent when the socket is writable.
+ * @param _socketNum a number representing the client the information would be send to.
+ * @param _data pointer inside a pooled buffer, such as the data given to the _reciveDataFunc. other memory is sent by TCP_Send.
+ * @param _dataLength the data send size.
+ * @return positive number represent the number of bytes sent or queued. negative number represent error.
+ */
+int TCP_SendBuffer(uint _socketNum, void* _data, uint _dataLength);
+
+/**
+ * @brief Send a pooled buffer as the payload of one frame, as TCP_SendBuffer does.
+ * Clients that agreed to compression get it through TCP_SendFrame, which makes its own copy.
+ * @param _socketNum a number representing the client the information would be send to.
+ * @param _requestID the ID of the request this frame respond to.
+ * @param _data pointer inside a pooled buffer. up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * @param _dataLength the payload size.
+ * @return positive number represent the number of bytes sent or queued, header included. negative number represent error.
+ */
+int TCP_SendFrameBuffer(uint _socketNum, uint _requestID, void* _data, uint _dataLength);
+
+/**
+ * @brief Let clients on this host move to shared memory rings (see tcp_shm.h and TCP_ClientUseSharedMemory). must be called before TCP_RunServer.
+ * Such a client keeps its socket number, and TCP_Send / TCP_SendFrame to it write to its ring. they never wait for room,
+ * a full ring fails the send with 0. messages from the client are up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * When disabled, a client asking for shared memory is refused and stays on the socket.
+ * @param _TCP pointer to the struct
+ * @param _isEnabled TRUE to accept shared memory clients.
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_ServerSetSharedMemory(TCP_S_t* _TCP, bool _isEnabled);
+
+/**
+ * @brief In framed mode, agree to compress with the clients that offer it (see tcp_compress.h and TCP_PipelineSetCompression).
+ * Compressed frames are decompressed before the _reciveDataFunc, and TCP_SendFrame compresses for such clients. must be called before TCP_RunServer.
+ * @param _TCP pointer to the struct
+ * @param _isEnabled TRUE to agree, FALSE to answer every offer with no compression.
+ * @param _dict dictionary to use with clients that have the same one. can be NULL. must live as long as the server.
+ * @param _threshold smaller responses are not compressed. TCP_COMPRESS_DEFAULT_THRESHOLD is a good start.
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_ServerSetCompression(TCP_S_t* _TCP, bool _isEnabled, const TCP_Dict_t* _dict, uint _threshold);
+
+/**
+ * @brief add a timer that fires on the server thread, between reads, so it may use TCP_Send like any user function.
+ * the server waits no longer than the nearest timer. can be called before TCP_RunServer or from any user function.
+ * @param _TCP pointer to the struct
+ * @param _delayMS first time it fires, from now
+ * @param _periodMS fires again every _periodMS after, until canceled or its function returns FALSE. 0 for a one-shot timer.
+ * @param _func user function to invoke
+ * @param _contex passed to the function
+ * @return the timer ID, 0 if failed.
+ */
+uint TCP_AddTimer(TCP_S_t* _TCP, uint _delayMS, uint _periodMS, timerFunc _func, void* _contex);
+
+/**
+ * @brief cancel a timer. safe inside any user function, a timer function of its own included.
+ * @param _TCP pointer to the struct
+ * @param _timerID as returned by TCP_AddTimer
+ * @return TRUE if canceled or FALSE if there is no such timer (fired already, or canceled).
+ */
+bool TCP_CancelTimer(TCP_S_t* _TCP, uint _timerID);
+
+
 
 
 
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* TCP_H_ */
 
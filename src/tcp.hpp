@@ -0,0 +1,233 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief C++ face of the server, with the handler, the framing and the validation picked at compile time:
+ *
+ *     struct Echo
+ *     {
+ *         void operator()(tcp::session<tcp::framed>& _session, std::string_view _msg) { _session.send_back(_msg); }
+ *     };
+ *
+ *     tcp::server<Echo, tcp::framed, tcp::max_size<4096> > server(4848);
+ *     server.run();
+ *
+ * The loop calls one function generated for these types. It calls the validator and the handler directly, so the
+ * compiler sees through both and inlines them. There is no std::function, no virtual call and no cast in user code.
+ * Messages come as std::string_view, bytes to send as std::string_view or std::span.
+ *
+ * A handler may also have on_connect(session&) and on_close(uint socket, void* context). They are registered only
+ * when present. State of its own for a connection is attached with session::set_context, in on_connect.
+ * A message the validator refuses closes its connection, without reaching the handler.
+ *
+ * The loop itself is the C server of tcp.h, the C API is unchanged.
+ *
+ * @bug a server is not movable, the loop keeps its address.
+ */
+
+#ifndef TCP_HPP_
+#define TCP_HPP_
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <utility>
+
+/* the C headers name their int "bool". keep the exact C types, and give the name back to C++ after.
+ * the internal one has a flexible array member, which C++ has as an extension only */
+#define bool tcp_c_bool_t
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include "tcp.h"
+#include "tcp_internal.h"
+#include "tcp_client_loop.h"
+#pragma GCC diagnostic pop
+#undef bool
+
+namespace tcp
+{
+
+/* ~~~ Framing policies ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* a byte stream. a message is what one read got */
+struct raw
+{
+	static constexpr bool is_framed = false;
+
+	static int send(uint _socketNum, uint, const void* _data, std::size_t _size)
+	{
+		return TCP_Send(_socketNum, const_cast<void*>(_data), _size);
+	}
+	static int send_buffer(uint _socketNum, uint, const void* _data, std::size_t _size)
+	{
+		return TCP_SendBuffer(_socketNum, const_cast<void*>(_data), _size);
+	}
+};
+
+/* length prefixed frames (tcp_frame.h). a message is one frame, a send answers it with the same request ID */
+struct framed
+{
+	static constexpr bool is_framed = true;
+
+	static int send(uint _socketNum, uint _requestID, const void* _data, std::size_t _size)
+	{
+		return TCP_SendFrame(_socketNum, _requestID, const_cast<void*>(_data), _size);
+	}
+	static int send_buffer(uint _socketNum, uint _requestID, const void* _data, std::size_t _size)
+	{
+		return TCP_SendFrameBuffer(_socketNum, _requestID, const_cast<void*>(_data), _size);
+	}
+};
+
+/* ~~~ Validation policies ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* every message goes to the handler */
+struct accept_all
+{
+	constexpr bool operator()(std::string_view) const { return true; }
+};
+
+/* messages longer than Max bytes close the connection */
+template <std::size_t Max>
+struct max_size
+{
+	constexpr bool operator()(std::string_view _msg) const { return _msg.size() <= Max; }
+};
+
+/* ~~~ Session ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief the connection a message came from, for the time of the handler call.
+ */
+template <class Framing>
+class session
+{
+public:
+	session(TCP_S_t* _TCP, uint _socketNum, uint _requestID, void* _context)
+		: m_TCP(_TCP), m_socketNum(_socketNum), m_requestID(_requestID), m_context(_context) {}
+
+	/**
+	 * @brief send bytes. in framed mode a frame answering the message.
+	 * @return positive number of bytes sent or queued. negative number represent error.
+	 */
+	int send(std::string_view _data) const { return Framing::send(m_socketNum, m_requestID, _data.data(), _data.size() ); }
+	int send(std::span<const std::byte> _data) const { return Framing::send(m_socketNum, m_requestID, _data.data(), _data.size() ); }
+
+	/**
+	 * @brief send back (part of) the message given to the handler. it is queued as it is, without a copy.
+	 * @return as send
+	 */
+	int send_back(std::string_view _received) const
+	{
+		return Framing::send_buffer(m_socketNum, m_requestID, _received.data(), _received.size() );
+	}
+
+	/* closed after the handler returns */
+	void close() const { TCP_ServerCloseLater(m_TCP, m_socketNum); }
+
+	/* what the handler attached to the connection. see TCP_SetConnectionContext */
+	void* context() const { return m_context; }
+	template <class T>
+	T* context_as() const { return static_cast<T*>(m_context); }
+	void set_context(void* _context)
+	{
+		m_context = _context;
+		TCP_SetConnectionContext(m_socketNum, _context);
+	}
+
+	uint socket() const { return m_socketNum; }
+	uint request_id() const { return m_requestID; }
+
+private:
+	TCP_S_t* m_TCP;
+	uint m_socketNum;
+	uint m_requestID;
+	void* m_context;
+};
+
+/* ~~~ Server ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+template <class Handler, class Framing = raw, class Validator = accept_all>
+class server
+{
+public:
+	using session_type = session<Framing>;
+
+	/**
+	 * @brief Create the server. see TCP_CreateServer. check it with operator bool.
+	 */
+	explicit server(uint _port, Handler _handler = Handler(), Validator _validator = Validator(),
+					uint _maxConnections = MAX_CLIENTS_NUM, uint _timeoutMS = 300000)
+		: m_handler(std::move(_handler) ), m_validator(std::move(_validator) )
+	{
+		m_TCP = TCP_CreateServer(_port, nullptr, _maxConnections, _timeoutMS, on_data,
+								HAS_CONNECT ? on_connect : nullptr, HAS_CLOSE ? on_close : nullptr, nullptr, this);
+		if (m_TCP && ! TCP_ServerSetFraming(m_TCP, Framing::is_framed) )
+		{
+			TCP_DestroyServer(m_TCP);
+			m_TCP = nullptr;
+		}
+	}
+
+	~server() { TCP_DestroyServer(m_TCP); }
+
+	server(const server&) = delete;
+	server& operator=(const server&) = delete;
+
+	explicit operator bool() const { return m_TCP != nullptr; }
+
+	bool run() { return TCP_RunServer(m_TCP); }
+	bool stop() { return TCP_StopServer(m_TCP); }
+
+	Handler& handler() { return m_handler; }
+	/* for the settings of the C API */
+	TCP_S_t* native() { return m_TCP; }
+
+private:
+	static constexpr bool HAS_CONNECT = requires(Handler& _handler, session_type& _session) { _handler.on_connect(_session); };
+	static constexpr bool HAS_CLOSE = requires(Handler& _handler, uint _socketNum, void* _context) { _handler.on_close(_socketNum, _context); };
+
+	static int on_data(void* _data, size_t _sizeData, uint _socketNum, void* _contex, void* _connContex)
+	{
+		server* self = static_cast<server*>(_contex);
+		std::string_view msg(static_cast<const char*>(_data), _sizeData);
+		session_type session(self->m_TCP, _socketNum, Framing::is_framed ? TCP_GetRequestID(self->m_TCP) : 0, _connContex);
+
+		if (! self->m_validator(msg) )
+		{
+			session.close();
+			return FALSE;
+		}
+		self->m_handler(session, msg);
+		return TRUE;
+	}
+
+	static int on_connect(uint _socketNum, void* _contex, void* _connContex)
+	{
+		if constexpr (HAS_CONNECT)
+		{
+			server* self = static_cast<server*>(_contex);
+			session_type session(self->m_TCP, _socketNum, 0, _connContex);
+
+			self->m_handler.on_connect(session);
+		}
+		return TRUE;
+	}
+
+	static int on_close(uint _socketNum, void* _contex, void* _connContex)
+	{
+		if constexpr (HAS_CLOSE)
+		{
+			static_cast<server*>(_contex)->m_handler.on_close(_socketNum, _connContex);
+		}
+		return TRUE;
+	}
+
+	TCP_S_t* m_TCP = nullptr;
+	Handler m_handler;
+	Validator m_validator;
+};
+
+} // namespace tcp
+
+#endif /* TCP_HPP_ */
@@ -0,0 +1,126 @@
+/*
+ * tcp_address.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "tcp_address.h"
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool TCP_ParseAddress(const char* _address, uint _port, struct sockaddr_storage* _sockAddr, socklen_t* _sockAddrLength)
+{
+	struct sockaddr_in* sIn = (struct sockaddr_in*) _sockAddr;
+	struct sockaddr_in6* sIn6 = (struct sockaddr_in6*) _sockAddr;
+	struct sockaddr_un* sUn = (struct sockaddr_un*) _sockAddr;
+	char host[TCP_ADDRESS_MAX_LENGTH];
+	size_t length;
+
+	if (NULL == _address || NULL == _sockAddr || NULL == _sockAddrLength)
+	{
+		return FALSE;
+	}
+
+	memset(_sockAddr, 0, sizeof(*_sockAddr) );
+
+	if (strncmp(_address, TCP_UNIX_PREFIX, sizeof(TCP_UNIX_PREFIX) - 1) == 0)
+	{
+		_address += sizeof(TCP_UNIX_PREFIX) - 1;
+		if (strlen(_address) == 0 || strlen(_address) >= sizeof(sUn->sun_path) )
+		{
+			return FALSE;
+		}
+
+		sUn->sun_family = AF_UNIX;
+		strcpy(sUn->sun_path, _address);
+		*_sockAddrLength = sizeof(struct sockaddr_un);
+		return TRUE;
+	}
+
+	if (_address[0] == '\0' || strcmp(_address, "*") == 0)
+	{
+		sIn->sin_family = AF_INET;
+		sIn->sin_addr.s_addr = INADDR_ANY;
+		sIn->sin_port = htons(_port);
+		*_sockAddrLength = sizeof(struct sockaddr_in);
+		return TRUE;
+	}
+
+	/* IPv6 may come in brackets, as it does inside an endpoint */
+	length = strlen(_address);
+	if (length >= sizeof(host) )
+	{
+		return FALSE;
+	}
+	if (_address[0] == '[' && _address[length - 1] == ']')
+	{
+		memcpy(host, _address + 1, length - 2);
+		host[length - 2] = '\0';
+	}
+	else
+	{
+		strcpy(host, _address);
+	}
+
+	if (inet_pton(AF_INET, host, &sIn->sin_addr) == 1)
+	{
+		sIn->sin_family = AF_INET;
+		sIn->sin_port = htons(_port);
+		*_sockAddrLength = sizeof(struct sockaddr_in);
+		return TRUE;
+	}
+
+	memset(_sockAddr, 0, sizeof(*_sockAddr) );
+	if (inet_pton(AF_INET6, host, &sIn6->sin6_addr) == 1)
+	{
+		sIn6->sin6_family = AF_INET6;
+		sIn6->sin6_port = htons(_port);
+		*_sockAddrLength = sizeof(struct sockaddr_in6);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+bool TCP_ParseEndpoint(const char* _endpoint, struct sockaddr_storage* _sockAddr, socklen_t* _sockAddrLength)
+{
+	char address[TCP_ADDRESS_MAX_LENGTH];
+	const char* portStart;
+	char* end;
+	long port;
+
+	if (NULL == _endpoint)
+	{
+		return FALSE;
+	}
+
+	if (strncmp(_endpoint, TCP_UNIX_PREFIX, sizeof(TCP_UNIX_PREFIX) - 1) == 0)
+	{
+		return TCP_ParseAddress(_endpoint, 0, _sockAddr, _sockAddrLength);
+	}
+
+	/* the port is after the last colon, IPv6 colons are inside the brackets */
+	portStart = strrchr(_endpoint, ':');
+	if (NULL == portStart || (size_t) (portStart - _endpoint) >= sizeof(address) )
+	{
+		return FALSE;
+	}
+
+	port = strtol(portStart + 1, &end, 10);
+	if (*end != '\0' || end == portStart + 1 || port < 0 || port > 65535)
+	{
+		return FALSE;
+	}
+
+	memcpy(address, _endpoint, portStart - _endpoint);
+	address[portStart - _endpoint] = '\0';
+
+	return TCP_ParseAddress(address, (uint) port, _sockAddr, _sockAddrLength);
+}
@@ -0,0 +1,53 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Address parsing shared by the server listeners and the clients.
+ * An address is one of:
+ *   "unix:/path/to/socket"  a Unix domain stream socket. the port is ignored.
+ *   "::1" or "[::1]"         an IPv6 address.
+ *   "127.0.0.1"              an IPv4 address.
+ *   "" or "*"               any local IPv4 address (servers only).
+ * An endpoint is an address and a port in one string: "127.0.0.1:4848", "[::]:4848", "*:4848", "unix:/tmp/server.sock".
+ *
+ * @bug
+ */
+
+#ifndef TCP_ADDRESS_H_
+#define TCP_ADDRESS_H_
+
+#include <sys/socket.h>
+
+typedef unsigned int uint;
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define TCP_UNIX_PREFIX "unix:"
+/* long enough for a Unix socket path with its prefix */
+#define TCP_ADDRESS_MAX_LENGTH 128
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief build a socket address from an address string and a port.
+ * @param _address the address, see above.
+ * @param _port the port. ignored for Unix sockets.
+ * @param _sockAddr output.
+ * @param _sockAddrLength output. the length to pass to bind / connect.
+ * @return TRUE if success or FALSE if the address could not be parsed.
+ */
+bool TCP_ParseAddress(const char* _address, uint _port, struct sockaddr_storage* _sockAddr, socklen_t* _sockAddrLength);
+
+/**
+ * @brief build a socket address from an endpoint string.
+ * @param _endpoint the endpoint, see above.
+ * @param _sockAddr output.
+ * @param _sockAddrLength output. the length to pass to bind / connect.
+ * @return TRUE if success or FALSE if the endpoint could not be parsed.
+ */
+bool TCP_ParseEndpoint(const char* _endpoint, struct sockaddr_storage* _sockAddr, socklen_t* _sockAddrLength);
+
+#endif /* TCP_ADDRESS_H_ */
@@ -0,0 +1,374 @@
+/*
+ * tcp_buffer.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#define _GNU_SOURCE /* MAP_HUGETLB, MAP_ANONYMOUS */
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "tcp_buffer.h"
+#include "tcp_internal.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define SLAB_MAGIC_NUMBER 0xfeedface
+
+/* blocks start after it, aligned for any data */
+#define SLAB_HEADER_SIZE 64
+#define BLOCK_HEADER_SIZE 16
+
+#define CLASSES_NUM 7
+
+#define SLAB_BASE(ptr) ((uintptr_t) (ptr) & ~((uintptr_t) TCP_BUFFER_SLAB_SIZE - 1))
+
+/* the map of the slabs. a bit for every slab sized piece of the user address space (47 bits, and one more to spare),
+ * in leaves of 8K bits made on first use */
+#define SLAB_SHIFT 21 /* log2 of TCP_BUFFER_SLAB_SIZE */
+#define ADDRESS_BITS 48
+#define LEAF_BITS 13
+#define LEAVES_NUM (1 << (ADDRESS_BITS - SLAB_SHIFT - LEAF_BITS) )
+#define LEAF_WORDS ((1 << LEAF_BITS) / 64)
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Block
+{
+	uint m_refCount; /* 0 while in a free list. changed atomically, any thread may hold the buffer */
+	uint m_class;
+	struct Block* m_next; /* in a free list */
+} Block_t;
+
+typedef struct SizeClass
+{
+	Block_t* m_free;
+	struct Slab* m_slab; /* still has blocks that were never carved */
+} SizeClass_t;
+
+/* the pool of one thread. blocks freed on other threads come back to it through m_returned */
+typedef struct Pool
+{
+	SizeClass_t m_classes[CLASSES_NUM];
+	Block_t* m_returned; /* pushed by the other threads, taken whole by the owner */
+} Pool_t;
+
+typedef struct Slab
+{
+	uint m_magicNumber;
+	uint m_class;
+	uint m_blockSize; /* header included */
+	uint m_carved; /* blocks handed out at least once. the rest of the slab was never touched */
+	uint m_blocksNum;
+	Pool_t* m_owner; /* of the thread that made it, where its blocks go back */
+} Slab_t;
+
+/* ~~~ Global ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* data sizes. a frame header, a raw read, pages, frame reads, and up to a full frame */
+static const uint g_classSizes[CLASSES_NUM] = {
+	64, 1024, 4096, 16384, 65536, 262144, TCP_BUFFER_MAX_SIZE
+};
+
+/* a pool per thread, so the loops of a group (tcp_group.h) never share one. made on first use, and never freed,
+ * as other threads may still give its blocks back */
+static __thread Pool_t* g_pool = NULL;
+
+/* every slab of every thread, so a pointer can be told to be pooled without touching memory that may not be mapped.
+ * leaves are added with a compare and swap and bits are only set, so it is read without a lock */
+static uint64_t* g_slabMap[LEAVES_NUM];
+
+static bool g_isHugePages = FALSE;
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static Pool_t* ThisPool(void);
+static void TakeReturned(Pool_t* _pool);
+static void GiveBack(Block_t* _block);
+static Block_t* FindBlock(const void* _data);
+static Slab_t* CreateSlab(Pool_t* _pool, uint _class);
+static void* MapSlab(void);
+static bool RegisterSlab(Slab_t* _slab);
+static bool IsSlab(uintptr_t _base);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void TCP_BufferUseHugePages(bool _isEnabled)
+{
+	g_isHugePages = _isEnabled;
+}
+
+void* TCP_BufferAlloc(uint _size)
+{
+	SizeClass_t* sizeClass;
+	Block_t* block;
+	Slab_t* slab;
+	Pool_t* pool;
+	uint class = 0;
+
+	while (class < CLASSES_NUM && g_classSizes[class] < _size)
+	{
+		++class;
+	}
+	pool = ThisPool();
+	if (class == CLASSES_NUM || ! pool)
+	{
+		return NULL;
+	}
+	sizeClass = &pool->m_classes[class];
+
+	if (! sizeClass->m_free && __atomic_load_n(&pool->m_returned, __ATOMIC_RELAXED) )
+	{
+		TakeReturned(pool);
+	}
+
+	if (sizeClass->m_free)
+	{
+		block = sizeClass->m_free;
+		sizeClass->m_free = block->m_next;
+	}
+	else
+	{
+		slab = sizeClass->m_slab;
+		if (! slab || slab->m_carved == slab->m_blocksNum)
+		{
+			slab = CreateSlab(pool, class);
+			if (! slab)
+			{
+				return NULL;
+			}
+			sizeClass->m_slab = slab;
+		}
+		block = (Block_t*) ((unsigned char*) slab + SLAB_HEADER_SIZE + slab->m_carved * slab->m_blockSize);
+		__atomic_store_n(&slab->m_carved, slab->m_carved + 1, __ATOMIC_RELEASE); /* read by FindBlock on any thread */
+		block->m_class = class;
+	}
+
+	block->m_refCount = 1;
+	block->m_next = NULL;
+	return (unsigned char*) block + BLOCK_HEADER_SIZE;
+}
+
+bool TCP_BufferRetain(const void* _data)
+{
+	Block_t* block = FindBlock(_data);
+	if (! block)
+	{
+		return FALSE;
+	}
+
+	__atomic_add_fetch(&block->m_refCount, 1, __ATOMIC_RELAXED);
+	return TRUE;
+}
+
+void TCP_BufferRelease(const void* _data)
+{
+	Block_t* block = FindBlock(_data);
+	if (! block)
+	{
+		return;
+	}
+
+	/* the last hold sees the writes of all the others before it gives the block back */
+	if (__atomic_sub_fetch(&block->m_refCount, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		GiveBack(block);
+	}
+}
+
+uint TCP_BufferCapacity(const void* _data)
+{
+	Block_t* block = FindBlock(_data);
+
+	return block ? g_classSizes[block->m_class] : 0;
+}
+
+bool TCP_BufferIsShared(const void* _data)
+{
+	Block_t* block = FindBlock(_data);
+
+	return block && __atomic_load_n(&block->m_refCount, __ATOMIC_ACQUIRE) > 1;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static Pool_t* ThisPool(void)
+{
+	if (! g_pool)
+	{
+		g_pool = calloc(1, sizeof(Pool_t) );
+	}
+	return g_pool;
+}
+
+/* the blocks other threads gave back, to the free lists of their classes */
+static void TakeReturned(Pool_t* _pool)
+{
+	Block_t* block = __atomic_exchange_n(&_pool->m_returned, NULL, __ATOMIC_ACQUIRE);
+	Block_t* next;
+
+	for ( ; block; block = next)
+	{
+		next = block->m_next;
+		block->m_next = _pool->m_classes[block->m_class].m_free;
+		_pool->m_classes[block->m_class].m_free = block;
+	}
+}
+
+/* to the pool of the thread that made its slab. the owner takes the whole list at once, so pushing needs no more than
+ * a compare and swap */
+static void GiveBack(Block_t* _block)
+{
+	Pool_t* owner = ((Slab_t*) SLAB_BASE(_block))->m_owner;
+	Block_t* head;
+
+	if (owner == g_pool)
+	{
+		_block->m_next = owner->m_classes[_block->m_class].m_free;
+		owner->m_classes[_block->m_class].m_free = _block;
+		return;
+	}
+
+	head = __atomic_load_n(&owner->m_returned, __ATOMIC_RELAXED);
+	do
+	{
+		_block->m_next = head;
+	}
+	while (! __atomic_compare_exchange_n(&owner->m_returned, &head, _block, TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED) );
+}
+
+/* NULL if not inside a handed out block. a look in the map of the slabs, and the headers */
+static Block_t* FindBlock(const void* _data)
+{
+	uintptr_t base = SLAB_BASE(_data);
+	Slab_t* slab;
+	Block_t* block;
+	uint index;
+
+	if (NULL == _data || ! IsSlab(base) )
+	{
+		return NULL;
+	}
+
+	slab = (Slab_t*) base;
+	if (slab->m_magicNumber != SLAB_MAGIC_NUMBER || (uintptr_t) _data < base + SLAB_HEADER_SIZE + BLOCK_HEADER_SIZE)
+	{
+		return NULL;
+	}
+	index = ((uintptr_t) _data - base - SLAB_HEADER_SIZE) / slab->m_blockSize;
+	if (index >= __atomic_load_n(&slab->m_carved, __ATOMIC_ACQUIRE) )
+	{
+		return NULL;
+	}
+	block = (Block_t*) (base + SLAB_HEADER_SIZE + index * slab->m_blockSize);
+
+	if ((unsigned char*) _data < (unsigned char*) block + BLOCK_HEADER_SIZE || 0 == __atomic_load_n(&block->m_refCount, __ATOMIC_RELAXED) )
+	{
+		/* a block header, or a buffer that was given back */
+		return NULL;
+	}
+	return block;
+}
+
+static Slab_t* CreateSlab(Pool_t* _pool, uint _class)
+{
+	Slab_t* slab = MapSlab();
+	if (! slab)
+	{
+		return NULL;
+	}
+
+	slab->m_magicNumber = SLAB_MAGIC_NUMBER;
+	slab->m_class = _class;
+	slab->m_blockSize = BLOCK_HEADER_SIZE + g_classSizes[_class];
+	slab->m_carved = 0;
+	slab->m_blocksNum = (TCP_BUFFER_SLAB_SIZE - SLAB_HEADER_SIZE) / slab->m_blockSize;
+	slab->m_owner = _pool;
+
+	if (! RegisterSlab(slab) )
+	{
+		munmap(slab, TCP_BUFFER_SLAB_SIZE);
+		return NULL;
+	}
+	return slab;
+}
+
+/* a slab aligned to its size, so a block is found from any pointer inside it */
+static void* MapSlab(void)
+{
+	unsigned char* mapped;
+	uintptr_t aligned;
+
+	if (g_isHugePages)
+	{
+		/* huge pages come aligned */
+		mapped = mmap(NULL, TCP_BUFFER_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (mapped != MAP_FAILED)
+		{
+			return mapped;
+		}
+		/* none reserved. normal pages still work */
+	}
+
+	mapped = mmap(NULL, 2 * TCP_BUFFER_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapped == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	/* trim to an aligned slab */
+	aligned = SLAB_BASE(mapped + TCP_BUFFER_SLAB_SIZE - 1);
+	if (aligned > (uintptr_t) mapped)
+	{
+		munmap(mapped, aligned - (uintptr_t) mapped);
+	}
+	munmap((unsigned char*) aligned + TCP_BUFFER_SLAB_SIZE, (uintptr_t) mapped + TCP_BUFFER_SLAB_SIZE - aligned);
+
+	return (void*) aligned;
+}
+
+static bool RegisterSlab(Slab_t* _slab)
+{
+	uintptr_t index = (uintptr_t) _slab >> SLAB_SHIFT;
+	uint64_t* leaf;
+	uint64_t* expected = NULL;
+
+	if ((index >> LEAF_BITS) >= LEAVES_NUM)
+	{
+		return FALSE;
+	}
+
+	leaf = __atomic_load_n(&g_slabMap[index >> LEAF_BITS], __ATOMIC_ACQUIRE);
+	if (! leaf)
+	{
+		leaf = calloc(LEAF_WORDS, sizeof(uint64_t) );
+		if (! leaf)
+		{
+			return FALSE;
+		}
+		if (! __atomic_compare_exchange_n(&g_slabMap[index >> LEAF_BITS], &expected, leaf, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) )
+		{
+			/* another thread made it first */
+			free(leaf);
+			leaf = expected;
+		}
+	}
+
+	__atomic_fetch_or(&leaf[(index & ((1 << LEAF_BITS) - 1)) / 64], (uint64_t) 1 << (index % 64), __ATOMIC_RELEASE);
+	return TRUE;
+}
+
+static bool IsSlab(uintptr_t _base)
+{
+	uintptr_t index = _base >> SLAB_SHIFT;
+	uint64_t* leaf;
+
+	if ((index >> LEAF_BITS) >= LEAVES_NUM)
+	{
+		return FALSE;
+	}
+	leaf = __atomic_load_n(&g_slabMap[index >> LEAF_BITS], __ATOMIC_ACQUIRE);
+	return leaf && (__atomic_load_n(&leaf[(index & ((1 << LEAF_BITS) - 1)) / 64], __ATOMIC_ACQUIRE) >> (index % 64) & 1);
+}
@@ -0,0 +1,81 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Pooled, reference counted message buffers.
+ * The server reads straight into these buffers and hands them to the user function as they are.
+ * A user function that wants the data after it returns takes a hold with TCP_BufferRetain instead of copying it,
+ * and may pass it to TCP_SendBuffer, which queues it without a copy when the socket is busy.
+ *
+ * Buffers come from 2MB slabs, one size class per slab, optionally backed by huge pages.
+ * Any pointer inside a buffer can be retained or released, so a frame in the middle of a read holds the whole read.
+ * It is found in constant time, through a map of the slabs and the header before each buffer.
+ * Each thread allocates from a pool of its own, without locks. Holds are atomic, so any thread may retain and release
+ * any buffer. The last release on another thread gives the buffer back to the pool it came from, through a list that
+ * its thread takes on its next allocation.
+ *
+ * @bug freed slabs are kept for reuse, never returned to the system. the pool of a thread that ended keeps its slabs.
+ */
+
+#ifndef TCP_BUFFER_H_
+#define TCP_BUFFER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* also the huge page size on x86 */
+#define TCP_BUFFER_SLAB_SIZE (1 << 21)
+
+/* the largest buffer, one per slab. holds a full frame with its header */
+#define TCP_BUFFER_MAX_SIZE (TCP_BUFFER_SLAB_SIZE - 128)
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief back new slabs with huge pages, if the system has them reserved. falls back to normal pages silently.
+ * @param _isEnabled TRUE to try huge pages
+ * @return void
+ */
+void TCP_BufferUseHugePages(bool _isEnabled);
+
+/**
+ * @brief get a buffer from the pool, held once by the caller.
+ * @param _size wanted size. rounded up to the size class.
+ * @return the buffer. NULL if failed or bigger than TCP_BUFFER_MAX_SIZE.
+ */
+void* TCP_BufferAlloc(uint _size);
+
+/**
+ * @brief take one more hold of a pooled buffer.
+ * @param _data any pointer inside the buffer, such as the data given to the user function.
+ * @return TRUE if success or FALSE if it is not a pooled buffer.
+ */
+bool TCP_BufferRetain(const void* _data);
+
+/**
+ * @brief drop one hold of a pooled buffer. the last one gives it back to the pool.
+ * @param _data any pointer inside the buffer
+ * @return void. silent fail.
+ */
+void TCP_BufferRelease(const void* _data);
+
+/**
+ * @brief get the usable size of a pooled buffer, from its start.
+ * @param _data any pointer inside the buffer
+ * @return the size, 0 if it is not a pooled buffer.
+ */
+uint TCP_BufferCapacity(const void* _data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCP_BUFFER_H_ */
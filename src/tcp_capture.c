@@ -0,0 +1,311 @@
+/*
+ * tcp_capture.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tcp_capture.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER 0xfadeface
+#define DEAD_MAGIC_NUMBER 0xdeadface
+
+#define FILE_MAGIC "TCPCAP01"
+#define FILE_VERSION 1
+
+#define ALIGN8(length) (((length) + 7) & ~((uint64_t) 7))
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct FileHeader
+{
+	char m_magic[8];
+	uint32_t m_version;
+	uint32_t m_reserved;
+} FileHeader_t;
+
+typedef struct RecordHeader
+{
+	uint64_t m_timeUS;
+	uint32_t m_socketNum;
+	uint32_t m_requestID;
+	uint32_t m_length;
+	uint32_t m_reserved;
+} RecordHeader_t;
+
+struct TCP_Capture
+{
+	uint m_magicNumber;
+	int m_fd;
+	unsigned char* m_window; /* TCP_CAPTURE_WINDOW_SIZE bytes of the file, from m_windowStart */
+	uint64_t m_windowStart;
+	uint64_t m_used; /* bytes of the file written */
+	uint64_t m_startUS;
+	unsigned long m_recordsNum;
+};
+
+struct TCP_CaptureReader
+{
+	uint m_magicNumber;
+	const unsigned char* m_file;
+	uint64_t m_size;
+	uint64_t m_offset; /* of the next record */
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool MapWindow(TCP_Capture_t* _capture, uint64_t _offset);
+static uint64_t NowUS(void);
+static bool IsStructValid(TCP_Capture_t* _capture);
+static bool IsReaderValid(TCP_CaptureReader_t* _reader);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Capture_t* TCP_CaptureCreate(const char* _path)
+{
+	TCP_Capture_t* aCapture;
+	FileHeader_t header;
+
+	if (NULL == _path)
+	{
+		return NULL;
+	}
+
+	aCapture = calloc(1, sizeof(TCP_Capture_t) );
+	if (! aCapture)
+	{
+		return NULL;
+	}
+
+	aCapture->m_fd = open(_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (aCapture->m_fd < 0)
+	{
+		perror("Capture open Failed");
+		free(aCapture);
+		return NULL;
+	}
+	aCapture->m_window = MAP_FAILED;
+	if (! MapWindow(aCapture, 0) )
+	{
+		close(aCapture->m_fd);
+		free(aCapture);
+		return NULL;
+	}
+
+	memset(&header, 0, sizeof(header) );
+	memcpy(header.m_magic, FILE_MAGIC, sizeof(header.m_magic) );
+	header.m_version = FILE_VERSION;
+	memcpy(aCapture->m_window, &header, sizeof(header) );
+	aCapture->m_used = sizeof(header);
+
+	aCapture->m_startUS = NowUS();
+	aCapture->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return aCapture;
+}
+
+void TCP_CaptureDestroy(TCP_Capture_t* _capture)
+{
+	if (! IsStructValid(_capture) )
+	{
+		return;
+	}
+
+	_capture->m_magicNumber = DEAD_MAGIC_NUMBER;
+	munmap(_capture->m_window, TCP_CAPTURE_WINDOW_SIZE);
+	/* the last window was reserved whole */
+	if (ftruncate(_capture->m_fd, _capture->m_used) < 0)
+	{
+		perror("Capture ftruncate Failed");
+	}
+	close(_capture->m_fd);
+	free(_capture);
+}
+
+bool TCP_CaptureWrite(TCP_Capture_t* _capture, uint _socketNum, uint _requestID, const void* _data, uint _length)
+{
+	RecordHeader_t header;
+	unsigned char* place;
+	uint64_t size;
+
+	if (! IsStructValid(_capture) || (NULL == _data && _length > 0) )
+	{
+		return FALSE;
+	}
+
+	if (_length > TCP_CAPTURE_MAX_RECORD)
+	{
+		_length = TCP_CAPTURE_MAX_RECORD;
+	}
+	size = ALIGN8(sizeof(header) + _length);
+	if (_capture->m_used + size > _capture->m_windowStart + TCP_CAPTURE_WINDOW_SIZE && ! MapWindow(_capture, _capture->m_used) )
+	{
+		return FALSE;
+	}
+
+	header.m_timeUS = NowUS() - _capture->m_startUS;
+	header.m_socketNum = _socketNum;
+	header.m_requestID = _requestID;
+	header.m_length = _length;
+	header.m_reserved = 0;
+
+	place = _capture->m_window + (_capture->m_used - _capture->m_windowStart);
+	memcpy(place, &header, sizeof(header) );
+	memcpy(place + sizeof(header), _data, _length);
+	_capture->m_used += size;
+	_capture->m_recordsNum++;
+	return TRUE;
+}
+
+unsigned long TCP_CaptureRecordsNum(TCP_Capture_t* _capture)
+{
+	return IsStructValid(_capture) ? _capture->m_recordsNum : 0;
+}
+
+TCP_CaptureReader_t* TCP_CaptureOpen(const char* _path)
+{
+	TCP_CaptureReader_t* aReader;
+	FileHeader_t header;
+	struct stat status;
+	void* file;
+	int fd;
+
+	if (NULL == _path)
+	{
+		return NULL;
+	}
+
+	fd = open(_path, O_RDONLY);
+	if (fd < 0)
+	{
+		perror("Capture open Failed");
+		return NULL;
+	}
+	if (fstat(fd, &status) < 0 || (uint64_t) status.st_size < sizeof(header) )
+	{
+		close(fd);
+		return NULL;
+	}
+	file = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	/* the mapping stays after the file is closed */
+	close(fd);
+	if (MAP_FAILED == file)
+	{
+		perror("Capture mmap Failed");
+		return NULL;
+	}
+	madvise(file, status.st_size, MADV_SEQUENTIAL);
+
+	memcpy(&header, file, sizeof(header) );
+	if (memcmp(header.m_magic, FILE_MAGIC, sizeof(header.m_magic) ) != 0 || header.m_version != FILE_VERSION)
+	{
+		munmap(file, status.st_size);
+		return NULL;
+	}
+
+	aReader = calloc(1, sizeof(TCP_CaptureReader_t) );
+	if (! aReader)
+	{
+		munmap(file, status.st_size);
+		return NULL;
+	}
+	aReader->m_file = file;
+	aReader->m_size = status.st_size;
+	aReader->m_offset = sizeof(header);
+	aReader->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return aReader;
+}
+
+void TCP_CaptureClose(TCP_CaptureReader_t* _reader)
+{
+	if (! IsReaderValid(_reader) )
+	{
+		return;
+	}
+
+	_reader->m_magicNumber = DEAD_MAGIC_NUMBER;
+	munmap((void*) _reader->m_file, _reader->m_size);
+	free(_reader);
+}
+
+bool TCP_CaptureNext(TCP_CaptureReader_t* _reader, TCP_CaptureRecord_t* _record)
+{
+	RecordHeader_t header;
+
+	if (! IsReaderValid(_reader) || NULL == _record || _reader->m_offset + sizeof(header) > _reader->m_size)
+	{
+		return FALSE;
+	}
+
+	memcpy(&header, _reader->m_file + _reader->m_offset, sizeof(header) );
+	if (_reader->m_offset + sizeof(header) + header.m_length > _reader->m_size)
+	{
+		/* the writer did not get to close the file */
+		return FALSE;
+	}
+
+	_record->m_timeUS = header.m_timeUS;
+	_record->m_socketNum = header.m_socketNum;
+	_record->m_requestID = header.m_requestID;
+	_record->m_length = header.m_length;
+	_record->m_data = _reader->m_file + _reader->m_offset + sizeof(header);
+	_reader->m_offset += ALIGN8(sizeof(header) + header.m_length);
+	return TRUE;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* maps the window holding _offset. the file is reserved for it first, so a full disk fails here and not as a SIGBUS on a copy */
+static bool MapWindow(TCP_Capture_t* _capture, uint64_t _offset)
+{
+	uint64_t start = _offset & ~((uint64_t) sysconf(_SC_PAGESIZE) - 1);
+	void* window;
+
+	if (posix_fallocate(_capture->m_fd, start, TCP_CAPTURE_WINDOW_SIZE) != 0)
+	{
+		fprintf(stderr, "Capture could not grow the file\n");
+		return FALSE;
+	}
+	window = mmap(NULL, TCP_CAPTURE_WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, _capture->m_fd, start);
+	if (MAP_FAILED == window)
+	{
+		perror("Capture mmap Failed");
+		return FALSE;
+	}
+
+	if (_capture->m_window != MAP_FAILED)
+	{
+		munmap(_capture->m_window, TCP_CAPTURE_WINDOW_SIZE);
+	}
+	_capture->m_window = window;
+	_capture->m_windowStart = start;
+	return TRUE;
+}
+
+static uint64_t NowUS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static bool IsStructValid(TCP_Capture_t* _capture)
+{
+	return (_capture && _capture->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
+
+static bool IsReaderValid(TCP_CaptureReader_t* _reader)
+{
+	return (_reader && _reader->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
@@ -0,0 +1,110 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief A binary capture of received messages, to replay real traffic against the server (replayClient).
+ * The file is a header, then one record per message: the time it was received, the socket, the request ID
+ * (framed mode) and the payload, each record padded to 8 bytes. Numbers are in host order.
+ * The writer appends into a memory mapped window of the file, so recording a message is a copy, without a system
+ * call. The kernel writes the pages back on its own. A new window is mapped every TCP_CAPTURE_WINDOW_SIZE bytes.
+ * The reader maps the whole file, and gives records that point into it.
+ *
+ * @bug not thread safe, one capture for one loop.
+ */
+
+#ifndef TCP_CAPTURE_H_
+#define TCP_CAPTURE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the file grows by this much at a time. a multiple of the page size */
+#define TCP_CAPTURE_WINDOW_SIZE (16 << 20)
+/* a longer message is recorded cut to this length */
+#define TCP_CAPTURE_MAX_RECORD (TCP_CAPTURE_WINDOW_SIZE / 4)
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct TCP_Capture TCP_Capture_t;
+typedef struct TCP_CaptureReader TCP_CaptureReader_t;
+
+typedef struct TCP_CaptureRecord
+{
+	uint64_t m_timeUS; /* since the capture was created */
+	uint m_socketNum;
+	uint m_requestID; /* 0 when not framed */
+	uint m_length;
+	const void* m_data; /* inside the reader's mapping, valid until it is closed */
+} TCP_CaptureRecord_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create a capture file to record into. an existing file is replaced.
+ * @param _path of the file
+ * @return a pointer to the struct. NULL if failed.
+ */
+TCP_Capture_t* TCP_CaptureCreate(const char* _path);
+
+/**
+ * @brief cut the file to what was recorded, and close it.
+ * @param _capture pointer to the struct
+ * @return void
+ */
+void TCP_CaptureDestroy(TCP_Capture_t* _capture);
+
+/**
+ * @brief record one message, stamped with the current time.
+ * @param _capture pointer to the struct
+ * @param _socketNum the message came from
+ * @param _requestID of the frame, 0 when not framed
+ * @param _data the message
+ * @param _length its bytes. above TCP_CAPTURE_MAX_RECORD only the first TCP_CAPTURE_MAX_RECORD are kept.
+ * @return TRUE if recorded or FALSE if failed (the disk is full).
+ */
+bool TCP_CaptureWrite(TCP_Capture_t* _capture, uint _socketNum, uint _requestID, const void* _data, uint _length);
+
+/**
+ * @brief the number of records written.
+ * @param _capture pointer to the struct
+ * @return the number
+ */
+unsigned long TCP_CaptureRecordsNum(TCP_Capture_t* _capture);
+
+/**
+ * @brief Open a capture file to read.
+ * @param _path of the file
+ * @return a pointer to the struct. NULL if failed or not a capture file.
+ */
+TCP_CaptureReader_t* TCP_CaptureOpen(const char* _path);
+
+/**
+ * @brief Close the file. records read from it are no longer valid.
+ * @param _reader pointer to the struct
+ * @return void
+ */
+void TCP_CaptureClose(TCP_CaptureReader_t* _reader);
+
+/**
+ * @brief read the next record, in the order they were written.
+ * @param _reader pointer to the struct
+ * @param _record out
+ * @return TRUE if read or FALSE at the end (or a truncated record).
+ */
+bool TCP_CaptureNext(TCP_CaptureReader_t* _reader, TCP_CaptureRecord_t* _record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCP_CAPTURE_H_ */
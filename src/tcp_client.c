@@ -10,11 +10,16 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <arpa/inet.h> /* ADDRSELEN */
-/* #include <errno.h> */
+#include <netinet/tcp.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h> /* close */
 
 #include "list.h"
 #include "tcp_client.h"
+#include "tcp_address.h"
+#include "tcp_shm.h"
 
 /* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -24,6 +29,9 @@
 #define GENERAL_ERROR -9
 #define BACK_LOG_CAPACITY 128
 
+/* a send to a full shared memory ring waits this long for the server to make room */
+#define SHM_FULL_WAIT_MS 1000
+
 /* ~~~ Global ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -36,23 +44,25 @@ struct TCP_C
 	int m_connectedNum; /* count the amount of open connections */
 
 	uint m_serverPort;
-	char m_serverIP[INET6_ADDRSTRLEN];
+	char m_serverIP[TCP_ADDRESS_MAX_LENGTH];
+	struct sockaddr_storage m_serverAddr;
+	socklen_t m_serverAddrLength;
+
+	uint m_connectTimeoutMS; /* 0 means wait as long as the kernel does */
+	bool m_isFastOpenPending; /* TCP Fast Open. connect is done by the first send */
 
+	TCP_Shm_t* m_shm; /* NULL unless the server accepted shared memory */
 };
 
 /* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-/**
- * @brief If the client need to know the server socket it is connected to.
- * @param _TCP the pointer to the client struct
- * @return int that represent the file descriptor (socket) of this client
- */
-int TCP_ClientGetSocket(TCP_C_t* _TCP);
-
 static bool IsStructValid(TCP_C_t* _TCP);
 static bool IsConnected(TCP_C_t* _TCP);
 
 bool TCP_ClientConnect(TCP_C_t* _TCP);
+static bool WaitConnected(int _socket, uint _timeoutMS);
+static int FastOpenSend(TCP_C_t* _TCP, void* _msg, uint _msgLength);
+static bool SetSocketBlockingEnabled(int fd, bool blocking);
 
 static void sanity_check(char* _string, uint _size, char _replaceWith);
 
@@ -61,8 +71,19 @@ static void sanity_check(char* _string, uint _size, char _replaceWith);
 
 
 TCP_C_t* TCP_CreateClient(char* _ServerIP, uint _serverPort)
+{
+	return TCP_CreateClientTimeout(_ServerIP, _serverPort, DEFAULT_CONNECT_TIMEOUT_MS, FALSE);
+}
+
+TCP_C_t* TCP_CreateClientTimeout(char* _ServerIP, uint _serverPort, uint _connectTimeoutMS, bool _isFastOpen)
 {
 	TCP_C_t* aTCP = 0;
+
+	if (NULL == _ServerIP)
+	{
+		return NULL;
+	}
+
 	aTCP = malloc(1 * sizeof(TCP_C_t) );
 	if (!aTCP)
 	{
@@ -70,11 +91,22 @@ TCP_C_t* TCP_CreateClient(char* _ServerIP, uint _serverPort)
 		return NULL;
 	}
 
-	strncpy(aTCP->m_serverIP , _ServerIP, INET6_ADDRSTRLEN);
+	strncpy(aTCP->m_serverIP , _ServerIP, TCP_ADDRESS_MAX_LENGTH - 1);
+	aTCP->m_serverIP[TCP_ADDRESS_MAX_LENGTH - 1] = '\0';
 	aTCP->m_serverPort = _serverPort;
 	aTCP->m_connectedNum = 0;
+	aTCP->m_connectTimeoutMS = _connectTimeoutMS;
+	aTCP->m_isFastOpenPending = FALSE;
+	aTCP->m_shm = NULL;
 
-	aTCP->m_commSocket = socket(PF_INET, SOCK_STREAM, 0);
+	if (! TCP_ParseAddress(aTCP->m_serverIP, aTCP->m_serverPort, &aTCP->m_serverAddr, &aTCP->m_serverAddrLength) )
+	{
+		fprintf(stderr, "CreateClient, bad server address %s\n", aTCP->m_serverIP);
+		free(aTCP);
+		return NULL;
+	}
+
+	aTCP->m_commSocket = socket(aTCP->m_serverAddr.ss_family, SOCK_STREAM, 0);
 	if (aTCP->m_commSocket < 0)
 	{
 		perror("CreateClient, Socket create Failed");
@@ -84,7 +116,7 @@ TCP_C_t* TCP_CreateClient(char* _ServerIP, uint _serverPort)
 
 	/* Reusing port */
 	int optval = 1;
-	if ( setsockopt(aTCP->m_commSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval) ) < 0)
+	if ( aTCP->m_serverAddr.ss_family != AF_UNIX && setsockopt(aTCP->m_commSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval) ) < 0)
 	{
 		perror("Socket setsockopt Failed");
 		close(aTCP->m_commSocket);
@@ -94,6 +126,14 @@ TCP_C_t* TCP_CreateClient(char* _ServerIP, uint _serverPort)
 
 	aTCP->m_magicNumber = ALIVE_MAGIC_NUMBER;
 
+	if (_isFastOpen && aTCP->m_serverAddr.ss_family != AF_UNIX)
+	{
+		/* the SYN would carry the first message, so connecting is left to the first send */
+		aTCP->m_isFastOpenPending = TRUE;
+		aTCP->m_connectedNum++;
+		return aTCP;
+	}
+
 	if (! TCP_ClientConnect(aTCP) )
 	{
 		perror("Socket Connect Failed");
@@ -115,6 +155,8 @@ void TCP_DestroyClient(TCP_C_t* _TCP)
 
 	_TCP->m_magicNumber = DEAD_MAGIC_NUMBER;
 
+	/* before the close, so the server finds the ring closed when it sees the socket close */
+	TCP_ShmDetach(_TCP->m_shm);
 	close(_TCP->m_commSocket);
 
 	free(_TCP);
@@ -125,19 +167,36 @@ void TCP_DestroyClient(TCP_C_t* _TCP)
 
 bool TCP_ClientConnect(TCP_C_t* _TCP)
 {
-	struct sockaddr_in client_sIn;
-	memset(&client_sIn , 0 , sizeof(client_sIn) );
+	int result;
 
-	client_sIn.sin_family = AF_INET;
-	client_sIn.sin_addr.s_addr = inet_addr(_TCP->m_serverIP);
-	client_sIn.sin_port = htons(_TCP->m_serverPort);
+	/* connect without blocking, so the wait can be bounded by the connect timeout */
+	if (! SetSocketBlockingEnabled(_TCP->m_commSocket, FALSE) )
+	{
+		return FALSE;
+	}
 
-	if (connect(_TCP->m_commSocket, (struct sockaddr *) &client_sIn, sizeof(client_sIn)) < 0)
+	result = connect(_TCP->m_commSocket, (struct sockaddr *) &_TCP->m_serverAddr, _TCP->m_serverAddrLength);
+	if (result < 0 && errno != EINPROGRESS)
+	{
+		perror("Socket client connect Failed");
+		return FALSE;
+	}
+	if (result < 0 && ! WaitConnected(_TCP->m_commSocket, _TCP->m_connectTimeoutMS) )
 	{
 		perror("Socket client connect Failed");
 		return FALSE;
 	}
-	_TCP->m_connectedNum++;
+
+	if (! SetSocketBlockingEnabled(_TCP->m_commSocket, TRUE) )
+	{
+		return FALSE;
+	}
+
+	if (! _TCP->m_isFastOpenPending)
+	{
+		_TCP->m_connectedNum++;
+	}
+	_TCP->m_isFastOpenPending = FALSE;
 
 	return TRUE;
 }
@@ -151,6 +210,12 @@ int TCP_ClientGetSocket(TCP_C_t* _TCP)
 		return GENERAL_ERROR;
 	}
 
+	/* whoever takes the socket expect it to be connected */
+	if (_TCP->m_isFastOpenPending && ! TCP_ClientConnect(_TCP) )
+	{
+		return GENERAL_ERROR;
+	}
+
 	return _TCP->m_commSocket;
 }
 
@@ -165,6 +230,15 @@ int TCP_ClientSend(TCP_C_t* _TCP, void* _msg, uint _msgLength)
 		return GENERAL_ERROR;
 	}
 
+	if (_TCP->m_isFastOpenPending)
+	{
+		return FastOpenSend(_TCP, _msg, _msgLength);
+	}
+	if (_TCP->m_shm)
+	{
+		return TCP_ShmWrite(_TCP->m_shm, _msg, _msgLength, 0, SHM_FULL_WAIT_MS);
+	}
+
 	int sent_bytes;
 	sent_bytes = send( _TCP->m_commSocket, _msg, _msgLength, 0 );
 
@@ -188,6 +262,22 @@ int TCP_ClientRecive(TCP_C_t* _TCP, void* _buffer, uint _bufferMaxLength)
 	{
 		return GENERAL_ERROR;
 	}
+	if (_TCP->m_isFastOpenPending && ! TCP_ClientConnect(_TCP) )
+	{
+		/* nothing was sent yet, so a plain connect is all that is missing */
+		return GENERAL_ERROR;
+	}
+
+	if (_TCP->m_shm)
+	{
+		nBytesRead = TCP_ShmRead(_TCP->m_shm, _buffer, _bufferMaxLength, NULL, TRUE);
+		if (nBytesRead < 0)
+		{
+			return GENERAL_ERROR;
+		}
+		sanity_check(_buffer, nBytesRead, '_');
+		return nBytesRead;
+	}
 
     nBytesRead = recv( _TCP->m_commSocket, _buffer, _bufferMaxLength , 0 );
 
@@ -204,6 +294,85 @@ int TCP_ClientRecive(TCP_C_t* _TCP, void* _buffer, uint _bufferMaxLength)
 }
 
 
+bool TCP_ClientIsAlive(TCP_C_t* _TCP)
+{
+	char peek;
+	int result;
+
+	if ( !IsStructValid(_TCP) || ! IsConnected(_TCP))
+	{
+		return FALSE;
+	}
+	if (_TCP->m_isFastOpenPending)
+	{
+		/* not connected yet, nothing could have gone wrong */
+		return TRUE;
+	}
+
+	result = recv(_TCP->m_commSocket, &peek, 1, MSG_PEEK | MSG_DONTWAIT);
+	if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+		/* nothing to read and no error, the connection is idle and alive */
+		return TRUE;
+	}
+
+	/* 0 is a close on server side, positive is data nobody asked for */
+	return FALSE;
+}
+
+
+bool TCP_ClientUseSharedMemory(TCP_C_t* _TCP, uint _ringSize)
+{
+	TCP_ShmHello_t hello;
+	TCP_Shm_t* shm;
+	struct pollfd pfd;
+	char reply = TCP_SHM_REJECT;
+	int activity;
+
+	if ( !IsStructValid(_TCP) || ! IsConnected(_TCP) || _TCP->m_shm)
+	{
+		return FALSE;
+	}
+	if (_TCP->m_isFastOpenPending && ! TCP_ClientConnect(_TCP) )
+	{
+		return FALSE;
+	}
+
+	shm = TCP_ShmCreate(_TCP->m_commSocket, _ringSize, &hello);
+	if (! shm)
+	{
+		return FALSE;
+	}
+
+	if (send(_TCP->m_commSocket, &hello, sizeof(hello), MSG_NOSIGNAL) != sizeof(hello) )
+	{
+		TCP_ShmDetach(shm);
+		return FALSE;
+	}
+
+	pfd.fd = _TCP->m_commSocket;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	do
+	{
+		activity = poll(&pfd, 1, _TCP->m_connectTimeoutMS ? (int) _TCP->m_connectTimeoutMS : DEFAULT_CONNECT_TIMEOUT_MS);
+	} while (activity < 0 && errno == EINTR);
+
+	if (activity <= 0 || recv(_TCP->m_commSocket, &reply, 1, 0) != 1 || reply != TCP_SHM_ACCEPT)
+	{
+		/* the segment is removed with it */
+		TCP_ShmDetach(shm);
+		return FALSE;
+	}
+
+	/* both sides mapped it. the name is not needed anymore, and a crash would not leave it behind */
+	TCP_ShmUnlink(shm);
+	_TCP->m_shm = shm;
+
+	return TRUE;
+}
+
+
 /* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 bool IsStructValid(TCP_C_t* _TCP)
@@ -216,6 +385,106 @@ bool IsConnected(TCP_C_t* _TCP)
 	return (bool) _TCP->m_connectedNum;
 }
 
+/* returns TRUE when a non-blocking connect completed successfully within the time */
+static bool WaitConnected(int _socket, uint _timeoutMS)
+{
+	struct pollfd pfd;
+	int socketError = 0;
+	socklen_t errorLength = sizeof(socketError);
+	int activity;
+
+	pfd.fd = _socket;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+
+	do
+	{
+		activity = poll(&pfd, 1, _timeoutMS ? (int) _timeoutMS : -1);
+	} while (activity < 0 && errno == EINTR);
+
+	if (activity == 0)
+	{
+		errno = ETIMEDOUT;
+		return FALSE;
+	}
+	if (activity < 0)
+	{
+		return FALSE;
+	}
+
+	if (getsockopt(_socket, SOL_SOCKET, SO_ERROR, &socketError, &errorLength) < 0)
+	{
+		return FALSE;
+	}
+	if (socketError != 0)
+	{
+		errno = socketError;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* first send of a TCP Fast Open client. the message rides the SYN when the server gave us a cookie before */
+static int FastOpenSend(TCP_C_t* _TCP, void* _msg, uint _msgLength)
+{
+	int sent_bytes;
+
+	if (! SetSocketBlockingEnabled(_TCP->m_commSocket, FALSE) )
+	{
+		return GENERAL_ERROR;
+	}
+
+	sent_bytes = sendto(_TCP->m_commSocket, _msg, _msgLength, MSG_FASTOPEN | MSG_NOSIGNAL,
+						(struct sockaddr *) &_TCP->m_serverAddr, _TCP->m_serverAddrLength);
+	if (sent_bytes < 0 && errno != EINPROGRESS)
+	{
+		/* fast open is disabled on this host (net.ipv4.tcp_fastopen). do it the old way */
+		SetSocketBlockingEnabled(_TCP->m_commSocket, TRUE);
+		if (! TCP_ClientConnect(_TCP) )
+		{
+			return GENERAL_ERROR;
+		}
+		return TCP_ClientSend(_TCP, _msg, _msgLength);
+	}
+
+	/* EINPROGRESS means no cookie yet. the SYN went out alone, and the data is sent once connected */
+	if (! WaitConnected(_TCP->m_commSocket, _TCP->m_connectTimeoutMS) )
+	{
+		perror("Socket client fast open connect Failed");
+		return GENERAL_ERROR;
+	}
+	if (! SetSocketBlockingEnabled(_TCP->m_commSocket, TRUE) )
+	{
+		return GENERAL_ERROR;
+	}
+	_TCP->m_isFastOpenPending = FALSE;
+
+	if (sent_bytes < 0)
+	{
+		return TCP_ClientSend(_TCP, _msg, _msgLength);
+	}
+	if ((uint) sent_bytes < _msgLength)
+	{
+		/* the SYN took only part of it */
+		int rest = TCP_ClientSend(_TCP, (char*) _msg + sent_bytes, _msgLength - sent_bytes);
+		return (rest < 0) ? rest : sent_bytes + rest;
+	}
+
+	return sent_bytes;
+}
+
+/** Returns true on success, or false if there was an error */
+static bool SetSocketBlockingEnabled(int fd, bool blocking)
+{
+	if (fd < 0) return FALSE;
+
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0) return FALSE;
+	flags = blocking ? (flags&~O_NONBLOCK) : (flags|O_NONBLOCK);
+	return (fcntl(fd, F_SETFL, flags) == 0) ? TRUE : FALSE;
+}
+
 static void sanity_check(char* _string, uint _size, char _replaceWith)
 {
     int j = 0;
@@ -15,18 +15,35 @@ typedef int bool;
 #define TRUE 1
 #define FALSE 0
 
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* connect timeout used by TCP_CreateClient */
+#define DEFAULT_CONNECT_TIMEOUT_MS 5000
+
 /* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 typedef struct TCP_C TCP_C_t;
 
 
 /**
  * @brief Create all is needed for a TCP client to connect to the server
- * @param _ServerIP the ip address (ipv4 or ipv6) of the server
- * @param _serverPort the listning for new connection port on the server
+ * @param _ServerIP the ip address (ipv4 or ipv6) of the server, or "unix:/path" for a server listening on a Unix domain socket.
+ * @param _serverPort the listning for new connection port on the server. ignored for Unix sockets.
  * @return pointer to the newly create struct
  */
 TCP_C_t* TCP_CreateClient(char* _ServerIP, uint _serverPort);
 
+/**
+ * @brief Create a client with control over the connect.
+ * @param _ServerIP the ip address (ipv4 or ipv6) of the server, or "unix:/path" for a Unix domain socket.
+ * @param _serverPort the listning for new connection port on the server. ignored for Unix sockets.
+ * @param _connectTimeoutMS give up connecting after this time (miliSeconds) instead of the kernel SYN retries period. 0 to wait as long as the kernel does.
+ * @param _isFastOpen TRUE for TCP Fast Open. the connect is done by the first TCP_ClientSend and its data rides the SYN,
+ * which saves a round trip once the server gave this host a cookie. the server should enable it with TCP_ServerSetFastOpen.
+ * when it is on, errors of the connect are reported by the first send. ignored for Unix sockets.
+ * @return pointer to the newly create struct. NULL if failed.
+ */
+TCP_C_t* TCP_CreateClientTimeout(char* _ServerIP, uint _serverPort, uint _connectTimeoutMS, bool _isFastOpen);
+
 
 /**
  * @brief Cleans up and free after the program. This include the disconnect function inside it.
@@ -54,4 +71,31 @@ int TCP_ClientSend(TCP_C_t* _TCP, void* _msg, uint _msgLength);
  */
 int TCP_ClientRecive(TCP_C_t* _TCP, void* _buffer, uint _bufferMaxLength);
 
+/**
+ * @brief If the client need to know the server socket it is connected to.
+ * @param _TCP the pointer to the client struct
+ * @return int that represent the file descriptor (socket) of this client
+ */
+int TCP_ClientGetSocket(TCP_C_t* _TCP);
+
+/**
+ * @brief Check without blocking that the connection is still usable.
+ * A connection closed by the server, in error, or holding unread data (a stale response) is not usable.
+ * @param _TCP a pointer to the TCP struct
+ * @return TRUE if the connection can carry a new request, FALSE otherwise.
+ */
+bool TCP_ClientIsAlive(TCP_C_t* _TCP);
+
+/**
+ * @brief Move the data of this connection to shared memory rings, for a client on the same host as the server (see tcp_shm.h).
+ * must be called right after the create, before any other data. the server must enable it with TCP_ServerSetSharedMemory.
+ * On success TCP_ClientSend and TCP_ClientRecive keep working as before, over the rings. each recive returns one whole message.
+ * On failure the connection stays on the socket.
+ * The socket stays open and is still used to tell when the server is gone, so it should not be read or written by the user.
+ * @param _TCP a pointer to the TCP struct
+ * @param _ringSize bytes of each direction ring. power of 2, TCP_SHM_DEFAULT_RING_SIZE is a good start.
+ * @return TRUE if the server accepted, FALSE otherwise.
+ */
+bool TCP_ClientUseSharedMemory(TCP_C_t* _TCP, uint _ringSize);
+
 #endif /* TCP_CLIENT_H_ */
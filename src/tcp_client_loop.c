@@ -0,0 +1,675 @@
+/*
+ * tcp_client_loop.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h> /* uint64_t */
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h> /* close */
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "tcp_client_loop.h"
+#include "tcp_address.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+#define CONN_MAGIC_NUMBER	0xdeadbeef
+
+#define GENERAL_ERROR -9
+
+#define EVENTS_PER_WAIT 256
+#define MIN_OUT_BUFFER 1024
+
+typedef enum ConnState
+{
+	CONN_CONNECTING,
+	CONN_CONNECTED
+} ConnState_t;
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct ClientConn
+{
+	int m_magicNumber;
+
+	int m_socketFD;
+	ConnState_t m_state;
+	bool m_isWriteWatched; /* EPOLLOUT is set on the socket */
+
+	/* outbound bytes the kernel did not take yet. allocated only when needed */
+	char* m_outBuf;
+	uint m_outLength;
+	uint m_outCapacity;
+} ClientConn_t;
+
+struct TCP_CL
+{
+	int m_magicNumber;
+
+	int m_epollFD;
+	int m_wakeFD; /* eventfd used to wake the loop on stop */
+
+	uint m_connectionCapacity;
+	uint m_connectedNum;
+
+	/* connections indexed by socket number */
+	ClientConn_t** m_conns;
+	uint m_connsSize;
+
+	bool m_isLoopRun;
+
+	clientLoopConnectFunc m_connectFunc;
+	clientLoopDataFunc m_reciveDataFunc;
+	clientLoopDisconnectFunc m_disconnectFunc;
+
+	void* m_contex;
+
+	char m_readBuffer[CLIENT_LOOP_READ_SIZE];
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_CL_t* _loop);
+static ClientConn_t* GetConn(TCP_CL_t* _loop, int _socketNum);
+static bool StoreConn(TCP_CL_t* _loop, ClientConn_t* _conn);
+static void CloseConn(TCP_CL_t* _loop, ClientConn_t* _conn);
+
+static bool WatchWrite(TCP_CL_t* _loop, ClientConn_t* _conn, bool _isWatch);
+static bool QueueOut(ClientConn_t* _conn, const char* _msg, uint _msgLength);
+static int FlushOut(ClientConn_t* _conn);
+
+static void HandleConnecting(TCP_CL_t* _loop, ClientConn_t* _conn);
+static void HandleWritable(TCP_CL_t* _loop, ClientConn_t* _conn);
+static void HandleReadable(TCP_CL_t* _loop, ClientConn_t* _conn);
+
+static bool SetSocketBlockingEnabled(int fd, bool blocking);
+static bool IsFail_nonBlocking(int _result);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_CL_t* TCP_CreateClientLoop(uint _maxConnections,
+		clientLoopConnectFunc _connectFunc,
+		clientLoopDataFunc _reciveDataFunc,
+		clientLoopDisconnectFunc _disconnectFunc,
+		void* _contex
+		)
+{
+	TCP_CL_t* aLoop;
+	struct epoll_event event;
+
+	if (NULL == _reciveDataFunc || 0 == _maxConnections)
+	{
+		return NULL;
+	}
+
+	aLoop = malloc(1 * sizeof(TCP_CL_t) );
+	if (!aLoop)
+	{
+		return NULL;
+	}
+
+	aLoop->m_epollFD = epoll_create1(0);
+	if (aLoop->m_epollFD < 0)
+	{
+		perror("CreateClientLoop, epoll_create Failed");
+		free(aLoop);
+		return NULL;
+	}
+
+	aLoop->m_wakeFD = eventfd(0, EFD_NONBLOCK);
+	if (aLoop->m_wakeFD < 0)
+	{
+		perror("CreateClientLoop, eventfd Failed");
+		close(aLoop->m_epollFD);
+		free(aLoop);
+		return NULL;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = aLoop->m_wakeFD;
+	if (epoll_ctl(aLoop->m_epollFD, EPOLL_CTL_ADD, aLoop->m_wakeFD, &event) < 0)
+	{
+		perror("CreateClientLoop, epoll_ctl Failed");
+		close(aLoop->m_wakeFD);
+		close(aLoop->m_epollFD);
+		free(aLoop);
+		return NULL;
+	}
+
+	aLoop->m_conns = NULL;
+	aLoop->m_connsSize = 0;
+	aLoop->m_connectionCapacity = _maxConnections;
+	aLoop->m_connectedNum = 0;
+	aLoop->m_isLoopRun = FALSE;
+
+	aLoop->m_connectFunc = _connectFunc;
+	aLoop->m_reciveDataFunc = _reciveDataFunc;
+	aLoop->m_disconnectFunc = _disconnectFunc;
+	aLoop->m_contex = _contex;
+
+	aLoop->m_magicNumber = ALIVE_MAGIC_NUMBER;
+
+	return aLoop;
+}
+
+void TCP_DestroyClientLoop(TCP_CL_t* _loop)
+{
+	uint i;
+
+	if ( !IsStructValid(_loop) )
+	{
+		return;
+	}
+
+	_loop->m_magicNumber = DEAD_MAGIC_NUMBER;
+
+	for (i = 0; i < _loop->m_connsSize; ++i)
+	{
+		if (_loop->m_conns[i])
+		{
+			CloseConn(_loop, _loop->m_conns[i]);
+		}
+	}
+	free(_loop->m_conns);
+
+	close(_loop->m_wakeFD);
+	close(_loop->m_epollFD);
+
+	free(_loop);
+	return;
+}
+
+int TCP_ClientLoopConnect(TCP_CL_t* _loop, const char* _serverIP, uint _serverPort)
+{
+	int socketFD;
+	ClientConn_t* aConn;
+	struct sockaddr_storage sAddr;
+	socklen_t sAddrLength;
+	struct epoll_event event;
+
+	if ( !IsStructValid(_loop) || NULL == _serverIP)
+	{
+		return GENERAL_ERROR;
+	}
+	if (_loop->m_connectedNum >= _loop->m_connectionCapacity)
+	{
+		return GENERAL_ERROR;
+	}
+
+	if (! TCP_ParseAddress(_serverIP, _serverPort, &sAddr, &sAddrLength) )
+	{
+		return GENERAL_ERROR;
+	}
+
+	socketFD = socket(sAddr.ss_family, SOCK_STREAM, 0);
+	if (socketFD < 0)
+	{
+		perror("ClientLoopConnect, Socket create Failed");
+		return GENERAL_ERROR;
+	}
+	if (! SetSocketBlockingEnabled(socketFD, FALSE) )
+	{
+		close(socketFD);
+		return GENERAL_ERROR;
+	}
+
+	aConn = calloc(1, sizeof(ClientConn_t) );
+	if (! aConn)
+	{
+		close(socketFD);
+		return GENERAL_ERROR;
+	}
+	aConn->m_socketFD = socketFD;
+	aConn->m_state = CONN_CONNECTING;
+	aConn->m_magicNumber = CONN_MAGIC_NUMBER;
+
+	/* even an immediate success (possible on loopback) is reported from the loop like any other connect */
+	if (connect(socketFD, (struct sockaddr *) &sAddr, sAddrLength) < 0 && errno != EINPROGRESS)
+	{
+		perror("ClientLoopConnect, connect Failed");
+		close(socketFD);
+		free(aConn);
+		return GENERAL_ERROR;
+	}
+
+	if (! StoreConn(_loop, aConn) )
+	{
+		close(socketFD);
+		free(aConn);
+		return GENERAL_ERROR;
+	}
+
+	/* a connect is completed when the socket become writable */
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLOUT;
+	event.data.fd = socketFD;
+	if (epoll_ctl(_loop->m_epollFD, EPOLL_CTL_ADD, socketFD, &event) < 0)
+	{
+		perror("ClientLoopConnect, epoll_ctl Failed");
+		_loop->m_conns[socketFD] = NULL;
+		close(socketFD);
+		free(aConn);
+		return GENERAL_ERROR;
+	}
+	aConn->m_isWriteWatched = TRUE;
+
+	_loop->m_connectedNum++;
+
+	return socketFD;
+}
+
+int TCP_ClientLoopSend(TCP_CL_t* _loop, uint _socketNum, const void* _msg, uint _msgLength)
+{
+	ClientConn_t* conn;
+	int sent_bytes = 0;
+
+	if ( !IsStructValid(_loop) || NULL == _msg)
+	{
+		return GENERAL_ERROR;
+	}
+	conn = GetConn(_loop, _socketNum);
+	if (! conn)
+	{
+		return GENERAL_ERROR;
+	}
+
+	/* keep the order. if something is already waiting, the new data goes after it */
+	if (conn->m_state == CONN_CONNECTED && 0 == conn->m_outLength)
+	{
+		sent_bytes = send(conn->m_socketFD, _msg, _msgLength, MSG_NOSIGNAL);
+		if ( IsFail_nonBlocking(sent_bytes) )
+		{
+			perror("ClientLoopSend Failed");
+			return sent_bytes;
+		}
+		if (sent_bytes < 0)
+		{
+			sent_bytes = 0;
+		}
+	}
+
+	if ((uint) sent_bytes < _msgLength)
+	{
+		if (! QueueOut(conn, (const char*) _msg + sent_bytes, _msgLength - sent_bytes) )
+		{
+			return GENERAL_ERROR;
+		}
+		if (conn->m_state == CONN_CONNECTED && ! WatchWrite(_loop, conn, TRUE) )
+		{
+			return GENERAL_ERROR;
+		}
+	}
+
+	return _msgLength;
+}
+
+bool TCP_ClientLoopDisconnect(TCP_CL_t* _loop, uint _socketNum)
+{
+	ClientConn_t* conn;
+
+	if ( !IsStructValid(_loop) )
+	{
+		return FALSE;
+	}
+	conn = GetConn(_loop, _socketNum);
+	if (! conn)
+	{
+		return FALSE;
+	}
+
+	CloseConn(_loop, conn);
+	return TRUE;
+}
+
+int TCP_ClientLoopRunOnce(TCP_CL_t* _loop, int _timeoutMS)
+{
+	struct epoll_event events[EVENTS_PER_WAIT];
+	ClientConn_t* conn;
+	int activity;
+	int i;
+
+	if ( !IsStructValid(_loop) )
+	{
+		return GENERAL_ERROR;
+	}
+
+	activity = epoll_wait(_loop->m_epollFD, events, EVENTS_PER_WAIT, _timeoutMS);
+	if (activity < 0)
+	{
+		if (errno == EINTR)
+		{
+			return 0;
+		}
+		perror("ClientLoop epoll_wait error");
+		return GENERAL_ERROR;
+	}
+
+	for (i = 0; i < activity; ++i)
+	{
+		if (events[i].data.fd == _loop->m_wakeFD)
+		{
+			uint64_t dummy;
+			if (read(_loop->m_wakeFD, &dummy, sizeof(dummy)) < 0)
+			{
+				/* nothing to do, the loop flag is what matters */
+			}
+			continue;
+		}
+
+		/* a callback of an earlier event might have closed this connection */
+		conn = GetConn(_loop, events[i].data.fd);
+		if (! conn)
+		{
+			continue;
+		}
+
+		if (conn->m_state == CONN_CONNECTING)
+		{
+			HandleConnecting(_loop, conn);
+			continue;
+		}
+
+		if (events[i].events & EPOLLOUT)
+		{
+			HandleWritable(_loop, conn);
+			conn = GetConn(_loop, events[i].data.fd);
+			if (! conn)
+			{
+				continue;
+			}
+		}
+
+		if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+		{
+			HandleReadable(_loop, conn);
+		}
+	}
+
+	return activity;
+}
+
+bool TCP_RunClientLoop(TCP_CL_t* _loop)
+{
+	if ( !IsStructValid(_loop) )
+	{
+		return FALSE;
+	}
+
+	_loop->m_isLoopRun = TRUE;
+	while (_loop->m_isLoopRun)
+	{
+		if (TCP_ClientLoopRunOnce(_loop, -1) < 0)
+		{
+			_loop->m_isLoopRun = FALSE;
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+bool TCP_StopClientLoop(TCP_CL_t* _loop)
+{
+	uint64_t one = 1;
+
+	if ( !IsStructValid(_loop) )
+	{
+		return FALSE;
+	}
+
+	_loop->m_isLoopRun = FALSE;
+	/* write is async-signal-safe, so this can be called from a handler */
+	if (write(_loop->m_wakeFD, &one, sizeof(one)) < 0)
+	{
+		return FALSE;
+	}
+	return TRUE;
+}
+
+int TCP_ClientLoopConnectionsNum(TCP_CL_t* _loop)
+{
+	if ( !IsStructValid(_loop) )
+	{
+		return GENERAL_ERROR;
+	}
+	return _loop->m_connectedNum;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_CL_t* _loop)
+{
+	return !(NULL == _loop || ALIVE_MAGIC_NUMBER != _loop->m_magicNumber);
+}
+
+static ClientConn_t* GetConn(TCP_CL_t* _loop, int _socketNum)
+{
+	if (_socketNum < 0 || (uint) _socketNum >= _loop->m_connsSize)
+	{
+		return NULL;
+	}
+	return _loop->m_conns[_socketNum];
+}
+
+static bool StoreConn(TCP_CL_t* _loop, ClientConn_t* _conn)
+{
+	uint newSize;
+	ClientConn_t** newConns;
+
+	if ((uint) _conn->m_socketFD >= _loop->m_connsSize)
+	{
+		/* socket numbers are small and dense, so a direct index table is enough */
+		newSize = _loop->m_connsSize ? _loop->m_connsSize : 64;
+		while (newSize <= (uint) _conn->m_socketFD)
+		{
+			newSize *= 2;
+		}
+
+		newConns = realloc(_loop->m_conns, newSize * sizeof(ClientConn_t*) );
+		if (! newConns)
+		{
+			return FALSE;
+		}
+		memset(newConns + _loop->m_connsSize, 0, (newSize - _loop->m_connsSize) * sizeof(ClientConn_t*) );
+
+		_loop->m_conns = newConns;
+		_loop->m_connsSize = newSize;
+	}
+
+	_loop->m_conns[_conn->m_socketFD] = _conn;
+	return TRUE;
+}
+
+static void CloseConn(TCP_CL_t* _loop, ClientConn_t* _conn)
+{
+	if (NULL == _conn || _conn->m_magicNumber != CONN_MAGIC_NUMBER)
+	{
+		return;
+	}
+
+	_loop->m_conns[_conn->m_socketFD] = NULL;
+	_loop->m_connectedNum--;
+
+	/* closing the socket removes it from the epoll set */
+	close(_conn->m_socketFD);
+
+	_conn->m_magicNumber = -1;
+	free(_conn->m_outBuf);
+	free(_conn);
+	return;
+}
+
+static bool WatchWrite(TCP_CL_t* _loop, ClientConn_t* _conn, bool _isWatch)
+{
+	struct epoll_event event;
+
+	if (_conn->m_isWriteWatched == _isWatch)
+	{
+		return TRUE;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = _isWatch ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+	event.data.fd = _conn->m_socketFD;
+	if (epoll_ctl(_loop->m_epollFD, EPOLL_CTL_MOD, _conn->m_socketFD, &event) < 0)
+	{
+		perror("ClientLoop epoll_ctl Failed");
+		return FALSE;
+	}
+
+	_conn->m_isWriteWatched = _isWatch;
+	return TRUE;
+}
+
+static bool QueueOut(ClientConn_t* _conn, const char* _msg, uint _msgLength)
+{
+	uint newCapacity;
+	char* newBuf;
+
+	if (_conn->m_outLength + _msgLength > _conn->m_outCapacity)
+	{
+		newCapacity = _conn->m_outCapacity ? _conn->m_outCapacity : MIN_OUT_BUFFER;
+		while (newCapacity < _conn->m_outLength + _msgLength)
+		{
+			newCapacity *= 2;
+		}
+
+		newBuf = realloc(_conn->m_outBuf, newCapacity);
+		if (! newBuf)
+		{
+			return FALSE;
+		}
+		_conn->m_outBuf = newBuf;
+		_conn->m_outCapacity = newCapacity;
+	}
+
+	memcpy(_conn->m_outBuf + _conn->m_outLength, _msg, _msgLength);
+	_conn->m_outLength += _msgLength;
+
+	return TRUE;
+}
+
+/* returns the bytes left in the queue, or negative number on error */
+static int FlushOut(ClientConn_t* _conn)
+{
+	int sent_bytes;
+
+	while (_conn->m_outLength > 0)
+	{
+		sent_bytes = send(_conn->m_socketFD, _conn->m_outBuf, _conn->m_outLength, MSG_NOSIGNAL);
+		if (sent_bytes < 0)
+		{
+			return IsFail_nonBlocking(sent_bytes) ? GENERAL_ERROR : (int) _conn->m_outLength;
+		}
+
+		memmove(_conn->m_outBuf, _conn->m_outBuf + sent_bytes, _conn->m_outLength - sent_bytes);
+		_conn->m_outLength -= sent_bytes;
+	}
+
+	/* an idle connection should not hold memory */
+	free(_conn->m_outBuf);
+	_conn->m_outBuf = NULL;
+	_conn->m_outCapacity = 0;
+
+	return 0;
+}
+
+static void HandleConnecting(TCP_CL_t* _loop, ClientConn_t* _conn)
+{
+	int socketError = 0;
+	socklen_t errorLength = sizeof(socketError);
+	int socketNum = _conn->m_socketFD;
+
+	if (getsockopt(socketNum, SOL_SOCKET, SO_ERROR, &socketError, &errorLength) < 0 || socketError != 0)
+	{
+		CloseConn(_loop, _conn);
+		if (_loop->m_connectFunc)
+		{
+			_loop->m_connectFunc(socketNum, FALSE, _loop->m_contex);
+		}
+		return;
+	}
+
+	_conn->m_state = CONN_CONNECTED;
+
+	if (_loop->m_connectFunc)
+	{
+		_loop->m_connectFunc(socketNum, TRUE, _loop->m_contex);
+	}
+
+	/* the user might have closed it inside the function */
+	if (GetConn(_loop, socketNum) == _conn)
+	{
+		HandleWritable(_loop, _conn);
+	}
+}
+
+static void HandleWritable(TCP_CL_t* _loop, ClientConn_t* _conn)
+{
+	int left = FlushOut(_conn);
+	int socketNum = _conn->m_socketFD;
+
+	if (left < 0)
+	{
+		CloseConn(_loop, _conn);
+		if (_loop->m_disconnectFunc)
+		{
+			_loop->m_disconnectFunc(socketNum, _loop->m_contex);
+		}
+		return;
+	}
+
+	WatchWrite(_loop, _conn, left > 0);
+}
+
+static void HandleReadable(TCP_CL_t* _loop, ClientConn_t* _conn)
+{
+	int socketNum = _conn->m_socketFD;
+	int nBytesRead;
+
+	nBytesRead = recv(socketNum, _loop->m_readBuffer, CLIENT_LOOP_READ_SIZE, 0);
+	if (nBytesRead > 0)
+	{
+		_loop->m_reciveDataFunc(_loop->m_readBuffer, nBytesRead, socketNum, _loop->m_contex);
+		return;
+	}
+
+	if (nBytesRead == 0 || IsFail_nonBlocking(nBytesRead) )
+	{
+		/* closed on server side, or a real error */
+		CloseConn(_loop, _conn);
+		if (_loop->m_disconnectFunc)
+		{
+			_loop->m_disconnectFunc(socketNum, _loop->m_contex);
+		}
+	}
+}
+
+/** Returns true on success, or false if there was an error */
+static bool SetSocketBlockingEnabled(int fd, bool blocking)
+{
+	if (fd < 0) return FALSE;
+
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0) return FALSE;
+	flags = blocking ? (flags&~O_NONBLOCK) : (flags|O_NONBLOCK);
+	return (fcntl(fd, F_SETFL, flags) == 0) ? TRUE : FALSE;
+}
+
+static bool IsFail_nonBlocking(int _result)
+{
+	return (0 > _result && errno != EAGAIN && errno != EWOULDBLOCK);
+}
@@ -0,0 +1,133 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief An event loop that drives many non-blocking TCP client connections from a single thread.
+ * Connections are identified by their socket number, the same way the server identify its clients.
+ * Data is delivered as raw bytes, no sanity check is done on it.
+ *
+ * @bug
+ */
+
+#ifndef TCP_CLIENT_LOOP_H_
+#define TCP_CLIENT_LOOP_H_
+
+#include <sys/types.h> /* size_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* size of the single read buffer shared by all connections of a loop */
+#define CLIENT_LOOP_READ_SIZE 16384
+
+/**
+ * @brief invoked when a connect attempt ended. when _isConnected is FALSE the socket is already closed.
+ */
+typedef int (*clientLoopConnectFunc)(uint _socketNum, bool _isConnected, void* _contex);
+/**
+ * @brief invoked when data arrived on a connection. _data is valid only until the function returns.
+ */
+typedef int (*clientLoopDataFunc)(void* _data, size_t _sizeData, uint _socketNum, void* _contex);
+/**
+ * @brief invoked when an established connection was closed, either by the server or because of an error.
+ */
+typedef int (*clientLoopDisconnectFunc)(uint _socketNum, void* _contex);
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_CL TCP_CL_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create an empty client loop.
+ * @param _maxConnections max number of simultaneous connections the loop would hold. the process file descriptor limit must allow it.
+ * @param _connectFunc user function to invoke when a connect attempt completes. can be left NULL.
+ * @param _reciveDataFunc user function to invoke when data is recived. must not be NULL.
+ * @param _disconnectFunc user function to invoke when a connection is closed. can be left NULL.
+ * @param _contex user pointer passed to all the functions above.
+ * @return a pointer to the struct. NULL if failed.
+ */
+TCP_CL_t* TCP_CreateClientLoop(uint _maxConnections,
+						clientLoopConnectFunc _connectFunc,
+						clientLoopDataFunc _reciveDataFunc,
+						clientLoopDisconnectFunc _disconnectFunc,
+						void* _contex
+						);
+
+/**
+ * @brief close all connections (without invoking the disconnect function) and free the loop.
+ * @param _loop pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_DestroyClientLoop(TCP_CL_t* _loop);
+
+/**
+ * @brief start a non-blocking connect to a server. the result is reported by the connect function.
+ * @param _loop pointer to the struct
+ * @param _serverIP the ip address (ipv4 or ipv6) of the server, or "unix:/path" for a Unix domain socket.
+ * @param _serverPort the server listening port. ignored for Unix sockets.
+ * @return the socket number of the new connection, or negative number on error.
+ */
+int TCP_ClientLoopConnect(TCP_CL_t* _loop, const char* _serverIP, uint _serverPort);
+
+/**
+ * @brief non-blocking send. what the kernel would not take right now is queued and sent when the socket become writable.
+ * can be called while the connection is still connecting.
+ * @param _loop pointer to the struct
+ * @param _socketNum the connection to send on
+ * @param _msg the data to be send
+ * @param _msgLength the data send size
+ * @return _msgLength when the data was sent or queued. negative number represent error.
+ */
+int TCP_ClientLoopSend(TCP_CL_t* _loop, uint _socketNum, const void* _msg, uint _msgLength);
+
+/**
+ * @brief close a connection. the disconnect function is not invoked.
+ * @param _loop pointer to the struct
+ * @param _socketNum the connection to close
+ * @return TRUE if the connection was found and closed.
+ */
+bool TCP_ClientLoopDisconnect(TCP_CL_t* _loop, uint _socketNum);
+
+/**
+ * @brief wait once for events and dispatch them.
+ * @param _loop pointer to the struct
+ * @param _timeoutMS max wait time. -1 to wait until something happen.
+ * @return number of events handled, or negative number on error.
+ */
+int TCP_ClientLoopRunOnce(TCP_CL_t* _loop, int _timeoutMS);
+
+/**
+ * @brief run the loop until TCP_StopClientLoop is called.
+ * @param _loop pointer to the struct
+ * @return TRUE when stopped normally or FALSE when failed.
+ */
+bool TCP_RunClientLoop(TCP_CL_t* _loop);
+
+/**
+ * @brief stop TCP_RunClientLoop. safe to call from a signal handler or another thread.
+ * @param _loop pointer to the struct
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_StopClientLoop(TCP_CL_t* _loop);
+
+/**
+ * @brief get the number of connections held by the loop, including those that are still connecting.
+ * @param _loop pointer to the struct
+ * @return number of connections, or negative number on error.
+ */
+int TCP_ClientLoopConnectionsNum(TCP_CL_t* _loop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCP_CLIENT_LOOP_H_ */
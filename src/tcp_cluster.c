@@ -0,0 +1,525 @@
+/*
+ * tcp_cluster.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "tcp_cluster.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+
+#define GENERAL_ERROR -9
+
+#define SERVER_NAME_SIZE 128 /* an ip, or unix: and a socket path */
+
+#define FNV64_OFFSET 14695981039346656037ull
+#define FNV64_PRIME 1099511628211ull
+#define GOLDEN64 0x9e3779b97f4a7c15ull
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Node
+{
+	bool m_isUsed;
+	char m_serverIP[SERVER_NAME_SIZE];
+	uint m_serverPort;
+	uint64_t m_hash; /* of its address. its points on the ring are taken from it */
+
+	TCP_C_t* m_client; /* NULL until first used, and while down */
+	uint64_t m_retryAtMS; /* not connected again before. 0 when it did not fail */
+
+	unsigned long m_requests;
+	unsigned long m_failures;
+} Node_t;
+
+typedef struct Point
+{
+	uint64_t m_position;
+	uint m_nodeID;
+} Point_t;
+
+struct TCP_Cluster
+{
+	int m_magicNumber;
+
+	uint m_virtualNodes;
+	uint m_timeoutMS; /* of a connect, and of a request */
+	uint m_retryMS;
+
+	Node_t m_nodes[TCP_CLUSTER_MAX_NODES];
+	uint m_nodesNum;
+
+	/* the points of all the servers, sorted by position. rebuilt when a server is added or removed */
+	Point_t* m_ring;
+	uint m_pointsNum;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool BuildRing(TCP_Cluster_t* _cluster);
+static int ComparePoints(const void* _a, const void* _b);
+static uint FindPoint(TCP_Cluster_t* _cluster, uint64_t _hash);
+static TCP_C_t* Connect(TCP_Cluster_t* _cluster, Node_t* _node);
+static int Exchange(TCP_Cluster_t* _cluster, TCP_C_t* _client, const void* _msg, uint _msgLength, void* _answer, uint _answerMaxLength);
+static bool WaitSocket(int _socketFD, short _events, uint64_t _deadlineMS);
+static void CloseNode(Node_t* _node);
+static uint64_t HashKey(const void* _key, size_t _keyLength);
+static uint64_t Mix(uint64_t _value);
+static uint64_t NowMS(void);
+static bool IsNodeValid(TCP_Cluster_t* _cluster, int _nodeID);
+static bool IsStructValid(TCP_Cluster_t* _cluster);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Cluster_t* TCP_CreateCluster(uint _virtualNodes, uint _timeoutMS, uint _retryMS)
+{
+	TCP_Cluster_t* aCluster;
+
+	aCluster = calloc(1, sizeof(TCP_Cluster_t) );
+	if (! aCluster)
+	{
+		return NULL;
+	}
+
+	aCluster->m_virtualNodes = _virtualNodes ? _virtualNodes : TCP_CLUSTER_DEFAULT_VNODES;
+	aCluster->m_timeoutMS = _timeoutMS ? _timeoutMS : DEFAULT_CONNECT_TIMEOUT_MS;
+	aCluster->m_retryMS = _retryMS;
+	aCluster->m_ring = NULL;
+	aCluster->m_pointsNum = 0;
+
+	aCluster->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return aCluster;
+}
+
+void TCP_DestroyCluster(TCP_Cluster_t* _cluster)
+{
+	uint i;
+
+	if (! IsStructValid(_cluster) )
+	{
+		return;
+	}
+
+	_cluster->m_magicNumber = DEAD_MAGIC_NUMBER;
+	for (i = 0; i < TCP_CLUSTER_MAX_NODES; ++i)
+	{
+		CloseNode(&_cluster->m_nodes[i]);
+	}
+	free(_cluster->m_ring);
+	free(_cluster);
+}
+
+int TCP_ClusterAddNode(TCP_Cluster_t* _cluster, const char* _serverIP, uint _serverPort)
+{
+	char name[SERVER_NAME_SIZE + 16];
+	Node_t* node;
+	int nodeID = -1;
+	int i;
+
+	if (! IsStructValid(_cluster) || NULL == _serverIP || strlen(_serverIP) >= SERVER_NAME_SIZE)
+	{
+		return GENERAL_ERROR;
+	}
+
+	for (i = TCP_CLUSTER_MAX_NODES - 1; i >= 0; --i)
+	{
+		node = &_cluster->m_nodes[i];
+		if (! node->m_isUsed)
+		{
+			nodeID = i;
+		}
+		else if (node->m_serverPort == _serverPort && 0 == strcmp(node->m_serverIP, _serverIP) )
+		{
+			return GENERAL_ERROR;
+		}
+	}
+	if (nodeID < 0)
+	{
+		return GENERAL_ERROR;
+	}
+
+	node = &_cluster->m_nodes[nodeID];
+	memset(node, 0, sizeof(Node_t) );
+	strcpy(node->m_serverIP, _serverIP);
+	node->m_serverPort = _serverPort;
+	/* by its address, so a server has the same points in every client, whatever the order it was added in */
+	snprintf(name, sizeof(name), "%s:%u", _serverIP, _serverPort);
+	node->m_hash = HashKey(name, strlen(name) );
+	node->m_isUsed = TRUE;
+	_cluster->m_nodesNum++;
+
+	if (! BuildRing(_cluster) )
+	{
+		node->m_isUsed = FALSE;
+		_cluster->m_nodesNum--;
+		return GENERAL_ERROR;
+	}
+	return nodeID;
+}
+
+bool TCP_ClusterRemoveNode(TCP_Cluster_t* _cluster, int _nodeID)
+{
+	if (! IsStructValid(_cluster) || ! IsNodeValid(_cluster, _nodeID) )
+	{
+		return FALSE;
+	}
+
+	CloseNode(&_cluster->m_nodes[_nodeID]);
+	_cluster->m_nodes[_nodeID].m_isUsed = FALSE;
+	_cluster->m_nodesNum--;
+	/* a smaller ring always fits the array of the bigger one */
+	BuildRing(_cluster);
+	return TRUE;
+}
+
+int TCP_ClusterOwner(TCP_Cluster_t* _cluster, const void* _key, size_t _keyLength)
+{
+	if (! IsStructValid(_cluster) || 0 == _cluster->m_pointsNum || (NULL == _key && _keyLength > 0) )
+	{
+		return GENERAL_ERROR;
+	}
+
+	return _cluster->m_ring[FindPoint(_cluster, HashKey(_key, _keyLength) )].m_nodeID;
+}
+
+TCP_C_t* TCP_ClusterPick(TCP_Cluster_t* _cluster, const void* _key, size_t _keyLength, int* _nodeID)
+{
+	uint64_t tried = 0; /* a bit for each node ID */
+	uint triedNum = 0;
+	TCP_C_t* client;
+	uint nodeID;
+	uint point;
+	uint i;
+
+	if (! IsStructValid(_cluster) || 0 == _cluster->m_pointsNum || (NULL == _key && _keyLength > 0) )
+	{
+		return NULL;
+	}
+
+	/* clockwise from the key. the first point of every server is its place in the order of replicas */
+	point = FindPoint(_cluster, HashKey(_key, _keyLength) );
+	for (i = 0; i < _cluster->m_pointsNum && triedNum < _cluster->m_nodesNum; ++i, point = (point + 1) % _cluster->m_pointsNum)
+	{
+		nodeID = _cluster->m_ring[point].m_nodeID;
+		if (tried & (1ull << nodeID) )
+		{
+			continue;
+		}
+		tried |= 1ull << nodeID;
+		++triedNum;
+
+		client = Connect(_cluster, &_cluster->m_nodes[nodeID]);
+		if (client)
+		{
+			if (_nodeID)
+			{
+				*_nodeID = nodeID;
+			}
+			return client;
+		}
+	}
+	return NULL;
+}
+
+void TCP_ClusterFailed(TCP_Cluster_t* _cluster, int _nodeID)
+{
+	Node_t* node;
+
+	if (! IsStructValid(_cluster) || ! IsNodeValid(_cluster, _nodeID) )
+	{
+		return;
+	}
+
+	node = &_cluster->m_nodes[_nodeID];
+	CloseNode(node);
+	node->m_retryAtMS = NowMS() + _cluster->m_retryMS;
+	node->m_failures++;
+}
+
+int TCP_ClusterRequest(TCP_Cluster_t* _cluster, const void* _key, size_t _keyLength, void* _msg, uint _msgLength,
+					void* _answer, uint _answerMaxLength, int* _nodeID)
+{
+	TCP_C_t* client;
+	int nodeID;
+	int result;
+	uint attempts;
+
+	if (! IsStructValid(_cluster) || NULL == _msg || NULL == _answer)
+	{
+		return GENERAL_ERROR;
+	}
+
+	/* every failure takes its server out of the ring until its retry, so the next pick is the next replica */
+	for (attempts = 0; attempts < _cluster->m_nodesNum; ++attempts)
+	{
+		client = TCP_ClusterPick(_cluster, _key, _keyLength, &nodeID);
+		if (! client)
+		{
+			break;
+		}
+
+		result = Exchange(_cluster, client, _msg, _msgLength, _answer, _answerMaxLength);
+		if (result > 0)
+		{
+			_cluster->m_nodes[nodeID].m_requests++;
+			if (_nodeID)
+			{
+				*_nodeID = nodeID;
+			}
+			return result;
+		}
+		TCP_ClusterFailed(_cluster, nodeID);
+	}
+	return GENERAL_ERROR;
+}
+
+bool TCP_ClusterNodeStatus(TCP_Cluster_t* _cluster, int _nodeID, bool* _isUp, unsigned long* _requests, unsigned long* _failures)
+{
+	Node_t* node;
+
+	if (! IsStructValid(_cluster) || ! IsNodeValid(_cluster, _nodeID) )
+	{
+		return FALSE;
+	}
+
+	node = &_cluster->m_nodes[_nodeID];
+	if (_isUp)
+	{
+		*_isUp = (node->m_client != NULL || NowMS() >= node->m_retryAtMS);
+	}
+	if (_requests)
+	{
+		*_requests = node->m_requests;
+	}
+	if (_failures)
+	{
+		*_failures = node->m_failures;
+	}
+	return TRUE;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* every server at m_virtualNodes points, sorted. O(points log points), a few milliseconds for a full cluster */
+static bool BuildRing(TCP_Cluster_t* _cluster)
+{
+	uint pointsNum = _cluster->m_nodesNum * _cluster->m_virtualNodes;
+	Point_t* ring;
+	uint used = 0;
+	uint i;
+	uint v;
+
+	ring = _cluster->m_ring;
+	if (pointsNum > _cluster->m_pointsNum)
+	{
+		ring = realloc(_cluster->m_ring, pointsNum * sizeof(Point_t) );
+		if (! ring)
+		{
+			return FALSE;
+		}
+		_cluster->m_ring = ring;
+	}
+
+	for (i = 0; i < TCP_CLUSTER_MAX_NODES; ++i)
+	{
+		if (! _cluster->m_nodes[i].m_isUsed)
+		{
+			continue;
+		}
+		for (v = 0; v < _cluster->m_virtualNodes; ++v)
+		{
+			ring[used].m_position = Mix(_cluster->m_nodes[i].m_hash + (v + 1) * GOLDEN64);
+			ring[used].m_nodeID = i;
+			++used;
+		}
+	}
+
+	qsort(ring, used, sizeof(Point_t), ComparePoints);
+	_cluster->m_pointsNum = used;
+	return TRUE;
+}
+
+static int ComparePoints(const void* _a, const void* _b)
+{
+	const Point_t* a = _a;
+	const Point_t* b = _b;
+
+	if (a->m_position != b->m_position)
+	{
+		return (a->m_position > b->m_position) - (a->m_position < b->m_position);
+	}
+	/* the same in every client */
+	return (int) a->m_nodeID - (int) b->m_nodeID;
+}
+
+/* the first point at or after _hash, around the end of the ring back to 0 */
+static uint FindPoint(TCP_Cluster_t* _cluster, uint64_t _hash)
+{
+	uint low = 0;
+	uint high = _cluster->m_pointsNum;
+	uint middle;
+
+	while (low < high)
+	{
+		middle = low + (high - low) / 2;
+		if (_cluster->m_ring[middle].m_position < _hash)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return (low == _cluster->m_pointsNum) ? 0 : low;
+}
+
+/* the connection of the node, made now if it has none. NULL while it waits for its retry, or when it can not be reached */
+static TCP_C_t* Connect(TCP_Cluster_t* _cluster, Node_t* _node)
+{
+	if (_node->m_client)
+	{
+		return _node->m_client;
+	}
+	if (_node->m_retryAtMS > 0 && NowMS() < _node->m_retryAtMS)
+	{
+		return NULL;
+	}
+
+	_node->m_client = TCP_CreateClientTimeout(_node->m_serverIP, _node->m_serverPort, _cluster->m_timeoutMS, FALSE);
+	if (! _node->m_client)
+	{
+		_node->m_retryAtMS = NowMS() + _cluster->m_retryMS;
+		_node->m_failures++;
+		return NULL;
+	}
+	_node->m_retryAtMS = 0;
+	return _node->m_client;
+}
+
+/* one request and one read of its answer, both within the timeout. a server that closed the connection fails the send
+ * instead of raising SIGPIPE, and a hung one fails the wait, so the request moves on to the next replica */
+static int Exchange(TCP_Cluster_t* _cluster, TCP_C_t* _client, const void* _msg, uint _msgLength, void* _answer, uint _answerMaxLength)
+{
+	uint64_t deadlineMS = NowMS() + _cluster->m_timeoutMS;
+	int socketFD = TCP_ClientGetSocket(_client);
+	uint sentBytes = 0;
+	int result;
+
+	if (socketFD < 0)
+	{
+		return GENERAL_ERROR;
+	}
+
+	while (sentBytes < _msgLength)
+	{
+		if (! WaitSocket(socketFD, POLLOUT, deadlineMS) )
+		{
+			return GENERAL_ERROR;
+		}
+		result = send(socketFD, (const char*) _msg + sentBytes, _msgLength - sentBytes, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			return GENERAL_ERROR;
+		}
+		if (result > 0)
+		{
+			sentBytes += result;
+		}
+	}
+
+	if (! WaitSocket(socketFD, POLLIN, deadlineMS) )
+	{
+		return GENERAL_ERROR;
+	}
+	result = recv(socketFD, _answer, _answerMaxLength, MSG_DONTWAIT);
+	return (result > 0) ? result : GENERAL_ERROR;
+}
+
+/* FALSE if the deadline passed first */
+static bool WaitSocket(int _socketFD, short _events, uint64_t _deadlineMS)
+{
+	struct pollfd pollFD;
+	uint64_t now;
+	int ready;
+
+	pollFD.fd = _socketFD;
+	pollFD.events = _events;
+	do
+	{
+		now = NowMS();
+		if (now >= _deadlineMS)
+		{
+			return FALSE;
+		}
+		ready = poll(&pollFD, 1, _deadlineMS - now);
+	}
+	while (ready < 0 && errno == EINTR);
+
+	return ready > 0;
+}
+
+static void CloseNode(Node_t* _node)
+{
+	if (_node->m_client)
+	{
+		TCP_DestroyClient(_node->m_client);
+		_node->m_client = NULL;
+	}
+}
+
+/* FNV-1a spreads similar keys badly on its own ("key1", "key2"), the mix fixes the high bits the ring sorts by */
+static uint64_t HashKey(const void* _key, size_t _keyLength)
+{
+	const unsigned char* bytes = _key;
+	uint64_t hash = FNV64_OFFSET;
+	size_t i;
+
+	for (i = 0; i < _keyLength; ++i)
+	{
+		hash = (hash ^ bytes[i]) * FNV64_PRIME;
+	}
+	return Mix(hash);
+}
+
+/* the splitmix64 finalizer */
+static uint64_t Mix(uint64_t _value)
+{
+	_value ^= _value >> 30;
+	_value *= 0xbf58476d1ce4e5b9ull;
+	_value ^= _value >> 27;
+	_value *= 0x94d049bb133111ebull;
+	_value ^= _value >> 31;
+	return _value;
+}
+
+static uint64_t NowMS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static bool IsNodeValid(TCP_Cluster_t* _cluster, int _nodeID)
+{
+	return (_nodeID >= 0 && _nodeID < TCP_CLUSTER_MAX_NODES && _cluster->m_nodes[_nodeID].m_isUsed);
+}
+
+static bool IsStructValid(TCP_Cluster_t* _cluster)
+{
+	return (_cluster && _cluster->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
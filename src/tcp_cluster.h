@@ -0,0 +1,123 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Client side sharding over several servers. Every request has a key, and goes to the server that owns the key
+ * on a consistent hash ring. Each server is placed on the ring at many points (virtual nodes) so the keys are spread
+ * evenly, and adding or removing a server moves only the keys of its own share, about 1/N of them.
+ * A server that is down is skipped: the key goes to the next server on the ring, its replica, until the server is
+ * retried after _retryMS. Connections are made on first use, a server that is down when added is not a failure.
+ * Not thread safe, as TCP_C. one cluster per thread.
+ *
+ * @bug TCP_ClusterRequest sends again to the replica when the answer did not come, so a request the failed server
+ * already carried out runs twice. requests should be safe to repeat.
+ */
+
+#ifndef TCP_CLUSTER_H_
+#define TCP_CLUSTER_H_
+
+#include <stddef.h>
+
+#include "tcp_client.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define TCP_CLUSTER_MAX_NODES 64
+/* points of a server on the ring. more spreads the keys more evenly, at a bigger ring */
+#define TCP_CLUSTER_DEFAULT_VNODES 160
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_Cluster TCP_Cluster_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create an empty cluster.
+ * @param _virtualNodes points of each server on the ring. 0 for TCP_CLUSTER_DEFAULT_VNODES.
+ * @param _timeoutMS give up connecting to a server, or on a request to it (sending it and waiting for its answer), after
+ * this time (miliSeconds). 0 for DEFAULT_CONNECT_TIMEOUT_MS.
+ * @param _retryMS a server that failed is skipped for this long (miliSeconds) before it is connected again.
+ * @return pointer to the newly create struct. NULL if failed.
+ */
+TCP_Cluster_t* TCP_CreateCluster(uint _virtualNodes, uint _timeoutMS, uint _retryMS);
+
+/**
+ * @brief Close the connections to all the servers and free.
+ * @param _cluster pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_DestroyCluster(TCP_Cluster_t* _cluster);
+
+/**
+ * @brief Add a server. it takes its share of the keys at once.
+ * @param _cluster pointer to the struct
+ * @param _serverIP the ip address of the server, as TCP_CreateClient
+ * @param _serverPort the port of the server
+ * @return the node ID of the server, 0 to TCP_CLUSTER_MAX_NODES - 1. negative number if failed (full, or added already).
+ */
+int TCP_ClusterAddNode(TCP_Cluster_t* _cluster, const char* _serverIP, uint _serverPort);
+
+/**
+ * @brief Remove a server and close its connection. its keys go to the servers after it on the ring. its ID may be reused.
+ * @param _cluster pointer to the struct
+ * @param _nodeID as TCP_ClusterAddNode returned
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_ClusterRemoveNode(TCP_Cluster_t* _cluster, int _nodeID);
+
+/**
+ * @brief The server that owns a key, up or down.
+ * @param _cluster pointer to the struct
+ * @param _key any bytes
+ * @param _keyLength its size
+ * @return the node ID. negative number if there are no servers.
+ */
+int TCP_ClusterOwner(TCP_Cluster_t* _cluster, const void* _key, size_t _keyLength);
+
+/**
+ * @brief The connection for a key: of its owner, or of the next server on the ring that can be reached.
+ * @param _cluster pointer to the struct
+ * @param _key any bytes
+ * @param _keyLength its size
+ * @param _nodeID output. the server of the connection. can be left NULL.
+ * @return a connected client, which stays the cluster's. NULL when no server can be reached.
+ */
+TCP_C_t* TCP_ClusterPick(TCP_Cluster_t* _cluster, const void* _key, size_t _keyLength, int* _nodeID);
+
+/**
+ * @brief Tell the cluster a server failed the user: its connection is closed and it is skipped until it is retried.
+ * @param _cluster pointer to the struct
+ * @param _nodeID the server
+ * @return void. silent fail.
+ */
+void TCP_ClusterFailed(TCP_Cluster_t* _cluster, int _nodeID);
+
+/**
+ * @brief Send a request to the server of its key and read one answer. a server that fails the send or the answer, or
+ * does not answer within the timeout of the cluster, is marked failed and the request goes to the next one on the ring,
+ * at most once to every server. a closed connection does not raise SIGPIPE.
+ * @param _cluster pointer to the struct
+ * @param _key any bytes
+ * @param _keyLength its size
+ * @param _msg the request
+ * @param _msgLength its size
+ * @param _answer output. what one read of the answer returned.
+ * @param _answerMaxLength the size of _answer
+ * @param _nodeID output. the server that answered. can be left NULL.
+ * @return the size of the answer. negative number if no server answered.
+ */
+int TCP_ClusterRequest(TCP_Cluster_t* _cluster, const void* _key, size_t _keyLength, void* _msg, uint _msgLength,
+					void* _answer, uint _answerMaxLength, int* _nodeID);
+
+/**
+ * @brief How a server is doing.
+ * @param _cluster pointer to the struct
+ * @param _nodeID the server
+ * @param _isUp output. FALSE while it is skipped after a failure. can be left NULL.
+ * @param _requests output. requests it answered by TCP_ClusterRequest. can be left NULL.
+ * @param _failures output. times it failed. can be left NULL.
+ * @return TRUE if success or FALSE if failed (no such server).
+ */
+bool TCP_ClusterNodeStatus(TCP_Cluster_t* _cluster, int _nodeID, bool* _isUp, unsigned long* _requests, unsigned long* _failures);
+
+#endif /* TCP_CLUSTER_H_ */
@@ -0,0 +1,482 @@
+/*
+ * tcp_compress.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h> /* htonl, ntohl */
+
+#include "tcp_compress.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define HASH_LOG 12
+#define HASH_SIZE (1 << HASH_LOG)
+
+/* a token holds 4 bits of each length, 15 means more length bytes follow */
+#define TOKEN_RUN_MASK 15
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+struct TCP_Dict
+{
+	int m_magicNumber;
+
+	unsigned char* m_data;
+	uint m_length;
+	uint32_t m_ID;
+
+	/* the dictionary positions, hashed once here instead of on every message */
+	uint32_t m_table[HASH_SIZE];
+};
+
+/* the dictionary is seen as if it was right before the message. positions count from its start */
+typedef struct Window
+{
+	const unsigned char* m_dict;
+	uint m_dictLength;
+	const unsigned char* m_src;
+} Window_t;
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(const TCP_Dict_t* _dict);
+static uint32_t Read32(const unsigned char* _at);
+static uint Hash(uint32_t _value);
+static uint32_t WindowRead32(const Window_t* _window, uint _position);
+static uint MatchLength(const Window_t* _window, uint _candidate, uint _position, uint _srcLength);
+static unsigned char* WriteLength(unsigned char* _out, uint _length);
+static unsigned char* WriteSequence(unsigned char* _out, const unsigned char* _outLimit,
+									const unsigned char* _literals, uint _literalsLength, uint _offset, uint _matchLength);
+static bool ReadLength(const unsigned char** _in, const unsigned char* _inEnd, uint* _length);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Dict_t* TCP_CreateDictionary(const void* _data, uint _length)
+{
+	TCP_Dict_t* aDict;
+	uint32_t hash = FNV_OFFSET;
+	uint i;
+
+	if (NULL == _data || 0 == _length)
+	{
+		return NULL;
+	}
+	if (_length > TCP_DICT_MAX_SIZE)
+	{
+		_data = (const unsigned char*) _data + _length - TCP_DICT_MAX_SIZE;
+		_length = TCP_DICT_MAX_SIZE;
+	}
+
+	aDict = calloc(1, sizeof(TCP_Dict_t) );
+	if (! aDict)
+	{
+		return NULL;
+	}
+
+	aDict->m_data = malloc(_length);
+	if (! aDict->m_data)
+	{
+		free(aDict);
+		return NULL;
+	}
+	memcpy(aDict->m_data, _data, _length);
+	aDict->m_length = _length;
+
+	for (i = 0; i < _length; ++i)
+	{
+		hash = (hash ^ aDict->m_data[i]) * FNV_PRIME;
+	}
+	/* 0 is kept for no dictionary */
+	aDict->m_ID = hash ? hash : 1;
+
+	/* later positions overwrite earlier ones, so the end of the dictionary is preferred */
+	for (i = 0; i + MIN_MATCH <= _length; ++i)
+	{
+		aDict->m_table[Hash(Read32(aDict->m_data + i) )] = i + 1;
+	}
+
+	aDict->m_magicNumber = ALIVE_MAGIC_NUMBER;
+
+	return aDict;
+}
+
+void TCP_DestroyDictionary(TCP_Dict_t* _dict)
+{
+	if (! IsStructValid(_dict) )
+	{
+		return;
+	}
+
+	_dict->m_magicNumber = DEAD_MAGIC_NUMBER;
+	free(_dict->m_data);
+	free(_dict);
+}
+
+uint32_t TCP_DictionaryID(const TCP_Dict_t* _dict)
+{
+	return IsStructValid(_dict) ? _dict->m_ID : 0;
+}
+
+uint TCP_Compress(const void* _src, uint _srcLength, void* _dst, uint _dstMaxLength, const TCP_Dict_t* _dict)
+{
+	uint32_t table[HASH_SIZE]; /* position + 1 in the window, 0 for empty */
+	Window_t window;
+	const unsigned char* src = _src;
+	unsigned char* out = (unsigned char*) _dst + TCP_COMPRESS_LENGTH_SIZE;
+	const unsigned char* outLimit;
+	uint32_t originalLength;
+	uint32_t value;
+	uint position = 0;
+	uint anchor = 0;
+	uint candidate;
+	uint matchLength;
+	uint hash;
+
+	if (NULL == _src || NULL == _dst || _srcLength <= TCP_COMPRESS_LENGTH_SIZE || _dstMaxLength <= TCP_COMPRESS_LENGTH_SIZE)
+	{
+		return 0;
+	}
+
+	/* no gain, no point */
+	outLimit = (const unsigned char*) _dst + ((_dstMaxLength < _srcLength) ? _dstMaxLength : _srcLength - 1);
+
+	window.m_dict = NULL;
+	window.m_dictLength = 0;
+	window.m_src = src;
+	if (IsStructValid(_dict) )
+	{
+		window.m_dict = _dict->m_data;
+		window.m_dictLength = _dict->m_length;
+		memcpy(table, _dict->m_table, sizeof(table) );
+	}
+	else
+	{
+		memset(table, 0, sizeof(table) );
+	}
+
+	while (position + MIN_MATCH <= _srcLength)
+	{
+		value = Read32(src + position);
+		hash = Hash(value);
+		candidate = table[hash];
+		table[hash] = window.m_dictLength + position + 1;
+
+		if (candidate && window.m_dictLength + position - (candidate - 1) <= MAX_OFFSET
+			&& WindowRead32(&window, candidate - 1) == value)
+		{
+			matchLength = MIN_MATCH + MatchLength(&window, candidate - 1 + MIN_MATCH, position + MIN_MATCH, _srcLength);
+
+			out = WriteSequence(out, outLimit, src + anchor, position - anchor,
+								window.m_dictLength + position - (candidate - 1), matchLength);
+			if (! out)
+			{
+				return 0;
+			}
+
+			position += matchLength;
+			anchor = position;
+			continue;
+		}
+
+		/* skip faster over data that does not compress */
+		position += 1 + ((position - anchor) >> 6);
+	}
+
+	if (anchor < _srcLength)
+	{
+		out = WriteSequence(out, outLimit, src + anchor, _srcLength - anchor, 0, 0);
+		if (! out)
+		{
+			return 0;
+		}
+	}
+
+	originalLength = htonl(_srcLength);
+	memcpy(_dst, &originalLength, TCP_COMPRESS_LENGTH_SIZE);
+
+	return out - (unsigned char*) _dst;
+}
+
+uint TCP_CompressedLength(const void* _src, uint _srcLength)
+{
+	uint32_t originalLength;
+
+	if (NULL == _src || _srcLength < TCP_COMPRESS_LENGTH_SIZE)
+	{
+		return 0;
+	}
+
+	memcpy(&originalLength, _src, TCP_COMPRESS_LENGTH_SIZE);
+	return ntohl(originalLength);
+}
+
+int TCP_Decompress(const void* _src, uint _srcLength, void* _dst, uint _dstMaxLength, const TCP_Dict_t* _dict)
+{
+	const unsigned char* in = (const unsigned char*) _src + TCP_COMPRESS_LENGTH_SIZE;
+	const unsigned char* inEnd = (const unsigned char*) _src + _srcLength;
+	unsigned char* dst = _dst;
+	const unsigned char* dict = NULL;
+	uint dictLength = 0;
+	uint originalLength;
+	uint produced = 0;
+	uint literalsLength;
+	uint matchLength;
+	uint offset;
+	uint fromDict;
+	uint i;
+	unsigned char token;
+
+	originalLength = TCP_CompressedLength(_src, _srcLength);
+	if (NULL == _dst || 0 == originalLength || originalLength > _dstMaxLength)
+	{
+		return -1;
+	}
+	if (IsStructValid(_dict) )
+	{
+		dict = _dict->m_data;
+		dictLength = _dict->m_length;
+	}
+
+	while (in < inEnd)
+	{
+		token = *in++;
+
+		literalsLength = token >> 4;
+		if (literalsLength == TOKEN_RUN_MASK && ! ReadLength(&in, inEnd, &literalsLength) )
+		{
+			return -1;
+		}
+		if (literalsLength > (uint) (inEnd - in) || literalsLength > originalLength - produced)
+		{
+			return -1;
+		}
+		memcpy(dst + produced, in, literalsLength);
+		in += literalsLength;
+		produced += literalsLength;
+
+		if (in == inEnd)
+		{
+			/* the last sequence has no match */
+			break;
+		}
+
+		if (inEnd - in < 2)
+		{
+			return -1;
+		}
+		offset = in[0] | (in[1] << 8);
+		in += 2;
+
+		matchLength = token & TOKEN_RUN_MASK;
+		if (matchLength == TOKEN_RUN_MASK && ! ReadLength(&in, inEnd, &matchLength) )
+		{
+			return -1;
+		}
+		matchLength += MIN_MATCH;
+
+		if (0 == offset || offset > produced + dictLength || matchLength > originalLength - produced)
+		{
+			return -1;
+		}
+
+		if (offset > produced)
+		{
+			/* starts in the dictionary, and may run on into the message */
+			fromDict = offset - produced;
+			if (fromDict > matchLength)
+			{
+				fromDict = matchLength;
+			}
+			memcpy(dst + produced, dict + dictLength - (offset - produced), fromDict);
+			produced += fromDict;
+			matchLength -= fromDict;
+		}
+
+		if (offset >= matchLength)
+		{
+			memcpy(dst + produced, dst + produced - offset, matchLength);
+		}
+		else
+		{
+			/* overlapping, a repeated pattern. byte by byte repeats it */
+			for (i = 0; i < matchLength; ++i)
+			{
+				dst[produced + i] = dst[produced + i - offset];
+			}
+		}
+		produced += matchLength;
+	}
+
+	return (produced == originalLength) ? (int) produced : -1;
+}
+
+void TCP_CompressHelloEncode(uint _codec, uint32_t _dictID, unsigned char* _out)
+{
+	uint32_t dictID = htonl(_dictID);
+
+	_out[0] = (unsigned char) _codec;
+	memcpy(_out + 1, &dictID, 4);
+}
+
+bool TCP_CompressHelloDecode(const unsigned char* _in, uint _length, uint* _codec, uint32_t* _dictID)
+{
+	uint32_t dictID;
+
+	if (NULL == _in || _length < TCP_COMPRESS_HELLO_SIZE)
+	{
+		return FALSE;
+	}
+
+	*_codec = _in[0];
+	memcpy(&dictID, _in + 1, 4);
+	*_dictID = ntohl(dictID);
+	return TRUE;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(const TCP_Dict_t* _dict)
+{
+	return !(NULL == _dict || ALIVE_MAGIC_NUMBER != _dict->m_magicNumber);
+}
+
+static uint32_t Read32(const unsigned char* _at)
+{
+	uint32_t value;
+
+	memcpy(&value, _at, 4);
+	return value;
+}
+
+static uint Hash(uint32_t _value)
+{
+	return (_value * 2654435761u) >> (32 - HASH_LOG);
+}
+
+static uint32_t WindowRead32(const Window_t* _window, uint _position)
+{
+	unsigned char bytes[4];
+	uint i;
+
+	if (_position + 4 <= _window->m_dictLength)
+	{
+		return Read32(_window->m_dict + _position);
+	}
+	if (_position >= _window->m_dictLength)
+	{
+		return Read32(_window->m_src + _position - _window->m_dictLength);
+	}
+
+	/* across the dictionary end */
+	for (i = 0; i < 4; ++i)
+	{
+		bytes[i] = (_position + i < _window->m_dictLength) ? _window->m_dict[_position + i]
+															: _window->m_src[_position + i - _window->m_dictLength];
+	}
+	return Read32(bytes);
+}
+
+/* bytes matching after the first MIN_MATCH. _candidate is a window position, _position a message position */
+static uint MatchLength(const Window_t* _window, uint _candidate, uint _position, uint _srcLength)
+{
+	const unsigned char* src = _window->m_src;
+	uint length = 0;
+
+	/* the part of the candidate in the dictionary */
+	while (_candidate + length < _window->m_dictLength && _position + length < _srcLength
+			&& _window->m_dict[_candidate + length] == src[_position + length])
+	{
+		length++;
+	}
+	if (_candidate + length < _window->m_dictLength)
+	{
+		return length;
+	}
+
+	/* the rest of the candidate is in the message itself */
+	src = _window->m_src + (_candidate + length - _window->m_dictLength) - length;
+	while (_position + length < _srcLength && src[length] == _window->m_src[_position + length])
+	{
+		length++;
+	}
+	return length;
+}
+
+static unsigned char* WriteLength(unsigned char* _out, uint _length)
+{
+	while (_length >= 255)
+	{
+		*_out++ = 255;
+		_length -= 255;
+	}
+	*_out++ = (unsigned char) _length;
+	return _out;
+}
+
+/* _matchLength 0 for the last sequence. returns NULL when the output is full */
+static unsigned char* WriteSequence(unsigned char* _out, const unsigned char* _outLimit,
+									const unsigned char* _literals, uint _literalsLength, uint _offset, uint _matchLength)
+{
+	uint matchCode = _matchLength ? _matchLength - MIN_MATCH : 0;
+	unsigned char* token = _out;
+
+	/* token, length bytes, literals and offset, at most */
+	if ((uint) (_outLimit - _out) < 1 + _literalsLength / 255 + 1 + _literalsLength + 2 + matchCode / 255 + 1)
+	{
+		return NULL;
+	}
+
+	*token = ((_literalsLength < TOKEN_RUN_MASK) ? _literalsLength : TOKEN_RUN_MASK) << 4;
+	_out++;
+	if (_literalsLength >= TOKEN_RUN_MASK)
+	{
+		_out = WriteLength(_out, _literalsLength - TOKEN_RUN_MASK);
+	}
+	memcpy(_out, _literals, _literalsLength);
+	_out += _literalsLength;
+
+	if (0 == _matchLength)
+	{
+		return _out;
+	}
+
+	*_out++ = _offset & 0xff;
+	*_out++ = _offset >> 8;
+	*token |= (matchCode < TOKEN_RUN_MASK) ? matchCode : TOKEN_RUN_MASK;
+	if (matchCode >= TOKEN_RUN_MASK)
+	{
+		_out = WriteLength(_out, matchCode - TOKEN_RUN_MASK);
+	}
+
+	return _out;
+}
+
+static bool ReadLength(const unsigned char** _in, const unsigned char* _inEnd, uint* _length)
+{
+	unsigned char byte;
+
+	do
+	{
+		/* a real length is bounded by the frame size, this only stops an overflow */
+		if (*_in >= _inEnd || *_length > (1u << 30) )
+		{
+			return FALSE;
+		}
+		byte = *(*_in)++;
+		*_length += byte;
+	} while (byte == 255);
+
+	return TRUE;
+}
@@ -0,0 +1,129 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Per-message compression for framed connections.
+ * The codec is a small LZ77 in the LZ4 block layout: literal runs and back references, no entropy stage.
+ * It is fast enough to pay off against the system calls it saves on repetitive text.
+ * A dictionary of typical messages can be shared by both sides, so even short messages find matches.
+ *
+ * On the wire (see tcp_frame.h):
+ *   A HELLO frame offers compression, its payload is a codec byte and the dictionary ID. the peer answers with the same
+ *   frame, naming what it agrees to. nothing is compressed toward a peer before it answered.
+ *   A COMPRESSED frame payload is the original length (4 bytes, network order) and the compressed block.
+ *   Messages below a size threshold, or that did not get smaller, are sent as they are.
+ *
+ * @bug
+ */
+
+#ifndef TCP_COMPRESS_H_
+#define TCP_COMPRESS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define TCP_CODEC_NONE 0
+#define TCP_CODEC_LZ 1
+
+/* smaller messages rarely shrink enough to be worth it */
+#define TCP_COMPRESS_DEFAULT_THRESHOLD 128
+
+/* only the last 64KB of a dictionary can be referred to */
+#define TCP_DICT_MAX_SIZE (1 << 16)
+
+/* before the block in a COMPRESSED payload */
+#define TCP_COMPRESS_LENGTH_SIZE 4
+/* HELLO payload. codec and dictionary ID */
+#define TCP_COMPRESS_HELLO_SIZE 5
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_Dict TCP_Dict_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create a dictionary from sample messages. both sides must create it from the same bytes.
+ * @param _data samples, usually many typical messages back to back. the most common content should be at the end.
+ * @param _length the samples size. only the last TCP_DICT_MAX_SIZE bytes are used.
+ * @return pointer to the newly create struct. NULL if failed.
+ */
+TCP_Dict_t* TCP_CreateDictionary(const void* _data, uint _length);
+
+/**
+ * @brief free a dictionary. it must not be in use by a server or a pipeline.
+ * @param _dict pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_DestroyDictionary(TCP_Dict_t* _dict);
+
+/**
+ * @brief get the ID sent in the HELLO frame, a hash of the dictionary content.
+ * @param _dict pointer to the struct. can be NULL.
+ * @return the ID. 0 for no dictionary.
+ */
+uint32_t TCP_DictionaryID(const TCP_Dict_t* _dict);
+
+/**
+ * @brief compress a message into a COMPRESSED frame payload.
+ * @param _src the message
+ * @param _srcLength the message size
+ * @param _dst output
+ * @param _dstMaxLength output size. nothing longer than the message is written.
+ * @param _dict dictionary agreed with the peer. NULL for none.
+ * @return the payload size. 0 if the message does not get smaller.
+ */
+uint TCP_Compress(const void* _src, uint _srcLength, void* _dst, uint _dstMaxLength, const TCP_Dict_t* _dict);
+
+/**
+ * @brief get the original size of a COMPRESSED frame payload, to check the output is big enough.
+ * @param _src the payload
+ * @param _srcLength the payload size
+ * @return the original size. 0 if the payload is too short.
+ */
+uint TCP_CompressedLength(const void* _src, uint _srcLength);
+
+/**
+ * @brief decompress a COMPRESSED frame payload. the payload comes from the peer and is fully checked.
+ * @param _src the payload
+ * @param _srcLength the payload size
+ * @param _dst output
+ * @param _dstMaxLength output size
+ * @param _dict dictionary agreed with the peer. NULL for none.
+ * @return the message size, or negative number if the payload is broken or does not fit.
+ */
+int TCP_Decompress(const void* _src, uint _srcLength, void* _dst, uint _dstMaxLength, const TCP_Dict_t* _dict);
+
+/**
+ * @brief write a HELLO frame payload.
+ * @param _codec TCP_CODEC_LZ to offer or agree, TCP_CODEC_NONE to refuse
+ * @param _dictID the dictionary to use, 0 for none
+ * @param _out output. TCP_COMPRESS_HELLO_SIZE bytes.
+ * @return void
+ */
+void TCP_CompressHelloEncode(uint _codec, uint32_t _dictID, unsigned char* _out);
+
+/**
+ * @brief read a HELLO frame payload.
+ * @param _in the payload
+ * @param _length the payload size
+ * @param _codec output
+ * @param _dictID output
+ * @return TRUE if valid. FALSE if too short.
+ */
+bool TCP_CompressHelloDecode(const unsigned char* _in, uint _length, uint* _codec, uint32_t* _dictID);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCP_COMPRESS_H_ */
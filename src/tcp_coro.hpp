@@ -0,0 +1,792 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief C++20 coroutines over the server and the client loop, so request/response logic is written straight-line:
+ *
+ *     tcp::Task Echo(tcp::Connection& _conn)
+ *     {
+ *         while (tcp::Message msg = co_await _conn.read())
+ *         {
+ *             co_await _conn.write(msg);
+ *         }
+ *     }
+ *
+ * Everything runs on the library's own single-threaded loop (TCP_RunServer / TCP_RunClientLoop). A read that has
+ * nothing yet suspends the coroutine, and the loop resumes it from the data function. A write never suspends,
+ * what the socket does not take is queued by the library.
+ *
+ * Awaiting allocates nothing. The awaiters live in the coroutine frame, and the frames come from a free list
+ * (FramePool below), so a new connection reuses the frame of an old one.
+ * On the server a message is the pooled buffer itself (tcp_buffer.h), and writing it back does not copy it.
+ *
+ * @bug the loop is single threaded, so are the coroutines. do not resume them from another thread.
+ */
+
+#ifndef TCP_CORO_HPP_
+#define TCP_CORO_HPP_
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "tcp.hpp"
+
+namespace tcp
+{
+
+class Connection;
+
+namespace detail
+{
+
+/* ~~~ Frame pool ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* coroutine frames by size, in steps of FRAME_STEP. bigger ones go to the heap */
+class FramePool
+{
+public:
+	static void* Alloc(std::size_t _size)
+	{
+		std::size_t bucket = Bucket(_size);
+		void* frame;
+
+		if (bucket >= BUCKETS_NUM)
+		{
+			return ::operator new(_size);
+		}
+		frame = s_free[bucket];
+		if (frame)
+		{
+			s_free[bucket] = *static_cast<void**>(frame);
+			return frame;
+		}
+		return ::operator new((bucket + 1) * FRAME_STEP);
+	}
+
+	static void Free(void* _frame, std::size_t _size)
+	{
+		std::size_t bucket = Bucket(_size);
+
+		if (bucket >= BUCKETS_NUM)
+		{
+			::operator delete(_frame);
+			return;
+		}
+		*static_cast<void**>(_frame) = s_free[bucket];
+		s_free[bucket] = _frame;
+	}
+
+private:
+	static constexpr std::size_t FRAME_STEP = 128;
+	static constexpr std::size_t BUCKETS_NUM = 64;
+
+	static std::size_t Bucket(std::size_t _size)
+	{
+		return (_size - 1) / FRAME_STEP;
+	}
+
+	static inline thread_local void* s_free[BUCKETS_NUM] = {};
+};
+
+/* what a connection runs on. the server or the client loop */
+class Backend
+{
+public:
+	virtual ~Backend() = default;
+	virtual int Send(Connection& _conn, const void* _data, std::size_t _size) = 0;
+	virtual int SendReceived(Connection& _conn, const void* _data, std::size_t _size, uint _requestID) = 0;
+	virtual void Close(Connection& _conn) = 0;
+};
+
+} // namespace detail
+
+/* ~~~ Task ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief a coroutine that runs on its own once started, and frees itself when it ends.
+ * a Task that was never started is destroyed with it.
+ */
+class Task
+{
+public:
+	struct promise_type
+	{
+		void (*m_doneFunc)(void*) = nullptr;
+		void* m_doneContex = nullptr;
+
+		Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+
+		/* after the locals of the coroutine were destroyed */
+		~promise_type()
+		{
+			if (m_doneFunc)
+			{
+				m_doneFunc(m_doneContex);
+			}
+		}
+
+		static void* operator new(std::size_t _size) { return detail::FramePool::Alloc(_size); }
+		static void operator delete(void* _frame, std::size_t _size) { detail::FramePool::Free(_frame, _size); }
+	};
+
+	Task(Task&& _other) noexcept : m_handle(_other.m_handle) { _other.m_handle = nullptr; }
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+		}
+	}
+
+	/**
+	 * @brief run until the first suspension. the task is on its own after.
+	 * @param _doneFunc invoked when the coroutine ends. can be nullptr.
+	 * @param _doneContex passed to _doneFunc
+	 */
+	void Start(void (*_doneFunc)(void*) = nullptr, void* _doneContex = nullptr)
+	{
+		std::coroutine_handle<promise_type> handle = m_handle;
+
+		if (! handle)
+		{
+			return;
+		}
+		m_handle = nullptr;
+		handle.promise().m_doneFunc = _doneFunc;
+		handle.promise().m_doneContex = _doneContex;
+		handle.resume();
+	}
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> _handle) : m_handle(_handle) {}
+
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+/* ~~~ Message ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief what a read returned. valid until the next read on the same connection.
+ * false when the connection was closed. in framed mode it is one frame.
+ */
+struct Message
+{
+	const char* m_data = nullptr;
+	std::size_t m_size = 0;
+	uint m_requestID = 0;
+
+	explicit operator bool() const { return m_data != nullptr; }
+};
+
+/* ~~~ Connection ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+class Connection
+{
+public:
+	class ReadAwaiter
+	{
+	public:
+		explicit ReadAwaiter(Connection& _conn) : m_conn(_conn) {}
+
+		bool await_ready()
+		{
+			m_conn.ReleaseCurrent();
+			return m_conn.m_inNum > 0 || m_conn.m_isClosed;
+		}
+		void await_suspend(std::coroutine_handle<> _handle) { m_conn.m_waiter = _handle; }
+		Message await_resume() { return m_conn.Pop(); }
+
+	private:
+		Connection& m_conn;
+	};
+
+	class WriteAwaiter
+	{
+	public:
+		explicit WriteAwaiter(int _result) : m_result(_result) {}
+
+		/* the library queues what the socket does not take, so a write never waits */
+		bool await_ready() const noexcept { return true; }
+		void await_suspend(std::coroutine_handle<>) const noexcept {}
+		int await_resume() const noexcept { return m_result; }
+
+	private:
+		int m_result;
+	};
+
+	Connection(detail::Backend& _backend, uint _socketNum) : m_backend(&_backend), m_socketNum(_socketNum) {}
+	Connection(const Connection&) = delete;
+	Connection& operator=(const Connection&) = delete;
+
+	~Connection()
+	{
+		if (! m_isClosed)
+		{
+			m_backend->Close(*this);
+		}
+		ReleaseCurrent();
+		while (m_inNum > 0)
+		{
+			Pop();
+			ReleaseCurrent();
+		}
+	}
+
+	/**
+	 * @brief co_await it for the next message. never waits when one already arrived.
+	 * @return false Message when the connection is closed.
+	 */
+	ReadAwaiter read() { return ReadAwaiter(*this); }
+
+	/**
+	 * @brief co_await it to send bytes. in framed mode it is one frame, answering the last message read.
+	 * @return positive number of bytes sent or queued. negative number represent error.
+	 */
+	WriteAwaiter write(const void* _data, std::size_t _size)
+	{
+		return WriteAwaiter(m_isClosed ? -1 : m_backend->Send(*this, _data, _size) );
+	}
+
+	/**
+	 * @brief co_await it to send back a message that was read. on the server it is not copied.
+	 * @return as the other write
+	 */
+	WriteAwaiter write(const Message& _msg)
+	{
+		return WriteAwaiter(m_isClosed ? -1 : m_backend->SendReceived(*this, _msg.m_data, _msg.m_size, _msg.m_requestID) );
+	}
+
+	/**
+	 * @brief close the connection. a pending read returns a false Message.
+	 */
+	void close()
+	{
+		if (! m_isClosed)
+		{
+			m_backend->Close(*this);
+			MarkClosed();
+		}
+	}
+
+	uint socket() const { return m_socketNum; }
+	bool isOpen() const { return ! m_isClosed; }
+	/* of the last message read, what a framed write answers */
+	uint requestID() const { return m_requestID; }
+
+	/* ~~~ for the backends ~~~ */
+
+	/* a message arrived. _isPooled when it is a pooled buffer to hold, otherwise it is copied */
+	void Deliver(const void* _data, std::size_t _size, uint _requestID, bool _isPooled)
+	{
+		Slot* slot;
+
+		/* the current message keeps its slot too */
+		if (m_inNum + (m_current ? 1 : 0) == m_inbox.size() )
+		{
+			Grow();
+		}
+		slot = &m_inbox[(m_inHead + m_inNum) % m_inbox.size()];
+		slot->m_size = _size;
+		slot->m_requestID = _requestID;
+		slot->m_isPooled = _isPooled && TCP_BufferRetain(_data);
+		if (slot->m_isPooled)
+		{
+			slot->m_data = static_cast<const char*>(_data);
+		}
+		else
+		{
+			/* reuses the slot memory, so a steady stream allocates nothing */
+			slot->m_copy.assign(static_cast<const char*>(_data), static_cast<const char*>(_data) + _size);
+			slot->m_data = slot->m_copy.data() ? slot->m_copy.data() : "";
+		}
+		++m_inNum;
+
+		ResumeWaiter(); /* last, the coroutine may end and free this connection */
+	}
+
+	/* the peer closed, or the connection broke */
+	void MarkClosed()
+	{
+		m_isClosed = true;
+		ResumeWaiter(); /* last, as in Deliver */
+	}
+
+	/* for the connect awaiter */
+	void SetWaiter(std::coroutine_handle<> _handle) { m_waiter = _handle; }
+	void ResumeWaiter()
+	{
+		std::coroutine_handle<> waiter = m_waiter;
+
+		if (waiter)
+		{
+			m_waiter = nullptr;
+			waiter.resume();
+		}
+	}
+	/* the backend is going away. returns the suspended coroutine, that will never be resumed, to destroy */
+	std::coroutine_handle<> Abandon()
+	{
+		std::coroutine_handle<> waiter = m_waiter;
+
+		m_isClosed = true;
+		m_waiter = nullptr;
+		return waiter;
+	}
+
+	bool m_isHandlerDone = false;
+
+private:
+	struct Slot
+	{
+		const char* m_data = nullptr;
+		std::size_t m_size = 0;
+		uint m_requestID = 0;
+		bool m_isPooled = false;
+		std::vector<char> m_copy;
+	};
+
+	static constexpr std::size_t INBOX_START_SIZE = 4;
+
+	Message Pop()
+	{
+		Slot* slot;
+		Message msg;
+
+		if (0 == m_inNum)
+		{
+			return msg;
+		}
+		slot = &m_inbox[m_inHead];
+		m_inHead = (m_inHead + 1) % m_inbox.size();
+		--m_inNum;
+
+		m_current = slot;
+		m_requestID = slot->m_requestID;
+		msg.m_data = slot->m_data;
+		msg.m_size = slot->m_size;
+		msg.m_requestID = slot->m_requestID;
+		return msg;
+	}
+
+	/* the message given by the last read is no longer needed */
+	void ReleaseCurrent()
+	{
+		if (m_current && m_current->m_isPooled)
+		{
+			TCP_BufferRelease(m_current->m_data);
+			m_current->m_isPooled = false;
+		}
+		m_current = nullptr;
+	}
+
+	void Grow()
+	{
+		std::vector<Slot> bigger(m_inbox.empty() ? INBOX_START_SIZE : m_inbox.size() * 2);
+		std::size_t i;
+
+		for (i = 0; i < m_inNum; ++i)
+		{
+			MoveSlot(m_inbox[(m_inHead + i) % m_inbox.size()], bigger[i]);
+		}
+		if (m_current)
+		{
+			/* out of the way of the queue, until the next read releases it */
+			MoveSlot(*m_current, bigger.back() );
+			m_current = &bigger.back();
+		}
+		m_inbox.swap(bigger);
+		m_inHead = 0;
+	}
+
+	static void MoveSlot(Slot& _from, Slot& _to)
+	{
+		_to = std::move(_from);
+		if (! _to.m_isPooled)
+		{
+			_to.m_data = _to.m_copy.data() ? _to.m_copy.data() : "";
+		}
+	}
+
+	detail::Backend* m_backend;
+	uint m_socketNum;
+	bool m_isClosed = false;
+	uint m_requestID = 0;
+	std::coroutine_handle<> m_waiter;
+
+	std::vector<Slot> m_inbox; /* circular */
+	std::size_t m_inHead = 0;
+	std::size_t m_inNum = 0;
+	Slot* m_current = nullptr;
+};
+
+/* ~~~ Server ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief a server that starts a coroutine for every new connection.
+ * the connection lives until the coroutine ended and the socket was closed. when the coroutine ends first, the
+ * connection is closed.
+ */
+class Server : private detail::Backend
+{
+public:
+	using Handler = std::function<Task(Connection&)>;
+
+	/**
+	 * @brief Create the server. see TCP_CreateServer.
+	 * @param _isFramed framed mode, a read is one frame. see TCP_ServerSetFraming.
+	 * @return the server, nullptr if failed.
+	 */
+	static std::unique_ptr<Server> Create(uint _port, Handler _handler, bool _isFramed = false,
+										uint _maxConnections = MAX_CLIENTS_NUM, uint _timeoutMS = 300000)
+	{
+		std::unique_ptr<Server> server(new Server(std::move(_handler), _isFramed) );
+
+		server->m_TCP = TCP_CreateServer(_port, NULL, _maxConnections, _timeoutMS,
+										DataFunc, ConnectFunc, ClosedFunc, NULL, server.get() );
+		if (! server->m_TCP || ! TCP_ServerSetFraming(server->m_TCP, _isFramed) )
+		{
+			return nullptr;
+		}
+		return server;
+	}
+
+	~Server()
+	{
+		std::vector<std::coroutine_handle<> > waiters;
+
+		for (Connection*& conn : m_connections)
+		{
+			if (conn && conn->m_isHandlerDone)
+			{
+				delete conn;
+			}
+			else if (conn)
+			{
+				waiters.push_back(conn->Abandon() );
+			}
+			conn = nullptr;
+		}
+		/* ends the coroutines. HandlerDone deletes their connections, as they are closed */
+		for (std::coroutine_handle<> waiter : waiters)
+		{
+			if (waiter)
+			{
+				waiter.destroy();
+			}
+		}
+		TCP_DestroyServer(m_TCP);
+	}
+
+	bool Run() { return TCP_RunServer(m_TCP); }
+	bool Stop() { return TCP_StopServer(m_TCP); }
+	/* for the settings of the C API */
+	TCP_S_t* native() { return m_TCP; }
+
+private:
+	Server(Handler _handler, bool _isFramed) : m_handler(std::move(_handler) ), m_isFramed(_isFramed) {}
+
+	int Send(Connection& _conn, const void* _data, std::size_t _size) override
+	{
+		if (m_isFramed)
+		{
+			return TCP_SendFrame(_conn.socket(), _conn.requestID(), const_cast<void*>(_data), _size);
+		}
+		return TCP_Send(_conn.socket(), const_cast<void*>(_data), _size);
+	}
+
+	int SendReceived(Connection& _conn, const void* _data, std::size_t _size, uint _requestID) override
+	{
+		/* a pooled buffer is queued as it is */
+		if (m_isFramed)
+		{
+			return TCP_SendFrameBuffer(_conn.socket(), _requestID, const_cast<void*>(_data), _size);
+		}
+		return TCP_SendBuffer(_conn.socket(), const_cast<void*>(_data), _size);
+	}
+
+	void Close(Connection& _conn) override
+	{
+		/* safe inside a data function. the closed function follows */
+		TCP_ServerCloseLater(m_TCP, _conn.socket() );
+	}
+
+	static int ConnectFunc(uint _socketNum, void* _contex, void*)
+	{
+		Server* server = static_cast<Server*>(_contex);
+		Connection* conn = new Connection(*server, _socketNum);
+
+		if (_socketNum >= server->m_connections.size() )
+		{
+			server->m_connections.resize(_socketNum + 1, nullptr);
+		}
+		server->m_connections[_socketNum] = conn;
+		TCP_SetConnectionContext(_socketNum, conn);
+
+		server->m_handler(*conn).Start(HandlerDone, conn);
+		return 1;
+	}
+
+	static int DataFunc(void* _data, size_t _sizeData, uint, void* _contex, void* _connContex)
+	{
+		Server* server = static_cast<Server*>(_contex);
+		Connection* conn = static_cast<Connection*>(_connContex);
+
+		if (conn)
+		{
+			conn->Deliver(_data, _sizeData, server->m_isFramed ? TCP_GetRequestID(server->m_TCP) : 0, true);
+		}
+		return 1;
+	}
+
+	static int ClosedFunc(uint _socketNum, void* _contex, void* _connContex)
+	{
+		Server* server = static_cast<Server*>(_contex);
+		Connection* conn = static_cast<Connection*>(_connContex);
+
+		if (! conn)
+		{
+			return 1;
+		}
+		server->m_connections[_socketNum] = nullptr;
+		if (conn->m_isHandlerDone)
+		{
+			delete conn;
+		}
+		else
+		{
+			/* the coroutine reads a false Message, and ends */
+			conn->MarkClosed();
+		}
+		return 1;
+	}
+
+	static void HandlerDone(void* _conn)
+	{
+		Connection* conn = static_cast<Connection*>(_conn);
+
+		conn->m_isHandlerDone = true;
+		if (conn->isOpen() )
+		{
+			/* deleted by the closed function */
+			conn->close();
+		}
+		else
+		{
+			delete conn;
+		}
+	}
+
+	TCP_S_t* m_TCP = nullptr;
+	Handler m_handler;
+	bool m_isFramed;
+	std::vector<Connection*> m_connections; /* by socket number, for the destructor. the callbacks get theirs as the connection context */
+};
+
+/* ~~~ Client loop ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief coroutines connecting to servers, over a client loop. raw bytes, as tcp_client_loop.h.
+ * connections belong to the coroutine that made them, and are closed when it lets go of them.
+ */
+class ClientLoop : private detail::Backend
+{
+public:
+	class ConnectAwaiter
+	{
+	public:
+		ConnectAwaiter(ClientLoop& _loop, const char* _serverIP, uint _serverPort)
+			: m_loop(_loop), m_serverIP(_serverIP), m_serverPort(_serverPort) {}
+
+		bool await_ready() const noexcept { return false; }
+
+		bool await_suspend(std::coroutine_handle<> _handle)
+		{
+			int socketNum = TCP_ClientLoopConnect(m_loop.m_loop, m_serverIP, m_serverPort);
+
+			if (socketNum < 0)
+			{
+				return false;
+			}
+			m_conn = new Connection(m_loop, socketNum);
+			m_conn->SetWaiter(_handle);
+			m_loop.Store(m_conn);
+			return true;
+		}
+
+		std::unique_ptr<Connection> await_resume()
+		{
+			std::unique_ptr<Connection> conn(m_conn);
+
+			if (conn && ! conn->isOpen() )
+			{
+				return nullptr;
+			}
+			return conn;
+		}
+
+	private:
+		ClientLoop& m_loop;
+		const char* m_serverIP;
+		uint m_serverPort;
+		Connection* m_conn = nullptr;
+	};
+
+	/**
+	 * @brief Create an empty loop. see TCP_CreateClientLoop.
+	 * @return the loop, nullptr if failed.
+	 */
+	static std::unique_ptr<ClientLoop> Create(uint _maxConnections = MAX_CLIENTS_NUM)
+	{
+		std::unique_ptr<ClientLoop> loop(new ClientLoop);
+
+		loop->m_loop = TCP_CreateClientLoop(_maxConnections, ConnectFunc, DataFunc, DisconnectFunc, loop.get() );
+		if (! loop->m_loop)
+		{
+			return nullptr;
+		}
+		return loop;
+	}
+
+	~ClientLoop()
+	{
+		std::vector<std::coroutine_handle<> > waiters;
+
+		for (Connection*& conn : m_connections)
+		{
+			if (conn)
+			{
+				waiters.push_back(conn->Abandon() );
+			}
+			conn = nullptr;
+		}
+		/* the coroutines never resume. ending them lets go of their connections */
+		for (std::coroutine_handle<> waiter : waiters)
+		{
+			if (waiter)
+			{
+				waiter.destroy();
+			}
+		}
+		TCP_DestroyClientLoop(m_loop);
+	}
+
+	/**
+	 * @brief co_await it for a connection. "unix:/path" for a Unix domain socket.
+	 * @return the connection, nullptr if failed.
+	 */
+	ConnectAwaiter connect(const char* _serverIP, uint _serverPort) { return ConnectAwaiter(*this, _serverIP, _serverPort); }
+
+	/* start a coroutine on this loop. it runs until its first co_await right away */
+	void Spawn(Task _task) { _task.Start(); }
+
+	int RunOnce(int _timeoutMS) { return TCP_ClientLoopRunOnce(m_loop, _timeoutMS); }
+	bool Run() { return TCP_RunClientLoop(m_loop); }
+	bool Stop() { return TCP_StopClientLoop(m_loop); }
+	TCP_CL_t* native() { return m_loop; }
+
+private:
+	ClientLoop() = default;
+
+	int Send(Connection& _conn, const void* _data, std::size_t _size) override
+	{
+		return TCP_ClientLoopSend(m_loop, _conn.socket(), _data, _size);
+	}
+
+	int SendReceived(Connection& _conn, const void* _data, std::size_t _size, uint) override
+	{
+		return Send(_conn, _data, _size);
+	}
+
+	void Close(Connection& _conn) override
+	{
+		TCP_ClientLoopDisconnect(m_loop, _conn.socket() );
+		Forget(_conn.socket() );
+	}
+
+	void Store(Connection* _conn)
+	{
+		if (_conn->socket() >= m_connections.size() )
+		{
+			m_connections.resize(_conn->socket() + 1, nullptr);
+		}
+		m_connections[_conn->socket()] = _conn;
+	}
+
+	void Forget(uint _socketNum)
+	{
+		if (_socketNum < m_connections.size() )
+		{
+			m_connections[_socketNum] = nullptr;
+		}
+	}
+
+	Connection* Find(uint _socketNum)
+	{
+		return _socketNum < m_connections.size() ? m_connections[_socketNum] : nullptr;
+	}
+
+	static int ConnectFunc(uint _socketNum, tcp_c_bool_t _isConnected, void* _contex)
+	{
+		ClientLoop* loop = static_cast<ClientLoop*>(_contex);
+		Connection* conn = loop->Find(_socketNum);
+
+		if (! conn)
+		{
+			return 1;
+		}
+		if (! _isConnected)
+		{
+			/* the socket is already closed */
+			loop->Forget(_socketNum);
+			conn->MarkClosed();
+			return 1;
+		}
+		conn->ResumeWaiter();
+		return 1;
+	}
+
+	static int DataFunc(void* _data, size_t _sizeData, uint _socketNum, void* _contex)
+	{
+		ClientLoop* loop = static_cast<ClientLoop*>(_contex);
+		Connection* conn = loop->Find(_socketNum);
+
+		if (conn)
+		{
+			/* the loop buffer is reused, it is copied */
+			conn->Deliver(_data, _sizeData, 0, false);
+		}
+		return 1;
+	}
+
+	static int DisconnectFunc(uint _socketNum, void* _contex)
+	{
+		ClientLoop* loop = static_cast<ClientLoop*>(_contex);
+		Connection* conn = loop->Find(_socketNum);
+
+		if (conn)
+		{
+			loop->Forget(_socketNum);
+			conn->MarkClosed();
+		}
+		return 1;
+	}
+
+	TCP_CL_t* m_loop = nullptr;
+	std::vector<Connection*> m_connections; /* by socket number. owned by the coroutines */
+};
+
+} // namespace tcp
+
+#endif /* TCP_CORO_HPP_ */
@@ -0,0 +1,47 @@
+/*
+ * tcp_frame.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <string.h>
+#include <arpa/inet.h> /* htonl, ntohl */
+
+#include "tcp_frame.h"
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void TCP_FrameEncode(const TCP_FrameHeader_t* _header, unsigned char* _out)
+{
+	uint32_t length = htonl(_header->m_length);
+	uint32_t requestID = htonl(_header->m_requestID);
+	uint16_t flags = htons(_header->m_flags);
+	uint16_t method = htons(_header->m_method);
+
+	/* memcpy, as the output is not aligned when frames are packed back to back */
+	memcpy(_out, &length, 4);
+	memcpy(_out + 4, &requestID, 4);
+	memcpy(_out + 8, &flags, 2);
+	memcpy(_out + 10, &method, 2);
+}
+
+bool TCP_FrameDecode(const unsigned char* _in, TCP_FrameHeader_t* _header)
+{
+	uint32_t length;
+	uint32_t requestID;
+	uint16_t flags;
+	uint16_t method;
+
+	memcpy(&length, _in, 4);
+	memcpy(&requestID, _in + 4, 4);
+	memcpy(&flags, _in + 8, 2);
+	memcpy(&method, _in + 10, 2);
+
+	_header->m_length = ntohl(length);
+	_header->m_requestID = ntohl(requestID);
+	_header->m_flags = ntohs(flags);
+	_header->m_method = ntohs(method);
+
+	return _header->m_length <= TCP_FRAME_MAX_PAYLOAD;
+}
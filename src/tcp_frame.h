@@ -0,0 +1,68 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief The frame header used when the server runs in framed mode, and by the framed clients.
+ * Every message on the wire is a fixed size header followed by the payload. all header fields are sent in network order.
+ *
+ * @bug
+ */
+
+#ifndef TCP_FRAME_H_
+#define TCP_FRAME_H_
+
+#include <stdint.h>
+
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define TCP_FRAME_HEADER_SIZE 12
+/* a peer announcing a bigger payload is treated as broken and disconnected */
+#define TCP_FRAME_MAX_PAYLOAD (1 << 20)
+
+/* m_flags bits */
+#define TCP_FRAME_FLAG_COMPRESSED 0x0001 /* the payload is compressed, see tcp_compress.h */
+#define TCP_FRAME_FLAG_HELLO 0x0002 /* compression offer or answer. never passed to the user */
+#define TCP_FRAME_FLAG_ERROR 0x0004 /* an RPC call failed. the payload is its TCP_RPC_STATUS, 4 bytes in network order */
+
+/* why an RPC call failed, see tcp_rpc.h */
+typedef enum TCP_RPC_STATUS {
+	TCP_RPC_OK = 0,
+	TCP_RPC_NO_METHOD = 1, /* no such method on the server */
+	TCP_RPC_BAD_ARGS = 2, /* the method did not accept the arguments */
+	TCP_RPC_FAILED = 3, /* the method failed */
+	TCP_RPC_BROKEN = 4 /* client side only. the connection broke before the answer came */
+} TCP_RPC_STATUS;
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct TCP_FrameHeader
+{
+	uint32_t m_length;    /* payload bytes following the header */
+	uint32_t m_requestID; /* chosen by the requester, echoed back in the response */
+	uint16_t m_flags;
+	uint16_t m_method;    /* the RPC method called, see tcp_rpc.h. 0 for plain frames and for answers */
+} TCP_FrameHeader_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief write the header in wire format
+ * @param _header the header to encode
+ * @param _out output. TCP_FRAME_HEADER_SIZE bytes.
+ * @return void
+ */
+void TCP_FrameEncode(const TCP_FrameHeader_t* _header, unsigned char* _out);
+
+/**
+ * @brief read a header from wire format
+ * @param _in TCP_FRAME_HEADER_SIZE bytes as received
+ * @param _header output.
+ * @return TRUE if the header is valid. FALSE if the payload is too big to be a real frame.
+ */
+bool TCP_FrameDecode(const unsigned char* _in, TCP_FrameHeader_t* _header);
+
+#endif /* TCP_FRAME_H_ */
@@ -0,0 +1,254 @@
+/*
+ * tcp_group.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#define _GNU_SOURCE /* pthread_setaffinity_np, CPU_SET */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <linux/filter.h> /* sock_filter, SKF_AD_CPU */
+
+#include "tcp_group.h"
+#include "tcp_internal.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER 0xfadeface
+#define DEAD_MAGIC_NUMBER 0xdeadface
+
+/* load the CPU, a compare and a return for each loop, and the default */
+#define STEER_PROGRAM_SIZE(loopsNum) (1 + 2 * (loopsNum) + 2)
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Loop
+{
+	TCP_S_t* m_server;
+	int m_cpu;
+	pthread_t m_thread;
+	bool m_result;
+} Loop_t;
+
+struct TCP_Group
+{
+	uint m_magicNumber;
+	uint m_loopsNum;
+	Loop_t m_loops[TCP_GROUP_MAX_LOOPS];
+};
+
+/* ~~~ Global ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static __thread TCP_S_t* g_thisServer = NULL;
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool AttachSteering(int _listenSocket, const int* _cpus, uint _loopsNum);
+static void* LoopThread(void* _loop);
+static bool IsStructValid(TCP_Group_t* _group);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Group_t* TCP_CreateServerGroup(const char* _endpoint, uint _loopsNum, const int* _cpus, uint _maxConnections, uint _timeoutMS,
+		userActionFunc _reciveDataFunc,
+		clientConnectionChangeFunc _newClientConnected,
+		clientConnectionChangeFunc _clientDissconected,
+		errorFunc _errorFunc,
+		void* _contex
+		)
+{
+	TCP_Group_t* aGroup;
+	Loop_t* loop;
+	uint i;
+
+	if (NULL == _endpoint || 0 == _loopsNum || _loopsNum > TCP_GROUP_MAX_LOOPS)
+	{
+		return NULL;
+	}
+
+	aGroup = calloc(1, sizeof(TCP_Group_t) );
+	if (! aGroup)
+	{
+		return NULL;
+	}
+	aGroup->m_magicNumber = ALIVE_MAGIC_NUMBER;
+
+	/* the listeners join the port in this order, which is the index the steering program returns */
+	for (i = 0; i < _loopsNum; ++i)
+	{
+		loop = &aGroup->m_loops[i];
+		loop->m_cpu = _cpus ? _cpus[i] : -1;
+		loop->m_server = TCP_CreateServerReusePort(_endpoint, _maxConnections, _timeoutMS,
+										_reciveDataFunc, _newClientConnected, _clientDissconected, _errorFunc, _contex);
+		if (! loop->m_server)
+		{
+			TCP_DestroyServerGroup(aGroup);
+			return NULL;
+		}
+		aGroup->m_loopsNum++;
+		TCP_ServerSetCpu(loop->m_server, loop->m_cpu);
+	}
+
+	if (! AttachSteering(TCP_ServerListenSocket(aGroup->m_loops[0].m_server), _cpus, _loopsNum) )
+	{
+		TCP_DestroyServerGroup(aGroup);
+		return NULL;
+	}
+
+	return aGroup;
+}
+
+void TCP_DestroyServerGroup(TCP_Group_t* _group)
+{
+	uint i;
+
+	if (! IsStructValid(_group) )
+	{
+		return;
+	}
+
+	_group->m_magicNumber = DEAD_MAGIC_NUMBER;
+	for (i = 0; i < _group->m_loopsNum; ++i)
+	{
+		TCP_DestroyServer(_group->m_loops[i].m_server);
+	}
+	free(_group);
+}
+
+bool TCP_RunServerGroup(TCP_Group_t* _group)
+{
+	bool result = TRUE;
+	uint started;
+	uint i;
+
+	if (! IsStructValid(_group) )
+	{
+		return FALSE;
+	}
+
+	for (started = 0; started < _group->m_loopsNum; ++started)
+	{
+		if (pthread_create(&_group->m_loops[started].m_thread, NULL, LoopThread, &_group->m_loops[started]) != 0)
+		{
+			perror("RunServerGroup, pthread_create Failed");
+			TCP_StopServerGroup(_group);
+			result = FALSE;
+			break;
+		}
+	}
+
+	for (i = 0; i < started; ++i)
+	{
+		pthread_join(_group->m_loops[i].m_thread, NULL);
+		result = result && _group->m_loops[i].m_result;
+	}
+	return result;
+}
+
+bool TCP_StopServerGroup(TCP_Group_t* _group)
+{
+	uint i;
+
+	if (! IsStructValid(_group) )
+	{
+		return FALSE;
+	}
+
+	for (i = 0; i < _group->m_loopsNum; ++i)
+	{
+		TCP_StopServer(_group->m_loops[i].m_server);
+	}
+	return TRUE;
+}
+
+TCP_S_t* TCP_GroupServer(TCP_Group_t* _group, uint _index)
+{
+	if (! IsStructValid(_group) || _index >= _group->m_loopsNum)
+	{
+		return NULL;
+	}
+
+	return _group->m_loops[_index].m_server;
+}
+
+TCP_S_t* TCP_GroupThisServer(void)
+{
+	return g_thisServer;
+}
+
+uint TCP_GroupLoopsNum(TCP_Group_t* _group)
+{
+	return IsStructValid(_group) ? _group->m_loopsNum : 0;
+}
+
+bool TCP_GroupLoopStats(TCP_Group_t* _group, uint _index, TCP_LoopStats_t* _stats)
+{
+	if (! IsStructValid(_group) || _index >= _group->m_loopsNum || NULL == _stats)
+	{
+		return FALSE;
+	}
+
+	_stats->m_cpu = _group->m_loops[_index].m_cpu;
+	return TCP_ServerCpuStats(_group->m_loops[_index].m_server, &_stats->m_accepted, &_stats->m_acceptedOnCpu);
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the port gives a connection to the loop pinned to the CPU it arrived on, or to loop (CPU % loops number) */
+static bool AttachSteering(int _listenSocket, const int* _cpus, uint _loopsNum)
+{
+	struct sock_filter code[STEER_PROGRAM_SIZE(TCP_GROUP_MAX_LOOPS)];
+	struct sock_fprog program;
+	uint length = 0;
+	uint i;
+
+	code[length++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+	for (i = 0; _cpus && i < _loopsNum; ++i)
+	{
+		code[length++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, _cpus[i], 0, 1);
+		code[length++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, i);
+	}
+	code[length++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, _loopsNum);
+	code[length++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_A, 0);
+
+	program.len = length;
+	program.filter = code;
+	if (setsockopt(_listenSocket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program) ) < 0)
+	{
+		perror("Socket setsockopt SO_ATTACH_REUSEPORT_CBPF Failed");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void* LoopThread(void* _loop)
+{
+	Loop_t* loop = _loop;
+	cpu_set_t cpus;
+
+	if (loop->m_cpu >= 0)
+	{
+		CPU_ZERO(&cpus);
+		CPU_SET(loop->m_cpu, &cpus);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+		{
+			/* still serves, only not pinned */
+			fprintf(stderr, "loop could not be pinned to CPU %d\n", loop->m_cpu);
+		}
+	}
+
+	g_thisServer = loop->m_server;
+	loop->m_result = TCP_RunServer(loop->m_server);
+	g_thisServer = NULL;
+	return NULL;
+}
+
+static bool IsStructValid(TCP_Group_t* _group)
+{
+	return (_group && _group->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
@@ -0,0 +1,115 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Several server loops on one port, each in a thread of its own, optionally pinned to a CPU.
+ * Every loop has its own listener on the port (SO_REUSEPORT). A classic BPF program on the port picks the loop for
+ * each new connection by the CPU its packets arrive on, the CPU the NIC queue (RSS) delivers it to. So a connection is
+ * served on the core that already has its socket state in cache.
+ * Loop i is pinned to _cpus[i]. Connections arriving on a CPU that has no loop go to loop (CPU % loops number).
+ *
+ * The user functions of all the loops run at the same time, on their threads. A connection belongs to one loop, and
+ * TCP_Send to it must come from that loop. The buffer pool and the timers are per loop.
+ *
+ * @bug settings (framing, compression, ...) are made on each loop, through TCP_GroupServer.
+ */
+
+#ifndef TCP_GROUP_H_
+#define TCP_GROUP_H_
+
+#include "tcp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define TCP_GROUP_MAX_LOOPS 64
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct TCP_Group TCP_Group_t;
+
+typedef struct TCP_LoopStats
+{
+	int m_cpu; /* the loop is pinned to, -1 if not */
+	unsigned long m_accepted;
+	unsigned long m_acceptedOnCpu; /* connections whose packets arrive on m_cpu (SO_INCOMING_CPU) */
+} TCP_LoopStats_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create the loops of a group, and steer the connections of the port between them.
+ * @param _endpoint "*:4848", "127.0.0.1:4848" or "[::]:4848" (see tcp_address.h). not a Unix socket.
+ * @param _loopsNum number of loops. up to TCP_GROUP_MAX_LOOPS.
+ * @param _cpus _loopsNum CPU numbers, loop i is pinned to _cpus[i]. NULL to leave the loops unpinned.
+ * @param _maxConnections per loop.
+ * other parameters are the same as TCP_CreateServer. the same _contex is given to the user functions of all loops.
+ * @return a pointer to the struct. NULL if failed.
+ */
+TCP_Group_t* TCP_CreateServerGroup(const char* _endpoint, uint _loopsNum, const int* _cpus, uint _maxConnections, uint _timeoutMS,
+						userActionFunc _reciveDataFunc,
+						clientConnectionChangeFunc _newClientConnected,
+						clientConnectionChangeFunc _clientDissconected,
+						errorFunc _errorFunc,
+						void* _contex
+						);
+
+/**
+ * @brief Destroy the group and its loops. the loops must not run.
+ * @param _group pointer to the struct
+ * @return void
+ */
+void TCP_DestroyServerGroup(TCP_Group_t* _group);
+
+/**
+ * @brief run every loop in a thread of its own, and wait until all of them stop.
+ * @param _group pointer to the struct
+ * @return TRUE when all stopped normally or FALSE when failed
+ */
+bool TCP_RunServerGroup(TCP_Group_t* _group);
+
+/**
+ * @brief stop all the loops. safe to call from a signal handler or another thread.
+ * @param _group pointer to the struct
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_StopServerGroup(TCP_Group_t* _group);
+
+/**
+ * @brief get the server of one loop, for its settings or TCP_GetRequestID.
+ * @param _group pointer to the struct
+ * @param _index of the loop
+ * @return the server, NULL if failed.
+ */
+TCP_S_t* TCP_GroupServer(TCP_Group_t* _group, uint _index);
+
+/**
+ * @brief get the server of the loop running on the calling thread. for the user functions.
+ * @return the server, NULL if not called from a loop of a group.
+ */
+TCP_S_t* TCP_GroupThisServer(void);
+
+/**
+ * @brief get the number of loops.
+ * @param _group pointer to the struct
+ * @return the number, 0 if failed.
+ */
+uint TCP_GroupLoopsNum(TCP_Group_t* _group);
+
+/**
+ * @brief get the stats of one loop. may be called while the loops run.
+ * @param _group pointer to the struct
+ * @param _index of the loop
+ * @param _stats out
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_GroupLoopStats(TCP_Group_t* _group, uint _index, TCP_LoopStats_t* _stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCP_GROUP_H_ */
@@ -0,0 +1,148 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Server functions shared by the modules built on top of the server (pub/sub). not for the user.
+ * A shared buffer holds one message exactly as it goes on the wire, and is queued to many connections without a copy.
+ * Each connection sends what the kernel would take right away, and queues the rest to be sent when its socket is writable.
+ *
+ * @bug
+ */
+
+#ifndef TCP_INTERNAL_H_
+#define TCP_INTERNAL_H_
+
+#include "tcp.h"
+#include "tcp_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* TCP_ServerSendShared results */
+#define TCP_SHARED_QUEUED 1
+#define TCP_SHARED_FULL 0
+
+/**
+ * @brief invoked when a connection is closed, before the user function is.
+ */
+typedef void (*connectionClosedHook)(uint _socketNum, void* _contex);
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* a pooled buffer (tcp_buffer.h), held by the creator and every queue holding it */
+typedef struct TCP_SharedBuf
+{
+	uint m_length; /* wire bytes, header included */
+	uint m_payloadOffset; /* where the payload starts, after the frame header in framed mode */
+	unsigned char m_data[];
+} TCP_SharedBuf_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief copy a message into a new shared buffer, framed when the server is in framed mode (request ID 0).
+ * @param _TCP pointer to the server
+ * @param _msg the payload
+ * @param _msgLength the payload size
+ * @return the buffer, held once by the caller. NULL if failed.
+ */
+TCP_SharedBuf_t* TCP_ServerCreateShared(TCP_S_t* _TCP, const void* _msg, uint _msgLength);
+
+/**
+ * @brief TCP_SendFrame with more header flags, as TCP_FRAME_FLAG_ERROR. not to a shared memory client, its ring has no flags.
+ * @param _socketNum the connection
+ * @param _requestID of the request answered
+ * @param _flags tcp_frame.h flags. the compression ones are the server's own and are ignored.
+ * @param _msg the payload
+ * @param _msgLength the payload size. up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * @return as TCP_SendFrame.
+ */
+int TCP_ServerSendFrameFlags(uint _socketNum, uint _requestID, uint _flags, const void* _msg, uint _msgLength);
+
+/**
+ * @brief drop one hold of a shared buffer. the last one frees it.
+ * @param _buf the buffer
+ * @return void
+ */
+void TCP_SharedRelease(TCP_SharedBuf_t* _buf);
+
+/**
+ * @brief tell if a pooled buffer is held by anyone but the caller, so the server knows it can not reuse it.
+ * @param _data any pointer inside the buffer
+ * @return TRUE if held more than once.
+ */
+bool TCP_BufferIsShared(const void* _data);
+
+/**
+ * @brief send a shared buffer to a connection without blocking, after whatever is queued for it.
+ * @param _TCP pointer to the server
+ * @param _socketNum the connection
+ * @param _buf the buffer. held by the queue if not sent at once.
+ * @param _maxQueued when this many messages are already queued, nothing is done. 0 for no limit.
+ * @return TCP_SHARED_QUEUED when sent or queued, TCP_SHARED_FULL over the limit, negative number if the connection is unknown or broken.
+ */
+int TCP_ServerSendShared(TCP_S_t* _TCP, uint _socketNum, TCP_SharedBuf_t* _buf, uint _maxQueued);
+
+/**
+ * @brief close a connection at the start of the next server loop, so it is safe while the connections are iterated.
+ * nothing more is sent to it.
+ * @param _TCP pointer to the server
+ * @param _socketNum the connection
+ * @return TRUE if the connection was found.
+ */
+bool TCP_ServerCloseLater(TCP_S_t* _TCP, uint _socketNum);
+
+/**
+ * @brief set the function told about every closed connection. one per server.
+ * @param _TCP pointer to the server
+ * @param _hook the function. NULL to remove it.
+ * @param _contex passed to the function
+ * @return TRUE if success or FALSE if failed, or if the server has a function already. remove it first.
+ */
+bool TCP_ServerSetClosedHook(TCP_S_t* _TCP, connectionClosedHook _hook, void* _contex);
+
+/**
+ * @brief Create a server for one loop of a group (tcp_group.h). its listener has SO_REUSEPORT, so the loops share the port.
+ * parameters are the same as TCP_CreateServer, with one endpoint as in TCP_CreateServerEndpoints.
+ * @return a pointer to the struct. NULL if failed.
+ */
+TCP_S_t* TCP_CreateServerReusePort(const char* _endpoint, uint _maxConnections, uint _timeoutMS,
+						userActionFunc _reciveDataFunc,
+						clientConnectionChangeFunc _newClientConnected,
+						clientConnectionChangeFunc _clientDissconected,
+						errorFunc _errorFunc,
+						void* _contex
+						);
+
+/**
+ * @brief tell the server the CPU its loop is pinned to, for its stats and as a hint on its listener (SO_INCOMING_CPU).
+ * @param _TCP pointer to the server
+ * @param _cpu the CPU, -1 for none
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_ServerSetCpu(TCP_S_t* _TCP, int _cpu);
+
+/**
+ * @brief connections accepted by the server, and how many of them had their packets arriving on its CPU.
+ * @param _TCP pointer to the server
+ * @param _accepted out
+ * @param _acceptedOnCpu out. stays 0 when no CPU was set.
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_ServerCpuStats(TCP_S_t* _TCP, unsigned long* _accepted, unsigned long* _acceptedOnCpu);
+
+/**
+ * @brief the listening socket of the server, its first one.
+ * @param _TCP pointer to the server
+ * @return the socket, negative number if failed.
+ */
+int TCP_ServerListenSocket(TCP_S_t* _TCP);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCP_INTERNAL_H_ */
@@ -0,0 +1,252 @@
+/*
+ * tcp_log.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tcp_log.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define RING_MASK (TCP_LOG_RING_SIZE - 1)
+/* the background thread naps this long when the ring is empty */
+#define IDLE_SLEEP_US 1000
+#define LINE_SIZE 512
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct LogRecord
+{
+	struct timespec m_time;
+	const char* m_format;
+	int m_level;
+	int m_errno;
+	long m_numbers[2];
+	unsigned int m_textLength;
+	char m_text[TCP_LOG_TEXT_SIZE];
+} LogRecord_t;
+
+/* a slot is free for the writer at position p when its sequence is p, and ready for the reader when it is p + 1 */
+typedef struct Slot
+{
+	uint64_t m_sequence;
+	LogRecord_t m_record;
+} Slot_t;
+
+/* ~~~ Global ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static Slot_t g_ring[TCP_LOG_RING_SIZE];
+static uint64_t g_tail; /* next position to write, taken by the writers with a compare and swap */
+static uint64_t g_head; /* next position to read, the background thread only */
+
+static FILE* g_out;
+static bool g_isRunning = FALSE;
+static bool g_isStopping = FALSE;
+static pthread_t g_thread;
+static int g_level = TCP_LOG_DEBUG;
+static unsigned long g_dropped;
+
+static const char* const LEVEL_NAMES[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void* Background(void* _unused);
+static unsigned int Drain(void);
+static void Format(const LogRecord_t* _record, FILE* _out);
+static void Fill(LogRecord_t* _record, int _level, int _errno, const char* _format, long _number1, long _number2, const void* _text, unsigned int _textLength);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool TCP_LogStart(FILE* _out)
+{
+	uint64_t i;
+
+	if (NULL == _out || __atomic_load_n(&g_isRunning, __ATOMIC_ACQUIRE) )
+	{
+		return FALSE;
+	}
+
+	for (i = 0; i < TCP_LOG_RING_SIZE; ++i)
+	{
+		g_ring[i].m_sequence = i;
+	}
+	g_tail = 0;
+	g_head = 0;
+	g_out = _out;
+	g_isStopping = FALSE;
+
+	if (pthread_create(&g_thread, NULL, Background, NULL) != 0)
+	{
+		perror("LogStart, pthread_create Failed");
+		return FALSE;
+	}
+	__atomic_store_n(&g_isRunning, TRUE, __ATOMIC_RELEASE);
+	return TRUE;
+}
+
+void TCP_LogStop(void)
+{
+	if (! __atomic_load_n(&g_isRunning, __ATOMIC_ACQUIRE) )
+	{
+		return;
+	}
+
+	__atomic_store_n(&g_isRunning, FALSE, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_isStopping, TRUE, __ATOMIC_RELEASE);
+	pthread_join(g_thread, NULL);
+
+	/* a writer that saw it running just before */
+	Drain();
+	fflush(g_out);
+}
+
+void TCP_LogSetLevel(int _level)
+{
+	__atomic_store_n(&g_level, _level, __ATOMIC_RELAXED);
+}
+
+unsigned long TCP_LogDropped(void)
+{
+	return __atomic_load_n(&g_dropped, __ATOMIC_RELAXED);
+}
+
+void TCP_LogWrite(int _level, int _errno, const char* _format, long _number1, long _number2, const void* _text, unsigned int _textLength)
+{
+	LogRecord_t record;
+	uint64_t position;
+	int64_t distance;
+	Slot_t* slot;
+
+	if (_level < __atomic_load_n(&g_level, __ATOMIC_RELAXED) || _level < TCP_LOG_DEBUG || _level > TCP_LOG_ERROR || NULL == _format)
+	{
+		return;
+	}
+
+	if (! __atomic_load_n(&g_isRunning, __ATOMIC_ACQUIRE) )
+	{
+		/* no background thread, the caller writes it */
+		Fill(&record, _level, _errno, _format, _number1, _number2, _text, _textLength);
+		Format(&record, stderr);
+		return;
+	}
+
+	position = __atomic_load_n(&g_tail, __ATOMIC_RELAXED);
+	for (;;)
+	{
+		slot = &g_ring[position & RING_MASK];
+		distance = (int64_t) __atomic_load_n(&slot->m_sequence, __ATOMIC_ACQUIRE) - (int64_t) position;
+		if (0 == distance)
+		{
+			if (__atomic_compare_exchange_n(&g_tail, &position, position + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+			{
+				break;
+			}
+			/* another writer took it, position was reloaded */
+		}
+		else if (distance < 0)
+		{
+			/* the reader did not free it yet, the ring is full */
+			__atomic_fetch_add(&g_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		else
+		{
+			position = __atomic_load_n(&g_tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	Fill(&slot->m_record, _level, _errno, _format, _number1, _number2, _text, _textLength);
+	__atomic_store_n(&slot->m_sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void* Background(void* _unused)
+{
+	while (! __atomic_load_n(&g_isStopping, __ATOMIC_ACQUIRE) )
+	{
+		if (0 == Drain() )
+		{
+			usleep(IDLE_SLEEP_US);
+		}
+	}
+	return NULL;
+}
+
+/* writes the records ready, in order. returns how many */
+static unsigned int Drain(void)
+{
+	Slot_t* slot;
+	unsigned int drained = 0;
+
+	for (;;)
+	{
+		slot = &g_ring[g_head & RING_MASK];
+		if (__atomic_load_n(&slot->m_sequence, __ATOMIC_ACQUIRE) != g_head + 1)
+		{
+			break;
+		}
+		Format(&slot->m_record, g_out);
+		__atomic_store_n(&slot->m_sequence, g_head + TCP_LOG_RING_SIZE, __ATOMIC_RELEASE);
+		++g_head;
+		++drained;
+	}
+
+	if (drained > 0)
+	{
+		fflush(g_out);
+	}
+	return drained;
+}
+
+static void Format(const LogRecord_t* _record, FILE* _out)
+{
+	char line[LINE_SIZE];
+	char errorText[128];
+	struct tm local;
+	int length;
+
+	localtime_r(&_record->m_time.tv_sec, &local);
+	length = snprintf(line, sizeof(line), "%02d:%02d:%02d.%06ld %-5s ", local.tm_hour, local.tm_min, local.tm_sec,
+					_record->m_time.tv_nsec / 1000, LEVEL_NAMES[_record->m_level]);
+
+	/* the format is the caller's literal, checked by the compiler where it is written (TCP_LOG_CHECK_FORMAT). extra numbers are ignored */
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+	if (_record->m_textLength > 0 || strstr(_record->m_format, "%.*s") )
+	{
+		length += snprintf(line + length, sizeof(line) - length, _record->m_format, (int) _record->m_textLength, _record->m_text,
+						_record->m_numbers[0], _record->m_numbers[1]);
+	}
+	else
+	{
+		length += snprintf(line + length, sizeof(line) - length, _record->m_format, _record->m_numbers[0], _record->m_numbers[1]);
+	}
+	#pragma GCC diagnostic pop
+
+	if (_record->m_errno && length < (int) sizeof(line) - 1)
+	{
+		snprintf(line + length, sizeof(line) - length, ": %s", strerror_r(_record->m_errno, errorText, sizeof(errorText) ) == 0 ? errorText : "unknown error");
+	}
+	fprintf(_out, "%s\n", line);
+}
+
+static void Fill(LogRecord_t* _record, int _level, int _errno, const char* _format, long _number1, long _number2, const void* _text, unsigned int _textLength)
+{
+	clock_gettime(CLOCK_REALTIME, &_record->m_time);
+	_record->m_format = _format;
+	_record->m_level = _level;
+	_record->m_errno = _errno;
+	_record->m_numbers[0] = _number1;
+	_record->m_numbers[1] = _number2;
+	_record->m_textLength = (_text && _textLength > TCP_LOG_TEXT_SIZE) ? TCP_LOG_TEXT_SIZE : (_text ? _textLength : 0);
+	memcpy(_record->m_text, _text ? _text : "", _record->m_textLength);
+}
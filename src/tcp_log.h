@@ -0,0 +1,121 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Logging off the loop thread. A log call copies a fixed size record (time, level, errno, format, two numbers
+ * and up to TCP_LOG_TEXT_SIZE bytes of text) into a lock-free ring, and returns. A background thread formats the
+ * records and writes them. When the ring is full the record is dropped and counted, the caller never waits.
+ * Until TCP_LogStart, and after TCP_LogStop, records are written at once to stderr, as before.
+ *
+ * The format is a string literal, only its address is kept. It takes two long numbers (%ld, %lu, %lx),
+ * TCP_LOG_TEXT takes a text first (%.*s), then the two numbers:
+ *
+ *     TCP_LOG(TCP_LOG_WARN, "server has too many (%ld) connection. dropping new socket #%ld", connected, socket);
+ *     TCP_LOG_ERRNO(TCP_LOG_ERROR, "Read Failed", 0, 0);           (ends with ": " and the errno text, as perror)
+ *     TCP_LOG_TEXT(TCP_LOG_DEBUG, "Recive:%.*s", data, length, 0, 0);
+ *
+ * Levels under TCP_LOG_MIN_LEVEL are removed at compile time. it is TCP_LOG_INFO with NDEBUG, TCP_LOG_DEBUG without.
+ *
+ * @bug records of different threads are written in the order they took their place in the ring, which may differ
+ * by a few microseconds from the order of their times.
+ */
+
+#ifndef TCP_LOG_H_
+#define TCP_LOG_H_
+
+#include <stdio.h>
+#include <errno.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define TCP_LOG_DEBUG 0
+#define TCP_LOG_INFO 1
+#define TCP_LOG_WARN 2
+#define TCP_LOG_ERROR 3
+
+#ifndef TCP_LOG_MIN_LEVEL
+	#if defined(NDEBUG)
+		#define TCP_LOG_MIN_LEVEL TCP_LOG_INFO
+	#else
+		#define TCP_LOG_MIN_LEVEL TCP_LOG_DEBUG
+	#endif
+#endif
+
+/* records in the ring. a power of 2 */
+#define TCP_LOG_RING_SIZE 4096
+/* longer text is cut */
+#define TCP_LOG_TEXT_SIZE 48
+
+/* never runs. the compiler checks the format against what the background thread gives it: the numbers as longs, after
+ * the text. a format may use fewer numbers than given */
+#define TCP_LOG_CHECK_FORMAT(...) \
+	_Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wformat-extra-args\"") \
+	if (0) printf(__VA_ARGS__); \
+	_Pragma("GCC diagnostic pop")
+
+#define TCP_LOG(level, format, number1, number2) \
+	do { TCP_LOG_CHECK_FORMAT(format, (long) (number1), (long) (number2)) \
+		if ((level) >= TCP_LOG_MIN_LEVEL) TCP_LogWrite((level), 0, (format), (long) (number1), (long) (number2), NULL, 0); } while (0)
+
+#define TCP_LOG_ERRNO(level, format, number1, number2) \
+	do { TCP_LOG_CHECK_FORMAT(format, (long) (number1), (long) (number2)) \
+		if ((level) >= TCP_LOG_MIN_LEVEL) TCP_LogWrite((level), errno, (format), (long) (number1), (long) (number2), NULL, 0); } while (0)
+
+#define TCP_LOG_TEXT(level, format, text, length, number1, number2) \
+	do { TCP_LOG_CHECK_FORMAT(format, (int) (length), (const char*) (text), (long) (number1), (long) (number2)) \
+		if ((level) >= TCP_LOG_MIN_LEVEL) TCP_LogWrite((level), 0, (format), (long) (number1), (long) (number2), (text), (length)); } while (0)
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief start the background thread. records are written to _out from now on.
+ * @param _out where to, stdout or an open file. stays the caller's.
+ * @return TRUE if success or FALSE if failed (started already).
+ */
+bool TCP_LogStart(FILE* _out);
+
+/**
+ * @brief write what is left in the ring, and stop the background thread.
+ * @return void
+ */
+void TCP_LogStop(void);
+
+/**
+ * @brief records under _level are dropped from now on, without being counted. on top of TCP_LOG_MIN_LEVEL.
+ * @param _level TCP_LOG_DEBUG to TCP_LOG_ERROR
+ * @return void
+ */
+void TCP_LogSetLevel(int _level);
+
+/**
+ * @brief records dropped since the start because the ring was full.
+ * @return the number
+ */
+unsigned long TCP_LogDropped(void);
+
+/**
+ * @brief add a record. called by the macros above.
+ * @param _level of the record
+ * @param _errno to add its text, 0 for none
+ * @param _format string literal, see above
+ * @param _number1 for the format
+ * @param _number2 for the format
+ * @param _text for a %.*s first in the format, NULL for none
+ * @param _textLength bytes of _text
+ * @return void
+ */
+void TCP_LogWrite(int _level, int _errno, const char* _format, long _number1, long _number2, const void* _text, unsigned int _textLength);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCP_LOG_H_ */
@@ -0,0 +1,678 @@
+/*
+ * tcp_pipeline.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h> /* iovec */
+
+#include "tcp_pipeline.h"
+#include "tcp_frame.h"
+#include "tcp_compress.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+
+#define GENERAL_ERROR -9
+
+#define PIPE_READ_SIZE 16384
+/* IDs are returned as int, so they wrap before reaching the sign bit. 0 is never used */
+#define MAX_REQUEST_ID 0x7fffffff
+
+typedef enum SlotState
+{
+	SLOT_FREE,
+	SLOT_PENDING,
+	SLOT_DONE /* response arrived and waits for TCP_PipelineWait */
+} SlotState_t;
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct PipeSlot
+{
+	uint m_requestID;
+	SlotState_t m_state;
+	pipelineDoneFunc m_doneFunc;
+	void* m_userData;
+
+	void* m_response; /* only for requests without a done function */
+	uint m_responseLength;
+	uint m_responseFlags;
+} PipeSlot_t;
+
+struct TCP_Pipe
+{
+	int m_magicNumber;
+
+	TCP_C_t* m_client;
+	int m_socketFD;
+
+	/* requests in flight. request ID n lives at slot (n & m_slotsMask) */
+	PipeSlot_t* m_slots;
+	uint m_slotsMask;
+	uint m_nextRequestID;
+	uint m_inFlight;
+
+	/* bytes received and not yet dispatched */
+	unsigned char* m_inBuf;
+	uint m_inLength;
+	uint m_inCapacity;
+
+	/* bytes the kernel did not take yet */
+	unsigned char* m_outBuf;
+	uint m_outLength;
+	uint m_outCapacity;
+
+	bool m_isDispatching; /* a done function is running, m_inBuf must not move */
+	uint m_lastFlags; /* of the response handled last, TCP_PipelineLastFlags */
+
+	/* compression. requests are compressed only once the server agreed */
+	bool m_isCompressOffered;
+	uint m_codec;
+	const TCP_Dict_t* m_dict;
+	uint m_compressThreshold;
+	unsigned char* m_packBuf; /* TCP_FRAME_MAX_PAYLOAD bytes each, allocated when offered */
+	unsigned char* m_unpackBuf;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_Pipe_t* _pipe);
+static int ReadResponses(TCP_Pipe_t* _pipe);
+static int DispatchResponses(TCP_Pipe_t* _pipe);
+static int DispatchResponse(TCP_Pipe_t* _pipe, TCP_FrameHeader_t* _header, unsigned char* _payload);
+static int SendRequest(TCP_Pipe_t* _pipe, uint _method, const void* _msg, uint _msgLength, pipelineDoneFunc _doneFunc, void* _userData);
+static bool SendFrame(TCP_Pipe_t* _pipe, uint _requestID, uint _method, uint _flags, const void* _msg, uint _msgLength);
+static void CompleteSlot(TCP_Pipe_t* _pipe, PipeSlot_t* _slot, unsigned char* _data, uint _length);
+static bool AppendOut(TCP_Pipe_t* _pipe, const void* _data, uint _length);
+static int FlushOut(TCP_Pipe_t* _pipe);
+static bool EnsureCapacity(unsigned char** _buf, uint* _capacity, uint _needed);
+static long NowMS(void);
+static bool SetSocketBlockingEnabled(int fd, bool blocking);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Pipe_t* TCP_CreatePipeline(TCP_C_t* _client, uint _maxInFlight)
+{
+	TCP_Pipe_t* aPipe;
+	uint slotsNum = 1;
+	int socketFD;
+
+	socketFD = TCP_ClientGetSocket(_client);
+	if (socketFD < 0 || 0 == _maxInFlight)
+	{
+		return NULL;
+	}
+
+	while (slotsNum < _maxInFlight)
+	{
+		slotsNum *= 2;
+	}
+
+	aPipe = calloc(1, sizeof(TCP_Pipe_t) );
+	if (!aPipe)
+	{
+		return NULL;
+	}
+
+	aPipe->m_slots = calloc(slotsNum, sizeof(PipeSlot_t) );
+	if (! aPipe->m_slots)
+	{
+		free(aPipe);
+		return NULL;
+	}
+
+	if (! SetSocketBlockingEnabled(socketFD, FALSE) )
+	{
+		free(aPipe->m_slots);
+		free(aPipe);
+		return NULL;
+	}
+
+	aPipe->m_client = _client;
+	aPipe->m_socketFD = socketFD;
+	aPipe->m_slotsMask = slotsNum - 1;
+	aPipe->m_nextRequestID = 1;
+
+	aPipe->m_magicNumber = ALIVE_MAGIC_NUMBER;
+
+	return aPipe;
+}
+
+void TCP_DestroyPipeline(TCP_Pipe_t* _pipe)
+{
+	uint i;
+
+	if ( !IsStructValid(_pipe) )
+	{
+		return;
+	}
+
+	_pipe->m_magicNumber = DEAD_MAGIC_NUMBER;
+
+	/* give the client back as it was taken */
+	SetSocketBlockingEnabled(_pipe->m_socketFD, TRUE);
+
+	for (i = 0; i <= _pipe->m_slotsMask; ++i)
+	{
+		free(_pipe->m_slots[i].m_response);
+	}
+	free(_pipe->m_slots);
+	free(_pipe->m_inBuf);
+	free(_pipe->m_outBuf);
+	free(_pipe->m_packBuf);
+	free(_pipe->m_unpackBuf);
+	free(_pipe);
+	return;
+}
+
+int TCP_PipelineSend(TCP_Pipe_t* _pipe, const void* _msg, uint _msgLength, pipelineDoneFunc _doneFunc, void* _userData)
+{
+	return SendRequest(_pipe, 0, _msg, _msgLength, _doneFunc, _userData);
+}
+
+int TCP_PipelineSendMethod(TCP_Pipe_t* _pipe, uint _method, const void* _msg, uint _msgLength, pipelineDoneFunc _doneFunc, void* _userData)
+{
+	if (0 == _method || _method > UINT16_MAX)
+	{
+		return GENERAL_ERROR;
+	}
+	return SendRequest(_pipe, _method, _msg, _msgLength, _doneFunc, _userData);
+}
+
+uint TCP_PipelineLastFlags(TCP_Pipe_t* _pipe)
+{
+	return IsStructValid(_pipe) ? _pipe->m_lastFlags : 0;
+}
+
+int TCP_PipelinePoll(TCP_Pipe_t* _pipe, int _timeoutMS)
+{
+	struct pollfd pfd;
+	long deadline = NowMS() + _timeoutMS;
+	int handled = 0;
+	int activity;
+	int waitMS = _timeoutMS;
+
+	if ( !IsStructValid(_pipe) || _pipe->m_isDispatching)
+	{
+		return GENERAL_ERROR;
+	}
+
+	if (FlushOut(_pipe) < 0)
+	{
+		return GENERAL_ERROR;
+	}
+
+	while (TRUE)
+	{
+		pfd.fd = _pipe->m_socketFD;
+		pfd.events = POLLIN | (_pipe->m_outLength ? POLLOUT : 0);
+		pfd.revents = 0;
+
+		activity = poll(&pfd, 1, waitMS);
+		if (activity < 0 && errno != EINTR)
+		{
+			perror("PipelinePoll poll error");
+			return GENERAL_ERROR;
+		}
+
+		if (activity > 0)
+		{
+			if ((pfd.revents & POLLOUT) && FlushOut(_pipe) < 0)
+			{
+				return GENERAL_ERROR;
+			}
+			if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+			{
+				handled = ReadResponses(_pipe);
+				if (handled != 0)
+				{
+					return handled;
+				}
+			}
+		}
+
+		/* only writes happened so far. keep waiting for a response until the time is over */
+		if (_timeoutMS >= 0)
+		{
+			waitMS = deadline - NowMS();
+			if (waitMS <= 0)
+			{
+				return 0;
+			}
+		}
+	}
+}
+
+int TCP_PipelineWait(TCP_Pipe_t* _pipe, uint _requestID, void* _buffer, uint _bufferMaxLength, int _timeoutMS)
+{
+	PipeSlot_t* slot;
+	long deadline = NowMS() + _timeoutMS;
+	int waitMS = _timeoutMS;
+	int length;
+
+	if ( !IsStructValid(_pipe) || NULL == _buffer)
+	{
+		return GENERAL_ERROR;
+	}
+
+	slot = &_pipe->m_slots[_requestID & _pipe->m_slotsMask];
+	if (slot->m_requestID != _requestID || slot->m_state == SLOT_FREE || slot->m_doneFunc)
+	{
+		return GENERAL_ERROR;
+	}
+
+	while (slot->m_state == SLOT_PENDING)
+	{
+		if (TCP_PipelinePoll(_pipe, waitMS) < 0)
+		{
+			return GENERAL_ERROR;
+		}
+		if (_timeoutMS >= 0)
+		{
+			waitMS = deadline - NowMS();
+			if (waitMS <= 0 && slot->m_state == SLOT_PENDING)
+			{
+				return GENERAL_ERROR;
+			}
+		}
+	}
+
+	length = (slot->m_responseLength < _bufferMaxLength) ? slot->m_responseLength : _bufferMaxLength;
+	memcpy(_buffer, slot->m_response, length);
+	_pipe->m_lastFlags = slot->m_responseFlags;
+
+	free(slot->m_response);
+	slot->m_response = NULL;
+	slot->m_state = SLOT_FREE;
+
+	return length;
+}
+
+bool TCP_PipelineSetCompression(TCP_Pipe_t* _pipe, const TCP_Dict_t* _dict, uint _threshold)
+{
+	unsigned char hello[TCP_COMPRESS_HELLO_SIZE];
+
+	if ( !IsStructValid(_pipe) || _pipe->m_isCompressOffered)
+	{
+		return FALSE;
+	}
+
+	_pipe->m_packBuf = malloc(TCP_FRAME_MAX_PAYLOAD);
+	_pipe->m_unpackBuf = malloc(TCP_FRAME_MAX_PAYLOAD);
+	if (! _pipe->m_packBuf || ! _pipe->m_unpackBuf)
+	{
+		free(_pipe->m_packBuf);
+		free(_pipe->m_unpackBuf);
+		_pipe->m_packBuf = NULL;
+		_pipe->m_unpackBuf = NULL;
+		return FALSE;
+	}
+
+	_pipe->m_dict = _dict;
+	_pipe->m_compressThreshold = _threshold;
+
+	/* request ID 0 is never used by a request. the answer is handled by DispatchResponse */
+	TCP_CompressHelloEncode(TCP_CODEC_LZ, TCP_DictionaryID(_dict), hello);
+	if (! SendFrame(_pipe, 0, 0, TCP_FRAME_FLAG_HELLO, hello, TCP_COMPRESS_HELLO_SIZE) )
+	{
+		return FALSE;
+	}
+	_pipe->m_isCompressOffered = TRUE;
+
+	return TRUE;
+}
+
+int TCP_PipelineInFlight(TCP_Pipe_t* _pipe)
+{
+	if ( !IsStructValid(_pipe) )
+	{
+		return GENERAL_ERROR;
+	}
+	return _pipe->m_inFlight;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_Pipe_t* _pipe)
+{
+	return !(NULL == _pipe || ALIVE_MAGIC_NUMBER != _pipe->m_magicNumber);
+}
+
+/* returns the request ID, or GENERAL_ERROR */
+static int SendRequest(TCP_Pipe_t* _pipe, uint _method, const void* _msg, uint _msgLength, pipelineDoneFunc _doneFunc, void* _userData)
+{
+	PipeSlot_t* slot;
+	uint packedLength;
+	uint requestID;
+
+	if ( !IsStructValid(_pipe) || (NULL == _msg && _msgLength > 0) || _msgLength > TCP_FRAME_MAX_PAYLOAD)
+	{
+		return GENERAL_ERROR;
+	}
+
+	requestID = _pipe->m_nextRequestID;
+	slot = &_pipe->m_slots[requestID & _pipe->m_slotsMask];
+
+	/* the slot is still held by an older request. make room by reading responses */
+	while (slot->m_state != SLOT_FREE)
+	{
+		if (_pipe->m_isDispatching || slot->m_state == SLOT_DONE)
+		{
+			/* can not read from inside a done function, and a kept response is freed only by its wait */
+			return GENERAL_ERROR;
+		}
+		if (TCP_PipelinePoll(_pipe, -1) < 0)
+		{
+			return GENERAL_ERROR;
+		}
+	}
+
+	packedLength = 0;
+	if (_pipe->m_codec == TCP_CODEC_LZ && _msgLength >= _pipe->m_compressThreshold)
+	{
+		packedLength = TCP_Compress(_msg, _msgLength, _pipe->m_packBuf, TCP_FRAME_MAX_PAYLOAD, _pipe->m_dict);
+	}
+
+	/* when it did not get smaller, it is sent as it is */
+	if ( (packedLength > 0 && ! SendFrame(_pipe, requestID, _method, TCP_FRAME_FLAG_COMPRESSED, _pipe->m_packBuf, packedLength) )
+		|| (0 == packedLength && ! SendFrame(_pipe, requestID, _method, 0, _msg, _msgLength) ) )
+	{
+		return GENERAL_ERROR;
+	}
+
+	slot->m_requestID = requestID;
+	slot->m_state = SLOT_PENDING;
+	slot->m_doneFunc = _doneFunc;
+	slot->m_userData = _userData;
+	_pipe->m_inFlight++;
+
+	_pipe->m_nextRequestID = (requestID == MAX_REQUEST_ID) ? 1 : requestID + 1;
+
+	return requestID;
+}
+
+/* returns the number of responses handled, or GENERAL_ERROR when the connection is closed or broken */
+static int ReadResponses(TCP_Pipe_t* _pipe)
+{
+	int nBytesRead;
+
+	if (! EnsureCapacity(&_pipe->m_inBuf, &_pipe->m_inCapacity, _pipe->m_inLength + PIPE_READ_SIZE) )
+	{
+		return GENERAL_ERROR;
+	}
+
+	nBytesRead = recv(_pipe->m_socketFD, _pipe->m_inBuf + _pipe->m_inLength, _pipe->m_inCapacity - _pipe->m_inLength, 0);
+	if (nBytesRead == 0)
+	{
+		#if !defined(NDEBUG) /* DEBUG */
+		printf("socket #%d was closed on server side. should disconnect from server.\n", _pipe->m_socketFD);
+		#endif
+		return GENERAL_ERROR;
+	}
+	if (nBytesRead < 0)
+	{
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : GENERAL_ERROR;
+	}
+
+	_pipe->m_inLength += nBytesRead;
+
+	return DispatchResponses(_pipe);
+}
+
+static int DispatchResponses(TCP_Pipe_t* _pipe)
+{
+	TCP_FrameHeader_t header;
+	uint offset = 0;
+	int handled = 0;
+	int result;
+
+	_pipe->m_isDispatching = TRUE;
+	while (_pipe->m_inLength - offset >= TCP_FRAME_HEADER_SIZE)
+	{
+		if (! TCP_FrameDecode(_pipe->m_inBuf + offset, &header) )
+		{
+			_pipe->m_isDispatching = FALSE;
+			return GENERAL_ERROR;
+		}
+		if (_pipe->m_inLength - offset - TCP_FRAME_HEADER_SIZE < header.m_length)
+		{
+			break;
+		}
+
+		result = DispatchResponse(_pipe, &header, _pipe->m_inBuf + offset + TCP_FRAME_HEADER_SIZE);
+		if (result < 0)
+		{
+			_pipe->m_isDispatching = FALSE;
+			return GENERAL_ERROR;
+		}
+		handled += result;
+
+		offset += TCP_FRAME_HEADER_SIZE + header.m_length;
+	}
+	_pipe->m_isDispatching = FALSE;
+
+	_pipe->m_inLength -= offset;
+	memmove(_pipe->m_inBuf, _pipe->m_inBuf + offset, _pipe->m_inLength);
+
+	return handled;
+}
+
+/* returns 1 if a request was completed, 0 if not, GENERAL_ERROR when the server broke the protocol */
+static int DispatchResponse(TCP_Pipe_t* _pipe, TCP_FrameHeader_t* _header, unsigned char* _payload)
+{
+	PipeSlot_t* slot;
+	uint codec;
+	uint32_t dictID;
+	int length = _header->m_length;
+
+	if (_header->m_flags & TCP_FRAME_FLAG_HELLO)
+	{
+		/* the server answer to the compression offer */
+		if (! _pipe->m_isCompressOffered || ! TCP_CompressHelloDecode(_payload, _header->m_length, &codec, &dictID) )
+		{
+			return GENERAL_ERROR;
+		}
+		_pipe->m_codec = codec;
+		if (dictID != TCP_DictionaryID(_pipe->m_dict) )
+		{
+			_pipe->m_dict = NULL;
+		}
+		return 0;
+	}
+
+	slot = &_pipe->m_slots[_header->m_requestID & _pipe->m_slotsMask];
+	if (slot->m_state != SLOT_PENDING || slot->m_requestID != _header->m_requestID)
+	{
+		/* a response nobody waits for. skip it */
+		return 0;
+	}
+
+	if (_header->m_flags & TCP_FRAME_FLAG_COMPRESSED)
+	{
+		if (! _pipe->m_isCompressOffered)
+		{
+			return GENERAL_ERROR;
+		}
+		length = TCP_Decompress(_payload, _header->m_length, _pipe->m_unpackBuf, TCP_FRAME_MAX_PAYLOAD, _pipe->m_dict);
+		if (length < 0)
+		{
+			return GENERAL_ERROR;
+		}
+		_payload = _pipe->m_unpackBuf;
+	}
+
+	slot->m_responseFlags = _header->m_flags & ~TCP_FRAME_FLAG_COMPRESSED;
+	CompleteSlot(_pipe, slot, _payload, length);
+	return 1;
+}
+
+static void CompleteSlot(TCP_Pipe_t* _pipe, PipeSlot_t* _slot, unsigned char* _data, uint _length)
+{
+	_pipe->m_inFlight--;
+
+	if (_slot->m_doneFunc)
+	{
+		/* free the slot first, the function might send the next request */
+		_slot->m_state = SLOT_FREE;
+		_pipe->m_lastFlags = _slot->m_responseFlags;
+		_slot->m_doneFunc(_slot->m_requestID, _data, _length, _slot->m_userData);
+		return;
+	}
+
+	/* future style. keep a copy until the user wait for it */
+	_slot->m_response = malloc(_length ? _length : 1);
+	if (_slot->m_response)
+	{
+		memcpy(_slot->m_response, _data, _length);
+	}
+	_slot->m_responseLength = _slot->m_response ? _length : 0;
+	_slot->m_state = SLOT_DONE;
+}
+
+/* send a frame now, or queue what the kernel did not take for the next poll */
+static bool SendFrame(TCP_Pipe_t* _pipe, uint _requestID, uint _method, uint _flags, const void* _msg, uint _msgLength)
+{
+	unsigned char header[TCP_FRAME_HEADER_SIZE];
+	TCP_FrameHeader_t frameHeader;
+	struct iovec iov[2];
+	struct msghdr msg;
+	int sent_bytes = 0;
+
+	frameHeader.m_length = _msgLength;
+	frameHeader.m_requestID = _requestID;
+	frameHeader.m_flags = _flags;
+	frameHeader.m_method = _method;
+	TCP_FrameEncode(&frameHeader, header);
+
+	if (0 == _pipe->m_outLength)
+	{
+		/* nothing queued, try to hand the frame to the kernel right away with one system call */
+		iov[0].iov_base = header;
+		iov[0].iov_len = TCP_FRAME_HEADER_SIZE;
+		iov[1].iov_base = (void*) _msg;
+		iov[1].iov_len = _msgLength;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = 2;
+
+		/* a server that closed the connection fails the send, as FlushOut, instead of killing the client with SIGPIPE */
+		sent_bytes = sendmsg(_pipe->m_socketFD, &msg, MSG_NOSIGNAL);
+		if (sent_bytes < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				perror("PipelineSend Failed");
+				return FALSE;
+			}
+			sent_bytes = 0;
+		}
+	}
+
+	if (sent_bytes < TCP_FRAME_HEADER_SIZE)
+	{
+		return AppendOut(_pipe, header + sent_bytes, TCP_FRAME_HEADER_SIZE - sent_bytes)
+				&& AppendOut(_pipe, _msg, _msgLength);
+	}
+	if ((uint) sent_bytes < TCP_FRAME_HEADER_SIZE + _msgLength)
+	{
+		return AppendOut(_pipe, (const char*) _msg + (sent_bytes - TCP_FRAME_HEADER_SIZE), TCP_FRAME_HEADER_SIZE + _msgLength - sent_bytes);
+	}
+
+	return TRUE;
+}
+
+static bool AppendOut(TCP_Pipe_t* _pipe, const void* _data, uint _length)
+{
+	if (! EnsureCapacity(&_pipe->m_outBuf, &_pipe->m_outCapacity, _pipe->m_outLength + _length) )
+	{
+		return FALSE;
+	}
+
+	memcpy(_pipe->m_outBuf + _pipe->m_outLength, _data, _length);
+	_pipe->m_outLength += _length;
+	return TRUE;
+}
+
+/* returns the bytes left in the queue, or GENERAL_ERROR */
+static int FlushOut(TCP_Pipe_t* _pipe)
+{
+	int sent_bytes;
+
+	while (_pipe->m_outLength > 0)
+	{
+		sent_bytes = send(_pipe->m_socketFD, _pipe->m_outBuf, _pipe->m_outLength, MSG_NOSIGNAL);
+		if (sent_bytes < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				return _pipe->m_outLength;
+			}
+			perror("PipelineSend Failed");
+			return GENERAL_ERROR;
+		}
+
+		memmove(_pipe->m_outBuf, _pipe->m_outBuf + sent_bytes, _pipe->m_outLength - sent_bytes);
+		_pipe->m_outLength -= sent_bytes;
+	}
+
+	return 0;
+}
+
+static bool EnsureCapacity(unsigned char** _buf, uint* _capacity, uint _needed)
+{
+	uint newCapacity;
+	unsigned char* newBuf;
+
+	if (_needed <= *_capacity)
+	{
+		return TRUE;
+	}
+
+	newCapacity = *_capacity ? *_capacity : PIPE_READ_SIZE;
+	while (newCapacity < _needed)
+	{
+		newCapacity *= 2;
+	}
+
+	newBuf = realloc(*_buf, newCapacity);
+	if (! newBuf)
+	{
+		return FALSE;
+	}
+
+	*_buf = newBuf;
+	*_capacity = newCapacity;
+	return TRUE;
+}
+
+static long NowMS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+/** Returns true on success, or false if there was an error */
+static bool SetSocketBlockingEnabled(int fd, bool blocking)
+{
+	if (fd < 0) return FALSE;
+
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0) return FALSE;
+	flags = blocking ? (flags&~O_NONBLOCK) : (flags|O_NONBLOCK);
+	return (fcntl(fd, F_SETFL, flags) == 0) ? TRUE : FALSE;
+}
@@ -0,0 +1,117 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Pipelined requests over one TCP client connection.
+ * Every request is sent as a frame (see tcp_frame.h) tagged with a request ID, and many requests can be in flight at once.
+ * Responses are matched by the ID to their completion function, or kept until the user wait for them (future style).
+ * The server must run in framed mode and echo the request ID back, see TCP_ServerSetFraming and TCP_SendFrame.
+ *
+ * @bug
+ */
+
+#ifndef TCP_PIPELINE_H_
+#define TCP_PIPELINE_H_
+
+#include <sys/types.h> /* size_t */
+
+#include "tcp_client.h"
+#include "tcp_compress.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief invoked when the response of a request arrives. _data is valid only until the function returns.
+ */
+typedef void (*pipelineDoneFunc)(uint _requestID, void* _data, size_t _sizeData, void* _userData);
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_Pipe TCP_Pipe_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Take over a connected client for pipelined requests.
+ * The client socket is switched to non-blocking and must not be used with TCP_ClientSend / TCP_ClientRecive until the pipeline is destroyed.
+ * @param _client a connected client
+ * @param _maxInFlight max number of requests waiting for a response. rounded up to a power of 2.
+ * @return pointer to the newly create struct. NULL if failed.
+ */
+TCP_Pipe_t* TCP_CreatePipeline(TCP_C_t* _client, uint _maxInFlight);
+
+/**
+ * @brief Free the pipeline. requests still in flight are dropped without their functions invoked. the client is not destroyed.
+ * @param _pipe pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_DestroyPipeline(TCP_Pipe_t* _pipe);
+
+/**
+ * @brief Send a request without waiting for its response.
+ * When _maxInFlight requests are already in flight, responses are read (and their functions invoked) until there is room.
+ * @param _pipe pointer to the struct
+ * @param _msg the request payload.
+ * @param _msgLength the payload size. up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * @param _doneFunc invoked with the response. NULL to keep the response for TCP_PipelineWait.
+ * @param _userData user pointer passed to _doneFunc.
+ * @return the request ID (positive number), or negative number on error.
+ */
+int TCP_PipelineSend(TCP_Pipe_t* _pipe, const void* _msg, uint _msgLength, pipelineDoneFunc _doneFunc, void* _userData);
+
+/**
+ * @brief TCP_PipelineSend for a call of an RPC method (see tcp_rpc.h). the method goes in the frame header.
+ * @param _pipe pointer to the struct
+ * @param _method 1 to 65535
+ * @param _msg the arguments.
+ * @param _msgLength the arguments size. up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * @param _doneFunc invoked with the answer. NULL to keep it for TCP_PipelineWait.
+ * @param _userData user pointer passed to _doneFunc.
+ * @return the request ID (positive number), or negative number on error.
+ */
+int TCP_PipelineSendMethod(TCP_Pipe_t* _pipe, uint _method, const void* _msg, uint _msgLength, pipelineDoneFunc _doneFunc, void* _userData);
+
+/**
+ * @brief the frame flags of the response handled last (TCP_FRAME_FLAG_ERROR). inside a done function, of its own
+ * response. after TCP_PipelineWait, of the one waited for.
+ * @param _pipe pointer to the struct
+ * @return the flags, 0 on error.
+ */
+uint TCP_PipelineLastFlags(TCP_Pipe_t* _pipe);
+
+/**
+ * @brief Read the responses that arrived and invoke their functions.
+ * @param _pipe pointer to the struct
+ * @param _timeoutMS max wait for the first response. 0 to not wait, -1 to wait until one arrives.
+ * @return number of responses handled, or negative number on error (the connection should be dropped).
+ */
+int TCP_PipelinePoll(TCP_Pipe_t* _pipe, int _timeoutMS);
+
+/**
+ * @brief Wait for the response of a request sent without a done function.
+ * @param _pipe pointer to the struct
+ * @param _requestID as returned by TCP_PipelineSend
+ * @param _buffer the response is copied here
+ * @param _bufferMaxLength the buffer size. a longer response is truncated.
+ * @param _timeoutMS max wait time. -1 to wait until it arrives.
+ * @return the response size, or negative number on error or timeout.
+ */
+int TCP_PipelineWait(TCP_Pipe_t* _pipe, uint _requestID, void* _buffer, uint _bufferMaxLength, int _timeoutMS);
+
+/**
+ * @brief Offer the server to compress the frames of this connection (see tcp_compress.h). requests are sent as they are
+ * until the server answers. best called before the first request. the server must agree with TCP_ServerSetCompression.
+ * @param _pipe pointer to the struct
+ * @param _dict dictionary to use if the server has the same one. can be NULL. must live as long as the pipeline.
+ * @param _threshold smaller requests are not compressed. TCP_COMPRESS_DEFAULT_THRESHOLD is a good start.
+ * @return TRUE if the offer was sent, FALSE otherwise.
+ */
+bool TCP_PipelineSetCompression(TCP_Pipe_t* _pipe, const TCP_Dict_t* _dict, uint _threshold);
+
+/**
+ * @brief get the number of requests waiting for a response.
+ * @param _pipe pointer to the struct
+ * @return number of requests in flight, or negative number on error.
+ */
+int TCP_PipelineInFlight(TCP_Pipe_t* _pipe);
+
+#endif /* TCP_PIPELINE_H_ */
@@ -0,0 +1,409 @@
+/*
+ * tcp_pool.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <arpa/inet.h> /* INET6_ADDRSTRLEN */
+
+#include "tcp_pool.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct PoolEntry
+{
+	TCP_C_t* m_client;
+	unsigned long m_lastUsedMS;
+} PoolEntry_t;
+
+struct TCP_Pool
+{
+	int m_magicNumber;
+
+	char m_serverIP[INET6_ADDRSTRLEN];
+	uint m_serverPort;
+
+	uint m_minWarm;
+	uint m_maxConnections;
+	uint m_idleTimeoutMS;
+	uint m_healthCheckMS;
+
+	/* idle clients. index 0 is the one idle for the longest time */
+	PoolEntry_t* m_idle;
+	uint m_idleNum;
+	TCP_C_t** m_busy; /* checked out clients. only these can be checked in */
+	uint m_busyNum;
+	uint m_pendingNum; /* connects in progress, counted against m_maxConnections */
+
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_availableCond; /* a client was checked in or added */
+	pthread_cond_t m_stopCond;
+	pthread_t m_healthThread;
+	bool m_isRun;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_Pool_t* _pool);
+static void* HealthThread(void* _pool);
+static void CheckIdleClients(TCP_Pool_t* _pool);
+static void FillWarmClients(TCP_Pool_t* _pool);
+static TCP_C_t* ConnectUnlocked(TCP_Pool_t* _pool);
+static void MarkBusy(TCP_Pool_t* _pool, TCP_C_t* _client);
+static bool UnmarkBusy(TCP_Pool_t* _pool, TCP_C_t* _client);
+static unsigned long NowMS(void);
+static struct timespec DeadlineAfter(uint _MS);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Pool_t* TCP_CreatePool(char* _serverIP, uint _serverPort, uint _minWarm, uint _maxConnections,
+		uint _idleTimeoutMS, uint _healthCheckMS)
+{
+	TCP_Pool_t* aPool;
+	pthread_condattr_t condAttr;
+
+	if (NULL == _serverIP || 0 == _maxConnections || _minWarm > _maxConnections || 0 == _healthCheckMS)
+	{
+		return NULL;
+	}
+
+	aPool = calloc(1, sizeof(TCP_Pool_t) );
+	if (!aPool)
+	{
+		return NULL;
+	}
+
+	aPool->m_idle = malloc(_maxConnections * sizeof(PoolEntry_t) );
+	aPool->m_busy = malloc(_maxConnections * sizeof(TCP_C_t*) );
+	if (! aPool->m_idle || ! aPool->m_busy)
+	{
+		free(aPool->m_idle);
+		free(aPool->m_busy);
+		free(aPool);
+		return NULL;
+	}
+
+	strncpy(aPool->m_serverIP, _serverIP, INET6_ADDRSTRLEN - 1);
+	aPool->m_serverPort = _serverPort;
+	aPool->m_minWarm = _minWarm;
+	aPool->m_maxConnections = _maxConnections;
+	aPool->m_idleTimeoutMS = _idleTimeoutMS;
+	aPool->m_healthCheckMS = _healthCheckMS;
+
+	/* waits are measured on the monotonic clock, so a clock change would not break them */
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&aPool->m_lock, NULL);
+	pthread_cond_init(&aPool->m_availableCond, &condAttr);
+	pthread_cond_init(&aPool->m_stopCond, &condAttr);
+	pthread_condattr_destroy(&condAttr);
+
+	aPool->m_magicNumber = ALIVE_MAGIC_NUMBER;
+
+	/* warm up before returning, so the first requests do not pay the handshake */
+	pthread_mutex_lock(&aPool->m_lock);
+	FillWarmClients(aPool);
+	aPool->m_isRun = TRUE;
+	pthread_mutex_unlock(&aPool->m_lock);
+
+	if (pthread_create(&aPool->m_healthThread, NULL, HealthThread, aPool) != 0)
+	{
+		perror("CreatePool, thread create Failed");
+		aPool->m_isRun = FALSE;
+		TCP_DestroyPool(aPool);
+		return NULL;
+	}
+
+	return aPool;
+}
+
+void TCP_DestroyPool(TCP_Pool_t* _pool)
+{
+	uint i;
+
+	if ( !IsStructValid(_pool) )
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&_pool->m_lock);
+	if (_pool->m_isRun)
+	{
+		_pool->m_isRun = FALSE;
+		pthread_cond_signal(&_pool->m_stopCond);
+		pthread_mutex_unlock(&_pool->m_lock);
+		pthread_join(_pool->m_healthThread, NULL);
+		pthread_mutex_lock(&_pool->m_lock);
+	}
+	_pool->m_magicNumber = DEAD_MAGIC_NUMBER;
+
+	for (i = 0; i < _pool->m_idleNum; ++i)
+	{
+		TCP_DestroyClient(_pool->m_idle[i].m_client);
+	}
+	pthread_mutex_unlock(&_pool->m_lock);
+
+	pthread_cond_destroy(&_pool->m_availableCond);
+	pthread_cond_destroy(&_pool->m_stopCond);
+	pthread_mutex_destroy(&_pool->m_lock);
+
+	free(_pool->m_idle);
+	free(_pool->m_busy);
+	free(_pool);
+	return;
+}
+
+TCP_C_t* TCP_PoolCheckout(TCP_Pool_t* _pool, uint _waitMS)
+{
+	TCP_C_t* client;
+	struct timespec deadline;
+
+	if ( !IsStructValid(_pool) )
+	{
+		return NULL;
+	}
+
+	deadline = DeadlineAfter(_waitMS);
+
+	pthread_mutex_lock(&_pool->m_lock);
+	while (TRUE)
+	{
+		/* most recently used first, it is the least likely to have been closed by the server */
+		while (_pool->m_idleNum > 0)
+		{
+			client = _pool->m_idle[--_pool->m_idleNum].m_client;
+			if (TCP_ClientIsAlive(client) )
+			{
+				MarkBusy(_pool, client);
+				pthread_mutex_unlock(&_pool->m_lock);
+				return client;
+			}
+			TCP_DestroyClient(client);
+		}
+
+		if (_pool->m_busyNum + _pool->m_pendingNum < _pool->m_maxConnections)
+		{
+			client = ConnectUnlocked(_pool);
+			if (client)
+			{
+				MarkBusy(_pool, client);
+			}
+			pthread_mutex_unlock(&_pool->m_lock);
+			return client;
+		}
+
+		if (pthread_cond_timedwait(&_pool->m_availableCond, &_pool->m_lock, &deadline) != 0)
+		{
+			pthread_mutex_unlock(&_pool->m_lock);
+			return NULL;
+		}
+	}
+}
+
+bool TCP_PoolCheckin(TCP_Pool_t* _pool, TCP_C_t* _client, bool _isBroken)
+{
+	if ( !IsStructValid(_pool) || NULL == _client)
+	{
+		return FALSE;
+	}
+
+	pthread_mutex_lock(&_pool->m_lock);
+	if (! UnmarkBusy(_pool, _client) )
+	{
+		/* of another pool, or checked in already. taking it would put it in the pool twice */
+		pthread_mutex_unlock(&_pool->m_lock);
+		return FALSE;
+	}
+
+	if (_isBroken || ! TCP_ClientIsAlive(_client) )
+	{
+		TCP_DestroyClient(_client);
+	}
+	else
+	{
+		_pool->m_idle[_pool->m_idleNum].m_client = _client;
+		_pool->m_idle[_pool->m_idleNum].m_lastUsedMS = NowMS();
+		_pool->m_idleNum++;
+	}
+
+	/* a waiter can take the idle client, or open a new one in place of the destroyed one */
+	pthread_cond_signal(&_pool->m_availableCond);
+	pthread_mutex_unlock(&_pool->m_lock);
+
+	return TRUE;
+}
+
+bool TCP_PoolStatus(TCP_Pool_t* _pool, uint* _idleNum, uint* _busyNum)
+{
+	if ( !IsStructValid(_pool) )
+	{
+		return FALSE;
+	}
+
+	pthread_mutex_lock(&_pool->m_lock);
+	if (_idleNum)
+	{
+		*_idleNum = _pool->m_idleNum;
+	}
+	if (_busyNum)
+	{
+		*_busyNum = _pool->m_busyNum;
+	}
+	pthread_mutex_unlock(&_pool->m_lock);
+
+	return TRUE;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_Pool_t* _pool)
+{
+	return !(NULL == _pool || ALIVE_MAGIC_NUMBER != _pool->m_magicNumber);
+}
+
+static void* HealthThread(void* _pool)
+{
+	TCP_Pool_t* pool = _pool;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&pool->m_lock);
+	while (pool->m_isRun)
+	{
+		deadline = DeadlineAfter(pool->m_healthCheckMS);
+		pthread_cond_timedwait(&pool->m_stopCond, &pool->m_lock, &deadline);
+		if (! pool->m_isRun)
+		{
+			break;
+		}
+
+		CheckIdleClients(pool);
+		FillWarmClients(pool);
+	}
+	pthread_mutex_unlock(&pool->m_lock);
+
+	return NULL;
+}
+
+/* must be called with the lock held */
+static void CheckIdleClients(TCP_Pool_t* _pool)
+{
+	unsigned long now = NowMS();
+	uint total = _pool->m_idleNum + _pool->m_busyNum + _pool->m_pendingNum;
+	uint i;
+	uint kept = 0;
+	PoolEntry_t* entry;
+
+	for (i = 0; i < _pool->m_idleNum; ++i)
+	{
+		entry = &_pool->m_idle[i];
+
+		if (! TCP_ClientIsAlive(entry->m_client)
+			|| (total > _pool->m_minWarm && now - entry->m_lastUsedMS > _pool->m_idleTimeoutMS) )
+		{
+			TCP_DestroyClient(entry->m_client);
+			total--;
+			continue;
+		}
+
+		/* keep the order, oldest stay at the bottom */
+		_pool->m_idle[kept++] = *entry;
+	}
+
+	_pool->m_idleNum = kept;
+}
+
+/* must be called with the lock held */
+static void FillWarmClients(TCP_Pool_t* _pool)
+{
+	TCP_C_t* client;
+
+	while (_pool->m_idleNum + _pool->m_busyNum + _pool->m_pendingNum < _pool->m_minWarm)
+	{
+		client = ConnectUnlocked(_pool);
+		if (! client)
+		{
+			/* server is down. try again on the next health check */
+			return;
+		}
+
+		/* new clients go on top, they are the freshest */
+		_pool->m_idle[_pool->m_idleNum].m_client = client;
+		_pool->m_idle[_pool->m_idleNum].m_lastUsedMS = NowMS();
+		_pool->m_idleNum++;
+		pthread_cond_signal(&_pool->m_availableCond);
+	}
+}
+
+/* must be called with the lock held. the lock is released during the handshake */
+static TCP_C_t* ConnectUnlocked(TCP_Pool_t* _pool)
+{
+	TCP_C_t* client;
+
+	_pool->m_pendingNum++;
+	pthread_mutex_unlock(&_pool->m_lock);
+
+	client = TCP_CreateClient(_pool->m_serverIP, _pool->m_serverPort);
+
+	pthread_mutex_lock(&_pool->m_lock);
+	_pool->m_pendingNum--;
+
+	return client;
+}
+
+/* must be called with the lock held */
+static void MarkBusy(TCP_Pool_t* _pool, TCP_C_t* _client)
+{
+	_pool->m_busy[_pool->m_busyNum++] = _client;
+}
+
+/* must be called with the lock held. FALSE if the client is not checked out of this pool */
+static bool UnmarkBusy(TCP_Pool_t* _pool, TCP_C_t* _client)
+{
+	uint i;
+
+	for (i = 0; i < _pool->m_busyNum; ++i)
+	{
+		if (_pool->m_busy[i] == _client)
+		{
+			/* the order does not matter, the last takes its place */
+			_pool->m_busy[i] = _pool->m_busy[--_pool->m_busyNum];
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static unsigned long NowMS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000UL + now.tv_nsec / 1000000UL;
+}
+
+static struct timespec DeadlineAfter(uint _MS)
+{
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += _MS / 1000;
+	deadline.tv_nsec += (_MS % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	return deadline;
+}
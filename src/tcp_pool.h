@@ -0,0 +1,70 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief A pool of warm TCP client connections to one server.
+ * A background thread keeps a minimum of connected clients ready, closes clients idle for too long
+ * and replaces connections the server has closed. All functions are thread safe.
+ *
+ * @bug
+ */
+
+#ifndef TCP_POOL_H_
+#define TCP_POOL_H_
+
+#include "tcp_client.h"
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_Pool TCP_Pool_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create the pool, connect the warm clients and start the background thread.
+ * @param _serverIP the ip address of the server
+ * @param _serverPort the listning for new connection port on the server
+ * @param _minWarm number of connected clients the pool tries to always hold.
+ * @param _maxConnections max number of clients, checked out and idle together.
+ * @param _idleTimeoutMS an idle client above the _minWarm count is closed after this time (miliSeconds).
+ * @param _healthCheckMS the interval (miliSeconds) in which idle clients are checked and the pool is refilled.
+ * @return pointer to the newly create struct. NULL if failed. a server that is down at creation is not a failure.
+ */
+TCP_Pool_t* TCP_CreatePool(char* _serverIP, uint _serverPort, uint _minWarm, uint _maxConnections,
+						uint _idleTimeoutMS, uint _healthCheckMS);
+
+/**
+ * @brief Stop the background thread and destroy all idle clients.
+ * Clients that are still checked out are not destroyed, they should be checked in first.
+ * @param _pool pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_DestroyPool(TCP_Pool_t* _pool);
+
+/**
+ * @brief Take a connected client out of the pool. dead idle clients are replaced on the way.
+ * @param _pool pointer to the struct
+ * @param _waitMS how long to wait (miliSeconds) when all _maxConnections are checked out.
+ * @return a connected client, or NULL when the server can not be reached or the wait ended.
+ */
+TCP_C_t* TCP_PoolCheckout(TCP_Pool_t* _pool, uint _waitMS);
+
+/**
+ * @brief Return a client to the pool.
+ * @param _pool pointer to the struct
+ * @param _client a client returned by TCP_PoolCheckout
+ * @param _isBroken TRUE if the user saw an error on this client, so it would be destroyed instead of reused.
+ * @return TRUE if success or FALSE if failed. FALSE, and the client untouched, if it is not checked out of this pool:
+ * checked in already, or of another pool.
+ */
+bool TCP_PoolCheckin(TCP_Pool_t* _pool, TCP_C_t* _client, bool _isBroken);
+
+/**
+ * @brief Get the current count of the pool.
+ * @param _pool pointer to the struct
+ * @param _idleNum output. clients waiting in the pool. can be left NULL.
+ * @param _busyNum output. clients checked out. can be left NULL.
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_PoolStatus(TCP_Pool_t* _pool, uint* _idleNum, uint* _busyNum);
+
+#endif /* TCP_POOL_H_ */
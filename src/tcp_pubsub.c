@@ -0,0 +1,479 @@
+/*
+ * tcp_pubsub.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tcp_pubsub.h"
+#include "tcp_internal.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+
+#define GENERAL_ERROR -9
+
+/* power of 2 */
+#define TOPIC_BUCKETS 1024
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Topic
+{
+	char* m_name;
+	uint32_t m_hash;
+	uint* m_subscribers; /* sockets, in no order */
+	uint m_subscribersNum;
+	uint m_subscribersCapacity;
+	struct Topic* m_next; /* in the bucket */
+} Topic_t;
+
+/* the topics of one connection, so closing it does not search every topic */
+typedef struct SocketTopics
+{
+	Topic_t** m_topics;
+	uint m_topicsNum;
+	uint m_topicsCapacity;
+} SocketTopics_t;
+
+struct TCP_PubSub
+{
+	int m_magicNumber;
+
+	TCP_S_t* m_server;
+	uint m_maxQueued;
+	TCP_SLOW_POLICY m_policy;
+
+	Topic_t* m_buckets[TOPIC_BUCKETS];
+	SocketTopics_t* m_bySocket; /* by socket number */
+	uint m_bySocketSize;
+
+	unsigned long m_dropped;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_PubSub_t* _pubsub);
+static void ConnectionClosed(uint _socketNum, void* _contex);
+
+static uint32_t HashName(const char* _name);
+static Topic_t* FindTopic(TCP_PubSub_t* _pubsub, const char* _name, uint32_t _hash);
+static Topic_t* CreateTopic(TCP_PubSub_t* _pubsub, const char* _name, uint32_t _hash);
+static void DestroyTopic(TCP_PubSub_t* _pubsub, Topic_t* _topic);
+static bool AddSubscriber(Topic_t* _topic, uint _socketNum);
+static void RemoveSubscriber(Topic_t* _topic, uint _socketNum);
+
+static SocketTopics_t* GetSocketTopics(TCP_PubSub_t* _pubsub, uint _socketNum);
+static bool AddSocketTopic(SocketTopics_t* _ST, Topic_t* _topic);
+static bool RemoveSocketTopic(SocketTopics_t* _ST, Topic_t* _topic);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_PubSub_t* TCP_CreatePubSub(TCP_S_t* _TCP, uint _maxQueued, TCP_SLOW_POLICY _policy)
+{
+	TCP_PubSub_t* pubsub;
+
+	if (NULL == _TCP)
+	{
+		return NULL;
+	}
+
+	pubsub = calloc(1, sizeof(TCP_PubSub_t) );
+	if (! pubsub)
+	{
+		return NULL;
+	}
+
+	pubsub->m_server = _TCP;
+	pubsub->m_maxQueued = _maxQueued;
+	pubsub->m_policy = _policy;
+
+	if (! TCP_ServerSetClosedHook(_TCP, ConnectionClosed, pubsub) )
+	{
+		free(pubsub);
+		return NULL;
+	}
+
+	pubsub->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return pubsub;
+}
+
+void TCP_DestroyPubSub(TCP_PubSub_t* _pubsub)
+{
+	uint i;
+
+	if (! IsStructValid(_pubsub) )
+	{
+		return;
+	}
+
+	_pubsub->m_magicNumber = DEAD_MAGIC_NUMBER;
+	TCP_ServerSetClosedHook(_pubsub->m_server, NULL, NULL);
+
+	for (i = 0; i < TOPIC_BUCKETS; ++i)
+	{
+		while (_pubsub->m_buckets[i])
+		{
+			DestroyTopic(_pubsub, _pubsub->m_buckets[i]);
+		}
+	}
+	for (i = 0; i < _pubsub->m_bySocketSize; ++i)
+	{
+		free(_pubsub->m_bySocket[i].m_topics);
+	}
+	free(_pubsub->m_bySocket);
+	free(_pubsub);
+}
+
+bool TCP_Subscribe(TCP_PubSub_t* _pubsub, uint _socketNum, const char* _topic)
+{
+	SocketTopics_t* ST;
+	Topic_t* topic;
+	uint32_t hash;
+	uint i;
+
+	if (! IsStructValid(_pubsub) || NULL == _topic)
+	{
+		return FALSE;
+	}
+
+	ST = GetSocketTopics(_pubsub, _socketNum);
+	if (! ST)
+	{
+		return FALSE;
+	}
+
+	hash = HashName(_topic);
+	topic = FindTopic(_pubsub, _topic, hash);
+	if (topic)
+	{
+		/* a connection has far fewer topics than a topic has connections */
+		for (i = 0; i < ST->m_topicsNum; ++i)
+		{
+			if (ST->m_topics[i] == topic)
+			{
+				return TRUE;
+			}
+		}
+	}
+	else
+	{
+		topic = CreateTopic(_pubsub, _topic, hash);
+		if (! topic)
+		{
+			return FALSE;
+		}
+	}
+
+	if (! AddSubscriber(topic, _socketNum) )
+	{
+		if (0 == topic->m_subscribersNum)
+		{
+			DestroyTopic(_pubsub, topic);
+		}
+		return FALSE;
+	}
+	if (! AddSocketTopic(ST, topic) )
+	{
+		RemoveSubscriber(topic, _socketNum);
+		if (0 == topic->m_subscribersNum)
+		{
+			DestroyTopic(_pubsub, topic);
+		}
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+bool TCP_Unsubscribe(TCP_PubSub_t* _pubsub, uint _socketNum, const char* _topic)
+{
+	Topic_t* topic;
+
+	if (! IsStructValid(_pubsub) || NULL == _topic || _socketNum >= _pubsub->m_bySocketSize)
+	{
+		return FALSE;
+	}
+
+	topic = FindTopic(_pubsub, _topic, HashName(_topic) );
+	if (! topic || ! RemoveSocketTopic(&_pubsub->m_bySocket[_socketNum], topic) )
+	{
+		return FALSE;
+	}
+
+	RemoveSubscriber(topic, _socketNum);
+	if (0 == topic->m_subscribersNum)
+	{
+		DestroyTopic(_pubsub, topic);
+	}
+	return TRUE;
+}
+
+int TCP_Publish(TCP_PubSub_t* _pubsub, const char* _topic, const void* _msg, uint _msgLength)
+{
+	TCP_SharedBuf_t* buf;
+	Topic_t* topic;
+	int reached = 0;
+	int result;
+	uint i;
+
+	if (! IsStructValid(_pubsub) || NULL == _topic)
+	{
+		return GENERAL_ERROR;
+	}
+
+	topic = FindTopic(_pubsub, _topic, HashName(_topic) );
+	if (! topic)
+	{
+		return 0;
+	}
+
+	/* the one copy. every queue takes a hold on it */
+	buf = TCP_ServerCreateShared(_pubsub->m_server, _msg, _msgLength);
+	if (! buf)
+	{
+		return GENERAL_ERROR;
+	}
+
+	/* closing is deferred, so the subscribers do not change while sending */
+	for (i = 0; i < topic->m_subscribersNum; ++i)
+	{
+		result = TCP_ServerSendShared(_pubsub->m_server, topic->m_subscribers[i], buf, _pubsub->m_maxQueued);
+		if (result == TCP_SHARED_QUEUED)
+		{
+			++reached;
+		}
+		else if (result == TCP_SHARED_FULL)
+		{
+			++_pubsub->m_dropped;
+			if (_pubsub->m_policy == TCP_SLOW_DISCONNECT)
+			{
+				TCP_ServerCloseLater(_pubsub->m_server, topic->m_subscribers[i]);
+			}
+		}
+		else
+		{
+			/* broken connection */
+			TCP_ServerCloseLater(_pubsub->m_server, topic->m_subscribers[i]);
+		}
+	}
+
+	TCP_SharedRelease(buf);
+	return reached;
+}
+
+unsigned long TCP_PubSubDropped(TCP_PubSub_t* _pubsub)
+{
+	if (! IsStructValid(_pubsub) )
+	{
+		return 0;
+	}
+
+	return _pubsub->m_dropped;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_PubSub_t* _pubsub)
+{
+	return !(NULL == _pubsub || ALIVE_MAGIC_NUMBER != _pubsub->m_magicNumber);
+}
+
+static void ConnectionClosed(uint _socketNum, void* _contex)
+{
+	TCP_PubSub_t* pubsub = _contex;
+	SocketTopics_t* ST;
+	uint i;
+
+	if (! IsStructValid(pubsub) || _socketNum >= pubsub->m_bySocketSize)
+	{
+		return;
+	}
+
+	ST = &pubsub->m_bySocket[_socketNum];
+	for (i = 0; i < ST->m_topicsNum; ++i)
+	{
+		RemoveSubscriber(ST->m_topics[i], _socketNum);
+		if (0 == ST->m_topics[i]->m_subscribersNum)
+		{
+			DestroyTopic(pubsub, ST->m_topics[i]);
+		}
+	}
+
+	/* the socket number will be reused by another connection */
+	free(ST->m_topics);
+	ST->m_topics = NULL;
+	ST->m_topicsNum = 0;
+	ST->m_topicsCapacity = 0;
+}
+
+/* FNV-1a */
+static uint32_t HashName(const char* _name)
+{
+	uint32_t hash = FNV_OFFSET;
+
+	while (*_name)
+	{
+		hash ^= (unsigned char) *_name++;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static Topic_t* FindTopic(TCP_PubSub_t* _pubsub, const char* _name, uint32_t _hash)
+{
+	Topic_t* topic = _pubsub->m_buckets[_hash & (TOPIC_BUCKETS - 1)];
+
+	while (topic && (topic->m_hash != _hash || strcmp(topic->m_name, _name) != 0) )
+	{
+		topic = topic->m_next;
+	}
+	return topic;
+}
+
+static Topic_t* CreateTopic(TCP_PubSub_t* _pubsub, const char* _name, uint32_t _hash)
+{
+	Topic_t** bucket = &_pubsub->m_buckets[_hash & (TOPIC_BUCKETS - 1)];
+	Topic_t* topic;
+
+	topic = calloc(1, sizeof(Topic_t) );
+	if (! topic)
+	{
+		return NULL;
+	}
+	topic->m_name = malloc(strlen(_name) + 1);
+	if (! topic->m_name)
+	{
+		free(topic);
+		return NULL;
+	}
+	strcpy(topic->m_name, _name);
+	topic->m_hash = _hash;
+
+	topic->m_next = *bucket;
+	*bucket = topic;
+	return topic;
+}
+
+/* a topic is freed when its last subscriber leaves */
+static void DestroyTopic(TCP_PubSub_t* _pubsub, Topic_t* _topic)
+{
+	Topic_t** link = &_pubsub->m_buckets[_topic->m_hash & (TOPIC_BUCKETS - 1)];
+
+	while (*link != _topic)
+	{
+		link = &(*link)->m_next;
+	}
+	*link = _topic->m_next;
+
+	free(_topic->m_subscribers);
+	free(_topic->m_name);
+	free(_topic);
+}
+
+static bool AddSubscriber(Topic_t* _topic, uint _socketNum)
+{
+	uint* newSubscribers;
+	uint newCapacity;
+
+	if (_topic->m_subscribersNum == _topic->m_subscribersCapacity)
+	{
+		newCapacity = _topic->m_subscribersCapacity ? _topic->m_subscribersCapacity * 2 : 4;
+		newSubscribers = realloc(_topic->m_subscribers, newCapacity * sizeof(uint) );
+		if (! newSubscribers)
+		{
+			return FALSE;
+		}
+		_topic->m_subscribers = newSubscribers;
+		_topic->m_subscribersCapacity = newCapacity;
+	}
+
+	_topic->m_subscribers[_topic->m_subscribersNum++] = _socketNum;
+	return TRUE;
+}
+
+static void RemoveSubscriber(Topic_t* _topic, uint _socketNum)
+{
+	uint i;
+
+	for (i = 0; i < _topic->m_subscribersNum; ++i)
+	{
+		if (_topic->m_subscribers[i] == _socketNum)
+		{
+			/* order does not matter, the last one takes its place */
+			_topic->m_subscribers[i] = _topic->m_subscribers[--_topic->m_subscribersNum];
+			return;
+		}
+	}
+}
+
+static SocketTopics_t* GetSocketTopics(TCP_PubSub_t* _pubsub, uint _socketNum)
+{
+	SocketTopics_t* newTable;
+	uint newSize;
+
+	if (_socketNum >= _pubsub->m_bySocketSize)
+	{
+		newSize = _pubsub->m_bySocketSize ? _pubsub->m_bySocketSize : 64;
+		while (newSize <= _socketNum)
+		{
+			newSize *= 2;
+		}
+
+		newTable = realloc(_pubsub->m_bySocket, newSize * sizeof(SocketTopics_t) );
+		if (! newTable)
+		{
+			return NULL;
+		}
+		memset(newTable + _pubsub->m_bySocketSize, 0, (newSize - _pubsub->m_bySocketSize) * sizeof(SocketTopics_t) );
+		_pubsub->m_bySocket = newTable;
+		_pubsub->m_bySocketSize = newSize;
+	}
+
+	return &_pubsub->m_bySocket[_socketNum];
+}
+
+static bool AddSocketTopic(SocketTopics_t* _ST, Topic_t* _topic)
+{
+	Topic_t** newTopics;
+	uint newCapacity;
+
+	if (_ST->m_topicsNum == _ST->m_topicsCapacity)
+	{
+		newCapacity = _ST->m_topicsCapacity ? _ST->m_topicsCapacity * 2 : 4;
+		newTopics = realloc(_ST->m_topics, newCapacity * sizeof(Topic_t*) );
+		if (! newTopics)
+		{
+			return FALSE;
+		}
+		_ST->m_topics = newTopics;
+		_ST->m_topicsCapacity = newCapacity;
+	}
+
+	_ST->m_topics[_ST->m_topicsNum++] = _topic;
+	return TRUE;
+}
+
+static bool RemoveSocketTopic(SocketTopics_t* _ST, Topic_t* _topic)
+{
+	uint i;
+
+	for (i = 0; i < _ST->m_topicsNum; ++i)
+	{
+		if (_ST->m_topics[i] == _topic)
+		{
+			_ST->m_topics[i] = _ST->m_topics[--_ST->m_topicsNum];
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
@@ -0,0 +1,86 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Topic based publish/subscribe on top of the server.
+ * A published message is copied once into a reference counted buffer, and that one buffer is queued to every subscriber.
+ * A subscriber that does not keep up has its queue grow up to a limit, then it is either skipped or disconnected.
+ * Closed connections are unsubscribed from everything on their own.
+ *
+ * The publish path does not compress, the same bytes go to every subscriber.
+ *
+ * @bug
+ */
+
+#ifndef TCP_PUBSUB_H_
+#define TCP_PUBSUB_H_
+
+#include "tcp.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define TCP_PUBSUB_DEFAULT_MAX_QUEUED 1024
+
+/* what to do with a subscriber whose queue is full */
+typedef enum TCP_SLOW_POLICY {
+	TCP_SLOW_DROP, /* it misses the message */
+	TCP_SLOW_DISCONNECT /* it is closed at the start of the next server loop */
+} TCP_SLOW_POLICY;
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_PubSub TCP_PubSub_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create a topic index for a server. one per server.
+ * @param _TCP pointer to the server. in framed mode a message goes out as a frame with request ID 0.
+ * @param _maxQueued messages queued to one subscriber before it is slow. 0 for no limit.
+ * @param _policy what happens to a slow subscriber
+ * @return pointer to the newly create struct. NULL if failed, or if the server has a topic index already.
+ */
+TCP_PubSub_t* TCP_CreatePubSub(TCP_S_t* _TCP, uint _maxQueued, TCP_SLOW_POLICY _policy);
+
+/**
+ * @brief Destroy the topic index. must be called before the server is destroyed.
+ * @param _pubsub pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_DestroyPubSub(TCP_PubSub_t* _pubsub);
+
+/**
+ * @brief subscribe a connection to a topic. subscribing twice is the same as once.
+ * @param _pubsub pointer to the struct
+ * @param _socketNum the connection
+ * @param _topic the topic name
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_Subscribe(TCP_PubSub_t* _pubsub, uint _socketNum, const char* _topic);
+
+/**
+ * @brief unsubscribe a connection from a topic.
+ * @param _pubsub pointer to the struct
+ * @param _socketNum the connection
+ * @param _topic the topic name
+ * @return TRUE if it was subscribed.
+ */
+bool TCP_Unsubscribe(TCP_PubSub_t* _pubsub, uint _socketNum, const char* _topic);
+
+/**
+ * @brief send a message to every subscriber of a topic, without waiting for any of them.
+ * @param _pubsub pointer to the struct
+ * @param _topic the topic name
+ * @param _msg the message
+ * @param _msgLength the message size. up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * @return the number of subscribers it was sent or queued to. negative number represent error.
+ */
+int TCP_Publish(TCP_PubSub_t* _pubsub, const char* _topic, const void* _msg, uint _msgLength);
+
+/**
+ * @brief get how many messages slow subscribers did not get, since created.
+ * @param _pubsub pointer to the struct
+ * @return the count
+ */
+unsigned long TCP_PubSubDropped(TCP_PubSub_t* _pubsub);
+
+#endif /* TCP_PUBSUB_H_ */
@@ -0,0 +1,298 @@
+/*
+ * tcp_relay.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#define _GNU_SOURCE /* splice, pipe2, F_SETPIPE_SZ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> /* TCP_NODELAY */
+
+#include "tcp_relay.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER 0xfadeface
+#define DEAD_MAGIC_NUMBER 0xdeadface
+
+#define GENERAL_ERROR -9
+
+#define TO_UPSTREAM 0
+#define TO_CLIENT 1
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Direction
+{
+	int m_from;
+	int m_to;
+	int m_pipe[2]; /* read end, write end */
+	unsigned int m_pending; /* bytes in the pipe */
+	bool m_isEnded; /* m_from sent its EOF */
+	bool m_isShut; /* and it was passed on to m_to */
+} Direction_t;
+
+struct TCP_Relay
+{
+	unsigned int m_magicNumber;
+	int m_upstreamFD;
+	bool m_isConnecting;
+	Direction_t m_directions[2];
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool OpenPipe(Direction_t* _direction, int _from, int _to);
+static void ClosePipe(Direction_t* _direction);
+static int MoveDirection(Direction_t* _direction, fd_set* _readfds, fd_set* _writefds);
+static int Connected(TCP_Relay_t* _relay);
+static bool IsStructValid(TCP_Relay_t* _relay);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Relay_t* TCP_RelayCreate(int _clientFD, const struct sockaddr* _upstream, socklen_t _upstreamLength)
+{
+	TCP_Relay_t* aRelay;
+	int isNoDelay = 1;
+
+	if (_clientFD < 0 || NULL == _upstream)
+	{
+		return NULL;
+	}
+
+	aRelay = calloc(1, sizeof(TCP_Relay_t) );
+	if (! aRelay)
+	{
+		return NULL;
+	}
+
+	aRelay->m_upstreamFD = socket(_upstream->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (aRelay->m_upstreamFD < 0 || aRelay->m_upstreamFD >= FD_SETSIZE)
+	{
+		perror("Relay upstream socket Failed");
+		if (aRelay->m_upstreamFD >= 0)
+		{
+			close(aRelay->m_upstreamFD);
+		}
+		free(aRelay);
+		return NULL;
+	}
+	if (_upstream->sa_family != AF_UNIX)
+	{
+		/* the client decided when to send, the relay should not hold its bytes back */
+		setsockopt(aRelay->m_upstreamFD, IPPROTO_TCP, TCP_NODELAY, &isNoDelay, sizeof(isNoDelay) );
+	}
+
+	if (connect(aRelay->m_upstreamFD, _upstream, _upstreamLength) < 0 && errno != EINPROGRESS)
+	{
+		perror("Relay upstream connect Failed");
+		close(aRelay->m_upstreamFD);
+		free(aRelay);
+		return NULL;
+	}
+	aRelay->m_isConnecting = TRUE;
+
+	if (! OpenPipe(&aRelay->m_directions[TO_UPSTREAM], _clientFD, aRelay->m_upstreamFD)
+		|| ! OpenPipe(&aRelay->m_directions[TO_CLIENT], aRelay->m_upstreamFD, _clientFD) )
+	{
+		ClosePipe(&aRelay->m_directions[TO_UPSTREAM]);
+		close(aRelay->m_upstreamFD);
+		free(aRelay);
+		return NULL;
+	}
+
+	aRelay->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return aRelay;
+}
+
+void TCP_RelayDestroy(TCP_Relay_t* _relay)
+{
+	if (! IsStructValid(_relay) )
+	{
+		return;
+	}
+
+	_relay->m_magicNumber = DEAD_MAGIC_NUMBER;
+	ClosePipe(&_relay->m_directions[TO_UPSTREAM]);
+	ClosePipe(&_relay->m_directions[TO_CLIENT]);
+	close(_relay->m_upstreamFD);
+	free(_relay);
+}
+
+void TCP_RelayWatch(TCP_Relay_t* _relay, fd_set* _readfds, fd_set* _writefds, int* _maxFD)
+{
+	Direction_t* direction;
+	uint i;
+
+	if (! IsStructValid(_relay) || NULL == _readfds || NULL == _writefds || NULL == _maxFD)
+	{
+		return;
+	}
+
+	if (_relay->m_upstreamFD > *_maxFD)
+	{
+		*_maxFD = _relay->m_upstreamFD;
+	}
+	if (_relay->m_isConnecting)
+	{
+		/* writable when connected, or failed */
+		FD_SET(_relay->m_upstreamFD, _writefds);
+		return;
+	}
+
+	for (i = 0; i < 2; ++i)
+	{
+		direction = &_relay->m_directions[i];
+		if (direction->m_pending > 0)
+		{
+			FD_SET(direction->m_to, _writefds);
+		}
+		else if (! direction->m_isEnded)
+		{
+			/* one pipe full at a time per direction. the side is not read while the other does not take it */
+			FD_SET(direction->m_from, _readfds);
+		}
+		if (direction->m_from > *_maxFD)
+		{
+			*_maxFD = direction->m_from;
+		}
+	}
+}
+
+int TCP_RelayMove(TCP_Relay_t* _relay, fd_set* _readfds, fd_set* _writefds)
+{
+	int moved = 0;
+	int result;
+	uint i;
+
+	if (! IsStructValid(_relay) || NULL == _readfds || NULL == _writefds)
+	{
+		return GENERAL_ERROR;
+	}
+
+	if (_relay->m_isConnecting)
+	{
+		return FD_ISSET(_relay->m_upstreamFD, _writefds) ? Connected(_relay) : TCP_RELAY_IDLE;
+	}
+
+	for (i = 0; i < 2; ++i)
+	{
+		result = MoveDirection(&_relay->m_directions[i], _readfds, _writefds);
+		if (result < 0)
+		{
+			return result;
+		}
+		moved += result;
+	}
+
+	if (_relay->m_directions[TO_UPSTREAM].m_isShut && _relay->m_directions[TO_CLIENT].m_isShut)
+	{
+		return 0;
+	}
+	return moved > 0 ? moved : TCP_RELAY_IDLE;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool OpenPipe(Direction_t* _direction, int _from, int _to)
+{
+	_direction->m_from = _from;
+	_direction->m_to = _to;
+	if (pipe2(_direction->m_pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+	{
+		perror("Relay pipe Failed");
+		_direction->m_pipe[0] = -1;
+		_direction->m_pipe[1] = -1;
+		return FALSE;
+	}
+	/* the default 64K is one splice per 64K. not being able to grow it is no reason to fail */
+	fcntl(_direction->m_pipe[1], F_SETPIPE_SZ, TCP_RELAY_PIPE_SIZE);
+	return TRUE;
+}
+
+static void ClosePipe(Direction_t* _direction)
+{
+	if (_direction->m_pipe[0] >= 0)
+	{
+		close(_direction->m_pipe[0]);
+		close(_direction->m_pipe[1]);
+		_direction->m_pipe[0] = -1;
+		_direction->m_pipe[1] = -1;
+	}
+}
+
+/* one read and one write at most, so a busy pair does not starve the others. returns the bytes delivered or GENERAL_ERROR */
+static int MoveDirection(Direction_t* _direction, fd_set* _readfds, fd_set* _writefds)
+{
+	ssize_t result;
+	int moved = 0;
+	bool isReadNow = FALSE;
+
+	if (0 == _direction->m_pending && ! _direction->m_isEnded && FD_ISSET(_direction->m_from, _readfds) )
+	{
+		result = splice(_direction->m_from, NULL, _direction->m_pipe[1], NULL, TCP_RELAY_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (0 == result)
+		{
+			_direction->m_isEnded = TRUE;
+		}
+		else if (result > 0)
+		{
+			_direction->m_pending = result;
+			isReadNow = TRUE;
+		}
+		else if (errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			return GENERAL_ERROR;
+		}
+	}
+
+	/* what was just read is tried at once, the other side is writable most of the time */
+	if (_direction->m_pending > 0 && (isReadNow || FD_ISSET(_direction->m_to, _writefds) ) )
+	{
+		result = splice(_direction->m_pipe[0], NULL, _direction->m_to, NULL, _direction->m_pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (result > 0)
+		{
+			_direction->m_pending -= result;
+			moved = result;
+		}
+		else if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			return GENERAL_ERROR;
+		}
+	}
+
+	if (_direction->m_isEnded && 0 == _direction->m_pending && ! _direction->m_isShut)
+	{
+		/* half close. the other direction goes on */
+		shutdown(_direction->m_to, SHUT_WR);
+		_direction->m_isShut = TRUE;
+	}
+	return moved;
+}
+
+/* the connect to the upstream finished */
+static int Connected(TCP_Relay_t* _relay)
+{
+	int error = 0;
+	socklen_t length = sizeof(error);
+
+	if (getsockopt(_relay->m_upstreamFD, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0)
+	{
+		errno = error;
+		perror("Relay upstream connect Failed");
+		return GENERAL_ERROR;
+	}
+	_relay->m_isConnecting = FALSE;
+	return TCP_RELAY_IDLE;
+}
+
+static bool IsStructValid(TCP_Relay_t* _relay)
+{
+	return (_relay && _relay->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
@@ -0,0 +1,74 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief The proxy mode of the server (TCP_ServerSetProxy): an accepted connection paired with a connection to an
+ * upstream server, and the bytes moved between the two with splice, through a pipe for each direction, so they never
+ * reach user space. Driven by the server loop, never blocking.
+ * A side that ends its sending (EOF) is passed on as a shutdown of the writing of the other side, once what it sent
+ * before was delivered, so half closed connections keep working. The pair is done when both directions ended.
+ *
+ * @bug every pair takes 5 descriptors besides its client, 4 of them pipes, so with select the server reaches
+ * FD_SETSIZE at about a fifth of the connections. an upstream connection over it is refused.
+ */
+
+#ifndef TCP_RELAY_H_
+#define TCP_RELAY_H_
+
+#include <sys/select.h>
+#include <sys/socket.h>
+
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* asked of each pipe. the system may cap it (fs.pipe-max-size) */
+#define TCP_RELAY_PIPE_SIZE (1 << 18)
+
+/* TCP_RelayMove result, besides the bytes moved */
+#define TCP_RELAY_IDLE -1 /* nothing was ready */
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_Relay TCP_Relay_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief start connecting to the upstream for a client. the connect completes in TCP_RelayMove.
+ * @param _clientFD the accepted connection. non-blocking. stays the caller's.
+ * @param _upstream the upstream address
+ * @param _upstreamLength its size
+ * @return pointer to the newly create struct. NULL if failed.
+ */
+TCP_Relay_t* TCP_RelayCreate(int _clientFD, const struct sockaddr* _upstream, socklen_t _upstreamLength);
+
+/**
+ * @brief close the upstream connection and the pipes. bytes still in the pipes are lost.
+ * @param _relay pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_RelayDestroy(TCP_Relay_t* _relay);
+
+/**
+ * @brief add to the select sets what the pair waits for: to read a side whose pipe is empty, to write a side whose pipe is not.
+ * @param _relay pointer to the struct
+ * @param _readfds the read set
+ * @param _writefds the write set
+ * @param _maxFD in and out, the highest descriptor in the sets
+ * @return void
+ */
+void TCP_RelayWatch(TCP_Relay_t* _relay, fd_set* _readfds, fd_set* _writefds, int* _maxFD);
+
+/**
+ * @brief move what the select found ready, in both directions.
+ * @param _relay pointer to the struct
+ * @param _readfds as select returned it
+ * @param _writefds as select returned it
+ * @return the bytes delivered, 0 when both directions ended, TCP_RELAY_IDLE, or other negative number when a side
+ * failed (the upstream refused, a reset). on 0 or failure the client should be closed.
+ */
+int TCP_RelayMove(TCP_Relay_t* _relay, fd_set* _readfds, fd_set* _writefds);
+
+#endif /* TCP_RELAY_H_ */
@@ -0,0 +1,150 @@
+/*
+ * tcp_rpc.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <arpa/inet.h> /* htonl */
+
+#include "tcp_rpc.h"
+#include "tcp_internal.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+
+#define GENERAL_ERROR -9
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Method
+{
+	rpcMethodFunc m_func;
+	void* m_contex;
+} Method_t;
+
+struct TCP_Rpc
+{
+	int m_magicNumber;
+
+	Method_t* m_methods; /* by method number. 0 is never called */
+	uint m_methodsNum;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_Rpc_t* _rpc);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Rpc_t* TCP_CreateRpc(uint _methodsNum)
+{
+	TCP_Rpc_t* rpc;
+
+	if (0 == _methodsNum || _methodsNum > TCP_RPC_MAX_METHODS)
+	{
+		return NULL;
+	}
+
+	rpc = calloc(1, sizeof(TCP_Rpc_t) );
+	if (! rpc)
+	{
+		return NULL;
+	}
+
+	rpc->m_methods = calloc(_methodsNum + 1, sizeof(Method_t) );
+	if (! rpc->m_methods)
+	{
+		free(rpc);
+		return NULL;
+	}
+	rpc->m_methodsNum = _methodsNum;
+
+	rpc->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return rpc;
+}
+
+void TCP_DestroyRpc(TCP_Rpc_t* _rpc)
+{
+	if (! IsStructValid(_rpc) )
+	{
+		return;
+	}
+
+	_rpc->m_magicNumber = DEAD_MAGIC_NUMBER;
+	free(_rpc->m_methods);
+	free(_rpc);
+}
+
+bool TCP_RpcRegister(TCP_Rpc_t* _rpc, uint _method, rpcMethodFunc _func, void* _contex)
+{
+	if (! IsStructValid(_rpc) || 0 == _method || _method > _rpc->m_methodsNum)
+	{
+		return FALSE;
+	}
+
+	_rpc->m_methods[_method].m_func = _func;
+	_rpc->m_methods[_method].m_contex = _contex;
+	return TRUE;
+}
+
+TCP_RPC_STATUS TCP_RpcDispatch(TCP_Rpc_t* _rpc, TCP_S_t* _TCP, void* _data, size_t _sizeData, uint _socketNum)
+{
+	uint method = TCP_GetMethod(_TCP);
+	uint requestID = TCP_GetRequestID(_TCP);
+	TCP_RPC_STATUS status;
+
+	if (! IsStructValid(_rpc) )
+	{
+		return TCP_RPC_FAILED;
+	}
+
+	/* method 0, a plain frame, is out of the table as well */
+	if (0 == method || method > _rpc->m_methodsNum || ! _rpc->m_methods[method].m_func)
+	{
+		status = TCP_RPC_NO_METHOD;
+	}
+	else
+	{
+		status = _rpc->m_methods[method].m_func(_socketNum, requestID, _data, _sizeData, _rpc->m_methods[method].m_contex);
+	}
+
+	if (status != TCP_RPC_OK)
+	{
+		TCP_RpcReplyError(_socketNum, requestID, status);
+	}
+	return status;
+}
+
+int TCP_RpcReply(uint _socketNum, uint _requestID, void* _result, uint _resultLength)
+{
+	if (NULL == _result && 0 == _resultLength)
+	{
+		return TCP_SendFrame(_socketNum, _requestID, NULL, 0);
+	}
+
+	return TCP_SendFrameBuffer(_socketNum, _requestID, _result, _resultLength);
+}
+
+int TCP_RpcReplyError(uint _socketNum, uint _requestID, TCP_RPC_STATUS _status)
+{
+	uint32_t status = htonl(_status);
+
+	if (TCP_RPC_OK == _status)
+	{
+		return GENERAL_ERROR;
+	}
+
+	return TCP_ServerSendFrameFlags(_socketNum, _requestID, TCP_FRAME_FLAG_ERROR, &status, sizeof(status) );
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_Rpc_t* _rpc)
+{
+	return (_rpc && _rpc->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
@@ -0,0 +1,94 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Remote procedure calls on top of a framed server.
+ * A call is one frame (tcp_frame.h): the method number in its header, the request ID chosen by the caller, and the
+ * arguments as the payload. The methods are registered once, in a table the number of the method indexes directly.
+ * A method answers with TCP_RpcReply, at once or later from any other user function or timer, so answers on one
+ * connection come in any order and a client may have thousands of calls in flight (see tcp_rpc_client.h).
+ * A failed call is answered with a frame flagged TCP_FRAME_FLAG_ERROR, its TCP_RPC_STATUS the payload.
+ *
+ * The table is only read once the server runs, so one table can serve all the loops of a group (tcp_group.h).
+ *
+ * @bug calls over shared memory (TCP_ServerSetSharedMemory) have no method, the ring does not carry it.
+ */
+
+#ifndef TCP_RPC_H_
+#define TCP_RPC_H_
+
+#include "tcp.h"
+#include "tcp_frame.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the method field of the frame header is 16 bits, and 0 is a plain frame */
+#define TCP_RPC_MAX_METHODS 65535
+
+/**
+ * @brief a method. _args is a pooled buffer, as the _data of userActionFunc.
+ * @return TCP_RPC_OK when it answered, or will. any other status is answered as the error of the call.
+ */
+typedef TCP_RPC_STATUS (*rpcMethodFunc)(uint _socketNum, uint _requestID, void* _args, size_t _argsSize, void* _contex);
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_Rpc TCP_Rpc_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create an empty method table.
+ * @param _methodsNum the methods are numbered from 1 to _methodsNum. up to TCP_RPC_MAX_METHODS.
+ * @return pointer to the newly create struct. NULL if failed.
+ */
+TCP_Rpc_t* TCP_CreateRpc(uint _methodsNum);
+
+/**
+ * @brief Destroy the table. after the servers using it stopped.
+ * @param _rpc pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_DestroyRpc(TCP_Rpc_t* _rpc);
+
+/**
+ * @brief register the function of a method, before the server runs. registering again replaces it.
+ * @param _rpc pointer to the struct
+ * @param _method 1 to _methodsNum
+ * @param _func the method. NULL to remove it.
+ * @param _contex passed to _func as is.
+ * @return TRUE if success or FALSE if failed.
+ */
+bool TCP_RpcRegister(TCP_Rpc_t* _rpc, uint _method, rpcMethodFunc _func, void* _contex);
+
+/**
+ * @brief call the method of the frame being handled. for the _reciveDataFunc of a framed server, which passes its own parameters.
+ * an unknown method is answered with TCP_RPC_NO_METHOD.
+ * @param _rpc pointer to the struct
+ * @param _TCP the server the frame came to, for its method and request ID
+ * @param _data as given to the _reciveDataFunc
+ * @param _sizeData as given to the _reciveDataFunc
+ * @param _socketNum as given to the _reciveDataFunc
+ * @return the status of the call. TCP_RPC_OK when the method took it.
+ */
+TCP_RPC_STATUS TCP_RpcDispatch(TCP_Rpc_t* _rpc, TCP_S_t* _TCP, void* _data, size_t _sizeData, uint _socketNum);
+
+/**
+ * @brief answer a call. once per call.
+ * @param _socketNum the connection the call came from
+ * @param _requestID of the call
+ * @param _result the answer. a pooled buffer (the _args of the method too) is sent without a copy.
+ * @param _resultLength the answer size. up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * @return positive number represent the number of bytes sent or queued, header included. negative number represent error.
+ */
+int TCP_RpcReply(uint _socketNum, uint _requestID, void* _result, uint _resultLength);
+
+/**
+ * @brief answer a call with an error, for a method that answers later.
+ * @param _socketNum the connection the call came from
+ * @param _requestID of the call
+ * @param _status why it failed. not TCP_RPC_OK.
+ * @return positive number represent the number of bytes sent or queued, header included. negative number represent error.
+ */
+int TCP_RpcReplyError(uint _socketNum, uint _requestID, TCP_RPC_STATUS _status);
+
+#endif /* TCP_RPC_H_ */
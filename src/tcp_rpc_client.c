@@ -0,0 +1,200 @@
+/*
+ * tcp_rpc_client.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <arpa/inet.h> /* ntohl */
+
+#include "tcp_rpc_client.h"
+#include "tcp_pipeline.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+
+#define GENERAL_ERROR -9
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Call
+{
+	rpcDoneFunc m_doneFunc;
+	void* m_userData;
+} Call_t;
+
+struct TCP_RpcClient
+{
+	int m_magicNumber;
+
+	TCP_Pipe_t* m_pipe;
+	/* the calls in flight, as the slots of the pipeline: request ID n at (n & m_callsMask) */
+	Call_t* m_calls;
+	uint m_callsMask;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_RpcClient_t* _rpc);
+static void Answered(uint _requestID, void* _data, size_t _sizeData, void* _rpc);
+static TCP_RPC_STATUS StatusOf(uint _flags, const void* _data, size_t _sizeData);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_RpcClient_t* TCP_CreateRpcClient(TCP_C_t* _client, uint _maxInFlight)
+{
+	TCP_RpcClient_t* rpc;
+	uint callsNum = 1;
+
+	if (0 == _maxInFlight)
+	{
+		return NULL;
+	}
+	/* the same rounding as the pipeline, so two calls in flight never share an entry */
+	while (callsNum < _maxInFlight)
+	{
+		callsNum *= 2;
+	}
+
+	rpc = calloc(1, sizeof(TCP_RpcClient_t) );
+	if (! rpc)
+	{
+		return NULL;
+	}
+	rpc->m_calls = calloc(callsNum, sizeof(Call_t) );
+	rpc->m_pipe = rpc->m_calls ? TCP_CreatePipeline(_client, callsNum) : NULL;
+	if (! rpc->m_pipe)
+	{
+		free(rpc->m_calls);
+		free(rpc);
+		return NULL;
+	}
+	rpc->m_callsMask = callsNum - 1;
+
+	rpc->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return rpc;
+}
+
+void TCP_DestroyRpcClient(TCP_RpcClient_t* _rpc)
+{
+	if (! IsStructValid(_rpc) )
+	{
+		return;
+	}
+
+	_rpc->m_magicNumber = DEAD_MAGIC_NUMBER;
+	TCP_DestroyPipeline(_rpc->m_pipe);
+	free(_rpc->m_calls);
+	free(_rpc);
+}
+
+int TCP_RpcCall(TCP_RpcClient_t* _rpc, uint _method, const void* _args, uint _argsLength, rpcDoneFunc _doneFunc, void* _userData)
+{
+	int requestID;
+
+	if (! IsStructValid(_rpc) || NULL == _doneFunc)
+	{
+		return GENERAL_ERROR;
+	}
+
+	requestID = TCP_PipelineSendMethod(_rpc->m_pipe, _method, _args, _argsLength, Answered, _rpc);
+	if (requestID > 0)
+	{
+		/* no answer is read before it is sent, the entry is filled in time */
+		_rpc->m_calls[requestID & _rpc->m_callsMask].m_doneFunc = _doneFunc;
+		_rpc->m_calls[requestID & _rpc->m_callsMask].m_userData = _userData;
+	}
+	return requestID;
+}
+
+int TCP_RpcCallWait(TCP_RpcClient_t* _rpc, uint _method, const void* _args, uint _argsLength, void* _result, uint _resultMaxLength,
+					int _timeoutMS, TCP_RPC_STATUS* _status)
+{
+	int requestID;
+	int length;
+
+	if (! IsStructValid(_rpc) || NULL == _status)
+	{
+		return GENERAL_ERROR;
+	}
+
+	*_status = TCP_RPC_BROKEN;
+	requestID = TCP_PipelineSendMethod(_rpc->m_pipe, _method, _args, _argsLength, NULL, NULL);
+	if (requestID <= 0)
+	{
+		return GENERAL_ERROR;
+	}
+	length = TCP_PipelineWait(_rpc->m_pipe, requestID, _result, _resultMaxLength, _timeoutMS);
+	if (length < 0)
+	{
+		return GENERAL_ERROR;
+	}
+
+	*_status = StatusOf(TCP_PipelineLastFlags(_rpc->m_pipe), _result, length);
+	return (TCP_RPC_OK == *_status) ? length : GENERAL_ERROR;
+}
+
+int TCP_RpcPoll(TCP_RpcClient_t* _rpc, int _timeoutMS)
+{
+	if (! IsStructValid(_rpc) )
+	{
+		return GENERAL_ERROR;
+	}
+	return TCP_PipelinePoll(_rpc->m_pipe, _timeoutMS);
+}
+
+int TCP_RpcInFlight(TCP_RpcClient_t* _rpc)
+{
+	if (! IsStructValid(_rpc) )
+	{
+		return GENERAL_ERROR;
+	}
+	return TCP_PipelineInFlight(_rpc->m_pipe);
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_RpcClient_t* _rpc)
+{
+	return (_rpc && _rpc->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
+
+/* the done function of every call with one */
+static void Answered(uint _requestID, void* _data, size_t _sizeData, void* _rpc)
+{
+	TCP_RpcClient_t* rpc = _rpc;
+	Call_t* call = &rpc->m_calls[_requestID & rpc->m_callsMask];
+	TCP_RPC_STATUS status = StatusOf(TCP_PipelineLastFlags(rpc->m_pipe), _data, _sizeData);
+
+	if (TCP_RPC_OK == status)
+	{
+		call->m_doneFunc(_requestID, status, _data, _sizeData, call->m_userData);
+	}
+	else
+	{
+		call->m_doneFunc(_requestID, status, NULL, 0, call->m_userData);
+	}
+}
+
+static TCP_RPC_STATUS StatusOf(uint _flags, const void* _data, size_t _sizeData)
+{
+	uint32_t status;
+
+	if (! (_flags & TCP_FRAME_FLAG_ERROR) )
+	{
+		return TCP_RPC_OK;
+	}
+	if (_sizeData < sizeof(status) )
+	{
+		return TCP_RPC_FAILED;
+	}
+	memcpy(&status, _data, sizeof(status) );
+	status = ntohl(status);
+	/* an error with an OK status is still an error */
+	return (TCP_RPC_OK == status) ? TCP_RPC_FAILED : (TCP_RPC_STATUS) status;
+}
@@ -0,0 +1,91 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief The client side of tcp_rpc.h: calls of server methods over one TCP client connection.
+ * Calls are pipelined (tcp_pipeline.h), many can be in flight, and their answers are matched to them in whatever
+ * order the server sends them. A call either has a done function, or is waited for.
+ *
+ * @bug
+ */
+
+#ifndef TCP_RPC_CLIENT_H_
+#define TCP_RPC_CLIENT_H_
+
+#include <sys/types.h> /* size_t */
+
+#include "tcp_client.h"
+#include "tcp_frame.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief invoked when the answer of a call arrives. _result is valid only until the function returns, and is empty when
+ * _status is not TCP_RPC_OK.
+ */
+typedef void (*rpcDoneFunc)(uint _requestID, TCP_RPC_STATUS _status, void* _result, size_t _resultSize, void* _userData);
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+typedef struct TCP_RpcClient TCP_RpcClient_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Take over a connected client for calls. as TCP_CreatePipeline, the client must not be used directly until destroyed.
+ * @param _client a connected client
+ * @param _maxInFlight max number of calls waiting for an answer. rounded up to a power of 2.
+ * @return pointer to the newly create struct. NULL if failed.
+ */
+TCP_RpcClient_t* TCP_CreateRpcClient(TCP_C_t* _client, uint _maxInFlight);
+
+/**
+ * @brief Free the struct. calls still in flight are dropped without their functions invoked. the client is not destroyed.
+ * @param _rpc pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_DestroyRpcClient(TCP_RpcClient_t* _rpc);
+
+/**
+ * @brief call a method without waiting for its answer.
+ * When _maxInFlight calls are already in flight, answers are read (and their functions invoked) until there is room.
+ * @param _rpc pointer to the struct
+ * @param _method the number the server registered the method with. 1 to 65535.
+ * @param _args the arguments.
+ * @param _argsLength the arguments size. up to TCP_FRAME_MAX_PAYLOAD bytes.
+ * @param _doneFunc invoked with the answer. can not be NULL, see TCP_RpcCallWait.
+ * @param _userData user pointer passed to _doneFunc.
+ * @return the request ID of the call (positive number), or negative number on error.
+ */
+int TCP_RpcCall(TCP_RpcClient_t* _rpc, uint _method, const void* _args, uint _argsLength, rpcDoneFunc _doneFunc, void* _userData);
+
+/**
+ * @brief call a method and wait for its answer. the answers of other calls that arrive meanwhile get their functions.
+ * @param _rpc pointer to the struct
+ * @param _method the number the server registered the method with.
+ * @param _args the arguments.
+ * @param _argsLength the arguments size.
+ * @param _result the answer is copied here
+ * @param _resultMaxLength the buffer size. a longer answer is truncated.
+ * @param _timeoutMS max wait time. -1 to wait until it arrives.
+ * @param _status out. TCP_RPC_BROKEN when no answer came.
+ * @return the answer size, or negative number when _status is not TCP_RPC_OK.
+ */
+int TCP_RpcCallWait(TCP_RpcClient_t* _rpc, uint _method, const void* _args, uint _argsLength, void* _result, uint _resultMaxLength,
+					int _timeoutMS, TCP_RPC_STATUS* _status);
+
+/**
+ * @brief Read the answers that arrived and invoke their functions.
+ * @param _rpc pointer to the struct
+ * @param _timeoutMS max wait for the first answer. 0 to not wait, -1 to wait until one arrives.
+ * @return number of answers handled, or negative number on error (the connection should be dropped).
+ */
+int TCP_RpcPoll(TCP_RpcClient_t* _rpc, int _timeoutMS);
+
+/**
+ * @brief get the number of calls waiting for an answer.
+ * @param _rpc pointer to the struct
+ * @return number of calls in flight, or negative number on error.
+ */
+int TCP_RpcInFlight(TCP_RpcClient_t* _rpc);
+
+#endif /* TCP_RPC_CLIENT_H_ */
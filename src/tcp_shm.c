@@ -0,0 +1,675 @@
+/*
+ * tcp_shm.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#define _GNU_SOURCE /* struct ucred */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "tcp_shm.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER	0xfadeface
+#define DEAD_MAGIC_NUMBER	0xdeadface
+
+#define GENERAL_ERROR -9
+
+/* only segments made by TCP_ShmCreate are attached */
+#define SHM_NAME_PREFIX "/tcp_shm_"
+/* as TCP_ShmCreate makes them. a segment others may open could have a second writer */
+#define SHM_MODE (S_IRUSR | S_IWUSR)
+
+/* the loopback sockets of the host, to find the owner of a TCP peer */
+#define PROC_NET_TCP "/proc/net/tcp"
+#define PROC_NET_TCP6 "/proc/net/tcp6"
+#define PROC_LINE_SIZE 256
+#define PROC_ADDRESS_SIZE 33 /* 32 hex digits of an IPv6 address */
+
+#define CACHE_LINE_SIZE 64
+
+/* empty ring checks before the reader sleeps, tens of microseconds. no spinning on a single CPU, the writer needs it */
+#define SPIN_COUNT 4000
+/* a sleeping reader checks the connection this often, in case the peer died without waking it */
+#define SLEEP_SLICE_MS 100
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX() do {} while (0)
+#endif
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* ring control. each index on its own cache line, as each is written by another process */
+typedef struct ShmRing
+{
+	uint32_t m_head; /* bytes ever written. producer only */
+	char m_pad1[CACHE_LINE_SIZE - sizeof(uint32_t)];
+	uint32_t m_tail; /* bytes ever read. consumer only */
+	uint32_t m_isReaderWaiting; /* futex word. set by the consumer, cleared by the producer that wakes it */
+	char m_pad2[CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+} ShmRing_t;
+
+/* the segment. the data of the two rings follows */
+typedef struct ShmSegment
+{
+	char m_magic[TCP_SHM_MAGIC_LENGTH];
+	uint32_t m_ringSize;
+	uint32_t m_isClosed; /* set by the first side to leave */
+	uint32_t m_isAttached; /* claimed by the server that attached. a second one is refused */
+	char m_pad[CACHE_LINE_SIZE - TCP_SHM_MAGIC_LENGTH - 3 * sizeof(uint32_t)];
+	ShmRing_t m_toServer;
+	ShmRing_t m_toClient;
+} ShmSegment_t;
+
+struct TCP_Shm
+{
+	int m_magicNumber;
+
+	int m_socketFD;
+	bool m_isServer;
+	char m_name[TCP_SHM_NAME_LENGTH];
+
+	ShmSegment_t* m_segment;
+	size_t m_segmentSize;
+	uint32_t m_mask;
+
+	/* this side view */
+	ShmRing_t* m_out;
+	unsigned char* m_outData;
+	ShmRing_t* m_in;
+	unsigned char* m_inData;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_Shm_t* _shm);
+static TCP_Shm_t* MapSegment(int _socketFD, int _shmFD, const char* _name, size_t _segmentSize, bool _isServer);
+static void WakeReader(TCP_Shm_t* _shm);
+static bool WaitForMessage(TCP_Shm_t* _shm);
+static bool IsPeerGone(TCP_Shm_t* _shm);
+static void CopyIn(unsigned char* _ring, uint32_t _mask, uint32_t _at, const void* _data, uint32_t _length);
+static void CopyOut(const unsigned char* _ring, uint32_t _mask, uint32_t _at, void* _data, uint32_t _length);
+static int Futex(uint32_t* _word, int _op, uint32_t _value, uint _timeoutMS);
+static bool PeerIdentity(int _socketFD, pid_t* _pid, uid_t* _uid);
+static bool LoopbackOwner(const char* _table, const char* _peerAddress, uint _peerPort, const char* _ownAddress, uint _ownPort, uid_t* _uid);
+static void FormatAddress(const struct sockaddr_storage* _address, char* _hex, uint* _port, bool* _isV4);
+static void Unmap(TCP_Shm_t* _shm);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Shm_t* TCP_ShmCreate(int _socketFD, uint _ringSize, TCP_ShmHello_t* _hello)
+{
+	static uint s_segmentsNum = 0;
+	TCP_Shm_t* aShm;
+	ShmSegment_t* segment;
+	size_t segmentSize;
+	int shmFD;
+
+	if (NULL == _hello || _ringSize < TCP_SHM_MIN_RING_SIZE || _ringSize > TCP_SHM_MAX_RING_SIZE
+		|| (_ringSize & (_ringSize - 1)) != 0)
+	{
+		return NULL;
+	}
+
+	memset(_hello, 0, sizeof(*_hello) );
+	memcpy(_hello->m_magic, TCP_SHM_MAGIC, TCP_SHM_MAGIC_LENGTH);
+	_hello->m_ringSize = _ringSize;
+	snprintf(_hello->m_name, TCP_SHM_NAME_LENGTH, SHM_NAME_PREFIX "%d_%d_%u", (int) getpid(), _socketFD, s_segmentsNum++);
+
+	shmFD = shm_open(_hello->m_name, O_RDWR | O_CREAT | O_EXCL, SHM_MODE);
+	if (shmFD < 0)
+	{
+		perror("ShmCreate shm_open Failed");
+		return NULL;
+	}
+
+	segmentSize = sizeof(ShmSegment_t) + 2 * (size_t) _ringSize;
+	if (ftruncate(shmFD, segmentSize) < 0)
+	{
+		perror("ShmCreate ftruncate Failed");
+		close(shmFD);
+		shm_unlink(_hello->m_name);
+		return NULL;
+	}
+
+	aShm = MapSegment(_socketFD, shmFD, _hello->m_name, segmentSize, FALSE);
+	close(shmFD);
+	if (! aShm)
+	{
+		shm_unlink(_hello->m_name);
+		return NULL;
+	}
+
+	/* fresh pages are zero. both readers start asleep, so the first write wakes them */
+	segment = aShm->m_segment;
+	segment->m_ringSize = _ringSize;
+	segment->m_toServer.m_isReaderWaiting = 1;
+	segment->m_toClient.m_isReaderWaiting = 1;
+	memcpy(segment->m_magic, TCP_SHM_MAGIC, TCP_SHM_MAGIC_LENGTH);
+	aShm->m_mask = _ringSize - 1;
+
+	return aShm;
+}
+
+TCP_Shm_t* TCP_ShmAttach(int _socketFD, const TCP_ShmHello_t* _hello)
+{
+	TCP_Shm_t* aShm;
+	struct stat shmStat;
+	char name[TCP_SHM_NAME_LENGTH];
+	size_t segmentSize;
+	int shmFD;
+	pid_t peerPid;
+	uid_t peerUid;
+	int namePid;
+
+	if (NULL == _hello || memcmp(_hello->m_magic, TCP_SHM_MAGIC, TCP_SHM_MAGIC_LENGTH) != 0)
+	{
+		return NULL;
+	}
+
+	/* the handshake came from the network side, trust nothing in it */
+	memcpy(name, _hello->m_name, TCP_SHM_NAME_LENGTH);
+	name[TCP_SHM_NAME_LENGTH - 1] = '\0';
+	if (strncmp(name, SHM_NAME_PREFIX, sizeof(SHM_NAME_PREFIX) - 1) != 0 || strchr(name + 1, '/')
+		|| _hello->m_ringSize < TCP_SHM_MIN_RING_SIZE || _hello->m_ringSize > TCP_SHM_MAX_RING_SIZE
+		|| (_hello->m_ringSize & (_hello->m_ringSize - 1)) != 0)
+	{
+		return NULL;
+	}
+
+	/* a process of this host only, and the one that made the segment. its pid is in the name */
+	if (! PeerIdentity(_socketFD, &peerPid, &peerUid) || sscanf(name + sizeof(SHM_NAME_PREFIX) - 1, "%d_", &namePid) != 1
+		|| (peerPid > 0 && peerPid != namePid) )
+	{
+		return NULL;
+	}
+
+	shmFD = shm_open(name, O_RDWR, 0);
+	if (shmFD < 0)
+	{
+		perror("ShmAttach shm_open Failed");
+		return NULL;
+	}
+
+	segmentSize = sizeof(ShmSegment_t) + 2 * (size_t) _hello->m_ringSize;
+	if (fstat(shmFD, &shmStat) < 0 || (size_t) shmStat.st_size != segmentSize
+		|| shmStat.st_uid != peerUid || (shmStat.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)) != SHM_MODE)
+	{
+		close(shmFD);
+		return NULL;
+	}
+
+	aShm = MapSegment(_socketFD, shmFD, name, segmentSize, TRUE);
+	close(shmFD);
+	if (! aShm)
+	{
+		return NULL;
+	}
+
+	/* not another client's. the rings take one server, a second one would corrupt them. it is left as it is */
+	if (memcmp(aShm->m_segment->m_magic, TCP_SHM_MAGIC, TCP_SHM_MAGIC_LENGTH) != 0
+		|| aShm->m_segment->m_ringSize != _hello->m_ringSize
+		|| __atomic_exchange_n(&aShm->m_segment->m_isAttached, 1, __ATOMIC_ACQ_REL) )
+	{
+		Unmap(aShm);
+		return NULL;
+	}
+	aShm->m_mask = _hello->m_ringSize - 1;
+
+	return aShm;
+}
+
+void TCP_ShmUnlink(TCP_Shm_t* _shm)
+{
+	if (! IsStructValid(_shm) || _shm->m_name[0] == '\0')
+	{
+		return;
+	}
+
+	shm_unlink(_shm->m_name);
+	_shm->m_name[0] = '\0';
+}
+
+void TCP_ShmDetach(TCP_Shm_t* _shm)
+{
+	if (! IsStructValid(_shm) )
+	{
+		return;
+	}
+
+	_shm->m_magicNumber = DEAD_MAGIC_NUMBER;
+
+	/* a client sleeping on its ring should wake to see the flag */
+	__atomic_store_n(&_shm->m_segment->m_isClosed, 1, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&_shm->m_out->m_isReaderWaiting, 0, __ATOMIC_SEQ_CST);
+	Futex(&_shm->m_out->m_isReaderWaiting, FUTEX_WAKE, 1, 0);
+
+	if (_shm->m_name[0] != '\0')
+	{
+		/* the handshake never completed */
+		shm_unlink(_shm->m_name);
+	}
+
+	Unmap(_shm);
+}
+
+int TCP_ShmWrite(TCP_Shm_t* _shm, const void* _msg, uint _msgLength, uint _requestID, uint _waitMS)
+{
+	uint32_t header[2];
+	uint32_t head;
+	uint32_t needed;
+	struct timespec start, now;
+	bool isTimeTaken = FALSE;
+
+	if (! IsStructValid(_shm) || NULL == _msg || _msgLength > (_shm->m_mask + 1) / 2)
+	{
+		return GENERAL_ERROR;
+	}
+	if (__atomic_load_n(&_shm->m_segment->m_isClosed, __ATOMIC_ACQUIRE) )
+	{
+		return GENERAL_ERROR;
+	}
+	if (0 == _msgLength)
+	{
+		/* a zero length read means the peer is gone, so nothing is written */
+		return 0;
+	}
+
+	head = _shm->m_out->m_head;
+	needed = TCP_SHM_RECORD_HEADER_SIZE + _msgLength;
+
+	while (_shm->m_mask + 1 - (head - __atomic_load_n(&_shm->m_out->m_tail, __ATOMIC_ACQUIRE) ) < needed)
+	{
+		/* full. the reader is busy, so it does not need a wake up, only time */
+		if (0 == _waitMS || __atomic_load_n(&_shm->m_segment->m_isClosed, __ATOMIC_ACQUIRE) )
+		{
+			return 0;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (! isTimeTaken)
+		{
+			start = now;
+			isTimeTaken = TRUE;
+		}
+		if ( (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 >= _waitMS)
+		{
+			return 0;
+		}
+		sched_yield();
+	}
+
+	header[0] = _msgLength;
+	header[1] = _requestID;
+	CopyIn(_shm->m_outData, _shm->m_mask, head, header, TCP_SHM_RECORD_HEADER_SIZE);
+	CopyIn(_shm->m_outData, _shm->m_mask, head + TCP_SHM_RECORD_HEADER_SIZE, _msg, _msgLength);
+	__atomic_store_n(&_shm->m_out->m_head, head + needed, __ATOMIC_RELEASE);
+
+	/* pairs with the fence in TCP_ShmArm. one of the two sides sees the other */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&_shm->m_out->m_isReaderWaiting, __ATOMIC_RELAXED)
+		&& __atomic_exchange_n(&_shm->m_out->m_isReaderWaiting, 0, __ATOMIC_SEQ_CST) )
+	{
+		WakeReader(_shm);
+	}
+
+	return _msgLength;
+}
+
+int TCP_ShmRead(TCP_Shm_t* _shm, void* _buffer, uint _bufferMaxLength, uint* _requestID, bool _isBlocking)
+{
+	uint32_t header[2];
+	uint32_t tail;
+	uint32_t used;
+
+	if (! IsStructValid(_shm) || NULL == _buffer)
+	{
+		return GENERAL_ERROR;
+	}
+
+	tail = _shm->m_in->m_tail;
+	used = __atomic_load_n(&_shm->m_in->m_head, __ATOMIC_ACQUIRE) - tail;
+	while (0 == used)
+	{
+		if (__atomic_load_n(&_shm->m_segment->m_isClosed, __ATOMIC_ACQUIRE) )
+		{
+			return 0;
+		}
+		if (! _isBlocking)
+		{
+			return TCP_SHM_EMPTY;
+		}
+		if (! WaitForMessage(_shm) )
+		{
+			return 0;
+		}
+		used = __atomic_load_n(&_shm->m_in->m_head, __ATOMIC_ACQUIRE) - tail;
+	}
+
+	/* the peer is another process. a record that does not fit what was written is garbage */
+	if (used < TCP_SHM_RECORD_HEADER_SIZE || used > _shm->m_mask + 1)
+	{
+		return TCP_SHM_BROKEN;
+	}
+	CopyOut(_shm->m_inData, _shm->m_mask, tail, header, TCP_SHM_RECORD_HEADER_SIZE);
+	if (0 == header[0] || header[0] > used - TCP_SHM_RECORD_HEADER_SIZE)
+	{
+		return TCP_SHM_BROKEN;
+	}
+
+	CopyOut(_shm->m_inData, _shm->m_mask, tail + TCP_SHM_RECORD_HEADER_SIZE, _buffer,
+			header[0] < _bufferMaxLength ? header[0] : _bufferMaxLength);
+	__atomic_store_n(&_shm->m_in->m_tail, tail + TCP_SHM_RECORD_HEADER_SIZE + header[0], __ATOMIC_RELEASE);
+
+	if (_requestID)
+	{
+		*_requestID = header[1];
+	}
+
+	return header[0] < _bufferMaxLength ? header[0] : _bufferMaxLength;
+}
+
+bool TCP_ShmArm(TCP_Shm_t* _shm)
+{
+	if (! IsStructValid(_shm) )
+	{
+		return TRUE;
+	}
+
+	__atomic_store_n(&_shm->m_in->m_isReaderWaiting, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&_shm->m_in->m_head, __ATOMIC_ACQUIRE) != _shm->m_in->m_tail)
+	{
+		/* the writer may have missed the flag. no wake up is coming for this one */
+		__atomic_store_n(&_shm->m_in->m_isReaderWaiting, 0, __ATOMIC_RELAXED);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool IsStructValid(TCP_Shm_t* _shm)
+{
+	return !(NULL == _shm || ALIVE_MAGIC_NUMBER != _shm->m_magicNumber);
+}
+
+static TCP_Shm_t* MapSegment(int _socketFD, int _shmFD, const char* _name, size_t _segmentSize, bool _isServer)
+{
+	TCP_Shm_t* aShm;
+	ShmSegment_t* segment;
+	unsigned char* data;
+	size_t ringSize = (_segmentSize - sizeof(ShmSegment_t) ) / 2;
+
+	segment = mmap(NULL, _segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, _shmFD, 0);
+	if (MAP_FAILED == segment)
+	{
+		perror("Shm mmap Failed");
+		return NULL;
+	}
+
+	aShm = malloc(1 * sizeof(TCP_Shm_t) );
+	if (! aShm)
+	{
+		munmap(segment, _segmentSize);
+		return NULL;
+	}
+
+	data = (unsigned char*) (segment + 1);
+
+	aShm->m_socketFD = _socketFD;
+	aShm->m_isServer = _isServer;
+	strcpy(aShm->m_name, _name);
+	aShm->m_segment = segment;
+	aShm->m_segmentSize = _segmentSize;
+	aShm->m_mask = ringSize - 1;
+	if (_isServer)
+	{
+		aShm->m_out = &segment->m_toClient;
+		aShm->m_outData = data + ringSize;
+		aShm->m_in = &segment->m_toServer;
+		aShm->m_inData = data;
+		/* the client owns the name */
+		aShm->m_name[0] = '\0';
+	}
+	else
+	{
+		aShm->m_out = &segment->m_toServer;
+		aShm->m_outData = data;
+		aShm->m_in = &segment->m_toClient;
+		aShm->m_inData = data + ringSize;
+	}
+
+	aShm->m_magicNumber = ALIVE_MAGIC_NUMBER;
+
+	return aShm;
+}
+
+static void Unmap(TCP_Shm_t* _shm)
+{
+	_shm->m_magicNumber = DEAD_MAGIC_NUMBER;
+	munmap(_shm->m_segment, _shm->m_segmentSize);
+	free(_shm);
+}
+
+/* the peer of a connection, if it is on this host. its pid is known on a Unix socket only, 0 on TCP */
+static bool PeerIdentity(int _socketFD, pid_t* _pid, uid_t* _uid)
+{
+	struct sockaddr_storage peer;
+	struct sockaddr_storage own;
+	socklen_t length = sizeof(peer);
+	struct ucred credentials;
+	socklen_t credentialsLength = sizeof(credentials);
+	char peerHex[PROC_ADDRESS_SIZE];
+	char ownHex[PROC_ADDRESS_SIZE];
+	uint peerPort;
+	uint ownPort;
+	bool isV4;
+
+	if (getpeername(_socketFD, (struct sockaddr*) &peer, &length) < 0)
+	{
+		return FALSE;
+	}
+
+	if (AF_UNIX == peer.ss_family)
+	{
+		if (getsockopt(_socketFD, SOL_SOCKET, SO_PEERCRED, &credentials, &credentialsLength) < 0)
+		{
+			return FALSE;
+		}
+		*_pid = credentials.pid;
+		*_uid = credentials.uid;
+		return TRUE;
+	}
+
+	if (! (AF_INET == peer.ss_family && (ntohl(((struct sockaddr_in*) &peer)->sin_addr.s_addr) >> 24) == 127)
+		&& ! (AF_INET6 == peer.ss_family && (IN6_IS_ADDR_LOOPBACK(&((struct sockaddr_in6*) &peer)->sin6_addr)
+			|| (IN6_IS_ADDR_V4MAPPED(&((struct sockaddr_in6*) &peer)->sin6_addr)
+				&& ((struct sockaddr_in6*) &peer)->sin6_addr.s6_addr[12] == 127) ) ) )
+	{
+		/* the segment name means nothing on another host, and another host may not pick one of this host */
+		return FALSE;
+	}
+
+	/* TCP does not tell who is on the other side. the kernel table of the sockets does, by the peer's own socket */
+	length = sizeof(own);
+	if (getsockname(_socketFD, (struct sockaddr*) &own, &length) < 0)
+	{
+		return FALSE;
+	}
+	FormatAddress(&peer, peerHex, &peerPort, &isV4);
+	FormatAddress(&own, ownHex, &ownPort, &isV4);
+	*_pid = 0;
+	return LoopbackOwner(isV4 ? PROC_NET_TCP : PROC_NET_TCP6, peerHex, peerPort, ownHex, ownPort, _uid);
+}
+
+/* the uid of the socket at _peerAddress:_peerPort connected to _ownAddress:_ownPort, from the kernel table */
+static bool LoopbackOwner(const char* _table, const char* _peerAddress, uint _peerPort, const char* _ownAddress, uint _ownPort, uid_t* _uid)
+{
+	char line[PROC_LINE_SIZE];
+	char local[PROC_ADDRESS_SIZE];
+	char remote[PROC_ADDRESS_SIZE];
+	uint localPort;
+	uint remotePort;
+	uint uid;
+	bool isFound = FALSE;
+	FILE* table;
+
+	table = fopen(_table, "r");
+	if (! table)
+	{
+		return FALSE;
+	}
+
+	/* sl local_address rem_address st tx_queue:rx_queue tr:tm->when retrnsmt uid ... */
+	while (! isFound && fgets(line, sizeof(line), table) )
+	{
+		if (sscanf(line, "%*s %32[0-9A-Fa-f]:%x %32[0-9A-Fa-f]:%x %*s %*s %*s %*s %u", local, &localPort, remote, &remotePort, &uid) == 5
+			&& localPort == _peerPort && remotePort == _ownPort && strcasecmp(local, _peerAddress) == 0
+			&& strcasecmp(remote, _ownAddress) == 0)
+		{
+			*_uid = uid;
+			isFound = TRUE;
+		}
+	}
+	fclose(table);
+	return isFound;
+}
+
+/* as the kernel table writes it: each 32 bits of the address as a number in hex. a mapped IPv4 address as IPv4 */
+static void FormatAddress(const struct sockaddr_storage* _address, char* _hex, uint* _port, bool* _isV4)
+{
+	const struct sockaddr_in6* address6 = (const struct sockaddr_in6*) _address;
+	uint32_t words[4];
+	uint i;
+
+	if (AF_INET == _address->ss_family)
+	{
+		snprintf(_hex, PROC_ADDRESS_SIZE, "%08X", ((const struct sockaddr_in*) _address)->sin_addr.s_addr);
+		*_port = ntohs(((const struct sockaddr_in*) _address)->sin_port);
+		*_isV4 = TRUE;
+		return;
+	}
+
+	memcpy(words, &address6->sin6_addr, sizeof(words) );
+	*_port = ntohs(address6->sin6_port);
+	*_isV4 = IN6_IS_ADDR_V4MAPPED(&address6->sin6_addr);
+	if (*_isV4)
+	{
+		snprintf(_hex, PROC_ADDRESS_SIZE, "%08X", words[3]);
+		return;
+	}
+	for (i = 0; i < 4; ++i)
+	{
+		snprintf(_hex + 8 * i, PROC_ADDRESS_SIZE - 8 * i, "%08X", words[i]);
+	}
+}
+
+static void WakeReader(TCP_Shm_t* _shm)
+{
+	char doorbell = 1;
+
+	if (_shm->m_isServer)
+	{
+		Futex(&_shm->m_out->m_isReaderWaiting, FUTEX_WAKE, 1, 0);
+	}
+	else if (send(_shm->m_socketFD, &doorbell, 1, MSG_NOSIGNAL | MSG_DONTWAIT) < 0 && errno != EAGAIN)
+	{
+		/* a full socket buffer is already a doorbell nobody answered yet */
+		perror("Shm doorbell Failed");
+	}
+}
+
+/* client side. returns FALSE when the server is gone */
+static bool WaitForMessage(TCP_Shm_t* _shm)
+{
+	static long s_cpusNum = 0;
+	uint spins;
+
+	if (0 == s_cpusNum)
+	{
+		s_cpusNum = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+
+	for (spins = 0; s_cpusNum > 1 && spins < SPIN_COUNT; ++spins)
+	{
+		if (__atomic_load_n(&_shm->m_in->m_head, __ATOMIC_ACQUIRE) != _shm->m_in->m_tail)
+		{
+			return TRUE;
+		}
+		CPU_RELAX();
+	}
+
+	while (TCP_ShmArm(_shm) )
+	{
+		if (__atomic_load_n(&_shm->m_segment->m_isClosed, __ATOMIC_ACQUIRE) )
+		{
+			return FALSE;
+		}
+		if (Futex(&_shm->m_in->m_isReaderWaiting, FUTEX_WAIT, 1, SLEEP_SLICE_MS) < 0
+			&& errno == ETIMEDOUT && IsPeerGone(_shm) )
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* a server that crashed never sets the closed flag. the connection tells */
+static bool IsPeerGone(TCP_Shm_t* _shm)
+{
+	char peek;
+	int result;
+
+	result = recv(_shm->m_socketFD, &peek, 1, MSG_PEEK | MSG_DONTWAIT);
+	return (0 == result || (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) );
+}
+
+static void CopyIn(unsigned char* _ring, uint32_t _mask, uint32_t _at, const void* _data, uint32_t _length)
+{
+	uint32_t offset = _at & _mask;
+	uint32_t first = (_mask + 1 - offset < _length) ? _mask + 1 - offset : _length;
+
+	memcpy(_ring + offset, _data, first);
+	memcpy(_ring, (const unsigned char*) _data + first, _length - first);
+}
+
+static void CopyOut(const unsigned char* _ring, uint32_t _mask, uint32_t _at, void* _data, uint32_t _length)
+{
+	uint32_t offset = _at & _mask;
+	uint32_t first = (_mask + 1 - offset < _length) ? _mask + 1 - offset : _length;
+
+	memcpy(_data, _ring + offset, first);
+	memcpy((unsigned char*) _data + first, _ring, _length - first);
+}
+
+/* shared (not private) futex, the word is in memory mapped by two processes */
+static int Futex(uint32_t* _word, int _op, uint32_t _value, uint _timeoutMS)
+{
+	struct timespec timeout;
+
+	timeout.tv_sec = _timeoutMS / 1000;
+	timeout.tv_nsec = (_timeoutMS % 1000) * 1000000L;
+
+	return syscall(SYS_futex, _word, _op, _value, (FUTEX_WAIT == _op) ? &timeout : NULL, NULL, 0);
+}
@@ -0,0 +1,125 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief Shared-memory transport for clients on the same host as the server.
+ * A segment holds two single-producer single-consumer byte rings, one per direction. the rings are lock free,
+ * each message is a record of length, request ID and payload.
+ * The segment is created by the client, and its name is handed to the server over the normal TCP or Unix connection.
+ * That connection stays open. it tells each side when the other is gone, and carries the client to server wakeups.
+ * A consumer is woken only when it went to sleep on an empty ring:
+ *   server to client - a futex in the segment. the client spins a little before sleeping on it.
+ *   client to server - a doorbell byte on the connection, as the server sleeps in select.
+ *
+ * @bug
+ */
+
+#ifndef TCP_SHM_H_
+#define TCP_SHM_H_
+
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define TCP_SHM_MAGIC "TCPSHM01"
+#define TCP_SHM_MAGIC_LENGTH 8
+#define TCP_SHM_NAME_LENGTH 64
+
+/* bytes of each ring. power of 2 */
+#define TCP_SHM_DEFAULT_RING_SIZE (1 << 20)
+#define TCP_SHM_MIN_RING_SIZE (1 << 12)
+#define TCP_SHM_MAX_RING_SIZE (1 << 26)
+
+/* length and request ID before each payload */
+#define TCP_SHM_RECORD_HEADER_SIZE 8
+
+/* reply of the server to the handshake */
+#define TCP_SHM_ACCEPT 'Y'
+#define TCP_SHM_REJECT 'N'
+
+/* TCP_ShmRead results other than a length */
+#define TCP_SHM_EMPTY -1
+#define TCP_SHM_BROKEN -2
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the handshake, sent by the client as the first bytes of the connection */
+typedef struct TCP_ShmHello
+{
+	char m_magic[TCP_SHM_MAGIC_LENGTH];
+	uint32_t m_ringSize;
+	char m_name[TCP_SHM_NAME_LENGTH]; /* null terminated */
+} TCP_ShmHello_t;
+
+typedef struct TCP_Shm TCP_Shm_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief client side. create and map a new segment, and fill the handshake to send to the server.
+ * @param _socketFD the connection to the server
+ * @param _ringSize bytes of each ring. power of 2 between TCP_SHM_MIN_RING_SIZE and TCP_SHM_MAX_RING_SIZE.
+ * @param _hello output. the handshake.
+ * @return a pointer to the struct. NULL if failed.
+ */
+TCP_Shm_t* TCP_ShmCreate(int _socketFD, uint _ringSize, TCP_ShmHello_t* _hello);
+
+/**
+ * @brief server side. map the segment named in a handshake. only for a peer on this host, over a Unix socket or
+ * loopback TCP, whose user owns the segment, which only its user may open. on a Unix socket the peer must also be the
+ * process that made it. a segment is attached once, a second handshake naming it is refused.
+ * @param _socketFD the connection the handshake arrived on
+ * @param _hello the handshake as received
+ * @return a pointer to the struct. NULL if the handshake, the peer or the segment are not valid.
+ */
+TCP_Shm_t* TCP_ShmAttach(int _socketFD, const TCP_ShmHello_t* _hello);
+
+/**
+ * @brief remove the segment name. call once both sides mapped it, the memory stays until both unmap.
+ * @param _shm pointer to the struct
+ * @return void
+ */
+void TCP_ShmUnlink(TCP_Shm_t* _shm);
+
+/**
+ * @brief mark the segment closed, wake the peer and unmap. the connection socket is not closed.
+ * @param _shm pointer to the struct
+ * @return void. silent fail.
+ */
+void TCP_ShmDetach(TCP_Shm_t* _shm);
+
+/**
+ * @brief write one message to the peer, and wake it if it sleeps.
+ * @param _shm pointer to the struct
+ * @param _msg the data.
+ * @param _msgLength the data size. up to half the ring size.
+ * @param _requestID carried to the reader as is
+ * @param _waitMS how long to wait for room when the ring is full. 0 to fail at once.
+ * @return _msgLength if written. 0 if the ring is full. negative number on error or if the peer is gone. an empty message is not written.
+ */
+int TCP_ShmWrite(TCP_Shm_t* _shm, const void* _msg, uint _msgLength, uint _requestID, uint _waitMS);
+
+/**
+ * @brief read one message. a message longer than the buffer is cut to the buffer size.
+ * @param _shm pointer to the struct
+ * @param _buffer output
+ * @param _bufferMaxLength the buffer size
+ * @param _requestID output. can be NULL.
+ * @param _isBlocking FALSE to return at once when the ring is empty. TRUE to wait for a message, spinning first, then sleeping.
+ * @return the message length. TCP_SHM_EMPTY when not blocking and the ring is empty. 0 when the peer is gone. TCP_SHM_BROKEN when the peer wrote garbage.
+ */
+int TCP_ShmRead(TCP_Shm_t* _shm, void* _buffer, uint _bufferMaxLength, uint* _requestID, bool _isBlocking);
+
+/**
+ * @brief the reader is about to sleep. after it the writer wakes the reader on the next write.
+ * @param _shm pointer to the struct
+ * @return TRUE if the ring is still empty and it is safe to sleep. FALSE if a message slipped in, read again.
+ */
+bool TCP_ShmArm(TCP_Shm_t* _shm);
+
+#endif /* TCP_SHM_H_ */
@@ -0,0 +1,369 @@
+/*
+ * tcp_timer.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yuval Hamberg
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "tcp_timer.h"
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#define ALIVE_MAGIC_NUMBER 0xfadeface
+#define DEAD_MAGIC_NUMBER 0xdeadface
+
+#define START_CAPACITY 64
+
+/* a timer ID is the slot index + 1 in its low bits, and the slot generation above them */
+#define SLOT_BITS 24
+#define SLOT_MASK ((1u << SLOT_BITS) - 1)
+#define MAKE_ID(slot, generation) ((((generation) & 0xff) << SLOT_BITS) | ((slot) + 1))
+
+#define NOT_IN_HEAP ((uint) -1)
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct Timer
+{
+	uint64_t m_deadline;
+	uint64_t m_seq; /* order of scheduling. breaks deadline ties, and keeps a run from firing what it scheduled */
+	uint m_periodMS;
+	uint m_heapIndex; /* NOT_IN_HEAP while free */
+	uint m_generation;
+	uint m_nextFree;
+	timerFunc m_func;
+	void* m_contex;
+} Timer_t;
+
+struct TCP_Timers
+{
+	uint m_magicNumber;
+
+	Timer_t* m_slots;
+	uint m_slotsNum; /* slots ever used */
+	uint m_capacity;
+	uint m_freeHead; /* slot index + 1 of the first free slot, 0 when none */
+
+	uint* m_heap; /* slot indexes, smallest deadline first */
+	uint m_heapNum;
+
+	uint64_t m_nextSeq;
+};
+
+/* ~~~ Internal function forward declaration ~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool Grow(TCP_Timers_t* _timers);
+static Timer_t* FindTimer(TCP_Timers_t* _timers, uint _timerID);
+static void Schedule(TCP_Timers_t* _timers, uint _slot, uint64_t _deadline);
+static void HeapRemove(TCP_Timers_t* _timers, uint _heapIndex);
+static void SiftUp(TCP_Timers_t* _timers, uint _heapIndex);
+static void SiftDown(TCP_Timers_t* _timers, uint _heapIndex);
+static bool IsEarlier(TCP_Timers_t* _timers, uint _slotA, uint _slotB);
+static void PlaceAt(TCP_Timers_t* _timers, uint _heapIndex, uint _slot);
+static void FreeSlot(TCP_Timers_t* _timers, uint _slot);
+static bool IsStructValid(TCP_Timers_t* _timers);
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TCP_Timers_t* TCP_TimersCreate(void)
+{
+	TCP_Timers_t* aTimers = calloc(1, sizeof(TCP_Timers_t) );
+	if (! aTimers)
+	{
+		return NULL;
+	}
+
+	aTimers->m_magicNumber = ALIVE_MAGIC_NUMBER;
+	return aTimers;
+}
+
+void TCP_TimersDestroy(TCP_Timers_t* _timers)
+{
+	if (! IsStructValid(_timers) )
+	{
+		return;
+	}
+
+	_timers->m_magicNumber = DEAD_MAGIC_NUMBER;
+	free(_timers->m_slots);
+	free(_timers->m_heap);
+	free(_timers);
+}
+
+uint64_t TCP_TimersNowMS(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+uint TCP_TimersAdd(TCP_Timers_t* _timers, uint _delayMS, uint _periodMS, timerFunc _func, void* _contex)
+{
+	Timer_t* timer;
+	uint slot;
+
+	if (! IsStructValid(_timers) || NULL == _func)
+	{
+		return 0;
+	}
+
+	if (_timers->m_freeHead)
+	{
+		slot = _timers->m_freeHead - 1;
+		_timers->m_freeHead = _timers->m_slots[slot].m_nextFree;
+	}
+	else
+	{
+		if (_timers->m_slotsNum == TCP_TIMERS_MAX || (_timers->m_slotsNum == _timers->m_capacity && ! Grow(_timers) ) )
+		{
+			return 0;
+		}
+		slot = _timers->m_slotsNum++;
+		_timers->m_slots[slot].m_generation = 0;
+	}
+
+	timer = &_timers->m_slots[slot];
+	timer->m_periodMS = _periodMS;
+	timer->m_func = _func;
+	timer->m_contex = _contex;
+	Schedule(_timers, slot, TCP_TimersNowMS() + _delayMS);
+
+	return MAKE_ID(slot, timer->m_generation);
+}
+
+bool TCP_TimersCancel(TCP_Timers_t* _timers, uint _timerID)
+{
+	Timer_t* timer;
+
+	if (! IsStructValid(_timers) )
+	{
+		return FALSE;
+	}
+
+	timer = FindTimer(_timers, _timerID);
+	if (! timer)
+	{
+		return FALSE;
+	}
+
+	HeapRemove(_timers, timer->m_heapIndex);
+	FreeSlot(_timers, (_timerID & SLOT_MASK) - 1);
+	return TRUE;
+}
+
+int TCP_TimersNextMS(TCP_Timers_t* _timers, uint64_t _nowMS)
+{
+	uint64_t deadline;
+
+	if (! IsStructValid(_timers) || 0 == _timers->m_heapNum)
+	{
+		return -1;
+	}
+
+	deadline = _timers->m_slots[_timers->m_heap[0]].m_deadline;
+	if (deadline <= _nowMS)
+	{
+		return 0;
+	}
+	/* a very far timer wakes the loop early, it just waits again */
+	return (deadline - _nowMS > 0x7fffffff) ? 0x7fffffff : (int) (deadline - _nowMS);
+}
+
+uint TCP_TimersRun(TCP_Timers_t* _timers, uint64_t _nowMS)
+{
+	uint64_t lastSeq;
+	Timer_t* timer;
+	uint fired = 0;
+	uint slot;
+	uint timerID;
+
+	if (! IsStructValid(_timers) )
+	{
+		return 0;
+	}
+
+	lastSeq = _timers->m_nextSeq;
+	while (_timers->m_heapNum > 0)
+	{
+		slot = _timers->m_heap[0];
+		timer = &_timers->m_slots[slot];
+		if (timer->m_deadline > _nowMS || timer->m_seq >= lastSeq)
+		{
+			break;
+		}
+
+		timerID = MAKE_ID(slot, timer->m_generation);
+		HeapRemove(_timers, 0);
+		if (timer->m_periodMS)
+		{
+			/* keeps its rhythm. a loop that fell behind fires it once, not once for every period missed */
+			Schedule(_timers, slot, (timer->m_deadline + timer->m_periodMS > _nowMS) ? timer->m_deadline + timer->m_periodMS : _nowMS + timer->m_periodMS);
+			if (! timer->m_func(timerID, timer->m_contex) )
+			{
+				/* it may have canceled itself already */
+				TCP_TimersCancel(_timers, timerID);
+			}
+		}
+		else
+		{
+			timerFunc func = timer->m_func;
+			void* contex = timer->m_contex;
+
+			/* gone before the call, so the function may add timers in its place */
+			FreeSlot(_timers, slot);
+			func(timerID, contex);
+		}
+		++fired;
+	}
+
+	return fired;
+}
+
+uint TCP_TimersNum(TCP_Timers_t* _timers)
+{
+	return IsStructValid(_timers) ? _timers->m_heapNum : 0;
+}
+
+/* ~~~ Internal function  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool Grow(TCP_Timers_t* _timers)
+{
+	uint newCapacity = _timers->m_capacity ? _timers->m_capacity * 2 : START_CAPACITY;
+	Timer_t* newSlots;
+	uint* newHeap;
+
+	newSlots = realloc(_timers->m_slots, newCapacity * sizeof(Timer_t) );
+	if (! newSlots)
+	{
+		return FALSE;
+	}
+	_timers->m_slots = newSlots;
+
+	newHeap = realloc(_timers->m_heap, newCapacity * sizeof(uint) );
+	if (! newHeap)
+	{
+		return FALSE;
+	}
+	_timers->m_heap = newHeap;
+
+	_timers->m_capacity = newCapacity;
+	return TRUE;
+}
+
+/* NULL if the ID does not name a pending timer */
+static Timer_t* FindTimer(TCP_Timers_t* _timers, uint _timerID)
+{
+	uint slot = (_timerID & SLOT_MASK) - 1;
+	Timer_t* timer;
+
+	if (0 == (_timerID & SLOT_MASK) || slot >= _timers->m_slotsNum)
+	{
+		return NULL;
+	}
+
+	timer = &_timers->m_slots[slot];
+	if (timer->m_heapIndex == NOT_IN_HEAP || MAKE_ID(slot, timer->m_generation) != _timerID)
+	{
+		return NULL;
+	}
+	return timer;
+}
+
+static void Schedule(TCP_Timers_t* _timers, uint _slot, uint64_t _deadline)
+{
+	Timer_t* timer = &_timers->m_slots[_slot];
+
+	timer->m_deadline = _deadline;
+	timer->m_seq = _timers->m_nextSeq++;
+
+	PlaceAt(_timers, _timers->m_heapNum++, _slot);
+	SiftUp(_timers, timer->m_heapIndex);
+}
+
+static void HeapRemove(TCP_Timers_t* _timers, uint _heapIndex)
+{
+	uint last = _timers->m_heap[--_timers->m_heapNum];
+
+	_timers->m_slots[_timers->m_heap[_heapIndex]].m_heapIndex = NOT_IN_HEAP;
+	if (_heapIndex == _timers->m_heapNum)
+	{
+		return;
+	}
+
+	/* the last one fills the hole, and moves whichever way it has to */
+	PlaceAt(_timers, _heapIndex, last);
+	SiftUp(_timers, _heapIndex);
+	SiftDown(_timers, _timers->m_slots[last].m_heapIndex);
+}
+
+static void SiftUp(TCP_Timers_t* _timers, uint _heapIndex)
+{
+	uint slot = _timers->m_heap[_heapIndex];
+	uint parent;
+
+	while (_heapIndex > 0)
+	{
+		parent = (_heapIndex - 1) / 2;
+		if (! IsEarlier(_timers, slot, _timers->m_heap[parent]) )
+		{
+			break;
+		}
+		PlaceAt(_timers, _heapIndex, _timers->m_heap[parent]);
+		_heapIndex = parent;
+	}
+	PlaceAt(_timers, _heapIndex, slot);
+}
+
+static void SiftDown(TCP_Timers_t* _timers, uint _heapIndex)
+{
+	uint slot = _timers->m_heap[_heapIndex];
+	uint child;
+
+	while ((child = 2 * _heapIndex + 1) < _timers->m_heapNum)
+	{
+		if (child + 1 < _timers->m_heapNum && IsEarlier(_timers, _timers->m_heap[child + 1], _timers->m_heap[child]) )
+		{
+			++child;
+		}
+		if (! IsEarlier(_timers, _timers->m_heap[child], slot) )
+		{
+			break;
+		}
+		PlaceAt(_timers, _heapIndex, _timers->m_heap[child]);
+		_heapIndex = child;
+	}
+	PlaceAt(_timers, _heapIndex, slot);
+}
+
+static bool IsEarlier(TCP_Timers_t* _timers, uint _slotA, uint _slotB)
+{
+	Timer_t* a = &_timers->m_slots[_slotA];
+	Timer_t* b = &_timers->m_slots[_slotB];
+
+	return a->m_deadline < b->m_deadline || (a->m_deadline == b->m_deadline && a->m_seq < b->m_seq);
+}
+
+static void PlaceAt(TCP_Timers_t* _timers, uint _heapIndex, uint _slot)
+{
+	_timers->m_heap[_heapIndex] = _slot;
+	_timers->m_slots[_slot].m_heapIndex = _heapIndex;
+}
+
+static void FreeSlot(TCP_Timers_t* _timers, uint _slot)
+{
+	Timer_t* timer = &_timers->m_slots[_slot];
+
+	timer->m_heapIndex = NOT_IN_HEAP;
+	timer->m_generation++;
+	timer->m_nextFree = _timers->m_freeHead;
+	_timers->m_freeHead = _slot + 1;
+}
+
+static bool IsStructValid(TCP_Timers_t* _timers)
+{
+	return (_timers && _timers->m_magicNumber == ALIVE_MAGIC_NUMBER);
+}
@@ -0,0 +1,108 @@
+/**
+ * @author Yuval Hamberg
+ * @date Oct 19, 2026
+ *
+ * @brief One-shot and periodic timers for a single-threaded loop.
+ * Timers are kept in a binary min-heap by deadline, so adding or canceling one costs O(log n), and the loop
+ * learns how long it may sleep from the top of the heap.
+ * A timer ID names a slot with an 8 bit generation, so canceling a timer that already fired is a safe no-op,
+ * even after its slot was reused by up to 255 newer timers.
+ * The server owns one of these (TCP_AddTimer in tcp.h), and runs it between its waits.
+ *
+ * @bug not thread safe, timers are added, canceled and run from the loop thread only.
+ */
+
+#ifndef TCP_TIMER_H_
+#define TCP_TIMER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef int bool;
+#define TRUE 1
+#define FALSE 0
+
+/* ~~~ Defines ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* timers alive at once */
+#define TCP_TIMERS_MAX ((1 << 24) - 1)
+
+/* ~~~ Struct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* invoked when the timer is due. a periodic timer is canceled when it returns FALSE */
+typedef int (*timerFunc)(uint _timerID, void* _contex);
+
+typedef struct TCP_Timers TCP_Timers_t;
+
+/* ~~~ API function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Create an empty set of timers.
+ * @return a pointer to the struct. NULL if failed.
+ */
+TCP_Timers_t* TCP_TimersCreate(void);
+
+/**
+ * @brief Destroy the timers. pending ones never fire.
+ * @param _timers pointer to the struct
+ * @return void
+ */
+void TCP_TimersDestroy(TCP_Timers_t* _timers);
+
+/**
+ * @brief the clock the timers use, in miliseconds. monotonic.
+ * @return the time
+ */
+uint64_t TCP_TimersNowMS(void);
+
+/**
+ * @brief add a timer.
+ * @param _timers pointer to the struct
+ * @param _delayMS first time it fires, from now
+ * @param _periodMS fires again every _periodMS after. 0 for a one-shot timer.
+ * @param _func user function to invoke
+ * @param _contex passed to the function
+ * @return the timer ID, 0 if failed.
+ */
+uint TCP_TimersAdd(TCP_Timers_t* _timers, uint _delayMS, uint _periodMS, timerFunc _func, void* _contex);
+
+/**
+ * @brief cancel a timer. safe inside any timer function, its own included.
+ * @param _timers pointer to the struct
+ * @param _timerID as returned by TCP_TimersAdd
+ * @return TRUE if canceled or FALSE if there is no such timer (fired already, or canceled).
+ */
+bool TCP_TimersCancel(TCP_Timers_t* _timers, uint _timerID);
+
+/**
+ * @brief how long until the next timer is due.
+ * @param _timers pointer to the struct
+ * @param _nowMS current time, from TCP_TimersNowMS
+ * @return miliseconds, 0 if one is due already. -1 if there are no timers.
+ */
+int TCP_TimersNextMS(TCP_Timers_t* _timers, uint64_t _nowMS);
+
+/**
+ * @brief fire every timer due by _nowMS. timers added or rescheduled meanwhile wait for the next call.
+ * @param _timers pointer to the struct
+ * @param _nowMS current time, from TCP_TimersNowMS
+ * @return number of timers fired
+ */
+uint TCP_TimersRun(TCP_Timers_t* _timers, uint64_t _nowMS);
+
+/**
+ * @brief the number of pending timers.
+ * @param _timers pointer to the struct
+ * @return the number
+ */
+uint TCP_TimersNum(TCP_Timers_t* _timers);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCP_TIMER_H_ */